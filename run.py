@@ -101,10 +101,24 @@ KERNEL_INTERRUPT_PATH = {
     "kernel/memory/vmm.c",             # vmm_find_mapped_object, vmm_map_page (demand paging)
     "kernel/memory/pmm.c",             # pmm_alloc, pmm_free (demand paging)
     "klibc/avl.c",                     # called by vmm.c for VMA tree operations
+    "kernel/memory/zswap.c",           # zswap_load on swap-in faults, zswap_store on reclaim
+    "kernel/memory/slab.c",            # zswap chunk alloc/free from the fault path
+    "klibc/lz.c",                      # page (de)compression for zswap
+    "klibc/string.c",                  # kmemset/kmemcpy reached through slab on the fault path
+    "kernel/sys/smp.c",                # reschedule and TLB shootdown IPI handlers
+    "kernel/sys/hrtimer.c",            # hrtimer_run from the timer interrupt
+    "arch/x86_64/cpu/fpu.c",           # fpu_save, fpu_restore from the #NM handler
+    "kernel/sys/futex.c",              # futex_timeout from hrtimer_run
+    "kernel/sys/ktimer.c",             # ktimer_run from the timer interrupt
+    "kernel/sys/waitq.c",              # waitq_timeout from ktimer_run, waitq_wake_all from IRQs
+    "kernel/sys/clocksource.c",        # clock_read_ns from the timer interrupt
 }
 CPPFLAGS = [f"-I{HEADER_DIR}", "-D__ASSEMBLER__"]
 LDFLAGS = ["-n", "-nostdlib", "--gc-sections", f"-T{ROOT_DIR / 'targets/x86_64/linker.ld'}", "--no-relax", "-g"]
 
+# Release builds drop debug only sanity checks (#ifndef NDEBUG), test builds keep them
+CFLAGS_RELEASE = ["-DNDEBUG"]
+
 # Optimization Levels
 CFLAGS_FAST = ["-O2", "-fomit-frame-pointer", "-fpredictive-commoning", "-fstrict-aliasing"]
 CFLAGS_VFAST = ["-O3", "-fpredictive-commoning", "-fstrict-aliasing", "-fno-delete-null-pointer-checks", "-fomit-frame-pointer", "-fno-stack-protector"]
@@ -120,11 +134,11 @@ BUILD_PROFILES = {
         "confirm": False
     },
     "fast": {
-        "flags": CFLAGS_FAST,
+        "flags": CFLAGS_FAST + CFLAGS_RELEASE,
         "confirm": False
     },
     "vfast": {
-        "flags": CFLAGS_VFAST,
+        "flags": CFLAGS_VFAST + CFLAGS_RELEASE,
         "confirm": True,
         "msg": "WARNING: 'vfast' uses aggressive optimizations (-O3, -fno-stack-protector) which may cause unexpected kernel behavior or instability."
     }
@@ -345,9 +359,10 @@ def parse_timeout(val: str) -> Optional[int]:
     if unit == 'h': return num * 3600
     return None
 
-def run_qemu(iso_file: Path, headless: bool = False, timeout: Optional[int] = None):
+def run_qemu(iso_file: Path, headless: bool = False, timeout: Optional[int] = None, smp: int = 4):
     print(f"{GREEN}[SUCCESS] Starting QEMU with {iso_file.name}...{NC}")
     print(f"{CYAN}   > Mode: {'Headless' if headless else 'GUI'}")
+    print(f"   > CPUs: {smp}")
     print(f"   > Timeout: {f'{timeout} seconds' if timeout else 'None'}{NC}")
     
     qemu_cmd = [str(QEMU_EXEC)]
@@ -358,7 +373,8 @@ def run_qemu(iso_file: Path, headless: bool = False, timeout: Optional[int] = No
         "-cdrom", str(iso_file),
         "-serial", "mon:stdio",
         "-serial", f"file:{DEBUG_LOG}",
-        "-cpu", "kvm64,+smep,+smap"
+        "-cpu", "kvm64,+smep,+smap",
+        "-smp", str(smp)
     ]
     
     if headless:
@@ -386,17 +402,19 @@ def print_help():
 {YELLOW}Build Profiles (Optional):{NC}
   {GREEN}default{NC}   Standard debug build
   {GREEN}test{NC}      Defines -DTEST_BUILD
-  {GREEN}fast{NC}      -O2 optimizations
-  {GREEN}vfast{NC}     -O3 aggressive optimizations (Requires confirmation)
+  {GREEN}fast{NC}      -O2 optimizations, release (-DNDEBUG)
+  {GREEN}vfast{NC}     -O3 aggressive optimizations, release (Requires confirmation)
 
 {YELLOW}Run Options (QEMU):{NC}
   {GREEN}headless{NC}      Run QEMU without a GUI (uses -nographic)
   {GREEN}timeout=XX{NC}    Kill QEMU after XX duration (e.g., 10s, 2m, 1h)
+  {GREEN}smp=N{NC}         Number of emulated CPUs (default 4, max 16)
 
 {BLUE}Examples:{NC}
   python run.py all vfast headless
   python run.py build test
   python run.py all timeout=30s
+  python run.py all test smp=1
     """)
 
 # Entry Point
@@ -412,6 +430,7 @@ def main():
     build_profile = "default"
     run_headless = False
     run_timeout = None
+    run_smp = 4
 
     valid_commands = {"all", "build", "clean", "help"}
     valid_build_profiles = set(BUILD_PROFILES.keys())
@@ -431,6 +450,11 @@ def main():
             run_headless = True
         elif arg_lower.startswith("timeout="):
             run_timeout = parse_timeout(arg_lower.split("=")[1])
+        elif arg_lower.startswith("smp="):
+            try:
+                run_smp = max(1, min(16, int(arg_lower.split("=")[1])))
+            except ValueError:
+                print(f"{YELLOW}[WARN] Invalid CPU count '{arg}', using {run_smp}.{NC}")
         else:
             print(f"{YELLOW}[WARN] Unknown argument '{arg}', ignoring.{NC}")
 
@@ -455,7 +479,7 @@ def main():
         
         iso = find_iso_file()
         if iso: 
-            run_qemu(iso, headless=run_headless, timeout=run_timeout)
+            run_qemu(iso, headless=run_headless, timeout=run_timeout, smp=run_smp)
         else:
             sys.stderr.write(f"{RED}[ERROR] ISO file not found after build.{NC}\n")
             sys.exit(1)
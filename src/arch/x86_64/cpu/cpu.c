@@ -10,11 +10,12 @@
 
 #include <arch/x86_64/cpu/cpu.h>
 #include <arch/x86_64/cpu/msr.h>
+#include <arch/x86_64/cpu/fpu.h>
 #include <kernel/debug.h>
 #include <klibc/string.h>
 
 static cpu_info_t cpuinfo;
-cpu_local_t cpu_local = {0};
+cpu_local_t cpu_locals[MAX_CPUS] = {0};
 
 /*
  * cpuid - Execute the CPUID instruction with given EAX and ECX inputs
@@ -100,6 +101,69 @@ void write_xcr0(uint64_t value)
     __asm__ volatile("xsetbv" :: "a"(lo), "d"(hi), "c"(0));
 }
 
+/*
+ * cpu_enable_local_features - Turn on the per CPU control register features
+ */
+static void cpu_enable_local_features(void)
+{
+    // SSE is enabled at boot time (it's a requirement for GatOS to work)
+    // but it's good to do it here too
+    if (cpu_has_feature(CF_SSE)) {
+        cpu_enable_feature(CF_SSE);
+    }
+
+    // XSAVE first, the vector components below are XCR0 bits on top of it
+    if (cpu_has_feature(CF_XSAVE)) {
+        cpu_enable_feature(CF_XSAVE);
+    }
+
+    if (cpu_has_feature(CF_AVX)) {
+        cpu_enable_feature(CF_AVX);
+    }
+
+    if (cpu_has_feature(CF_AVX512F)) {
+        cpu_enable_feature(CF_AVX512F);
+    }
+
+    if (cpu_has_feature(CF_SMEP)) {
+        cpu_enable_feature(CF_SMEP);
+    }
+
+    if (cpu_has_feature(CF_SMAP)) {
+        cpu_enable_feature(CF_SMAP);
+    }
+}
+
+/*
+ * cpu_local_init - Fill in a CPU local block and point GS at it
+ */
+void cpu_local_init(uint32_t index, uint32_t lapic_id)
+{
+    cpu_local_t* cpu = &cpu_locals[index];
+    cpu->self = cpu;
+    cpu->index = index;
+    cpu->lapic_id = lapic_id;
+
+    // GS_BASE -> cpu_local in ring 0, KERNEL_GS_BASE holds user GS on entry
+    write_msr(MSR_GS_BASE, (uint64_t)cpu);
+    write_msr(MSR_KERNEL_GS_BASE, 0);
+
+    // Known starting point for the scheduler's FS_BASE cache
+    cpu->fs_base = 0;
+    write_msr(MSR_FS_BASE, 0);
+}
+
+/*
+ * cpu_init_ap - Per CPU setup for an application processor, cpu_init() ran on the BSP
+ */
+void cpu_init_ap(uint32_t index)
+{
+    uint32_t a, b, c, d;
+    cpu_enable_local_features();
+    cpuid(1, 0, &a, &b, &c, &d);
+    cpu_local_init(index, b >> 24);
+}
+
 /*
  * cpu_init - Initialize CPU information by querying CPUID and MSRs
  */
@@ -132,6 +196,7 @@ void cpu_init(void)
     if (c & (1 << 9))  cpuinfo.features |= CF_SSSE3;
     if (c & (1 << 19)) cpuinfo.features |= CF_SSE4_1;
     if (c & (1 << 20)) cpuinfo.features |= CF_SSE4_2;
+    if (c & (1 << 26)) cpuinfo.features |= CF_XSAVE;
     if (c & (1 << 28)) cpuinfo.features |= CF_AVX;
     if (c & (1 << 5))  cpuinfo.features |= CF_VMX;
 
@@ -139,8 +204,13 @@ void cpu_init(void)
         cpuid(7, 0, &a, &b, &c, &d);
         if (b & (1 << 7))  cpuinfo.features |= CF_SMEP;
         if (b & (1 << 20)) cpuinfo.features |= CF_SMAP;
+        if (b & (1 << 16)) cpuinfo.features |= CF_AVX512F;
     }
 
+    // AVX and AVX-512 state is only usable through XSAVE
+    if (!(cpuinfo.features & CF_XSAVE)) cpuinfo.features &= ~(uint64_t)(CF_AVX | CF_AVX512F);
+    if (!(cpuinfo.features & CF_AVX)) cpuinfo.features &= ~(uint64_t)CF_AVX512F;
+
     // NX support hacky check, blame x86 for this atrocity
     cpuid(0x80000000, 0, &a, &b, &c, &d);
     uint32_t max_ext = a;
@@ -170,27 +240,14 @@ void cpu_init(void)
         cpuinfo.core_count = ((b >> 26) & 0x3F) + 1;
     }
 
-    // SSE is enabled at boot time (it's a requirement for GatOS to work)
-    // but it's good to do it here too
-    if (cpu_has_feature(CF_SSE)) {
-        cpu_enable_feature(CF_SSE);
-    }
-
-    if (cpu_has_feature(CF_AVX)) {
-        cpu_enable_feature(CF_AVX);
-    }
-
-    if (cpu_has_feature(CF_SMEP)) {
-        cpu_enable_feature(CF_SMEP);
-    }
+    cpu_enable_local_features();
 
-    if (cpu_has_feature(CF_SMAP)) {
-        cpu_enable_feature(CF_SMAP);
-    }
+    // CPUID.01H:EBX[31:24] is the initial APIC ID, usable before the LAPIC is mapped
+    cpuid(1, 0, &a, &b, &c, &d);
+    cpu_local_init(0, b >> 24);
 
-    // GS_BASE -> cpu_local in ring 0, KERNEL_GS_BASE holds user GS on entry
-    write_msr(MSR_GS_BASE, (uint64_t)&cpu_local);
-    write_msr(MSR_KERNEL_GS_BASE, 0);
+    // XCR0 is final now, size the per thread save areas
+    fpu_init();
 
     LOGF("[CPU] Vendor: %s\n", cpuinfo.vendor);
     LOGF("[CPU] Brand:  %s\n", cpuinfo.brand);
@@ -248,14 +305,29 @@ bool cpu_enable_feature(cpu_feature_t feature)
             write_cr4(cr4);
             return true;
 
+        case CF_XSAVE:
+            cr4 = read_cr4();
+            cr4 |= (1 << 18); // CR4.OSXSAVE
+            write_cr4(cr4);
+            xcr0 = read_xcr0();
+            xcr0 |= XFEATURE_X87 | XFEATURE_SSE;
+            write_xcr0(xcr0);
+            return true;
+
         case CF_AVX:
         case CF_AVX2:
             cr4 = read_cr4();
             cr4 |= (1 << 18); // CR4.OSXSAVE
             write_cr4(cr4);
             xcr0 = read_xcr0();
-            xcr0 |= (1 << 0) | (1 << 1); // enable x87 and SSE
-            xcr0 |= (1 << 2); // enable AVX state
+            xcr0 |= XFEATURE_X87 | XFEATURE_SSE; // enable x87 and SSE
+            xcr0 |= XFEATURE_AVX; // enable AVX state
+            write_xcr0(xcr0);
+            return true;
+
+        case CF_AVX512F:
+            xcr0 = read_xcr0();
+            xcr0 |= XFEATURE_AVX512; // opmask and the ZMM upper halves, all or none
             write_xcr0(xcr0);
             return true;
 
@@ -316,12 +388,22 @@ bool cpu_is_feature_enabled(cpu_feature_t feature)
             cr4 = read_cr4();
             return ((cr4 & (1 << 9)) && (cr4 & (1 << 10)) && !(cr0 & (1 << 2)));
 
+        case CF_XSAVE:
+            cr4 = read_cr4();
+            return (cr4 & (1 << 18)) != 0;
+
         case CF_AVX:
         case CF_AVX2:
             cr4 = read_cr4();
+            if (!(cr4 & (1 << 18))) return false;
+            xcr0 = read_xcr0();
+            return (xcr0 & (XFEATURE_X87 | XFEATURE_SSE | XFEATURE_AVX)) == (XFEATURE_X87 | XFEATURE_SSE | XFEATURE_AVX);
+
+        case CF_AVX512F:
+            cr4 = read_cr4();
+            if (!(cr4 & (1 << 18))) return false;
             xcr0 = read_xcr0();
-            return ((cr4 & (1 << 18)) &&
-                    (xcr0 & (1 << 0)) && (xcr0 & (1 << 1)) && (xcr0 & (1 << 2)));
+            return (xcr0 & XFEATURE_AVX512) == XFEATURE_AVX512;
 
         case CF_NX:
             efer = read_msr(MSR_EFER);
@@ -30,8 +30,16 @@ typedef enum {
     CF_64BIT     = (1 << 12),
     CF_SMEP      = (1 << 13),
     CF_SMAP      = (1 << 14),
+    CF_XSAVE     = (1 << 15),
+    CF_AVX512F   = (1 << 16),
 } cpu_feature_t;
 
+// XCR0 state components, see fpu.c
+#define XFEATURE_X87        (1ULL << 0)
+#define XFEATURE_SSE        (1ULL << 1)
+#define XFEATURE_AVX        (1ULL << 2)
+#define XFEATURE_AVX512     ((1ULL << 5) | (1ULL << 6) | (1ULL << 7)) // Opmask, ZMM_Hi256, Hi16_ZMM
+
 // CPU Information Structure
 typedef struct {
     char vendor[13];
@@ -43,16 +51,50 @@ typedef struct {
     uint64_t features;
 } cpu_info_t;
 
-// CPU-local data structure for GS base
-typedef struct {
-    uint64_t kernel_stack; // offset 0
-    uint64_t user_stack;   // offset 8
+// Upper bound on logical CPUs brought online by smp_init()
+#define MAX_CPUS 16
+
+// CPU-local data structure for GS base, one per logical CPU
+// The first three offsets are hardcoded in syscall_entry.S and ISR.S
+typedef struct cpu_local {
+    uint64_t kernel_stack;          // offset 0
+    uint64_t user_stack;            // offset 8
+    uint64_t sched_stack_top;       // offset 16
+    struct cpu_local* self;         // offset 24, read by this_cpu()
+    void* thread;                   // offset 32, thread running on this CPU
+    void* vmm;                      // address space loaded in CR3
+    uint32_t index;                 // dense CPU number, 0 is the BSP
+    uint32_t lapic_id;
+    volatile uint32_t tlb_pending;  // shootdown requested by another CPU
+    volatile uint32_t online;
+    uint64_t fs_base;               // Last value written to MSR_FS_BASE
 } __attribute__((packed)) cpu_local_t;
 
-extern cpu_local_t cpu_local;
+extern cpu_local_t cpu_locals[MAX_CPUS];
+
+/*
+ * this_cpu - Returns the executing CPU's local block
+ */
+static inline cpu_local_t* this_cpu(void) {
+    cpu_local_t* c;
+    __asm__ volatile("mov %%gs:24, %0" : "=r"(c));
+    return c;
+}
+
+/*
+ * this_cpu_thread - Returns the thread running on this CPU in a single load,
+ * so a preemption and migration in between cannot mix up two CPUs
+ */
+static inline void* this_cpu_thread(void) {
+    void* t;
+    __asm__ volatile("mov %%gs:32, %0" : "=r"(t));
+    return t;
+}
 
 // Public API
 void cpu_init(void);
+void cpu_init_ap(uint32_t index);
+void cpu_local_init(uint32_t index, uint32_t lapic_id);
 const cpu_info_t* cpu_get_info(void);
 bool cpu_has_feature(cpu_feature_t feature);
 bool cpu_enable_feature(cpu_feature_t feature);
@@ -0,0 +1,174 @@
+/*
+ * fpu.c - Extended processor state (x87/SSE/AVX/AVX-512) save and restore
+ *
+ * CPUID.(EAX=0Dh,ECX=0):EBX gives the standard XSAVE area size for the
+ * components currently enabled in XCR0, CPUID.(EAX=0Dh,ECX=1):EBX the size
+ * of the compacted XSAVEC layout. Both are read once on the BSP after
+ * cpu_init() has programmed XCR0, every AP enables the same components.
+ *
+ * A fresh area is all zero except FCW and MXCSR. Its XSAVE header is zero
+ * too, so XRSTOR treats every extended component as being in its init state
+ * and accepts the area whatever layout the save instruction later writes.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#include <arch/x86_64/cpu/fpu.h>
+#include <arch/x86_64/cpu/cpu.h>
+#include <kernel/memory/heap.h>
+#include <kernel/debug.h>
+#include <klibc/string.h>
+
+static fpu_mode_t mode = FPU_MODE_FXSAVE;
+static uint64_t xfeatures = XFEATURE_X87 | XFEATURE_SSE;
+static uint32_t state_size = 512;
+
+// Per CPU so the #NM path never bounces a shared cache line
+static fpu_stats_t stats[MAX_CPUS];
+
+static const char* mode_names[] = { "xsaveopt", "xsavec", "xsave", "fxsave" };
+
+/*
+ * fpu_init - Picks the save instruction and sizes the per thread area, BSP only
+ */
+void fpu_init(void) {
+    if (cpu_is_feature_enabled(CF_XSAVE)) {
+        uint32_t a, b, c, d;
+        xfeatures = read_xcr0();
+
+        cpuid(0x0D, 0, &a, &b, &c, &d);
+        state_size = b;
+        mode = FPU_MODE_XSAVE;
+
+        cpuid(0x0D, 1, &a, &b, &c, &d);
+        if (a & (1 << 0)) {
+            mode = FPU_MODE_XSAVEOPT;
+        } else if (a & (1 << 1)) {
+            mode = FPU_MODE_XSAVEC;
+            state_size = b;
+        }
+    }
+
+    LOGF("[FPU] %s, XCR0 0x%lx, %u byte state per thread\n", mode_names[mode], xfeatures, state_size);
+}
+
+/*
+ * fpu_mode - Save instruction in use
+ */
+fpu_mode_t fpu_mode(void) {
+    return mode;
+}
+
+/*
+ * fpu_mode_name - Save instruction in use, as a string
+ */
+const char* fpu_mode_name(void) {
+    return mode_names[mode];
+}
+
+/*
+ * fpu_xfeatures - State components saved and restored, the XCR0 value
+ */
+uint64_t fpu_xfeatures(void) {
+    return xfeatures;
+}
+
+/*
+ * fpu_state_size - Bytes in one thread's save area
+ */
+uint32_t fpu_state_size(void) {
+    return state_size;
+}
+
+/*
+ * fpu_state_alloc - Allocates a save area holding the reset state
+ *
+ * The heap only guarantees 16 byte alignment, so the area is aligned by hand
+ * and the raw pointer kept in the 8 bytes in front of it for fpu_state_free().
+ */
+void* fpu_state_alloc(void) {
+    uint8_t* raw = kmalloc(state_size + FPU_AREA_ALIGN + sizeof(void*));
+    if (!raw) return NULL;
+
+    uintptr_t at = ((uintptr_t)raw + sizeof(void*) + FPU_AREA_ALIGN - 1) & ~(uintptr_t)(FPU_AREA_ALIGN - 1);
+    uint8_t* area = (uint8_t*)at;
+    ((void**)area)[-1] = raw;
+
+    // FCW 0x037F masks every x87 exception, MXCSR 0x1F80 every SSE one
+    kmemset(area, 0, state_size);
+    *(uint16_t*)(&area[0]) = 0x037F;
+    *(uint32_t*)(&area[24]) = 0x1F80;
+    return area;
+}
+
+/*
+ * fpu_state_free - Frees an area from fpu_state_alloc()
+ */
+void fpu_state_free(void* area) {
+    if (area) kfree(((void**)area)[-1]);
+}
+
+/*
+ * fpu_save - Writes the live register state to area
+ */
+void fpu_save(void* area) {
+    uint32_t lo = (uint32_t)xfeatures;
+    uint32_t hi = (uint32_t)(xfeatures >> 32);
+
+    switch (mode) {
+        case FPU_MODE_XSAVEOPT:
+            __asm__ volatile("xsaveopt64 (%0)" :: "r"(area), "a"(lo), "d"(hi) : "memory");
+            break;
+        case FPU_MODE_XSAVEC:
+            __asm__ volatile("xsavec64 (%0)" :: "r"(area), "a"(lo), "d"(hi) : "memory");
+            break;
+        case FPU_MODE_XSAVE:
+            __asm__ volatile("xsave64 (%0)" :: "r"(area), "a"(lo), "d"(hi) : "memory");
+            break;
+        default:
+            __asm__ volatile("fxsave64 (%0)" :: "r"(area) : "memory");
+            break;
+    }
+    stats[this_cpu()->index].saves++;
+}
+
+/*
+ * fpu_restore - Loads the register state from area
+ */
+void fpu_restore(const void* area) {
+    uint32_t lo = (uint32_t)xfeatures;
+    uint32_t hi = (uint32_t)(xfeatures >> 32);
+
+    if (mode == FPU_MODE_FXSAVE)
+        __asm__ volatile("fxrstor64 (%0)" :: "r"(area) : "memory");
+    else
+        __asm__ volatile("xrstor64 (%0)" :: "r"(area), "a"(lo), "d"(hi) : "memory");
+    stats[this_cpu()->index].restores++;
+}
+
+/*
+ * fpu_count_switch - Counts a context switch that armed CR0.TS, interrupts disabled
+ */
+void fpu_count_switch(void) {
+    stats[this_cpu()->index].switches++;
+}
+
+/*
+ * fpu_count_trap - Counts a #NM fault, interrupts disabled
+ */
+void fpu_count_trap(void) {
+    stats[this_cpu()->index].traps++;
+}
+
+/*
+ * fpu_get_stats - Sums the lazy switching counters over every CPU
+ */
+void fpu_get_stats(fpu_stats_t* out) {
+    kmemset(out, 0, sizeof(*out));
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        out->switches += stats[i].switches;
+        out->traps += stats[i].traps;
+        out->saves += stats[i].saves;
+        out->restores += stats[i].restores;
+    }
+}
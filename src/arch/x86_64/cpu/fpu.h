@@ -0,0 +1,53 @@
+/*
+ * fpu.h - Extended processor state (x87/SSE/AVX/AVX-512) save and restore
+ *
+ * Each thread owns one save area sized from CPUID leaf 0xD for the
+ * components enabled in XCR0. The scheduler switches it lazily: CR0.TS is set
+ * on every context switch and the #NM handler saves the previous owner and
+ * restores the new one only when a thread actually touches the FPU.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// XSAVE areas must be 64 byte aligned, FXSAVE areas 16
+#define FPU_AREA_ALIGN  64
+
+// Save instruction picked by fpu_init(), best first
+typedef enum {
+    FPU_MODE_XSAVEOPT,  // Skips components not modified since the last XRSTOR
+    FPU_MODE_XSAVEC,    // Compacted layout, skips components in their init state
+    FPU_MODE_XSAVE,
+    FPU_MODE_FXSAVE     // No XSAVE, x87 and SSE only in a 512 byte area
+} fpu_mode_t;
+
+// Lazy switching counters, summed over every CPU
+typedef struct {
+    uint64_t switches;  // Context switches, an eager scheme pays a save and a restore on each
+    uint64_t traps;     // #NM faults taken, the lazy path
+    uint64_t saves;
+    uint64_t restores;
+} fpu_stats_t;
+
+void fpu_init(void);
+
+fpu_mode_t fpu_mode(void);
+const char* fpu_mode_name(void);
+uint64_t fpu_xfeatures(void);
+uint32_t fpu_state_size(void);
+
+// Per thread save areas, initialised to the architectural reset state
+void* fpu_state_alloc(void);
+void fpu_state_free(void* area);
+
+// CR0.TS must be clear
+void fpu_save(void* area);
+void fpu_restore(const void* area);
+
+void fpu_count_switch(void);
+void fpu_count_trap(void);
+void fpu_get_stats(fpu_stats_t* out);
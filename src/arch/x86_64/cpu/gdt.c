@@ -8,64 +8,76 @@
  */
 
 #include <arch/x86_64/cpu/gdt.h>
+#include <arch/x86_64/cpu/cpu.h>
+#include <arch/x86_64/cpu/msr.h>
 #include <arch/x86_64/memory/paging.h>
 #include <kernel/memory/pmm.h>
 #include <kernel/debug.h>
 #include <klibc/string.h>
 
-static gdt_t gdt;
-static tss_t tss;
+// One GDT and TSS per CPU, the TSS descriptor goes busy on ltr and cannot be shared
+static gdt_t gdts[MAX_CPUS];
+static tss_t tsss[MAX_CPUS];
 
 /*
  * gdt_set_entry - Populates a single GDT entry with provided parameters
  */
-static void gdt_set_entry(int index, uint32_t base, uint32_t limit, uint8_t access, uint8_t flags) {
-    gdt.entries[index].limit_low = (uint16_t)(limit & 0xFFFF);
-    gdt.entries[index].base_low = (uint16_t)(base & 0xFFFF);
-    gdt.entries[index].base_mid = (uint8_t)((base >> 16) & 0xFF);
-    gdt.entries[index].access = access;
-    gdt.entries[index].flags_limit_high = (uint8_t)(((limit >> 16) & 0x0F) | (flags << 4));
-    gdt.entries[index].base_high = (uint8_t)((base >> 24) & 0xFF);
+static void gdt_set_entry(gdt_t* gdt, int index, uint32_t base, uint32_t limit, uint8_t access, uint8_t flags) {
+    gdt->entries[index].limit_low = (uint16_t)(limit & 0xFFFF);
+    gdt->entries[index].base_low = (uint16_t)(base & 0xFFFF);
+    gdt->entries[index].base_mid = (uint8_t)((base >> 16) & 0xFF);
+    gdt->entries[index].access = access;
+    gdt->entries[index].flags_limit_high = (uint8_t)(((limit >> 16) & 0x0F) | (flags << 4));
+    gdt->entries[index].base_high = (uint8_t)((base >> 24) & 0xFF);
 }
 
 /*
  * gdt_set_tss - Configures the special 16-byte TSS system descriptor in the GDT
  */
-static void gdt_set_tss(int index, uint64_t base, uint32_t limit) {
-    gdt_set_entry(index, (uint32_t)base, limit, 0x89, 0x00);
+static void gdt_set_tss(gdt_t* gdt, int index, uint64_t base, uint32_t limit) {
+    gdt_set_entry(gdt, index, (uint32_t)base, limit, 0x89, 0x00);
 
-    gdt_entry_t* extra = &gdt.entries[index + 1];
+    gdt_entry_t* extra = &gdt->entries[index + 1];
     uint32_t* extra_raw = (uint32_t*)extra;
     extra_raw[0] = (uint32_t)(base >> 32);
     extra_raw[1] = 0;
 }
 
 /*
- * gdt_init - Entry point for initializing the GDT and TSS infrastructure
+ * gdt_init - Entry point for initializing the GDT and TSS infrastructure on the BSP
  */
 void gdt_init(void) {
+    gdt_init_cpu(0);
+}
+
+/*
+ * gdt_init_cpu - Build and load the GDT and TSS of one CPU, runs on that CPU
+ */
+void gdt_init_cpu(uint32_t cpu) {
+    gdt_t* gdt = &gdts[cpu];
+    tss_t* tss = &tsss[cpu];
 
     // clean both gdt and tss
-    kmemset(&gdt, 0, sizeof(gdt));
-    kmemset(&tss, 0, sizeof(tss));
+    kmemset(gdt, 0, sizeof(*gdt));
+    kmemset(tss, 0, sizeof(*tss));
 
     // config
-    gdt_set_entry(0, 0, 0, 0, 0);
-    gdt_set_entry(1, 0, 0xFFFFFFFF, GDT_PRESENT | GDT_DPL_0 | GDT_SYSTEM | GDT_EXECUTABLE | GDT_READ_WRITE, GDT_LONG_MODE);
-    gdt_set_entry(2, 0, 0xFFFFFFFF, GDT_PRESENT | GDT_DPL_0 | GDT_SYSTEM | GDT_READ_WRITE, 0);
-    gdt_set_entry(3, 0, 0xFFFFFFFF, GDT_PRESENT | GDT_DPL_3 | GDT_SYSTEM | GDT_READ_WRITE, 0);
-    gdt_set_entry(4, 0, 0xFFFFFFFF, GDT_PRESENT | GDT_DPL_3 | GDT_SYSTEM | GDT_EXECUTABLE | GDT_READ_WRITE, GDT_LONG_MODE);
+    gdt_set_entry(gdt, 0, 0, 0, 0, 0);
+    gdt_set_entry(gdt, 1, 0, 0xFFFFFFFF, GDT_PRESENT | GDT_DPL_0 | GDT_SYSTEM | GDT_EXECUTABLE | GDT_READ_WRITE, GDT_LONG_MODE);
+    gdt_set_entry(gdt, 2, 0, 0xFFFFFFFF, GDT_PRESENT | GDT_DPL_0 | GDT_SYSTEM | GDT_READ_WRITE, 0);
+    gdt_set_entry(gdt, 3, 0, 0xFFFFFFFF, GDT_PRESENT | GDT_DPL_3 | GDT_SYSTEM | GDT_READ_WRITE, 0);
+    gdt_set_entry(gdt, 4, 0, 0xFFFFFFFF, GDT_PRESENT | GDT_DPL_3 | GDT_SYSTEM | GDT_EXECUTABLE | GDT_READ_WRITE, GDT_LONG_MODE);
 
-    uint64_t tss_base = (uintptr_t)&tss;
-    gdt_set_tss(5, tss_base, sizeof(tss_t) - 1);
+    uint64_t tss_base = (uintptr_t)tss;
+    gdt_set_tss(gdt, 5, tss_base, sizeof(tss_t) - 1);
 
-    tss.iopb_offset = sizeof(tss_t);
+    tss->iopb_offset = sizeof(tss_t);
 
     // 16kb for a kernel stack to save the user state and execute a kernel handler when necessary
     uint64_t kstack_phys;
     if (pmm_alloc(16384, &kstack_phys) == PMM_OK) {
-        tss.rsp0 = PHYSMAP_P2V(kstack_phys + 16384);
-        LOGF("[GDT] Primary kernel stack allocated at 0x%lx (virt)\n", tss.rsp0);
+        tss->rsp0 = PHYSMAP_P2V(kstack_phys + 16384);
+        LOGF("[GDT] CPU %u kernel stack allocated at 0x%lx (virt)\n", cpu, tss->rsp0);
     } else {
         LOGF("[GDT] ERROR: Failed to allocate kernel stack for TSS!\n");
     }
@@ -73,20 +85,23 @@ void gdt_init(void) {
     // double fault stack, specific for critical exception
     uint64_t df_stack_phys;
     if (pmm_alloc(KERNEL_STACK_SIZE, &df_stack_phys) == PMM_OK) {
-        tss.ist[0] = PHYSMAP_P2V(df_stack_phys + 16384);
-        LOGF("[GDT] Double Fault IST stack allocated at 0x%lx\n", tss.ist[0]);
+        tss->ist[0] = PHYSMAP_P2V(df_stack_phys + 16384);
+        LOGF("[GDT] Double Fault IST stack allocated at 0x%lx\n", tss->ist[0]);
     }
 
     // page fault stack, same as above
     uint64_t pf_stack_phys;
     if (pmm_alloc(KERNEL_STACK_SIZE, &pf_stack_phys) == PMM_OK) {
-        tss.ist[1] = PHYSMAP_P2V(pf_stack_phys + KERNEL_STACK_SIZE);
-        LOGF("[GDT] Page Fault IST stack allocated at 0x%lx\n", tss.ist[1]);
+        tss->ist[1] = PHYSMAP_P2V(pf_stack_phys + KERNEL_STACK_SIZE);
+        LOGF("[GDT] Page Fault IST stack allocated at 0x%lx\n", tss->ist[1]);
     }
 
     gdt_ptr_t ptr;
-    ptr.limit = sizeof(gdt) - 1;
-    ptr.base = (uintptr_t)&gdt;
+    ptr.limit = sizeof(*gdt) - 1;
+    ptr.base = (uintptr_t)gdt;
+
+    // Reloading GS below zeroes the hidden base, keep the CPU local pointer
+    uint64_t gs_base = read_msr(MSR_GS_BASE);
 
     /* Note from the author:
     
@@ -116,12 +131,14 @@ void gdt_init(void) {
 
     __asm__ volatile("ltr %%ax" :: "a"((uint16_t)TSS_SEL));
 
-    LOGF("[GDT] Global Descriptor Table and TSS initialized successfully.\n");
+    write_msr(MSR_GS_BASE, gs_base);
+
+    LOGF("[GDT] CPU %u Global Descriptor Table and TSS initialized successfully.\n", cpu);
 }
 
 /*
- * tss_set_rsp0 - Updates the kernel stack pointer in the global TSS structure
+ * tss_set_rsp0 - Updates the kernel stack pointer in this CPU's TSS
  */
 void tss_set_rsp0(uint64_t rsp) {
-    tss.rsp0 = rsp;
+    tsss[this_cpu()->index].rsp0 = rsp;
 }
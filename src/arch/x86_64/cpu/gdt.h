@@ -67,4 +67,5 @@ typedef struct {
 
 
 void gdt_init(void);
+void gdt_init_cpu(uint32_t cpu);
 void tss_set_rsp0(uint64_t rsp);
@@ -12,22 +12,15 @@
 #include <klibc/stdio.h>
 #include <klibc/string.h>
 #include <arch/x86_64/cpu/cpu.h>
+#include <arch/x86_64/cpu/usercopy.h>
 #include <kernel/sys/panic.h>
 #include <kernel/sys/apic.h>
 #include <kernel/sys/scheduler.h>
 #include <kernel/sys/process.h>
 #include <kernel/debug.h>
 #include <kernel/misc.h>
-#include <kernel/memory/pmm.h>
 #include <arch/x86_64/memory/paging.h>
 
-// SSE free page zero: this file is compiled with -mno-sse (interrupt path).
-// rep stosq matches what kmemset does for aligned power of 2 sizes, without SSE.
-static inline void zero_page(void *dst) {
-    uint64_t cnt = PAGE_SIZE / sizeof(uint64_t);
-    __asm__ volatile("rep stosq" : "+D"(dst), "+c"(cnt) : "a"(0ULL) : "memory");
-}
-
 #pragma region Types and Globals
 
 idt_entry_t idt[IDT_SIZE] = {0};
@@ -135,6 +128,16 @@ void idt_init(void)
 
 #pragma region Dispatcher
 
+/*
+ * acct_return - Stops system time accounting if the context we resume is in ring 3
+ *
+ * After a switch the context belongs to the new thread, which is also sched_current() by now.
+ */
+static inline cpu_context_t* acct_return(cpu_context_t* context) {
+    if ((context->iret_cs & 3) == 3) sched_acct_exit(sched_current());
+    return context;
+}
+
 /*
  * interrupt_dispatcher - Central C handler called by assembly stubs
  */
@@ -147,6 +150,9 @@ cpu_context_t* interrupt_dispatcher(cpu_context_t* context)
         return context;
     }
 
+    // Time from here until we drop back to ring 3 is system time of the interrupted thread
+    if ((context->iret_cs & 3) == 3) sched_acct_enter(sched_current());
+
     if (irq_handlers[vec] != NULL) {
         context = irq_handlers[vec](context);
         if (!context) {
@@ -174,7 +180,7 @@ cpu_context_t* interrupt_dispatcher(cpu_context_t* context)
         if (vec >= INT_FIRST_INTERRUPT) {
             lapic_eoi();
         }
-        return context;
+        return acct_return(context);
     }
 
     if (vec < INT_FIRST_INTERRUPT) {
@@ -202,44 +208,35 @@ cpu_context_t* interrupt_dispatcher(cpu_context_t* context)
         }
 
         // demand paging
-        // try proc VMM first, fall back to kernel's
+        // try proc VMM first, fall back to kernel's. Reads of untouched pages
+        // share the zero frame, writes (error code bit 1) get a private frame.
+        // Before the scheduler runs there is no process, use whatever VMM is loaded
         if (vec == INT_PAGE_FAULT) {
             uint64_t cr2;
             __asm__ volatile("mov %%cr2, %0" : "=r"(cr2));
+            bool is_write = (context->error_code & 2) != 0;
 
-            vmm_t* demand_vmm = NULL;
-            vm_object* demand_obj = NULL;
-
+            vmm_status_t status = VMM_ERR_NOT_FOUND;
             thread_t* current = sched_current();
             if (current && current->process && current->process->vmm) {
-                demand_obj = vmm_find_mapped_object(current->process->vmm, (void*)cr2);
-                if (demand_obj && (demand_obj->flags & VM_FLAG_LAZY)) {
-                    demand_vmm = current->process->vmm;
-                }
+                status = vmm_handle_lazy_fault(current->process->vmm, (void*)cr2, is_write);
+            } else if (!current && vmm_get_current() != vmm_kernel_get()) {
+                status = vmm_handle_lazy_fault(vmm_get_current(), (void*)cr2, is_write);
             }
 
-            if (!demand_vmm) {
-                demand_obj = vmm_find_mapped_object(vmm_kernel_get(), (void*)cr2);
-                if (demand_obj && (demand_obj->flags & VM_FLAG_LAZY)) {
-                    demand_vmm = vmm_kernel_get();
-                }
+            // ring 3 never gets to fault in kernel memory
+            if (status == VMM_ERR_NOT_FOUND && (context->iret_cs & 3) == 0) {
+                status = vmm_handle_lazy_fault(vmm_kernel_get(), (void*)cr2, is_write);
             }
 
-            if (demand_vmm && demand_obj) {
-                uint64_t phys_base;
-                if (pmm_alloc(PAGE_SIZE, &phys_base) == PMM_OK) {
-                    uint64_t page_aligned_cr2 = cr2 & ~(PAGE_SIZE - 1);
-                    zero_page((void*)PHYSMAP_P2V(phys_base));
-                    vmm_status_t status = vmm_map_page(demand_vmm, phys_base, (void*)page_aligned_cr2, demand_obj->flags);
-                    if (status == VMM_OK) {
-                        return context;
-                    } else if (status == VMM_ERR_ALREADY_MAPPED) {
-                        pmm_free(phys_base, PAGE_SIZE); // Race: already backed by another CPU
-                        return context;
-                    } else {
-                        pmm_free(phys_base, PAGE_SIZE);
-                    }
-                }
+            if (status == VMM_OK) {
+                return acct_return(context);
+            }
+
+            // Nothing mapped under a user copy, hand the shortfall back to its caller
+            if ((context->iret_cs & 3) == 0 && context->iret_rip == (uint64_t)user_copy_fault_ip) {
+                context->iret_rip = (uint64_t)user_copy_fixup;
+                return acct_return(context);
             }
         }
 
@@ -274,7 +271,7 @@ cpu_context_t* interrupt_dispatcher(cpu_context_t* context)
                 LOGF("[USERSPACE FAULT] %s", buf + 1);
 
                 current->state = T_DEAD;
-                return sched_schedule(context);
+                return acct_return(sched_schedule(context));
             }
         }
 
@@ -304,5 +301,5 @@ cpu_context_t* interrupt_dispatcher(cpu_context_t* context)
         lapic_eoi();
     }
 
-    return context;
+    return acct_return(context);
 }
@@ -88,6 +88,8 @@ typedef struct
 #define INT_MACHINE_CHECK       18   // #MC - Machine Check
 #define INT_SIMD_ERROR          19   // #XF - SIMD (SSE/AVX) error
 
+#define INT_IPI_RESCHEDULE      0xF0 // Cross CPU reschedule request
+#define INT_IPI_TLB_SHOOTDOWN   0xF1 // Cross CPU TLB invalidation
 #define INT_SPURIOUS_INTERRUPT  255  // Spurious Interrupt Vector
 
 // Useful for loops and bounds checking
@@ -105,6 +107,7 @@ extern uint32_t gdt64_code_segment;
 typedef cpu_context_t* (*irq_handler_t)(cpu_context_t*);
 
 void idt_init(void);
+void load_idt(void* idt_addr);
 
 void irq_register(uint8_t vector, irq_handler_t handler);
 void irq_unregister(uint8_t vector);
@@ -134,6 +137,15 @@ static inline bool intr_save(void) {
     return enabled;
 }
 
+/*
+ * intr_enabled - True if the IF flag is set on this CPU
+ */
+static inline bool intr_enabled(void) {
+    uint64_t rflags;
+    __asm__ volatile("pushfq; popq %0" : "=r"(rflags) :: "memory");
+    return (rflags >> 9) & 1;
+}
+
 /*
  * intr_restore - Restore interrupt state saved by intr_save()
  */
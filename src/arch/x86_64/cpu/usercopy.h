@@ -0,0 +1,56 @@
+/*
+ * usercopy.h - Fault safe copies between kernel and user memory
+ *
+ * Both copies refuse any range that reaches past the lower half and stop
+ * at the first unmapped user page instead of faulting the kernel, they
+ * return how many bytes did not make it. Lazily mapped pages are faulted
+ * in as usual, so interrupts may stay enabled around them.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <arch/x86_64/cpu/cpu.h>
+
+// First address past user space
+#define USER_SPACE_END 0x0000800000000000ULL
+
+size_t user_copy(void* dst, const void* src, size_t len);
+
+// Labels in usercopy.S, the page fault handler redirects one to the other
+extern uint8_t user_copy_fault_ip[];
+extern uint8_t user_copy_fixup[];
+
+/*
+ * user_range_ok - True if [addr, addr + len) lies entirely in user space
+ */
+static inline bool user_range_ok(const void* addr, size_t len) {
+    uintptr_t a = (uintptr_t)addr;
+    return a + len >= a && a + len <= USER_SPACE_END;
+}
+
+/*
+ * copy_from_user - Copies len bytes from user address src, returns how many could not be
+ */
+static inline size_t copy_from_user(void* dst, const void* src, size_t len) {
+    if (!user_range_ok(src, len)) return len;
+    smap_allow();
+    size_t left = user_copy(dst, src, len);
+    smap_deny();
+    return left;
+}
+
+/*
+ * copy_to_user - Copies len bytes to user address dst, returns how many could not be
+ */
+static inline size_t copy_to_user(void* dst, const void* src, size_t len) {
+    if (!user_range_ok(dst, len)) return len;
+    smap_allow();
+    size_t left = user_copy(dst, src, len);
+    smap_deny();
+    return left;
+}
@@ -15,6 +15,11 @@
 
 // Userspace addresses
 #define USER_CODE_VIRT_ADDR  0x400000
+#define USER_VVAR_VIRT_ADDR  0x00007FFFFFFFE000 // Read only time page, see kernel/sys/vvar.h
+
+// AP startup trampoline, code page then PML4, PDPT and PD, all below the kernel image
+#define AP_TRAMPOLINE_PHYS   0x8000
+#define AP_TRAMPOLINE_PAGES  4
 
 // Stacks
 #define KERNEL_STACK_SIZE    16384 // 16 KiB
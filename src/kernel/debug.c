@@ -8,19 +8,97 @@
 
 #include <klibc/stdio.h>
 #include <kernel/drivers/serial.h>
+#include <kernel/sys/timers.h>
+#include <kernel/debug.h>
 #include <kernel/misc.h>
 #include <klibc/string.h>
 #include <stddef.h>
+#include <stdbool.h>
 #include <stdarg.h>
 
 static int dbg_counter = 0;
 
+// Every QEMU_LOG marker is the end of a boot phase, stamped with the raw TSC
+// so phases before timer calibration count too
+typedef struct {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+    bool deferred;      // Ran on its own thread, off the boot path
+} boot_phase_t;
+
+static boot_phase_t boot_phases[BOOT_PHASES_MAX];
+static uint32_t boot_phase_cnt = 0;
+static uint64_t boot_last = 0;      // End of the previous phase on the boot path
+
+/*
+ * boot_stamp - Records the phase [start, now] under msg
+ */
+static void boot_stamp(const char* msg, uint64_t start, uint64_t end, bool deferred) {
+    uint32_t i = __atomic_fetch_add(&boot_phase_cnt, 1, __ATOMIC_RELAXED);
+    if (i >= BOOT_PHASES_MAX) return;
+
+    boot_phases[i].name = msg;
+    boot_phases[i].start = start ? start : end;
+    boot_phases[i].end = end;
+    boot_phases[i].deferred = deferred;
+}
+
 /*
  * QEMU_LOG - Debug function to klog messages to qemu serial with counter
+ *
+ * Also closes the boot phase that began at the previous QEMU_LOG.
  */
 void QEMU_LOG(const char* msg, int total) {
+    uint64_t now = tsc_read();
+    boot_stamp(msg, boot_last, now, false);
+    boot_last = now;
+
     char buf[256];
-    ksnprintf(buf, sizeof(buf), "[%d/%d] %s\n", ++dbg_counter, total, msg);
+    ksnprintf(buf, sizeof(buf), "[%d/%d] %s\n", __atomic_add_fetch(&dbg_counter, 1, __ATOMIC_RELAXED), total, msg);
+    serial_write(buf);
+}
+
+/*
+ * QEMU_LOG_SPAN - QEMU_LOG for init work moved off the boot path, the phase began at start_tsc
+ */
+void QEMU_LOG_SPAN(const char* msg, int total, uint64_t start_tsc) {
+    boot_stamp(msg, start_tsc, tsc_read(), true);
+
+    char buf[256];
+    ksnprintf(buf, sizeof(buf), "[%d/%d] %s\n", __atomic_add_fetch(&dbg_counter, 1, __ATOMIC_RELAXED), total, msg);
+    serial_write(buf);
+}
+
+/*
+ * boot_report - Prints every boot phase with its offset from the first one and its length
+ *
+ * Deferred phases overlap the boot path, they are flagged with a '*'.
+ */
+void boot_report(void) {
+    uint32_t cnt = __atomic_load_n(&boot_phase_cnt, __ATOMIC_ACQUIRE);
+    if (cnt > BOOT_PHASES_MAX) cnt = BOOT_PHASES_MAX;
+    if (cnt == 0) return;
+
+    uint64_t origin = boot_phases[0].start;
+    uint64_t path_end = origin, last_end = origin;
+    char buf[256];
+
+    serial_write("[BOOT] Phase timing, microseconds since kernel_main\n");
+    serial_write("[BOOT]       at     took  phase\n");
+    for (uint32_t i = 0; i < cnt; i++) {
+        boot_phase_t* p = &boot_phases[i];
+        ksnprintf(buf, sizeof(buf), "[BOOT] %8lu %8lu %c%s\n",
+                  tsc_ticks_to_ns(p->start - origin) / 1000, tsc_ticks_to_ns(p->end - p->start) / 1000,
+                  p->deferred ? '*' : ' ', p->name);
+        serial_write(buf);
+
+        if (!p->deferred && p->end > path_end) path_end = p->end;
+        if (p->end > last_end) last_end = p->end;
+    }
+
+    ksnprintf(buf, sizeof(buf), "[BOOT] Boot path %lu us, deferred init done at %lu us\n",
+              tsc_ticks_to_ns(path_end - origin) / 1000, tsc_ticks_to_ns(last_end - origin) / 1000);
     serial_write(buf);
 }
 
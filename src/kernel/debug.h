@@ -8,6 +8,12 @@
 
 #pragma once
 
+#include <stdint.h>
+
+#define BOOT_PHASES_MAX 64
+
 void QEMU_LOG(const char* msg, int total);
+void QEMU_LOG_SPAN(const char* msg, int total, uint64_t start_tsc);
+void boot_report(void);
 void QEMU_GENERIC_LOG(const char* msg);
 void LOGF(const char* fmt, ...);
\ No newline at end of file
@@ -316,6 +316,7 @@ bool con_init(console_t* con) {
     con->ansi_st = 0; con->reent = 0;
     con->on = true; con->header_rows = 0;
     con->defer_render = false;
+    con->batch_depth = 0; con->batch_active = false;
     con->buffer = kmalloc(con->width * con->height * sizeof(console_char_t));
     if (!con->buffer) return false;
     size_t dirty_bytes = (con->width * con->height + 7) / 8;
@@ -429,25 +430,59 @@ void con_putc(console_t* con, char character) {
     spinlock_release(&con->lock, flags);
 }
 
+/*
+ * con_batch_begin - Defers rendering until the matching con_batch_end(), batches nest
+ *
+ * Lets a caller feeding con_write_batch() piece by piece pay for one flush
+ * at the end instead of one per piece.
+ */
+void con_batch_begin(console_t* con) {
+    if (!con) return;
+    extern tty_t* volatile active_tty;
+
+    bool flags = spinlock_acquire(&con->lock);
+    if (con->batch_depth++ == 0) {
+        // If this console is active, we can optimize the batch write by deferring
+        // rendering until the end of the batch
+        con->batch_active = (active_tty && active_tty->console == con);
+        if (con->batch_active) {
+            if (con->on) render_cursor(con, false);
+            con->defer_render = true;
+        }
+    }
+    spinlock_release(&con->lock, flags);
+}
+
+/*
+ * con_batch_end - Closes a con_batch_begin(), the outermost one flushes the backbuffer
+ */
+void con_batch_end(console_t* con) {
+    if (!con) return;
+
+    bool flags = spinlock_acquire(&con->lock);
+    bool flush = con->batch_depth && --con->batch_depth == 0 && con->batch_active;
+    spinlock_release(&con->lock, flags);
+
+    // After the batch is done if this console is active
+    // we need to flush the backbuffer to the framebuffer and enable direct rendering
+    if (flush) {
+        flush_display(con);
+        flags = spinlock_acquire(&con->lock);
+        if (con->batch_depth == 0) con->defer_render = false;
+        spinlock_release(&con->lock, flags);
+    }
+}
+
 /*
  * con_write_batch - Double-buffered batch write
  */
 void con_write_batch(console_t* con, const char* buf, size_t count) {
     if (!con || !buf || !count) return;
-    extern tty_t* volatile active_tty;
 
-    bool active = (active_tty && active_tty->console == con);
     size_t i = 0;
     const size_t chunk_len = 64;
 
-    // If this console is active, we can optimize the batch write by deferring 
-    // rendering until the end of the batch
-    if (active) {
-        bool flags = spinlock_acquire(&con->lock);
-        if (con->on) render_cursor(con, false);
-        con->defer_render = true;
-        spinlock_release(&con->lock, flags);
-    }
+    con_batch_begin(con);
 
     // Process the input in chunks to avoid holding the lock for too long at once, which keeps IRQs responsive
     while (i < count) {
@@ -461,14 +496,7 @@ void con_write_batch(console_t* con, const char* buf, size_t count) {
         spinlock_release(&con->lock, flags);
     }
 
-    // After the batch is done if this console is active 
-    // we need to flush the backbuffer to the framebuffer and enable direct rendering
-    if (active) {
-        flush_display(con);
-        bool flags = spinlock_acquire(&con->lock);
-        con->defer_render = false;
-        spinlock_release(&con->lock, flags);
-    }
+    con_batch_end(con);
 }
 
 /*
@@ -67,6 +67,10 @@ typedef struct {
 
     // When true, we skip draw_glyph
     bool defer_render;
+
+    // Nesting of con_batch_begin(), the outermost end flushes if the batch started on screen
+    uint32_t batch_depth;
+    bool batch_active;
 } console_t;
 
 // Global Hardware Management
@@ -76,6 +80,8 @@ void console_init(multiboot_parser_t* parser);
 bool con_init(console_t* con);
 void con_putc(console_t* con, char character);
 void con_write_batch(console_t* con, const char* buf, size_t count);
+void con_batch_begin(console_t* con);
+void con_batch_end(console_t* con);
 void con_set_color(console_t* con, uint8_t foreground, uint8_t background);
 void con_clear(console_t* con, uint8_t background);
 void con_refresh(console_t* con);
@@ -14,6 +14,7 @@
 #include <kernel/memory/heap.h>
 #include <kernel/sys/process.h>
 #include <kernel/sys/scheduler.h>
+#include <kernel/sys/syscall.h>
 #include <kernel/sys/timers.h>
 #include <kernel/sys/power.h>
 #include <kernel/debug.h>
@@ -21,9 +22,26 @@
 #include <klibc/stdio.h>
 #include <klibc/string.h>
 
+// Redraw reservation, a frame may take up to 15 ms and must be on screen 50 ms after the wake up
+#define DASH_DL_RUNTIME_NS  15000000ULL
+#define DASH_DL_DEADLINE_NS 50000000ULL
+#define DASH_DL_PERIOD_NS   200000000ULL
+
 static tty_t* dashTTY;
 static tty_t* lastTTY;
 
+// Set from the keyboard IRQ, the dashboard thread does the slow serial dump
+static volatile bool dump_pending = false;
+
+// Which page dash_draw() renders, flipped by CTRL+SHIFT+S
+typedef enum {
+    DASH_PAGE_OVERVIEW,
+    DASH_PAGE_SYSCALLS,
+    DASH_PAGE_COUNT,
+} dash_page_t;
+
+static volatile dash_page_t dash_page = DASH_PAGE_OVERVIEW;
+
 #pragma region Layout
 
 // layout struct
@@ -655,6 +673,32 @@ static char* fmt_size(char* out, size_t n, uint64_t bytes) {
     return out;
 }
 
+/*
+ * fmt_time - Format CPU time given in ns, in ms below a second
+ */
+static char* fmt_time(char* out, size_t n, uint64_t ns) {
+    uint64_t ms = ns / 1000000;
+    if (ms < 1000) {
+        ksnprintf(out, n, "%lu ms", ms);
+    } else {
+        ksnprintf(out, n, "%lu.%lu s", ms / 1000, (ms % 1000) / 100);
+    }
+    return out;
+}
+
+/*
+ * fmt_lat - Format a latency given in TSC cycles, in us below a millisecond
+ */
+static char* fmt_lat(char* out, size_t n, uint64_t cycles) {
+    uint64_t us = tsc_ticks_to_ns(cycles) / 1000;
+    if (us < 1000) {
+        ksnprintf(out, n, "%lu us", us);
+    } else {
+        ksnprintf(out, n, "%lu ms", us / 1000);
+    }
+    return out;
+}
+
 #pragma region CPU
 
 /*
@@ -755,13 +799,20 @@ static uint8_t state_color(thread_state_t s) {
 /*
  * fmt_tdetail - Format the state detail string for a thread row
  */
-static void fmt_tdetail(char* out, size_t n, const thread_t* t) {
-    if (t->state == T_SLEEPING) {
-        ksnprintf(out, n, "SLEEPING");
+static void fmt_tdetail(char* out, size_t n, thread_t* t) {
+    const char* s = t->dl_throttled ? "THROTTLED" : state_str(t->state);
+    rusage_t ru;
+    thread_rusage(t, &ru);
+    char run[16];
+    fmt_time(run, sizeof(run), ru.utime_ns + ru.stime_ns);
+
+    // Deadline threads carry their miss counter, everyone their CPU time and voluntary/involuntary switches
+    if (t->dl_period) {
+        ksnprintf(out, n, "%s EDF miss %lu %s %luv %lui", s, t->dl_misses, run, t->nvcsw, t->nivcsw);
         return;
     }
 
-    ksnprintf(out, n, "%s", state_str(t->state));
+    ksnprintf(out, n, "%s %s %luv %lui", s, run, t->nvcsw, t->nivcsw);
 }
 
 /*
@@ -804,7 +855,7 @@ static void condense_for_h(layout_t* L, int height) {
  * render_procs - Scaled process and thread table
  */
 static void render_procs(console_t* c, const layout_t* L) {
-    char mem[16], virt_s[16], detail[48], tid_buf[16], name_buf[128];
+    char mem[16], virt_s[16], cpu_s[16], detail[80], tid_buf[16], name_buf[128];
     int col;
     int tid_w = L->thr_w + 1;
     int thread_tree_w = 4;
@@ -837,8 +888,12 @@ static void render_procs(console_t* c, const layout_t* L) {
         int nth = 0;
         for (thread_t* t = proc->threads; t; t = t->next) nth++;
 
-        size_t vt = 0, res = 0;
-        if (proc->vmm) vmm_stats(proc->vmm, &vt, &res);
+        // Same numbers SYS_GETRUSAGE hands out
+        rusage_t ru;
+        process_rusage(proc, &ru);
+
+        size_t vt = 0;
+        if (proc->vmm) vmm_stats(proc->vmm, &vt, NULL, NULL);
 
         col = 0;
         set_col(c, CONSOLE_COLOR_YELLOW, CONSOLE_COLOR_BLACK);
@@ -853,9 +908,9 @@ static void render_procs(console_t* c, const layout_t* L) {
         ksnprintf(tid_buf, sizeof(tid_buf), "%d", nth);
         print_padded(c, tid_buf, L->thr_w); col += L->thr_w;
         if (L->state_col > col) { print_spaces(c, L->state_col - col); col = L->state_col; }
-        print_padded(c, "", L->state_w); col += L->state_w;
+        print_padded(c, fmt_time(cpu_s, sizeof(cpu_s), ru.utime_ns + ru.stime_ns), L->state_w); col += L->state_w;
         if (L->rss_col > col) { print_spaces(c, L->rss_col - col); col = L->rss_col; }
-        print_padded(c, fmt_size(mem, sizeof(mem), (uint64_t)res), L->mem_w); col += L->mem_w;
+        print_padded(c, fmt_size(mem, sizeof(mem), ru.rss), L->mem_w); col += L->mem_w;
         if (L->virt_col > col) { print_spaces(c, L->virt_col - col); col = L->virt_col; }
         print_padded(c, fmt_size(virt_s, sizeof(virt_s), (uint64_t)vt), L->mem_w);
         con_putc(c, '\n');
@@ -901,8 +956,113 @@ static void render_procs(console_t* c, const layout_t* L) {
     }
 }
 
+#pragma region Syscalls
+
+/*
+ * render_syscalls - Per syscall counts and latencies, then per process totals
+ */
+static void render_syscalls(console_t* c, const layout_t* L) {
+    char buf[5][16];
+    int name_w = L->W / 6;
+    if (name_w < 16) name_w = 16;
+
+    draw_section(c, L, "SYSCALLS");
+    for (int i = 0; i < L->header_gap; i++) con_putc(c, '\n');
+
+    set_col(c, CONSOLE_COLOR_LIGHT_CYAN, CONSOLE_COLOR_BLACK);
+    print_spaces(c, L->indent);
+    print_padded(c, "NR", L->pid_w);
+    print_padded(c, "NAME", name_w);
+    print_padded(c, "CALLS", L->mem_w + L->gap);
+    print_padded(c, "AVG", L->mem_w + L->gap);
+    print_padded(c, "P50", L->mem_w + L->gap);
+    print_padded(c, "P99", L->mem_w + L->gap);
+    print_padded(c, "MAX", L->mem_w);
+    con_putc(c, '\n');
+
+    for (uint32_t nr = 0; nr < SYSCALL_TABLE_SIZE; nr++) {
+        if (c->cy >= c->height - 2) break;
+
+        const syscall_desc_t* d = syscall_desc(nr);
+        if (!d) continue;
+
+        syscall_stat_t st;
+        syscall_get_stats(nr, &st);
+
+        // Never called is grayed out rather than hidden, the table keeps its shape
+        set_col(c, st.calls ? CONSOLE_COLOR_YELLOW : CONSOLE_COLOR_DARK_GRAY, CONSOLE_COLOR_BLACK);
+        print_spaces(c, L->indent);
+        ksnprintf(buf[0], sizeof(buf[0]), "%u", nr);
+        print_padded(c, buf[0], L->pid_w);
+
+        set_col(c, st.calls ? CONSOLE_COLOR_WHITE : CONSOLE_COLOR_DARK_GRAY, CONSOLE_COLOR_BLACK);
+        print_padded(c, d->name, name_w);
+        ksnprintf(buf[0], sizeof(buf[0]), "%lu", st.calls);
+        print_padded(c, buf[0], L->mem_w + L->gap);
+        print_padded(c, fmt_lat(buf[1], sizeof(buf[1]), st.calls ? st.cycles / st.calls : 0), L->mem_w + L->gap);
+        print_padded(c, fmt_lat(buf[2], sizeof(buf[2]), syscall_percentile(&st, 50)), L->mem_w + L->gap);
+        print_padded(c, fmt_lat(buf[3], sizeof(buf[3]), syscall_percentile(&st, 99)), L->mem_w + L->gap);
+        print_padded(c, fmt_lat(buf[4], sizeof(buf[4]), st.max_cycles), L->mem_w);
+        con_putc(c, '\n');
+    }
+
+    for (int i = 0; i < L->section_gap; i++) con_putc(c, '\n');
+
+    draw_section(c, L, "BY PROCESS");
+    for (int i = 0; i < L->header_gap; i++) con_putc(c, '\n');
+
+    set_col(c, CONSOLE_COLOR_LIGHT_CYAN, CONSOLE_COLOR_BLACK);
+    print_spaces(c, L->indent);
+    print_padded(c, "PID", L->pid_w);
+    print_padded(c, "NAME", name_w);
+    print_padded(c, "CALLS", L->mem_w + L->gap);
+    print_padded(c, "TIME", L->mem_w);
+    con_putc(c, '\n');
+
+    bool flags = process_list_lock();
+    for (process_t* proc = process_get_all(); proc; proc = proc->next) {
+        if (c->cy >= c->height - 2) break;
+        if (!proc->syscalls) continue;
+
+        set_col(c, CONSOLE_COLOR_YELLOW, CONSOLE_COLOR_BLACK);
+        print_spaces(c, L->indent);
+        ksnprintf(buf[0], sizeof(buf[0]), "%u", proc->pid);
+        print_padded(c, buf[0], L->pid_w);
+
+        set_col(c, CONSOLE_COLOR_WHITE, CONSOLE_COLOR_BLACK);
+        print_padded(c, proc->name, name_w);
+        ksnprintf(buf[0], sizeof(buf[0]), "%lu", proc->syscalls);
+        print_padded(c, buf[0], L->mem_w + L->gap);
+        print_padded(c, fmt_time(buf[1], sizeof(buf[1]), tsc_ticks_to_ns(proc->syscall_tsc)), L->mem_w);
+        con_putc(c, '\n');
+    }
+    process_list_unlock(flags);
+}
+
 #pragma region Main Draw
 
+/*
+ * dash_draw_overview - CPU, memory and process sections, the default page
+ */
+static void dash_draw_overview(console_t* con, layout_t* L) {
+    cpu_sec_t cpu = mk_cpu(L);
+    mem_sec_t mem = mk_mem(L);
+
+    // unify column positions across all sections, then bake them in
+    apply_lgrid(L, &cpu, &mem);
+    apply_pgrid(&cpu.pl, L);
+    apply_pgrid(&mem.phys_pl, L);
+    apply_pgrid(&mem.heap_pl, L);
+
+    render_cpu(con, L, &cpu);
+    for (int i = 0; i < L->section_gap; i++) con_putc(con, '\n');
+
+    render_mem(con, L, &mem);
+    for (int i = 0; i < L->section_gap; i++) con_putc(con, '\n');
+
+    render_procs(con, L);
+}
+
 /*
  * dash_draw - Render the full dashboard, build, measure, draw, done
  */
@@ -930,29 +1090,19 @@ static void dash_draw(void) {
 
     layout_t L = mk_layout((int)con->width);
     condense_for_h(&L, (int)con->height);
-    cpu_sec_t cpu = mk_cpu(&L);
-    mem_sec_t mem = mk_mem(&L);
-
-    // unify column positions across all sections, then bake them in
-    apply_lgrid(&L, &cpu, &mem);
-    apply_pgrid(&cpu.pl, &L);
-    apply_pgrid(&mem.phys_pl, &L);
-    apply_pgrid(&mem.heap_pl, &L);
-
-    render_cpu(con, &L, &cpu);
-    for (int i = 0; i < L.section_gap; i++) con_putc(con, '\n');
-
-    render_mem(con, &L, &mem);
-    for (int i = 0; i < L.section_gap; i++) con_putc(con, '\n');
 
-    render_procs(con, &L);
+    if (dash_page == DASH_PAGE_SYSCALLS) {
+        render_syscalls(con, &L);
+    } else {
+        dash_draw_overview(con, &L);
+    }
 
     // pad remaining rows to clear artifacts and anchor bottom text
     set_col(con, CONSOLE_COLOR_BLACK, CONSOLE_COLOR_BLACK);
     while (con->cy < con->height - 1) con_putc(con, '\n');
 
     set_col(con, CONSOLE_COLOR_DARK_GRAY, CONSOLE_COLOR_BLACK);
-    print_str(con, " CTRL+SHIFT+ESC to close or ALT+TAB to cycle");
+    print_str(con, " CTRL+SHIFT+ESC to close, CTRL+SHIFT+S to flip pages or ALT+TAB to cycle");
 
     con_refresh(con);
     set_defer(con, false);
@@ -967,6 +1117,12 @@ static void dash_thread(void* arg) {
     (void)arg;
 
     while (1) {
+        if (dump_pending) {
+            dump_pending = false;
+            sched_dump_stats();
+            syscall_dump_stats();
+        }
+
         if (active_tty == dashTTY) {
             dash_draw();
             // refresh every second while active, otherwise idle to save resources
@@ -986,6 +1142,20 @@ bool dash_active(void) {
     return active_tty == dashTTY;
 }
 
+/*
+ * dash_request_dump - Ask the dashboard thread to print scheduler statistics to serial
+ */
+void dash_request_dump(void) {
+    dump_pending = true;
+}
+
+/*
+ * dash_next_page - Flip to the next dashboard page, it shows on the next redraw
+ */
+void dash_next_page(void) {
+    dash_page = (dash_page + 1) % DASH_PAGE_COUNT;
+}
+
 /*
  * dash_toggle - Toggle the dashboard on or off, restoring the previous TTY on close
  */
@@ -1025,5 +1195,9 @@ void dash_init(void) {
     thread_t* t = thread_create(p, "dash", dash_thread, NULL, false, 0);
     if (!t) { LOGF("Failed to create dashboard thread\n"); return; }
 
+    // A redraw finishes within DASH_DL_DEADLINE_NS of the wake up even on a loaded system
+    if (!sched_set_deadline(t, DASH_DL_RUNTIME_NS, DASH_DL_DEADLINE_NS, DASH_DL_PERIOD_NS))
+        LOGF("Dashboard deadline reservation refused, redraws run best effort\n");
+
     sched_add(t);
 }
@@ -9,3 +9,5 @@
 void dash_init(void);
 void dash_toggle(void);
 bool dash_active(void);
+void dash_request_dump(void);
+void dash_next_page(void);
@@ -35,6 +35,22 @@ void input_handle_key(key_event_t event) {
         return;
     }
 
+    // Ctrl + Shift + D dumps scheduler and syscall accounting to serial
+    if ((event.modifiers & MOD_CTRL) &&
+        (event.modifiers & MOD_SHIFT) &&
+        event.keycode == KEY_D) {
+        dash_request_dump();
+        return;
+    }
+
+    // Ctrl + Shift + S flips the dashboard between its pages
+    if ((event.modifiers & MOD_CTRL) &&
+        (event.modifiers & MOD_SHIFT) &&
+        event.keycode == KEY_S && dash_active()) {
+        dash_next_page();
+        return;
+    }
+
     // Alt tab my beloved
     if ((event.modifiers & MOD_ALT) && event.keycode == KEY_TAB) {
         tty_cycle();
@@ -179,6 +179,9 @@ static void tty_wake(tty_t* tty) {
     while (t) {
         thread_t* next = t->rnext;
         t->rnext = NULL;
+
+        // Input waiters are interactive, let them cut in front of CPU bound threads
+        sched_boost(t);
         sched_add(t);
         t = next;
     }
@@ -186,24 +189,25 @@ static void tty_wake(tty_t* tty) {
 
 /*
  * tty_block - Block the current thread until data arrives on this TTY.
- * Re-checks the buffer with interrupts disabled to close the TOCTOU window
- * between the caller's empty-check and the actual sleep.
+ * Re-checks the buffer under tty->lock to close the TOCTOU window between
+ * the caller's empty-check and the actual sleep, tty_wake() may run on
+ * another CPU.
  */
 static void tty_block(tty_t* tty) {
     if (!sched_active()) return;
     thread_t* t = sched_current();
     if (!t) return;
 
-    bool iflag = intr_save();
+    bool flags = spinlock_acquire(&tty->lock);
     if (tty->head != tty->tail) {
         // Data arrived between caller's check and here — no need to block.
-        intr_restore(iflag);
+        spinlock_release(&tty->lock, flags);
         return;
     }
     t->state = T_BLOCKED;
     t->rnext = tty->wait_head;
     tty->wait_head = t;
-    intr_restore(iflag);
+    spinlock_release(&tty->lock, flags);
     sched_yield();
 }
 
@@ -280,6 +284,22 @@ void tty_write(tty_t* tty, const char* buf, size_t count) {
     con_write_batch(tty->console, buf, count);
 }
 
+/*
+ * tty_write_begin - Starts a write made of several tty_write() calls, shown at tty_write_end()
+ */
+void tty_write_begin(tty_t* tty) {
+    if (!tty || !tty->console) return;
+    con_batch_begin(tty->console);
+}
+
+/*
+ * tty_write_end - Ends a tty_write_begin() and puts the whole write on screen
+ */
+void tty_write_end(tty_t* tty) {
+    if (!tty || !tty->console) return;
+    con_batch_end(tty->console);
+}
+
 /*
  * tty_header_init - Reserves the top N rows of this TTY as a sticky
  * header that is never scrolled or overwritten by normal output
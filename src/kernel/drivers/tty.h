@@ -53,6 +53,8 @@ void tty_push_char_raw(tty_t* tty, char c);
 char tty_read_char(tty_t* tty);
 size_t tty_read(tty_t* tty, char* buf, size_t count);
 void tty_write(tty_t* tty, const char* buf, size_t count);
+void tty_write_begin(tty_t* tty);
+void tty_write_end(tty_t* tty);
 void tty_header_init(tty_t* tty, size_t rows);
 void tty_header_write(tty_t* tty, size_t row, const char* text, uint8_t fg, uint8_t bg);
 void tty_switch(tty_t* tty);
@@ -45,6 +45,11 @@ static thread_t *hotplug_thread = NULL;
 static tty_t *hotplug_tty = NULL;
 static volatile bool worker_idle = false;
 
+// Hotplug worker reservation, port and hub events get handled within 5 ms of the IRQ
+#define XHCI_DL_RUNTIME_NS  2000000ULL
+#define XHCI_DL_DEADLINE_NS 5000000ULL
+#define XHCI_DL_PERIOD_NS   20000000ULL
+
 static inline uint32_t cr32(xhci_hc_t *hc, uint32_t o) { return *(volatile uint32_t *)(hc->cap + o); }
 static inline uint8_t  cr8 (xhci_hc_t *hc, uint32_t o) { return *(volatile uint8_t  *)(hc->cap + o); }
 static inline uint32_t or32(xhci_hc_t *hc, uint32_t o) { return *(volatile uint32_t *)(hc->op  + o); }
@@ -157,7 +162,7 @@ static void flush_erdp(xhci_hc_t *hc) {
 }
 
 /*
- * wait_ev_poll - Busy poll fallback used before the scheduler is active
+ * wait_ev_poll - Busy poll fallback used before the scheduler is active or the MSI is routed
  */
 static trb_t wait_ev_poll(xhci_hc_t *hc, uint8_t type, uint32_t tmo) {
     xhci_completion_t *comp = (type == TRB_EV_CMD) ? &hc->cmd_comp : &hc->xfer_comp;
@@ -193,39 +198,31 @@ static void prepare_wait(xhci_hc_t *hc, uint8_t type) {
     xhci_completion_t *comp = (type == TRB_EV_CMD) ? &hc->cmd_comp : &hc->xfer_comp;
     bool iflag = intr_save();
     comp->done   = 0;
-    comp->waiter = NULL;
     kmemset(&comp->result, 0, sizeof(comp->result));
     intr_restore(iflag);
 }
 
 /*
- * wait_ev - Wait for an xHCI event TRB of the given type
+ * comp_done - waitq condition, the interrupt handler posted the event
+ */
+static bool comp_done(void *arg) {
+    return ((xhci_completion_t *)arg)->done;
+}
+
+/*
+ * wait_ev - Wait for an xHCI event TRB of the given type, up to tmo ms
  */
 static trb_t wait_ev(xhci_hc_t *hc, uint8_t type, uint32_t tmo) {
-    if (!sched_active()) {
+    // Enumeration at init runs before the MSI is set up, nothing would wake us
+    if (!sched_active() || !hc->msi_on) {
         return wait_ev_poll(hc, type, tmo);
     }
 
     xhci_completion_t *comp = (type == TRB_EV_CMD) ? &hc->cmd_comp : &hc->xfer_comp;
-
-    bool iflag = intr_save();
-
-    // Check if the event was already posted by an interrupt handler before we went to sleep
-    if (comp->done) {
-        trb_t r = comp->result;
-        intr_restore(iflag);
-        return r;
-    }
-    comp->waiter = sched_current();
-    comp->waiter->state = T_BLOCKED;
-    intr_restore(iflag);
-
-    sched_yield();
-
-    if (comp->done)
+    if (waitq_wait_timeout(&comp->wq, comp_done, comp, tmo))
         return comp->result;
 
-    // Safety fallback, go and poll brrrr
+    // The interrupt never came, go and poll brrrr
     return wait_ev_poll(hc, type, tmo);
 }
 
@@ -838,12 +835,8 @@ static void arm_int(xhci_hc_t *hc, xhci_slot_t *s) {
  */
 static void complete(xhci_completion_t *comp, trb_t ev) {
     comp->result = ev;
-    comp->done = 1;
-    if (comp->waiter) {
-        comp->waiter->state = T_READY;
-        sched_add(comp->waiter);
-        comp->waiter = NULL;
-    }
+    __atomic_store_n(&comp->done, 1, __ATOMIC_RELEASE);
+    waitq_wake_all(&comp->wq);
 }
 
 /*
@@ -1168,6 +1161,8 @@ bool xhci_init(void) {
             continue;
         }
         kmemset(hc, 0, sizeof(xhci_hc_t));
+        waitq_init(&hc->cmd_comp.wq, "xhci_cmd");
+        waitq_init(&hc->xfer_comp.wq, "xhci_xfer");
 
         uint32_t ms = align_up(pci->bar0_size, PAGE_SIZE);
         if (ms < PAGE_SIZE) ms = PAGE_SIZE;
@@ -1245,6 +1240,7 @@ bool xhci_init(void) {
             if (hc->dev_slots[j].active) arm_int(hc, &hc->dev_slots[j]);
         }
 
+        hc->msi_on = true;
         hcs[hc_cnt++] = hc;
         LOGF("[XHCI] controller %02x:%02x.%x ready (ports=%u slots=%u vec=%u)\n",
              pci->bus, pci->dev, pci->func, hc->ports, hc->slots, hc->msi_vec);
@@ -1290,6 +1286,9 @@ void xhci_hotplug_init(void) {
             return;
         }
 
+        if (!sched_set_deadline(hotplug_thread, XHCI_DL_RUNTIME_NS, XHCI_DL_DEADLINE_NS, XHCI_DL_PERIOD_NS))
+            LOGF("[XHCI] hotplug deadline reservation refused, running best effort\n");
+
         sched_add(hotplug_thread);
         LOGF("[XHCI] shared hotplug worker launched (PID=%u TID=%u)\n",
              hotplug_proc->pid, hotplug_thread->tid);
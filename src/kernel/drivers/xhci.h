@@ -12,6 +12,7 @@
 #include <arch/x86_64/cpu/interrupts.h>
 #include <kernel/sys/spinlock.h>
 #include <kernel/sys/process.h>
+#include <kernel/sys/waitq.h>
 
 #define XHCI_CAPLEN         0x00
 #define XHCI_HCIVERSION     0x02
@@ -182,7 +183,7 @@ typedef struct {
 typedef struct {
     volatile int  done;
     trb_t         result;
-    thread_t     *waiter;
+    waitq_t       wq;
 } xhci_completion_t;
 
 typedef struct {
@@ -208,6 +209,7 @@ typedef struct {
     xhci_slot_t dev_slots[256];
     spinlock_t lock;
     uint8_t msi_vec;
+    volatile bool msi_on;   // Events raise the MSI, waits can sleep instead of polling
 
     // Per HC completion slots
     xhci_completion_t cmd_comp;
@@ -18,6 +18,8 @@
 #include <kernel/drivers/serial.h>
 #include <kernel/drivers/keyboard.h>
 #include <kernel/sys/scheduler.h>
+#include <kernel/sys/smp.h>
+#include <kernel/sys/futex.h>
 #include <kernel/sys/userspace.h>
 #include <kernel/drivers/input.h>
 #include <kernel/drivers/tty.h>
@@ -30,6 +32,7 @@
 #include <kernel/sys/syscall.h>
 #include <kernel/memory/pmm.h>
 #include <kernel/memory/vmm.h>
+#include <kernel/memory/zswap.h>
 #include <kernel/sys/timers.h>
 #include <kernel/sys/power.h>
 #include <kernel/sys/acpi.h>
@@ -41,13 +44,71 @@
 // Forward declaration of userspace app launcher
 extern void uapps(void);
 
-#define TOTAL_DBG 25
+#define TOTAL_DBG 27
 
 static char* KERNEL_VERSION = "v2.0.0";
 
 // If it is a test build, the multiboot buffer will be defined in tests.c
 #ifndef TEST_BUILD
 static uint8_t multiboot_buffer[8 * 1024];
+
+// The boot path plus every deferred init thread still running, the last one out prints the boot report
+static volatile uint32_t boot_pending = 1;
+
+/*
+ * boot_finish - Drops one boot_pending reference, printing the phase table once all are gone
+ */
+static void boot_finish(void) {
+	if (__atomic_sub_fetch(&boot_pending, 1, __ATOMIC_ACQ_REL) == 0)
+		boot_report();
+}
+
+/*
+ * init_keyboard - PS/2 keyboard bring up, spends milliseconds waiting on the controller
+ */
+static void init_keyboard(void* arg) {
+	(void)arg;
+	uint64_t start = tsc_read();
+
+	keyboard_init();
+	irq_register(INT_FIRST_INTERRUPT + 1, (irq_handler_t)keyboard_handler);
+	// This runs on whichever CPU picked up the thread, IRQ 1 stays with the BSP
+	ioapic_redirect(1, INT_FIRST_INTERRUPT + 1, smp_cpu(0)->lapic_id, 0);
+	ioapic_unmask(1); // we allow the keyboard IRQ to be handled after this point, since the handler is registered and ready to go
+	QEMU_LOG_SPAN("Initialized Keyboard and routed IRQ 1", TOTAL_DBG, start);
+	kprintf("[KBD] Keyboard IRQ 1 routed and unmasked.\n");
+
+	boot_finish();
+}
+
+/*
+ * init_usb - xHCI bring up, port resets and enumeration take tens of milliseconds per port
+ */
+static void init_usb(void* arg) {
+	(void)arg;
+	uint64_t start = tsc_read();
+
+	if (xhci_init()) {
+		xhci_hotplug_init();
+		QEMU_LOG_SPAN("Initialized USB xHCI keyboard", TOTAL_DBG, start);
+	} else {
+		QEMU_LOG_SPAN("No USB xHCI keyboard found (falling back to PS/2)", TOTAL_DBG, start);
+		kprintf("[XHCI] No USB keyboard detected; PS/2 remains active.\n");
+	}
+
+	boot_finish();
+}
+
+/*
+ * boot_defer - Runs fn on a kernel thread of its own, or right here if none can be made
+ */
+static void boot_defer(const char* name, void (*fn)(void*)) {
+	__atomic_add_fetch(&boot_pending, 1, __ATOMIC_ACQ_REL);
+
+	thread_t* t = thread_create(sched_current()->process, name, fn, NULL, false, 0);
+	if (t) sched_add(t);
+	else fn(NULL);
+}
 #endif
 
 /*
@@ -72,6 +133,10 @@ void kernel_main(void* mb_info) {
 	idt_init();
 	QEMU_LOG("Initialized the IDT", TOTAL_DBG);
 
+	// CPUID and the BSP's GS based CPU local block, the VMM tracks the loaded address space there
+	cpu_init();
+	QEMU_LOG("Parsed CPU information and configured GS base", TOTAL_DBG);
+
 	// Multiboot comes next since we need to parse the memory map and other info before we can safely initialize memory management
 	multiboot_parser_t multiboot = {0};
 	multiboot_init(&multiboot, mb_info, multiboot_buffer, sizeof(multiboot_buffer));
@@ -109,6 +174,9 @@ void kernel_main(void* mb_info) {
 	// Exclude kernel image from the allocator before populating freelists
 	pmm_exclude_range(get_kstart(false), get_kend(false));
 
+	// The AP startup trampoline must stay put in low memory
+	pmm_exclude_range(AP_TRAMPOLINE_PHYS, AP_TRAMPOLINE_PHYS + AP_TRAMPOLINE_PAGES * PAGE_SIZE);
+
 	// Populate freelists from firmware reported available regions
 	for (size_t i = 0; i < multiboot.memory_map_length; i++) {
 		uintptr_t region_start, region_end;
@@ -141,8 +209,7 @@ void kernel_main(void* mb_info) {
 
 	// With the VMM online, we can use virtual addresses for everything from now on
 	gdt_init();
-	cpu_init();
-	QEMU_LOG("Parsed CPU information and configured GS base", TOTAL_DBG);
+	QEMU_LOG("Loaded the BSP GDT and TSS", TOTAL_DBG);
 
 	// kmalloc after heap init is available
 	heap_status_t heap_status = heap_kernel_init();
@@ -153,6 +220,11 @@ void kernel_main(void* mb_info) {
 	}
 	QEMU_LOG("Initialized kernel heap", TOTAL_DBG);
 
+	// Compressed swap pool for cold lazy user pages, the VMM reclaims into it under pressure
+	if (!zswap_init()) {
+		QEMU_LOG("[ZSWAP] Failed to initialize compressed swap, running without reclaim", TOTAL_DBG);
+	}
+
 	// ACPI and APIC come after memory management since they require dynamic memory for tables and structures
 	// and they need to be initialized before we can safely enable interrupts
 	acpi_init(&multiboot);
@@ -207,29 +279,25 @@ void kernel_main(void* mb_info) {
 	kprintf("[KERNEL] Dynamic TTY subsystem online.\n");
 	kprintf("[KERNEL] Use ALT+Tab to cycle between available consoles.\n");
 	
-	// Keyboard and routing
-	keyboard_init();
-	irq_register(INT_FIRST_INTERRUPT + 1, (irq_handler_t)keyboard_handler);
-	ioapic_redirect(1, INT_FIRST_INTERRUPT + 1, lapic_get_id(), 0);
-	ioapic_unmask(1); // we allow the keyboard IRQ to be handled after this point, since the handler is registered and ready to go
-	QEMU_LOG("Initialized Keyboard and routed IRQ 1", TOTAL_DBG);
-	kprintf("[KBD] Keyboard IRQ 1 routed and unmasked.\n");
-	
-	// PCI and USB for external keyboards
+	// PCI enumeration is quick, the devices behind it are probed later
 	pci_init();
-	if (xhci_init()) {
-		QEMU_LOG("Initialized USB xHCI keyboard", TOTAL_DBG);
-	} else {
-		QEMU_LOG("No USB xHCI keyboard found (falling back to PS/2)", TOTAL_DBG);
-		kprintf("[XHCI] No USB keyboard detected; PS/2 remains active.\n");
-	}
 
 	// Enable multitasking and userspace
     process_init();
     sched_init();
-	xhci_hotplug_init();
+    futex_init();
 	QEMU_LOG("Initialized Multitasking (Process & Scheduler)", TOTAL_DBG);
 
+	// Keyboards spend most of their bring up waiting on hardware,
+	// they do it on kernel threads while user programs already run
+	boot_defer("kbd_init", init_keyboard);
+	boot_defer("usb_init", init_usb);
+
+	// Wake the APs, each one joins the scheduler with its own run queue
+	smp_init();
+	kprintf("[SMP] %u CPU(s) online\n", smp_cpu_count());
+	QEMU_LOG("Started application processors", TOTAL_DBG);
+
 	// Enqueue userspace apps
 	uapps();
 	QEMU_LOG("Created userspace processes and threads", TOTAL_DBG);
@@ -244,6 +312,7 @@ void kernel_main(void* mb_info) {
 	QEMU_LOG("Enabled interrupts", TOTAL_DBG);
 
 	QEMU_LOG("Reached kernel end", TOTAL_DBG);
+	boot_finish();
 
 	// Simulate the kernel thread
 	kprintf("[KERNEL] Kernel initialization complete, entering interactive test loop...\n");
@@ -251,7 +320,7 @@ void kernel_main(void* mb_info) {
 	while (1) {
 	    char tt[128] = {0};
 
-	    kprintf("\nType anything you want (shutdown or reboot to exit): ");
+	    kprintf("\nType anything you want (shutdown or reboot to exit, syscalls or trace [on|off] for serial dumps): ");
 
 	    // Use scanset to read until newline
 	    if (kscanf(" %127[^\n]", tt) > 0) {
@@ -261,6 +330,12 @@ void kernel_main(void* mb_info) {
 	        } else if (kstrcmp(tt, "reboot") == 0) {
 				kprintf("Rebooting...\n");
 	            reboot();
+	        } else if (kstrcmp(tt, "syscalls") == 0) {
+				syscall_dump_stats();
+	        } else if (kstrcmp(tt, "trace on") == 0 || kstrcmp(tt, "trace off") == 0) {
+				syscall_trace_enable(tt[7] == 'n');
+	        } else if (kstrcmp(tt, "trace") == 0) {
+				syscall_trace_dump();
 	        }
 	        kprintf("You typed: %s\n", tt);
 	    }
@@ -13,7 +13,10 @@
 #include <kernel/memory/slab.h>
 #include <kernel/memory/pmm.h>
 #include <kernel/memory/vmm.h>
+#include <kernel/memory/zswap.h>
 #include <kernel/sys/spinlock.h>
+#include <kernel/sys/smp.h>
+#include <kernel/sys/timers.h>
 #include <kernel/debug.h>
 #include <klibc/string.h>
 #include <klibc/avl.h>
@@ -29,6 +32,22 @@
 // Sentinel for vmo_ext::phys_base when the object has no PMM backing
 #define VMM_PHYS_NONE UINT64_MAX
 
+// Objects mapping physical memory the caller handed in, never freed here
+#define VMM_CALLER_PHYS (VM_FLAG_MMIO | VM_FLAG_PHYS)
+
+// Non-present PTE holding a zswap handle: P clear, bit 1 set, handle in the rest.
+// Handles are 8 byte aligned so the low 3 bits are free for the marker.
+#define VMM_PTE_SWAP        (1ULL << 1)
+#define VMM_PTE_IS_SWAP(e)  (!((e) & PAGE_PRESENT) && ((e) & VMM_PTE_SWAP))
+#define VMM_PTE_HANDLE(e)   ((e) & ~7ULL)
+
+// Bound for a lockless tree walk, a torn read can otherwise chase a transient cycle
+#define VMA_WALK_MAX 64
+
+// Reclaim batch, and the free memory level below which lazy faults start reclaiming
+#define VMM_RECLAIM_BATCH     64
+#define VMM_RECLAIM_LOW_BYTES (2 * MEASUREMENT_UNIT_MB)
+
 // Extended vm_object with validation
 typedef struct vmo_ext {
     uint32_t magic;
@@ -39,23 +58,54 @@ typedef struct vmo_ext {
     uint64_t phys_base;
     uint64_t phys_length;
     avl_node_t vma_node;
+    // VMA tree augmentation, describes the subtree rooted at vma_node
+    uintptr_t sub_min_base; // base of the leftmost object
+    uintptr_t sub_max_end;  // end of the rightmost object
+    size_t    sub_max_gap;  // largest hole between two objects of the subtree
+    struct vmo_ext* retired_next; // retired list link, see vma_retire
 } vmo_ext;
 
 // Extended VMM with validation
-typedef struct {
+typedef struct vmm_ctx {
     uint32_t magic;
     vmm_t public;
     bool is_kernel;
     avl_tree_t vma_tree; // VMA tree, sorted by base address
-    spinlock_t lock;
+    spinlock_t lock;     // serializes writers and page table updates
+    uint32_t vma_seq;    // odd while a writer is changing the tree or an object's range/flags
+    uint32_t readers;    // lockless tree readers in flight
+    vmo_ext* retired;    // unlinked objects waiting for readers to leave
+    struct vmm_ctx* next_user; // user VMM registry, walked by reclaim
+    uintptr_t reclaim_hand;    // clock hand, next virtual address to scan
+
+    // Usage counters, written under lock
+    size_t rss;                // bytes backed by private frames
+    size_t peak_rss;
+    uint64_t minflt;           // lazy faults served without I/O
+    uint64_t majflt;           // lazy faults that had to load from zswap
 } vmm_ctx;
 
 static vmm_ctx* kernel_vmm = NULL;
-static vmm_t* current_vmm = NULL;
 static slab_cache_t* vmm_cache = NULL;
 static slab_cache_t* vmo_cache = NULL;
 static volatile size_t mmio_bytes = 0;
 
+// Every non-kernel VMM, so reclaim can find cold pages in any address space
+static vmm_ctx* user_vmms = NULL;
+static spinlock_t user_vmms_lock;
+
+// Shared read-only frame that backs untouched VM_FLAG_LAZY pages after a read fault.
+// It is never owned by a VMA, so every free path must skip it.
+static uint64_t zero_frame = 0;
+
+/*
+ * vmm_rss_add - Account private frames mapped (delta > 0) or released, vmm->lock held
+ */
+static inline void vmm_rss_add(vmm_ctx* vmm, int64_t delta) {
+    vmm->rss += (size_t)delta;
+    if (vmm->rss > vmm->peak_rss) vmm->peak_rss = vmm->rss;
+}
+
 // SSE free page zero: this file is compiled with -mno-sse (interrupt path).
 // rep stosq matches what kmemset does for aligned power of 2 sizes, without SSE.
 static inline void zero_page(void *dst) {
@@ -63,6 +113,13 @@ static inline void zero_page(void *dst) {
     __asm__ volatile("rep stosq" : "+D"(dst), "+c"(cnt) : "a"(0ULL) : "memory");
 }
 
+/*
+ * vmm_is_zero_frame - True if phys lies in the shared zero frame
+ */
+static inline bool vmm_is_zero_frame(uint64_t phys) {
+    return zero_frame && (phys & ~(uint64_t)(PAGE_SIZE - 1)) == zero_frame;
+}
+
 #pragma region Validation Helpers
 
 /*
@@ -111,6 +168,40 @@ static inline bool vm_object_validate(vmo_ext* obj) {
 
 #pragma region Internal Functions
 
+/*
+ * Lockless VMA lookups
+ *
+ * Writers hold vmm->lock and bracket every change to the tree shape or to an
+ * object's base/length/flags with vma_write_begin/end. Readers take no lock:
+ * they register in vmm->readers, walk the tree and retry if vma_seq moved.
+ * Unlinked objects are parked on vmm->retired and only freed once no reader
+ * is in flight, so a reader never touches freed memory.
+ */
+
+typedef struct {
+    vmo_ext*  obj;
+    uintptr_t base;
+    size_t    length;
+    size_t    flags;
+} vma_snap_t;
+
+static inline void vma_write_begin(vmm_ctx* vmm) {
+    __atomic_store_n(&vmm->vma_seq, vmm->vma_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void vma_write_end(vmm_ctx* vmm) {
+    __atomic_store_n(&vmm->vma_seq, vmm->vma_seq + 1, __ATOMIC_RELEASE);
+}
+
+static inline void vma_read_enter(vmm_ctx* vmm) {
+    __atomic_add_fetch(&vmm->readers, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline void vma_read_exit(vmm_ctx* vmm) {
+    __atomic_sub_fetch(&vmm->readers, 1, __ATOMIC_RELEASE);
+}
+
 /*
  * vma_cmp - Compare two VMA nodes
  */
@@ -122,11 +213,43 @@ static int vma_cmp(const avl_node_t* a, const avl_node_t* b) {
     return 0;
 }
 
+/*
+ * vma_augment - Recompute the subtree bounds and largest inner hole of a VMA node
+ */
+static void vma_augment(avl_node_t* n) {
+    vmo_ext* obj = AVL_ENTRY(n, vmo_ext, vma_node);
+    uintptr_t base = obj->public.base;
+    uintptr_t end = base + obj->public.length;
+
+    obj->sub_min_base = base;
+    obj->sub_max_end = end;
+    obj->sub_max_gap = 0;
+
+    if (n->left) {
+        vmo_ext* l = AVL_ENTRY(n->left, vmo_ext, vma_node);
+        obj->sub_min_base = l->sub_min_base;
+        obj->sub_max_gap = l->sub_max_gap;
+        if (base - l->sub_max_end > obj->sub_max_gap)
+            obj->sub_max_gap = base - l->sub_max_end;
+    }
+
+    if (n->right) {
+        vmo_ext* r = AVL_ENTRY(n->right, vmo_ext, vma_node);
+        obj->sub_max_end = r->sub_max_end;
+        if (r->sub_max_gap > obj->sub_max_gap)
+            obj->sub_max_gap = r->sub_max_gap;
+        if (r->sub_min_base - end > obj->sub_max_gap)
+            obj->sub_max_gap = r->sub_min_base - end;
+    }
+}
+
 /*
  * vma_insert - Insert obj into the VMM's VMA tree and maintain public.next / public.objects
  */
 static void vma_insert(vmm_ctx* vmm, vmo_ext* obj) {
+    vma_write_begin(vmm);
     avl_insert(&vmm->vma_tree, &obj->vma_node);
+    vma_write_end(vmm);
 
     avl_node_t* nx = avl_next(&obj->vma_node);
     avl_node_t* pv = avl_prev(&obj->vma_node);
@@ -150,7 +273,19 @@ static void vma_remove(vmm_ctx* vmm, vmo_ext* obj) {
     else
         vmm->public.objects = obj->public.next;
 
+    vma_write_begin(vmm);
     avl_remove(&vmm->vma_tree, &obj->vma_node);
+    vma_write_end(vmm);
+}
+
+/*
+ * vma_set_length - Change the length of an object already in the tree
+ */
+static void vma_set_length(vmm_ctx* vmm, vmo_ext* obj, size_t length) {
+    vma_write_begin(vmm);
+    obj->public.length = length;
+    avl_update(&vmm->vma_tree, &obj->vma_node);
+    vma_write_end(vmm);
 }
 
 /*
@@ -177,38 +312,129 @@ static vmo_ext* vma_find_containing(vmm_ctx* vmm, uintptr_t addr) {
 }
 
 /*
- * vma_find_gap - Find a gap of at least 'length' bytes in the VMM's address space, aligned to 'virt_align'
+ * vma_lookup - Lockless vma_find_containing, must run between vma_read_enter/exit
+ *
+ * Fills a consistent snapshot of the object's range and flags. Returns false
+ * if no object contains addr.
  */
-static uintptr_t vma_find_gap(vmm_ctx* vmm, size_t length, size_t virt_align) {
-    uintptr_t cand = align_up(vmm->public.alloc_base, virt_align);
-
-    while (cand && cand + length > cand && cand + length <= vmm->public.alloc_end) {
-        vmo_ext key = {0};
-        key.public.base = cand;
+static bool vma_lookup(vmm_ctx* vmm, uintptr_t addr, vma_snap_t* out) {
+    for (;;) {
+        uint32_t seq;
+        while ((seq = __atomic_load_n(&vmm->vma_seq, __ATOMIC_ACQUIRE)) & 1)
+            __asm__ volatile("pause");
+
+        avl_node_t* n = __atomic_load_n(&vmm->vma_tree.root, __ATOMIC_RELAXED);
+        vmo_ext* best = NULL;
+        for (int steps = 0; n && steps < VMA_WALK_MAX; steps++) {
+            vmo_ext* o = AVL_ENTRY(n, vmo_ext, vma_node);
+            uintptr_t base = __atomic_load_n(&o->public.base, __ATOMIC_RELAXED);
+            if (addr < base) {
+                n = __atomic_load_n(&n->left, __ATOMIC_RELAXED);
+            } else {
+                best = o;
+                if (addr == base) break;
+                n = __atomic_load_n(&n->right, __ATOMIC_RELAXED);
+            }
+        }
 
-        avl_node_t* fn = avl_floor(&vmm->vma_tree, &key.vma_node);
-        if (fn) {
-            vmo_ext* f = AVL_ENTRY(fn, vmo_ext, vma_node);
-            uintptr_t fend = f->public.base + f->public.length;
-            if (cand < fend) { cand = align_up(fend, virt_align); continue; }
+        if (best) {
+            out->obj = best;
+            out->base = __atomic_load_n(&best->public.base, __ATOMIC_RELAXED);
+            out->length = __atomic_load_n(&best->public.length, __ATOMIC_RELAXED);
+            out->flags = __atomic_load_n(&best->public.flags, __ATOMIC_RELAXED);
         }
 
-        avl_node_t* cn = avl_ceil(&vmm->vma_tree, &key.vma_node);
-        if (!cn)
-            break;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&vmm->vma_seq, __ATOMIC_RELAXED) != seq) continue;
 
-        vmo_ext* c = AVL_ENTRY(cn, vmo_ext, vma_node);
-        if (cand + length <= c->public.base)
-            break;
+        return best && addr < out->base + out->length;
+    }
+}
+
+/*
+ * vma_retire - Hand an object that was just removed from the tree over for deferred freeing
+ */
+static void vma_retire(vmm_ctx* vmm, vmo_ext* obj) {
+    obj->retired_next = vmm->retired;
+    vmm->retired = obj;
+}
 
-        cand = align_up(c->public.base + c->public.length, virt_align);
+void vmm_free_vm_object(vmo_ext* obj);
+
+/*
+ * vma_reap - Free retired objects once no lockless reader can still reach them
+ */
+static void vma_reap(vmm_ctx* vmm, bool wait) {
+    if (wait) {
+        while (__atomic_load_n(&vmm->readers, __ATOMIC_ACQUIRE))
+            __asm__ volatile("pause");
+    } else if (__atomic_load_n(&vmm->readers, __ATOMIC_ACQUIRE)) {
+        return;
     }
 
-    if (!cand || cand + length <= cand || cand + length > vmm->public.alloc_end)
-        return 0;
+    vmo_ext* obj = vmm->retired;
+    vmm->retired = NULL;
+    while (obj) {
+        vmo_ext* nx = obj->retired_next;
+        vmm_free_vm_object(obj);
+        obj = nx;
+    }
+}
+
+/*
+ * vma_gap_fit - Lowest address in [lo, hi) aligned to 'virt_align' with room for 'length', or 0
+ */
+static uintptr_t vma_gap_fit(vmm_ctx* vmm, uintptr_t lo, uintptr_t hi, size_t length, size_t virt_align) {
+    if (lo < vmm->public.alloc_base) lo = vmm->public.alloc_base;
+    if (hi > vmm->public.alloc_end) hi = vmm->public.alloc_end;
+
+    uintptr_t cand = align_up(lo, virt_align);
+    if (cand < lo || cand >= hi || hi - cand < length) return 0;
     return cand;
 }
 
+/*
+ * vma_gap_search - First fitting hole in the subtree at n, 'lo' being the end of whatever precedes it
+ *
+ * Subtrees whose holes are all smaller than 'length' are skipped using the
+ * augmentation, so only the path to the answer (plus holes that are big
+ * enough but lose to alignment) is visited. Depth is bounded by the tree height.
+ */
+static uintptr_t vma_gap_search(vmm_ctx* vmm, avl_node_t* n, uintptr_t lo, size_t length, size_t virt_align) {
+    if (!n) return 0;
+
+    vmo_ext* obj = AVL_ENTRY(n, vmo_ext, vma_node);
+    if (obj->sub_max_end <= vmm->public.alloc_base) return 0;
+    if (obj->sub_min_base - lo < length && obj->sub_max_gap < length) return 0;
+
+    uintptr_t found = vma_gap_search(vmm, n->left, lo, length, virt_align);
+    if (found) return found;
+
+    uintptr_t before = n->left ? AVL_ENTRY(n->left, vmo_ext, vma_node)->sub_max_end : lo;
+    found = vma_gap_fit(vmm, before, obj->public.base, length, virt_align);
+    if (found) return found;
+
+    return vma_gap_search(vmm, n->right, obj->public.base + obj->public.length, length, virt_align);
+}
+
+/*
+ * vma_find_gap - Find a gap of at least 'length' bytes in the VMM's address space, aligned to 'virt_align'
+ */
+static uintptr_t vma_find_gap(vmm_ctx* vmm, size_t length, size_t virt_align) {
+    if (!length) return 0;
+
+    avl_node_t* root = vmm->vma_tree.root;
+    if (!root)
+        return vma_gap_fit(vmm, vmm->public.alloc_base, vmm->public.alloc_end, length, virt_align);
+
+    uintptr_t found = vma_gap_search(vmm, root, vmm->public.alloc_base, length, virt_align);
+    if (found) return found;
+
+    // Tail hole after the last object
+    vmo_ext* top = AVL_ENTRY(root, vmo_ext, vma_node);
+    return vma_gap_fit(vmm, top->sub_max_end, vmm->public.alloc_end, length, virt_align);
+}
+
 /* 
  * vma_overlaps - Returns true if [start, start+length) overlaps any existing VMA
  */
@@ -369,6 +595,14 @@ static vmm_status_t arch_map_huge_page(uint64_t pt_root, uint64_t phys, void* vi
     return VMM_OK;
 }
 
+/*
+ * vmm_flush_page - Drop virt from this CPU's TLB and from every other CPU running on pt_root
+ */
+static void vmm_flush_page(uint64_t pt_root, void* virt) {
+    invlpg(virt);
+    smp_tlb_flush(pt_root, virt);
+}
+
 /*
  * arch_unmap_page - Unmap a single 4KB or 2MB page from the page tables (x86_64 version)
  * Returns the physical base of the unmapped page, or 0 if not mapped.
@@ -389,7 +623,7 @@ uint64_t arch_unmap_page(uint64_t pt_root, void* virt) {
         if (!(pde & PAGE_PRESENT)) return 0;
         uint64_t phys = pde & ~(uint64_t)(PAGE_2MB - 1) & ADDR_MASK;
         pd[PD_INDEX(virt)] = 0;
-        invlpg(virt);
+        vmm_flush_page(pt_root, virt);
 
         if (vmm_table_is_empty(pd)) {
             uint64_t pd_phys = PHYSMAP_V2P((uint64_t)pd);
@@ -408,14 +642,21 @@ uint64_t arch_unmap_page(uint64_t pt_root, void* virt) {
     if (!pt) return 0;
 
     size_t pt_index = PT_INDEX(virt);
+    uint64_t phys = 0;
 
-    if (!(pt[pt_index] & PAGE_PRESENT)) {
-        return 0;
-    }
+    if (VMM_PTE_IS_SWAP(pt[pt_index])) {
+        // Swapped out page, the compressed copy dies with the mapping
+        zswap_drop(VMM_PTE_HANDLE(pt[pt_index]));
+        pt[pt_index] = 0;
+    } else {
+        if (!(pt[pt_index] & PAGE_PRESENT)) {
+            return 0;
+        }
 
-    uint64_t phys = PT_ENTRY_ADDR(pt[pt_index]);
-    pt[pt_index] = 0;
-    invlpg(virt);
+        phys = PT_ENTRY_ADDR(pt[pt_index]);
+        pt[pt_index] = 0;
+        vmm_flush_page(pt_root, virt);
+    }
 
     if (vmm_table_is_empty(pt)) {
         uint64_t pt_phys = PHYSMAP_V2P((uint64_t)pt);
@@ -464,12 +705,126 @@ vmm_status_t arch_update_page_flags(uint64_t pt_root, void* virt, uint64_t new_f
     }
 
     uint64_t phys = PT_ENTRY_ADDR(pt[pt_index]);
+
+    // The zero frame is shared, it must stay read-only whatever the VMA allows
+    if (vmm_is_zero_frame(phys)) new_flags &= ~PAGE_WRITABLE;
+
     pt[pt_index] = phys | new_flags;
-    invlpg(virt);
+    vmm_flush_page(pt_root, virt);
+
+    return VMM_OK;
+}
+
+/*
+ * arch_replace_page - Point an existing 4KB mapping at a different frame
+ */
+static vmm_status_t arch_replace_page(uint64_t pt_root, uint64_t phys, void* virt, uint64_t pt_flags) {
+    uint64_t* pml4 = (uint64_t*)PHYSMAP_P2V(pt_root);
+
+    uint64_t* pdpt = vmm_ensure_table(pml4, PML4_INDEX(virt), false, false);
+    if (!pdpt) return VMM_ERR_NOT_FOUND;
+
+    uint64_t* pd = vmm_ensure_table(pdpt, PDPT_INDEX(virt), false, false);
+    if (!pd) return VMM_ERR_NOT_FOUND;
+
+    uint64_t* pt = vmm_ensure_table(pd, PD_INDEX(virt), false, false);
+    if (!pt) return VMM_ERR_NOT_FOUND;
+
+    size_t pt_index = PT_INDEX(virt);
+    if (!(pt[pt_index] & PAGE_PRESENT)) return VMM_ERR_NOT_FOUND;
+
+    pt[pt_index] = PT_ENTRY_ADDR(phys) | pt_flags;
+    vmm_flush_page(pt_root, virt);
+
+    return VMM_OK;
+}
+
+/*
+ * vmm_pte_ptr - Locate the leaf PTE for virt without creating tables
+ */
+static uint64_t* vmm_pte_ptr(uint64_t pt_root, void* virt) {
+    uint64_t* pml4 = (uint64_t*)PHYSMAP_P2V(pt_root);
+
+    uint64_t* pdpt = vmm_ensure_table(pml4, PML4_INDEX(virt), false, false);
+    if (!pdpt) return NULL;
+
+    uint64_t* pd = vmm_ensure_table(pdpt, PDPT_INDEX(virt), false, false);
+    if (!pd || (pd[PD_INDEX(virt)] & PAGE_HUGE)) return NULL;
+
+    uint64_t* pt = vmm_ensure_table(pd, PD_INDEX(virt), false, false);
+    if (!pt) return NULL;
+
+    return &pt[PT_INDEX(virt)];
+}
+
+/*
+ * arch_prune_tables - Free the PT/PD/PDPT above virt once they hold nothing
+ */
+static void arch_prune_tables(uint64_t pt_root, void* virt) {
+    uint64_t* pml4 = (uint64_t*)PHYSMAP_P2V(pt_root);
+
+    uint64_t* pdpt = vmm_ensure_table(pml4, PML4_INDEX(virt), false, false);
+    if (!pdpt) return;
+
+    uint64_t* pd = vmm_ensure_table(pdpt, PDPT_INDEX(virt), false, false);
+    if (!pd || (pd[PD_INDEX(virt)] & PAGE_HUGE)) return;
+
+    uint64_t* pt = vmm_ensure_table(pd, PD_INDEX(virt), false, false);
+    if (pt) {
+        if (!vmm_table_is_empty(pt)) return;
+        pmm_free(PHYSMAP_V2P((uint64_t)pt), PAGE_SIZE);
+        pd[PD_INDEX(virt)] = 0;
+    }
+
+    if (!vmm_table_is_empty(pd)) return;
+    pmm_free(PHYSMAP_V2P((uint64_t)pd), PAGE_SIZE);
+    pdpt[PDPT_INDEX(virt)] = 0;
+
+    if (!vmm_table_is_empty(pdpt)) return;
+    pmm_free(PHYSMAP_V2P((uint64_t)pdpt), PAGE_SIZE);
+    pml4[PML4_INDEX(virt)] = 0;
+}
+
+/*
+ * arch_move_page - Move one leaf PTE (present or swap marker) from 'from' to 'to'
+ */
+static vmm_status_t arch_move_page(uint64_t pt_root, void* from, void* to, bool set_user) {
+    uint64_t* src = vmm_pte_ptr(pt_root, from);
+    if (!src || !*src) return VMM_OK; // never faulted in, nothing to carry over
+
+    uint64_t* pml4 = (uint64_t*)PHYSMAP_P2V(pt_root);
+
+    uint64_t* pdpt = vmm_ensure_table(pml4, PML4_INDEX(to), true, set_user);
+    if (!pdpt) return VMM_ERR_NO_MEMORY;
+
+    uint64_t* pd = vmm_ensure_table(pdpt, PDPT_INDEX(to), true, set_user);
+    if (!pd) return VMM_ERR_NO_MEMORY;
+
+    uint64_t* pt = vmm_ensure_table(pd, PD_INDEX(to), true, set_user);
+    if (!pt) return VMM_ERR_NO_MEMORY;
+
+    uint64_t* dst = &pt[PT_INDEX(to)];
+    if (*dst) return VMM_ERR_ALREADY_MAPPED;
+
+    *dst = *src;
+    *src = 0;
+    vmm_flush_page(pt_root, from);
 
     return VMM_OK;
 }
 
+/*
+ * vmm_free_bytes - Free physical memory left in the PMM
+ */
+static uint64_t vmm_free_bytes(void) {
+    pmm_stats_t st;
+    pmm_get_stats(&st);
+    uint64_t total = 0;
+    for (int i = 0; i < PMM_MAX_ORDERS; i++)
+        total += st.free_blocks[i] << i;
+    return total * pmm_min_block_size();
+}
+
 /*
  * vmm_get_mapped_phys - Get physical address from virtual address
  */
@@ -547,11 +902,24 @@ void vmm_free_vm_object(vmo_ext* obj) {
 void vmm_destroy_page_table(uint64_t table_phys, bool purge, int level) {
     uint64_t* table = (uint64_t*)PHYSMAP_P2V(table_phys);
 
+    // Leaf tables may still hold swap markers that own zswap entries
+    if (purge && level == 1) {
+        for (size_t i = 0; i < PAGE_ENTRIES; ++i) {
+            if (VMM_PTE_IS_SWAP(table[i])) zswap_drop(VMM_PTE_HANDLE(table[i]));
+        }
+    }
+
     if (purge && level > 1) {
         for (size_t i = 0; i < PAGE_ENTRIES; ++i) {
             uint64_t entry = table[i];
             if (!(entry & PAGE_PRESENT)) continue;
 
+            // 2MB leaves are frames, not tables, their owner frees them
+            if (level == 2 && (entry & PAGE_HUGE)) {
+                table[i] = 0;
+                continue;
+            }
+
             uint64_t child_phys = PT_ENTRY_ADDR(entry);
             vmm_destroy_page_table(child_phys, purge, level - 1);
             table[i] = 0;
@@ -599,7 +967,7 @@ vmm_status_t vmm_alloc(vmm_t* vmm_pub, size_t length, size_t flags, void* arg, v
 
     bool lock_flags = spinlock_acquire(&vmm->lock);
 
-    if (flags & VM_FLAG_MMIO) {
+    if (flags & VMM_CALLER_PHYS) {
         uint64_t mmio_phys = (uint64_t)arg;
         if (mmio_phys & (PAGE_SIZE - 1)) {
             LOGF("[VMM ERROR] MMIO address 0x%lx is not page-aligned\n",
@@ -617,7 +985,7 @@ vmm_status_t vmm_alloc(vmm_t* vmm_pub, size_t length, size_t flags, void* arg, v
     }
 
     // Prefer 2MB aligned virtual base for large allocations so huge pages can fire
-    size_t virt_align = (!(flags & (VM_FLAG_MMIO | VM_FLAG_LAZY)) && length >= PAGE_2MB)
+    size_t virt_align = (!(flags & (VMM_CALLER_PHYS | VM_FLAG_LAZY)) && length >= PAGE_2MB)
                         ? PAGE_2MB : PAGE_SIZE;
 
     uintptr_t found_base = vma_find_gap(vmm, length, virt_align);
@@ -649,13 +1017,14 @@ vmm_status_t vmm_alloc(vmm_t* vmm_pub, size_t length, size_t flags, void* arg, v
     // To be blunt, I quite hate MMIO stuff being shoehorned into this API, but it was either this or a separate mmio_map 
     // function and I don't want to write more code than I have to :P
     uint64_t phys_base = 0;
-    if (flags & VM_FLAG_MMIO) {
+    if (flags & VMM_CALLER_PHYS) {
         phys_base = (uint64_t)arg;
     } else {
         pmm_status_t status = pmm_alloc(length, &phys_base);
         if (status != PMM_OK) {
             vma_remove(vmm, obj);
-            vmm_free_vm_object(obj);
+            vma_retire(vmm, obj);
+            vma_reap(vmm, false);
             spinlock_release(&vmm->lock, lock_flags);
             return VMM_ERR_NO_MEMORY;
         }
@@ -663,11 +1032,11 @@ vmm_status_t vmm_alloc(vmm_t* vmm_pub, size_t length, size_t flags, void* arg, v
     }
 
     // Determine page table flags and map the pages
-    obj->phys_base   = (flags & VM_FLAG_MMIO) ? VMM_PHYS_NONE : phys_base;
-    obj->phys_length = (flags & VM_FLAG_MMIO) ? 0 : length;
+    obj->phys_base   = (flags & VMM_CALLER_PHYS) ? VMM_PHYS_NONE : phys_base;
+    obj->phys_length = (flags & VMM_CALLER_PHYS) ? 0 : length;
     bool is_user_vmm = !vmm->is_kernel;
     uint64_t pt_flags = vmm_convert_vm_flags(flags, vmm->is_kernel);
-    bool allow_huge = !(flags & (VM_FLAG_MMIO | VM_FLAG_LAZY));
+    bool allow_huge = !(flags & (VMM_CALLER_PHYS | VM_FLAG_LAZY));
     bool any_huge = false;
 
     // Map each page, trying to use 2MB pages where possible
@@ -693,9 +1062,10 @@ vmm_status_t vmm_alloc(vmm_t* vmm_pub, size_t length, size_t flags, void* arg, v
         if (ms != VMM_OK) {
             for (size_t rb = 0; rb < offset; rb += PAGE_SIZE)
                 arch_unmap_page(vmm->public.pt_root, (void*)(obj->public.base + rb));
-            if (!(flags & VM_FLAG_MMIO)) pmm_free(phys_base, length);
+            if (!(flags & VMM_CALLER_PHYS)) pmm_free(phys_base, length);
             vma_remove(vmm, obj);
-            vmm_free_vm_object(obj);
+            vma_retire(vmm, obj);
+            vma_reap(vmm, false);
             spinlock_release(&vmm->lock, lock_flags);
             return ms;
         }
@@ -707,9 +1077,11 @@ vmm_status_t vmm_alloc(vmm_t* vmm_pub, size_t length, size_t flags, void* arg, v
     // pg_size > PAGE_SIZE means "has huge pages"
     obj->pg_size = any_huge ? PAGE_2MB : PAGE_SIZE;
 
-    // track MMIO usage for stats
+    // track MMIO usage for stats, caller owned RAM is neither MMIO nor this VMM's RSS
     if (flags & VM_FLAG_MMIO)
         __atomic_add_fetch(&mmio_bytes, length, __ATOMIC_RELAXED);
+    else if (!(flags & VM_FLAG_PHYS))
+        vmm_rss_add(vmm, (int64_t)length);
 
     *out_addr = (void*)obj->public.base;
     spinlock_release(&vmm->lock, lock_flags);
@@ -755,7 +1127,7 @@ vmm_status_t vmm_alloc_at(vmm_t* vmm_pub, void* desired_addr, size_t length, siz
     }
 
     // For MMIO, the physical base is provided by the caller and must be page aligned
-    if (flags & VM_FLAG_MMIO) {
+    if (flags & VMM_CALLER_PHYS) {
         uint64_t mmio_phys = (uint64_t)arg;
         if (mmio_phys & (PAGE_SIZE - 1)) {
             LOGF("[VMM] vmm_alloc_at: MMIO address 0x%lx not page-aligned\n",
@@ -785,23 +1157,24 @@ vmm_status_t vmm_alloc_at(vmm_t* vmm_pub, void* desired_addr, size_t length, siz
     vma_insert(vmm, obj);
 
     uint64_t phys_base = 0;
-    if (flags & VM_FLAG_MMIO) {
+    if (flags & VMM_CALLER_PHYS) {
         phys_base = (uint64_t)arg;
     } else {
         pmm_status_t pmm_status = pmm_alloc(length, &phys_base);
         if (pmm_status != PMM_OK) {
             vma_remove(vmm, obj);
-            vmm_free_vm_object(obj);
+            vma_retire(vmm, obj);
+            vma_reap(vmm, false);
             spinlock_release(&vmm->lock, lock_flags);
             return VMM_ERR_NO_MEMORY;
         }
     }
 
-    obj->phys_base   = (flags & VM_FLAG_MMIO) ? VMM_PHYS_NONE : phys_base;
-    obj->phys_length = (flags & VM_FLAG_MMIO) ? 0 : length;
+    obj->phys_base   = (flags & VMM_CALLER_PHYS) ? VMM_PHYS_NONE : phys_base;
+    obj->phys_length = (flags & VMM_CALLER_PHYS) ? 0 : length;
     bool is_user_vmm = !vmm->is_kernel;
     uint64_t pt_flags = vmm_convert_vm_flags(flags, vmm->is_kernel);
-    bool allow_huge = !(flags & (VM_FLAG_MMIO | VM_FLAG_LAZY));
+    bool allow_huge = !(flags & (VMM_CALLER_PHYS | VM_FLAG_LAZY));
     bool any_huge = false;
 
     // Map each page, trying to use 2MB pages where possible
@@ -827,9 +1200,10 @@ vmm_status_t vmm_alloc_at(vmm_t* vmm_pub, void* desired_addr, size_t length, siz
         if (ms != VMM_OK) {
             for (size_t rb = 0; rb < offset; rb += PAGE_SIZE)
                 arch_unmap_page(vmm->public.pt_root, (void*)(desired + rb));
-            if (!(flags & VM_FLAG_MMIO)) pmm_free(phys_base, length);
+            if (!(flags & VMM_CALLER_PHYS)) pmm_free(phys_base, length);
             vma_remove(vmm, obj);
-            vmm_free_vm_object(obj);
+            vma_retire(vmm, obj);
+            vma_reap(vmm, false);
             spinlock_release(&vmm->lock, lock_flags);
             return ms;
         }
@@ -843,6 +1217,8 @@ vmm_status_t vmm_alloc_at(vmm_t* vmm_pub, void* desired_addr, size_t length, siz
     // MMIO tracking
     if (flags & VM_FLAG_MMIO)
         __atomic_add_fetch(&mmio_bytes, length, __ATOMIC_RELAXED);
+    else if (!(flags & VM_FLAG_PHYS))
+        vmm_rss_add(vmm, (int64_t)length);
 
     *out_addr = desired_addr;
     spinlock_release(&vmm->lock, lock_flags);
@@ -869,7 +1245,8 @@ vmm_status_t vmm_free(vmm_t* vmm_pub, void* addr) {
         return VMM_ERR_INVALID;
     }
 
-    bool has_pmm_backing = !(cur->public.flags & VM_FLAG_MMIO);
+    bool has_pmm_backing = !(cur->public.flags & VMM_CALLER_PHYS);
+    size_t released = 0;
     if (cur->pg_size > PAGE_SIZE) {
         // Here we got a huge page region, so we know for sure that the entire region is backed by one 
         // contiguous PMM block (or no block at all, for lazy regions). Just unmap the whole 
@@ -879,8 +1256,10 @@ vmm_status_t vmm_free(vmm_t* vmm_pub, void* addr) {
         for (uintptr_t virt = cur->public.base;
              virt < cur->public.base + cur->public.length; virt += PAGE_SIZE)
             arch_unmap_page(vmm->public.pt_root, (void*)virt);
-        if (has_pmm_backing && cur->phys_base != VMM_PHYS_NONE)
+        if (has_pmm_backing && cur->phys_base != VMM_PHYS_NONE) {
             pmm_free(cur->phys_base, cur->public.length);
+            released = cur->public.length;
+        }
     } else {
         /* 
         Three cases:
@@ -903,8 +1282,10 @@ vmm_status_t vmm_free(vmm_t* vmm_pub, void* addr) {
             // Free any grown pages
             for (uintptr_t virt = base + cur->phys_length; virt < base + length; virt += PAGE_SIZE) {
                 uint64_t phys = 0;
-                if (vmm_get_mapped_phys(vmm->public.pt_root, (void*)virt, &phys))
+                if (vmm_get_mapped_phys(vmm->public.pt_root, (void*)virt, &phys) && !vmm_is_zero_frame(phys)) {
                     pmm_free(phys, PAGE_SIZE);
+                    released += PAGE_SIZE;
+                }
             }
 
             // Unmap the full virtual range
@@ -913,13 +1294,16 @@ vmm_status_t vmm_free(vmm_t* vmm_pub, void* addr) {
 
             // Bulk free the original contiguous allocation
             pmm_free(cur->phys_base, cur->phys_length);
+            released += cur->phys_length;
         } else {
             // walk every page and only mapped pages get freed
             for (uintptr_t virt = base; virt < base + length; virt += PAGE_SIZE) {
                 if (has_pmm_backing) {
                     uint64_t phys = 0;
-                    if (vmm_get_mapped_phys(vmm->public.pt_root, (void*)virt, &phys))
+                    if (vmm_get_mapped_phys(vmm->public.pt_root, (void*)virt, &phys) && !vmm_is_zero_frame(phys)) {
                         pmm_free(phys, PAGE_SIZE);
+                        released += PAGE_SIZE;
+                    }
                 }
                 arch_unmap_page(vmm->public.pt_root, (void*)virt);
             }
@@ -927,11 +1311,13 @@ vmm_status_t vmm_free(vmm_t* vmm_pub, void* addr) {
     }
 
     // track MMIO usage for stats
-    if (!has_pmm_backing)
+    if (cur->public.flags & VM_FLAG_MMIO)
         __atomic_sub_fetch(&mmio_bytes, cur->public.length, __ATOMIC_RELAXED);
+    vmm_rss_add(vmm, -(int64_t)released);
 
     vma_remove(vmm, cur);
-    vmm_free_vm_object(cur);
+    vma_retire(vmm, cur);
+    vma_reap(vmm, false);
 
     spinlock_release(&vmm->lock, lock_flags);
     return VMM_OK;
@@ -972,7 +1358,7 @@ vmm_t* vmm_create(uintptr_t alloc_base, uintptr_t alloc_end) {
 
     vmm->magic = VMM_MAGIC;
     vmm->is_kernel = false;
-    avl_init(&vmm->vma_tree, vma_cmp);
+    avl_init_augmented(&vmm->vma_tree, vma_cmp, vma_augment);
     spinlock_init(&vmm->lock, "user_vmm");
 
     uint64_t pt_root = vmm_alloc_page_table();
@@ -994,6 +1380,12 @@ vmm_t* vmm_create(uintptr_t alloc_base, uintptr_t alloc_end) {
     vmm->public.objects = NULL;
     vmm->public.alloc_base = alloc_base;
     vmm->public.alloc_end = alloc_end;
+    vmm->reclaim_hand = alloc_base;
+
+    bool list_flags = spinlock_acquire(&user_vmms_lock);
+    vmm->next_user = user_vmms;
+    user_vmms = vmm;
+    spinlock_release(&user_vmms_lock, list_flags);
 
     LOGF("[VMM] User VMM initialized, managing 0x%lx - 0x%lx (%zu MiB)\n",
            alloc_base, alloc_end, (alloc_end - alloc_base)/MEASUREMENT_UNIT_MB);
@@ -1013,9 +1405,19 @@ void vmm_destroy(vmm_t* vmm_pub) {
         return;
     }
 
+    // Unlink first so reclaim never picks up a VMM being torn down
+    bool list_flags = spinlock_acquire(&user_vmms_lock);
+    for (vmm_ctx** pp = &user_vmms; *pp; pp = &(*pp)->next_user) {
+        if (*pp == vmm) { *pp = vmm->next_user; break; }
+    }
+    spinlock_release(&user_vmms_lock, list_flags);
+
     // Acquiring the lock prevents any concurrent alloc from racing teardown
     bool lock_flags = spinlock_acquire(&vmm->lock);
 
+    // Lockless readers must be gone before objects are freed in place below
+    vma_reap(vmm, true);
+
     avl_node_t* n = avl_min(&vmm->vma_tree);
     while (n) {
         vmo_ext* cur = AVL_ENTRY(n, vmo_ext, vma_node);
@@ -1024,7 +1426,7 @@ void vmm_destroy(vmm_t* vmm_pub) {
             break;
         }
         avl_node_t* nx = avl_next(n);
-        if (!(cur->public.flags & VM_FLAG_MMIO)) {
+        if (!(cur->public.flags & VMM_CALLER_PHYS)) {
             if (cur->pg_size > PAGE_SIZE) {
                 // Huge page, use phys_base directly
                 if (cur->phys_base != VMM_PHYS_NONE)
@@ -1045,7 +1447,7 @@ void vmm_destroy(vmm_t* vmm_pub) {
                         for (uintptr_t virt = base + cur->phys_length;
                              virt < base + length; virt += PAGE_SIZE) {
                             uint64_t phys = 0;
-                            if (vmm_get_mapped_phys(vmm->public.pt_root, (void*)virt, &phys))
+                            if (vmm_get_mapped_phys(vmm->public.pt_root, (void*)virt, &phys) && !vmm_is_zero_frame(phys))
                                 pmm_free(phys, PAGE_SIZE);
                         }
                         // Bulk free the original contiguous allocation
@@ -1055,12 +1457,14 @@ void vmm_destroy(vmm_t* vmm_pub) {
                     // only faulted in pages are mapped
                     for (uintptr_t virt = base; virt < base + length; virt += PAGE_SIZE) {
                         uint64_t phys = 0;
-                        if (vmm_get_mapped_phys(vmm->public.pt_root, (void*)virt, &phys))
+                        if (vmm_get_mapped_phys(vmm->public.pt_root, (void*)virt, &phys) && !vmm_is_zero_frame(phys))
                             pmm_free(phys, PAGE_SIZE);
                     }
                 }
             }
         }
+        if (cur->public.flags & VM_FLAG_MMIO)
+            __atomic_sub_fetch(&mmio_bytes, cur->public.length, __ATOMIC_RELAXED);
         vmm_free_vm_object(cur);
         n = nx;
     }
@@ -1097,8 +1501,10 @@ void vmm_switch(vmm_t* vmm_pub) {
     vmm_ctx* vmm = vmm_get_instance(vmm_pub);
     if (!vmm) return;
 
+    // Published before CR3 so a concurrent smp_tlb_flush() never skips us with a stale TLB
+    this_cpu()->vmm = &vmm->public;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
     PML4_switch(vmm->public.pt_root);
-    current_vmm = &vmm->public;
 }
 
 /*
@@ -1106,10 +1512,11 @@ void vmm_switch(vmm_t* vmm_pub) {
  */
 vmm_t* vmm_get_current(void) {
     // If not explicitly set yet, assume kernel VMM
-    if (!current_vmm && kernel_vmm) {
+    vmm_t* current = (vmm_t*)this_cpu()->vmm;
+    if (!current && kernel_vmm) {
         return &kernel_vmm->public;
     }
-    return current_vmm;
+    return current;
 }
 
 #pragma endregion
@@ -1136,6 +1543,10 @@ vmm_status_t vmm_kernel_init(uintptr_t alloc_base, uintptr_t alloc_end) {
         cpu_enable_feature(CF_NX);
     }
 
+    // CR0.WP: ring 0 writes honour read-only PTEs, so a kernel copy into a user
+    // buffer mapped to the zero frame faults and gets a private page instead
+    write_cr0(read_cr0() | (1ULL << 16));
+
     // Kernel VMM is allocated from PMM directly for a stable physical address
     uint64_t vmm_phys = 0;
     if (pmm_alloc(sizeof(vmm_ctx), &vmm_phys) != PMM_OK) {
@@ -1147,8 +1558,9 @@ vmm_status_t vmm_kernel_init(uintptr_t alloc_base, uintptr_t alloc_end) {
 
     vmm->magic = VMM_MAGIC;
     vmm->is_kernel = true;
-    avl_init(&vmm->vma_tree, vma_cmp);
+    avl_init_augmented(&vmm->vma_tree, vma_cmp, vma_augment);
     spinlock_init(&vmm->lock, "kernel_vmm");
+    spinlock_init(&user_vmms_lock, "user_vmms");
 
     vmm->public.pt_root = (uint64_t)KERNEL_V2P(getPML4());
     vmm->public.objects = NULL;
@@ -1156,7 +1568,7 @@ vmm_status_t vmm_kernel_init(uintptr_t alloc_base, uintptr_t alloc_end) {
     vmm->public.alloc_end = alloc_end;
 
     kernel_vmm = vmm;
-    current_vmm = &kernel_vmm->public;
+    this_cpu()->vmm = &kernel_vmm->public;
 
     vmm_cache = slab_cache_create("vmm_ctx", sizeof(vmm_ctx), _Alignof(vmm_ctx));
     vmo_cache = slab_cache_create("vmo_ext", sizeof(vmo_ext), _Alignof(vmo_ext));
@@ -1166,6 +1578,13 @@ vmm_status_t vmm_kernel_init(uintptr_t alloc_base, uintptr_t alloc_end) {
         return VMM_ERR_NO_MEMORY;
     }
 
+    // Shared zero frame for read faults on lazy memory
+    if (pmm_alloc(PAGE_SIZE, &zero_frame) != PMM_OK) {
+        LOGF("[VMM] Failed to allocate the shared zero frame\n");
+        return VMM_ERR_NO_MEMORY;
+    }
+    zero_page((void*)PHYSMAP_P2V(zero_frame));
+
     LOGF("[VMM] Kernel VMM initialized, managing 0x%lx - 0x%lx (%zu MiB)\n",
          alloc_base, alloc_end, (alloc_end - alloc_base) / MEASUREMENT_UNIT_MB);
 
@@ -1215,7 +1634,7 @@ size_t vmm_get_alloc_size(vmm_t* vmm_pub) {
  */
 bool vmm_table_is_empty(uint64_t* table) {
     for (size_t i = 0; i < PAGE_ENTRIES; ++i) {
-        if (table[i] & PAGE_PRESENT) return false;
+        if (table[i] & (PAGE_PRESENT | VMM_PTE_SWAP)) return false;
     }
     return true;
 }
@@ -1239,31 +1658,38 @@ bool vmm_get_physical(vmm_t* vmm_pub, void* virt, uint64_t* out_phys) {
 
 /*
  * vmm_find_mapped_object - Find vm_object containing a virtual address
+ *
+ * Lockless, the object stays valid until the caller (or another thread) frees it.
  */
 vm_object* vmm_find_mapped_object(vmm_t* vmm_pub, void* addr) {
     vmm_ctx* vmm = vmm_get_instance(vmm_pub);
     if (!vmm || !addr) return NULL;
 
-    bool lock_flags = spinlock_acquire(&vmm->lock);
-
-    vmo_ext* cur = vma_find_containing(vmm, (uintptr_t)addr);
-    if (cur && !vm_object_validate(cur)) {
+    vma_snap_t snap;
+    vma_read_enter(vmm);
+    bool found = vma_lookup(vmm, (uintptr_t)addr, &snap);
+    if (found && !vm_object_validate(snap.obj)) {
         LOGF("[VMM ERROR] Corrupted vm_object in list\n");
-        spinlock_release(&vmm->lock, lock_flags);
-        return NULL;
+        found = false;
     }
-    spinlock_release(&vmm->lock, lock_flags);
-    return cur ? &cur->public : NULL;
+    vma_read_exit(vmm);
+
+    return found ? &snap.obj->public : NULL;
 }
 
 /*
  * vmm_check_flags - Check if a specific address has specific flags
  */
 bool vmm_check_flags(vmm_t* vmm_pub, void* addr, size_t required_flags) {
-    vm_object* obj = vmm_find_mapped_object(vmm_pub, addr);
-    if (!obj) return false;
+    vmm_ctx* vmm = vmm_get_instance(vmm_pub);
+    if (!vmm || !addr) return false;
 
-    return (obj->flags & required_flags) == required_flags;
+    vma_snap_t snap;
+    vma_read_enter(vmm);
+    bool found = vma_lookup(vmm, (uintptr_t)addr, &snap);
+    vma_read_exit(vmm);
+
+    return found && (snap.flags & required_flags) == required_flags;
 }
 
 /*
@@ -1327,7 +1753,10 @@ bool vmm_check_buffer(vmm_t* vmm_pub, const void* ptr, size_t size, size_t requi
                 return false;
             }
         } else {
-            if ((required_flags & VM_FLAG_WRITE) && !(pte & PAGE_WRITABLE)) {
+            // A zero frame mapping in a writable lazy object breaks on the first write
+            bool cow_zero = (last_obj->public.flags & (VM_FLAG_LAZY | VM_FLAG_WRITE)) == (VM_FLAG_LAZY | VM_FLAG_WRITE)
+                            && vmm_is_zero_frame(PT_ENTRY_ADDR(pte));
+            if ((required_flags & VM_FLAG_WRITE) && !(pte & PAGE_WRITABLE) && !cow_zero) {
                 spinlock_release(&vmm->lock, lock_flags);
                 return false;
             }
@@ -1370,6 +1799,118 @@ vmm_status_t vmm_map_page(vmm_t* vmm_pub, uint64_t phys, void* virt, size_t flag
     return status;
 }
 
+/*
+ * vmm_handle_lazy_fault - Back a faulting page of a VM_FLAG_LAZY object
+ *
+ * Read faults map the shared zero frame read-only. Write faults, either on
+ * an unmapped page or on a zero frame mapping, get a private zeroed frame.
+ * Swapped out pages are decompressed from zswap into a fresh frame. When no
+ * frame is available, cold pages are reclaimed and VMM_OK is returned so the
+ * access retries.
+ *
+ * The object is looked up without the VMM lock and write faults allocate and
+ * zero their frame before taking it, so the lock only covers revalidation and
+ * the PTE update. Faults on different objects overlap in everything else.
+ */
+vmm_status_t vmm_handle_lazy_fault(vmm_t* vmm_pub, void* addr, bool is_write) {
+    vmm_ctx* vmm = vmm_get_instance(vmm_pub);
+    if (!vmm) return VMM_ERR_NOT_INIT;
+
+    uint64_t t0 = tsc_read();
+    void* page = (void*)((uintptr_t)addr & ~(uintptr_t)(PAGE_SIZE - 1));
+
+    vma_snap_t snap;
+    vma_read_enter(vmm);
+    bool found = vma_lookup(vmm, (uintptr_t)addr, &snap);
+    vma_read_exit(vmm);
+
+    if (!found || !(snap.flags & VM_FLAG_LAZY)) return VMM_ERR_NOT_FOUND;
+    if (is_write && !(snap.flags & VM_FLAG_WRITE)) return VMM_ERR_INVALID;
+
+    // Write faults almost always end in a private frame, prepare it unlocked
+    uint64_t phys = 0;
+    if (is_write) {
+        if (pmm_alloc(PAGE_SIZE, &phys) != PMM_OK)
+            // Memory pressure: push cold pages into zswap and let the access retry
+            return vmm_reclaim(VMM_RECLAIM_BATCH) ? VMM_OK : VMM_ERR_NO_MEMORY;
+        zero_page((void*)PHYSMAP_P2V(phys));
+    }
+
+    bool lock_flags = spinlock_acquire(&vmm->lock);
+
+    // The object may have been freed, shrunk or reprotected meanwhile
+    vmo_ext* obj = vma_find_containing(vmm, (uintptr_t)addr);
+    vmm_status_t recheck = VMM_OK;
+    if (!obj || !(obj->public.flags & VM_FLAG_LAZY)) recheck = VMM_ERR_NOT_FOUND;
+    else if (is_write && !(obj->public.flags & VM_FLAG_WRITE)) recheck = VMM_ERR_INVALID;
+
+    // A different object now covers addr: returning OK retries the access against it
+    if (recheck != VMM_OK || obj != snap.obj) {
+        spinlock_release(&vmm->lock, lock_flags);
+        if (phys) pmm_free(phys, PAGE_SIZE);
+        return recheck;
+    }
+
+    uint64_t pt_flags = vmm_convert_vm_flags(obj->public.flags, vmm->is_kernel);
+    uint64_t* ptep = vmm_pte_ptr(vmm->public.pt_root, page);
+    uint64_t pte = ptep ? *ptep : 0;
+    bool swapped = VMM_PTE_IS_SWAP(pte);
+
+    if (pte & PAGE_PRESENT) {
+        // Another CPU got here first, or a write hit a page that is already private
+        if (!is_write || !vmm_is_zero_frame(PT_ENTRY_ADDR(pte))) {
+            spinlock_release(&vmm->lock, lock_flags);
+            if (phys) pmm_free(phys, PAGE_SIZE);
+            return VMM_OK;
+        }
+    } else if (!is_write && !swapped) {
+        vmm_status_t status = arch_map_page(vmm->public.pt_root, zero_frame, page,
+                                            pt_flags & ~PAGE_WRITABLE, !vmm->is_kernel);
+        if (status == VMM_OK) vmm->minflt++;
+        spinlock_release(&vmm->lock, lock_flags);
+        return status;
+    }
+
+    // Read fault on a swapped page, the only case still without a frame
+    if (!phys && pmm_alloc(PAGE_SIZE, &phys) != PMM_OK) {
+        spinlock_release(&vmm->lock, lock_flags);
+        return vmm_reclaim(VMM_RECLAIM_BATCH) ? VMM_OK : VMM_ERR_NO_MEMORY;
+    }
+
+    vmm_status_t status;
+    if (swapped) {
+        if (!zswap_load(VMM_PTE_HANDLE(pte), phys)) {
+            pmm_free(phys, PAGE_SIZE);
+            spinlock_release(&vmm->lock, lock_flags);
+            return VMM_ERR_NOT_FOUND;
+        }
+        // Freshly loaded pages count as referenced so the clock does not evict them at once
+        *ptep = PT_ENTRY_ADDR(phys) | pt_flags | PAGE_ACCESSED;
+        status = VMM_OK;
+    } else {
+        status = (pte & PAGE_PRESENT)
+            ? arch_replace_page(vmm->public.pt_root, phys, page, pt_flags | PAGE_ACCESSED)
+            : arch_map_page(vmm->public.pt_root, phys, page, pt_flags | PAGE_ACCESSED, !vmm->is_kernel);
+        if (status != VMM_OK) pmm_free(phys, PAGE_SIZE);
+    }
+
+    if (status == VMM_OK) {
+        vmm_rss_add(vmm, PAGE_SIZE);
+        if (swapped) vmm->majflt++;
+        else vmm->minflt++;
+    }
+
+    spinlock_release(&vmm->lock, lock_flags);
+
+    if (swapped) zswap_record_fault(tsc_read() - t0);
+
+    // Keep a little headroom so the slab can still grow the zswap pool
+    if (status == VMM_OK && zswap_is_initialized() && vmm_free_bytes() < VMM_RECLAIM_LOW_BYTES)
+        vmm_reclaim(VMM_RECLAIM_BATCH);
+
+    return status;
+}
+
 /*
  * vmm_unmap_page - Unmaps a virtual page and handles cleanup
  */
@@ -1396,7 +1937,7 @@ vmm_status_t vmm_map_range(vmm_t* vmm_pub, uint64_t phys, void* virt, size_t len
 
     uint64_t pt_flags = vmm_convert_vm_flags(flags, vmm->is_kernel);
     bool is_user_vmm = !vmm->is_kernel;
-    bool allow_huge = !(flags & (VM_FLAG_MMIO | VM_FLAG_LAZY));
+    bool allow_huge = !(flags & (VMM_CALLER_PHYS | VM_FLAG_LAZY));
 
     size_t offset = 0;
     while (offset < length) {
@@ -1465,6 +2006,66 @@ vmm_status_t vmm_unmap_range(vmm_t* vmm_pub, void* virt, size_t length) {
     return VMM_OK;
 }
 
+/*
+ * vmm_can_grow_in_place - True if [base, base+new_length) stays clear of the next VMA and in range
+ */
+static bool vmm_can_grow_in_place(vmm_ctx* vmm, vmo_ext* cur, size_t new_length) {
+    uintptr_t new_end = cur->public.base + new_length;
+    if (new_end < cur->public.base) return false;
+
+    avl_node_t* nx = avl_next(&cur->vma_node);
+    if (nx) return new_end <= AVL_ENTRY(nx, vmo_ext, vma_node)->public.base;
+    return new_end <= vmm->public.alloc_end;
+}
+
+/*
+ * vmm_grow_locked - Extend cur to new_length, backing the tail unless the object is lazy
+ */
+static vmm_status_t vmm_grow_locked(vmm_ctx* vmm, vmo_ext* cur, size_t new_length) {
+    size_t old_length = cur->public.length;
+    size_t growth = new_length - old_length;
+
+    // Lazy objects fault their tail in like the rest of them
+    if (cur->public.flags & VM_FLAG_LAZY) {
+        vma_set_length(vmm, cur, new_length);
+        return VMM_OK;
+    }
+
+    // We need to allocate new physical pages for the growth portion
+    uint64_t phys_base = 0;
+    pmm_status_t pmm_status = pmm_alloc(growth, &phys_base);
+    if (pmm_status != PMM_OK) {
+        LOGF("[VMM ERROR] vmm_grow: Failed to allocate %zu bytes of physical memory\n", growth);
+        return VMM_ERR_NO_MEMORY;
+    }
+
+    bool is_user_vmm = !vmm->is_kernel;
+    uint64_t pt_flags = vmm_convert_vm_flags(cur->public.flags, vmm->is_kernel);
+
+    // Map new pages one by one, rolling back on failure
+    for (size_t offset = 0; offset < growth; offset += PAGE_SIZE) {
+        vmm_status_t map_status =
+            arch_map_page(vmm->public.pt_root, phys_base + offset,
+                          (void*)(cur->public.base + old_length + offset),
+                          pt_flags, is_user_vmm);
+
+        if (map_status != VMM_OK) {
+            LOGF("[VMM ERROR] vmm_grow: Mapping failed at offset 0x%lx\n", offset);
+
+            for (size_t rb = 0; rb < offset; rb += PAGE_SIZE) {
+                arch_unmap_page(vmm->public.pt_root, (void*)(cur->public.base + old_length + rb));
+            }
+
+            pmm_free(phys_base, growth);
+            return map_status;
+        }
+    }
+
+    vmm_rss_add(vmm, (int64_t)growth);
+    vma_set_length(vmm, cur, new_length);
+    return VMM_OK;
+}
+
 /*
  * vmm_resize - Resize an existing virtual memory region
  */
@@ -1486,7 +2087,7 @@ vmm_status_t vmm_resize(vmm_t* vmm_pub, void* addr, size_t new_length) {
         return VMM_ERR_NOT_FOUND;
     }
 
-    if ((cur->public.flags & VM_FLAG_MMIO) || cur->pg_size > PAGE_SIZE) {
+    if ((cur->public.flags & VMM_CALLER_PHYS) || cur->pg_size > PAGE_SIZE) {
         LOGF("[VMM ERROR] vmm_resize: Cannot resize MMIO or huge page region\n");
         spinlock_release(&vmm->lock, lock_flags);
         return VMM_ERR_INVALID;
@@ -1500,74 +2101,21 @@ vmm_status_t vmm_resize(vmm_t* vmm_pub, void* addr, size_t new_length) {
     }
 
     if (new_length > old_length) {
-        size_t growth = new_length - old_length;
-        uintptr_t new_end = cur->public.base + new_length;
-
-        avl_node_t* nx = avl_next(&cur->vma_node);
-        vmo_ext* next_obj = nx ? AVL_ENTRY(nx, vmo_ext, vma_node) : NULL;
-        if (next_obj) {
-            if (new_end > next_obj->public.base) {
-                LOGF(
-                    "[VMM ERROR] vmm_resize: Growth would overlap with next "
-                    "object\n");
-                spinlock_release(&vmm->lock, lock_flags);
-                return VMM_ERR_OOM;
-            }
-        } else {
-            if (new_end > vmm->public.alloc_end) {
-                LOGF(
-                    "[VMM ERROR] vmm_resize: Growth exceeds allocation "
-                    "range\n");
-                spinlock_release(&vmm->lock, lock_flags);
-                return VMM_ERR_OOM;
-            }
-        }
-
-        // We need to allocate new physical pages for the growth portion
-        uint64_t phys_base = 0;
-        pmm_status_t pmm_status = pmm_alloc(growth, &phys_base);
-        if (pmm_status != PMM_OK) {
-            LOGF("[VMM ERROR] vmm_resize: Failed to allocate %zu bytes of physical memory\n", growth);
+        if (!vmm_can_grow_in_place(vmm, cur, new_length)) {
+            LOGF("[VMM ERROR] vmm_resize: Growth would overlap the next object or leave the allocation range\n");
             spinlock_release(&vmm->lock, lock_flags);
-            return VMM_ERR_NO_MEMORY;
-        }
-
-        bool is_user_vmm = !vmm->is_kernel;
-        uint64_t pt_flags = vmm_convert_vm_flags(cur->public.flags, vmm->is_kernel);
-        size_t mapped_offset = 0;
-
-        // Map new pages one by one, rolling back on failure
-        for (size_t offset = 0; offset < growth; offset += PAGE_SIZE) {
-            vmm_status_t map_status =
-                arch_map_page(vmm->public.pt_root, phys_base + offset,
-                              (void*)(cur->public.base + old_length + offset),
-                              pt_flags, is_user_vmm);
-
-            if (map_status != VMM_OK) {
-                LOGF("[VMM ERROR] vmm_resize: Mapping failed at offset 0x%lx\n", offset);
-
-                for (size_t rb = 0; rb < offset; rb += PAGE_SIZE) {
-                    arch_unmap_page(vmm->public.pt_root, (void*)(cur->public.base + old_length + rb));
-                }
-
-                pmm_free(phys_base, growth);
-
-                spinlock_release(&vmm->lock, lock_flags);
-                return map_status;
-            }
-
-            mapped_offset = offset + PAGE_SIZE;
+            return VMM_ERR_OOM;
         }
 
-        cur->public.length = new_length;
+        vmm_status_t status = vmm_grow_locked(vmm, cur, new_length);
         spinlock_release(&vmm->lock, lock_flags);
-        return VMM_OK;
+        return status;
     }
 
     else {
         size_t shrinkage = old_length - new_length;
         uintptr_t shrink_start = cur->public.base + new_length;
-        bool has_pmm_backing = !(cur->public.flags & VM_FLAG_MMIO);
+        bool has_pmm_backing = !(cur->public.flags & VMM_CALLER_PHYS);
 
         // Unmap virtual pages being shrunk away
         uintptr_t phys_end = cur->public.base + cur->phys_length;
@@ -1575,18 +2123,129 @@ vmm_status_t vmm_resize(vmm_t* vmm_pub, void* addr, size_t new_length) {
              virt += PAGE_SIZE) {
             if (has_pmm_backing && virt >= phys_end) {
                 uint64_t phys = 0;
-                if (vmm_get_mapped_phys(vmm->public.pt_root, (void*)virt, &phys))
+                if (vmm_get_mapped_phys(vmm->public.pt_root, (void*)virt, &phys) && !vmm_is_zero_frame(phys)) {
                     pmm_free(phys, PAGE_SIZE);
+                    vmm_rss_add(vmm, -(int64_t)PAGE_SIZE);
+                }
             }
             arch_unmap_page(vmm->public.pt_root, (void*)virt);
         }
 
-        cur->public.length = new_length;
+        vma_set_length(vmm, cur, new_length);
         spinlock_release(&vmm->lock, lock_flags);
         return VMM_OK;
     }
 }
 
+/*
+ * vmm_remap - Resize a region, relocating it when it cannot grow in place
+ *
+ * Growth happens in place when the gap after the object allows it. Otherwise,
+ * with may_move, the object takes a fresh gap and its PTEs (present pages and
+ * swap markers alike) are carried over, so no data is copied.
+ */
+vmm_status_t vmm_remap(vmm_t* vmm_pub, void* addr, size_t new_length, bool may_move, void** out_addr) {
+    vmm_ctx* vmm = vmm_get_instance(vmm_pub);
+    if (!vmm) return VMM_ERR_NOT_INIT;
+    if (!addr || !out_addr || new_length == 0) return VMM_ERR_INVALID;
+
+    *out_addr = NULL;
+
+    bool lock_flags = spinlock_acquire(&vmm->lock);
+
+    new_length = align_up(new_length, PAGE_SIZE);
+
+    vmo_ext* cur = vma_find_exact(vmm, (uintptr_t)addr);
+    if (!cur || !vm_object_validate(cur)) {
+        spinlock_release(&vmm->lock, lock_flags);
+        return VMM_ERR_NOT_FOUND;
+    }
+
+    if ((cur->public.flags & VMM_CALLER_PHYS) || cur->pg_size > PAGE_SIZE) {
+        spinlock_release(&vmm->lock, lock_flags);
+        return VMM_ERR_INVALID;
+    }
+
+    size_t old_length = cur->public.length;
+
+    // Shrinking never moves, vmm_resize already knows how to do it
+    if (new_length <= old_length) {
+        spinlock_release(&vmm->lock, lock_flags);
+        vmm_status_t status = vmm_resize(vmm_pub, addr, new_length);
+        if (status == VMM_OK) *out_addr = addr;
+        return status;
+    }
+
+    if (vmm_can_grow_in_place(vmm, cur, new_length)) {
+        vmm_status_t status = vmm_grow_locked(vmm, cur, new_length);
+        if (status == VMM_OK) *out_addr = addr;
+        spinlock_release(&vmm->lock, lock_flags);
+        return status;
+    }
+
+    if (!may_move) {
+        spinlock_release(&vmm->lock, lock_flags);
+        return VMM_ERR_OOM;
+    }
+
+    uintptr_t old_base = cur->public.base;
+    uintptr_t new_base = vma_find_gap(vmm, new_length, PAGE_SIZE);
+    if (!new_base) {
+        spinlock_release(&vmm->lock, lock_flags);
+        return VMM_ERR_OOM;
+    }
+
+    bool set_user = !vmm->is_kernel && (cur->public.flags & VM_FLAG_USER);
+
+    for (size_t off = 0; off < old_length; off += PAGE_SIZE) {
+        vmm_status_t st = arch_move_page(vmm->public.pt_root, (void*)(old_base + off),
+                                         (void*)(new_base + off), set_user);
+        if (st != VMM_OK) {
+            // Put back what already moved, the object stays where it was
+            for (size_t rb = 0; rb < off; rb += PAGE_SIZE) {
+                arch_move_page(vmm->public.pt_root, (void*)(new_base + rb), (void*)(old_base + rb), set_user);
+            }
+            for (size_t rb = 0; rb < off; rb += PAGE_2MB) {
+                arch_prune_tables(vmm->public.pt_root, (void*)(new_base + rb));
+            }
+            spinlock_release(&vmm->lock, lock_flags);
+            return st;
+        }
+    }
+
+    // Release the leaf tables the move emptied, one probe per 2MB span
+    for (uintptr_t virt = old_base; virt < old_base + old_length;
+         virt = align_down(virt, PAGE_2MB) + PAGE_2MB) {
+        arch_prune_tables(vmm->public.pt_root, (void*)virt);
+    }
+
+    vma_remove(vmm, cur);
+    cur->public.base = new_base;
+    vma_insert(vmm, cur);
+
+    vmm_status_t status = vmm_grow_locked(vmm, cur, new_length);
+    if (status != VMM_OK) {
+        // Growth failed at the destination, carry the pages back home
+        LOGF("[VMM ERROR] vmm_remap: Growth at 0x%lx failed, restoring 0x%lx\n", new_base, old_base);
+        for (size_t off = 0; off < old_length; off += PAGE_SIZE) {
+            arch_move_page(vmm->public.pt_root, (void*)(new_base + off), (void*)(old_base + off), set_user);
+        }
+        for (uintptr_t virt = new_base; virt < new_base + old_length;
+             virt = align_down(virt, PAGE_2MB) + PAGE_2MB) {
+            arch_prune_tables(vmm->public.pt_root, (void*)virt);
+        }
+        vma_remove(vmm, cur);
+        cur->public.base = old_base;
+        vma_insert(vmm, cur);
+        spinlock_release(&vmm->lock, lock_flags);
+        return status;
+    }
+
+    *out_addr = (void*)new_base;
+    spinlock_release(&vmm->lock, lock_flags);
+    return VMM_OK;
+}
+
 #pragma endregion
 
 #pragma region Protection
@@ -1618,7 +2277,9 @@ vmm_status_t vmm_protect(vmm_t* vmm_pub, void* addr, size_t new_flags) {
         return VMM_ERR_INVALID;
     }
 
+    vma_write_begin(vmm);
     obj->flags = new_flags;
+    vma_write_end(vmm);
 
     uint64_t pt_flags = vmm_convert_vm_flags(new_flags, vmm->is_kernel);
 
@@ -1638,6 +2299,129 @@ vmm_status_t vmm_protect(vmm_t* vmm_pub, void* addr, size_t new_flags) {
 
 #pragma endregion
 
+#pragma region Reclaim
+
+/*
+ * vmm_swap_out_page - Clock step for one page: give it a second chance or push it to zswap
+ *
+ * The page is unmapped and shot down on every CPU before it is compressed,
+ * a thread of the same process on another CPU cannot write to the frame
+ * after its contents were taken. Faults on it meanwhile wait on the VMM
+ * lock the caller holds and find either the swap marker or the old PTE.
+ */
+static bool vmm_swap_out_page(vmm_ctx* vmm, uint64_t* ptep, void* virt) {
+    if (!(*ptep & PAGE_PRESENT)) return false;
+
+    uint64_t phys = PT_ENTRY_ADDR(*ptep);
+    if (vmm_is_zero_frame(phys)) return false;
+
+    // Referenced since the last sweep, spare it this time. Atomic so a dirty bit
+    // another CPU sets meanwhile survives, and flushed so its TLB entry sets A again
+    if (*ptep & PAGE_ACCESSED) {
+        __atomic_fetch_and(ptep, ~PAGE_ACCESSED, __ATOMIC_SEQ_CST);
+        vmm_flush_page(vmm->public.pt_root, virt);
+        return false;
+    }
+
+    // Exchanged so a dirty bit set by another CPU up to this point is not lost on restore
+    uint64_t old = __atomic_exchange_n(ptep, 0, __ATOMIC_SEQ_CST);
+    vmm_flush_page(vmm->public.pt_root, virt);
+
+    uint64_t handle;
+    if (!zswap_store(phys, &handle)) {
+        __atomic_store_n(ptep, old, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    // Non-present entries are never cached, no second shootdown
+    __atomic_store_n(ptep, handle | VMM_PTE_SWAP, __ATOMIC_RELEASE);
+    pmm_free(phys, PAGE_SIZE);
+    vmm_rss_add(vmm, -(int64_t)PAGE_SIZE);
+    return true;
+}
+
+/*
+ * vmm_reclaim_vmm - Advance one VMM's clock hand over its lazy objects, at most one lap
+ */
+static size_t vmm_reclaim_vmm(vmm_ctx* vmm, size_t want) {
+    size_t freed = 0;
+    uintptr_t start = vmm->reclaim_hand;
+
+    // lap 0 scans [hand, end), lap 1 wraps around over [begin, hand)
+    for (int lap = 0; lap < 2 && freed < want; lap++) {
+        for (avl_node_t* it = avl_min(&vmm->vma_tree); it && freed < want; it = avl_next(it)) {
+            vmo_ext* obj = AVL_ENTRY(it, vmo_ext, vma_node);
+            if (!(obj->public.flags & VM_FLAG_LAZY) || (obj->public.flags & VMM_CALLER_PHYS)) continue;
+
+            uintptr_t lo = obj->public.base;
+            uintptr_t hi = lo + obj->public.length;
+            if (lap == 0) {
+                if (hi <= start) continue;
+                if (lo < start) lo = start;
+            } else {
+                if (lo >= start) break;
+                if (hi > start) hi = start;
+            }
+
+            for (uintptr_t virt = lo; virt < hi && freed < want; virt += PAGE_SIZE) {
+                uint64_t* ptep = vmm_pte_ptr(vmm->public.pt_root, (void*)virt);
+                if (!ptep) {
+                    // No leaf table, nothing was ever faulted in this 2MB span
+                    virt = align_up(virt + 1, PAGE_2MB) - PAGE_SIZE;
+                } else if (vmm_swap_out_page(vmm, ptep, (void*)virt)) {
+                    freed++;
+                }
+                vmm->reclaim_hand = virt + PAGE_SIZE;
+            }
+        }
+    }
+
+    return freed;
+}
+
+/*
+ * vmm_reclaim - Compress up to 'target' cold lazy user pages into zswap
+ *
+ * Second chance clock over every user VMM: pages with the accessed bit set
+ * lose it and survive, the rest are stored in zswap and their PTE becomes a
+ * swap marker. Two sweeps so a fully referenced working set still yields.
+ * Must not be called with any VMM lock held. Returns the frames released.
+ */
+size_t vmm_reclaim(size_t target) {
+    if (!zswap_is_initialized() || target == 0) return 0;
+
+    size_t freed = 0;
+    bool list_flags = spinlock_acquire(&user_vmms_lock);
+
+    for (int sweep = 0; sweep < 2 && freed < target; sweep++) {
+        for (vmm_ctx* v = user_vmms; v && freed < target; v = v->next_user) {
+            bool lock_flags = spinlock_acquire(&v->lock);
+            freed += vmm_reclaim_vmm(v, target - freed);
+            spinlock_release(&v->lock, lock_flags);
+        }
+    }
+
+    spinlock_release(&user_vmms_lock, list_flags);
+    return freed;
+}
+
+/*
+ * vmm_reclaim_from - vmm_reclaim limited to one user VMM, same two sweeps
+ */
+size_t vmm_reclaim_from(vmm_t* vmm_pub, size_t target) {
+    vmm_ctx* vmm = vmm_get_instance(vmm_pub);
+    if (!vmm || vmm->is_kernel || !zswap_is_initialized() || target == 0) return 0;
+
+    size_t freed = 0;
+    bool lock_flags = spinlock_acquire(&vmm->lock);
+    for (int sweep = 0; sweep < 2 && freed < target; sweep++)
+        freed += vmm_reclaim_vmm(vmm, target - freed);
+    spinlock_release(&vmm->lock, lock_flags);
+    return freed;
+}
+
+#pragma endregion
+
 /*
  * vmm_mmio_total - Total bytes currently mapped as MMIO across all VMM instances
  */
@@ -1694,9 +2478,10 @@ void vmm_dump(vmm_t* vmm_pub) {
 }
 
 /*
- * vmm_stats - Get the number of pages handled by the VMM and the number of mapped pages
+ * vmm_stats - Get the bytes handled by the VMM, the bytes backed by private frames
+ * and the bytes mapped to the shared zero frame
  */
-void vmm_stats(vmm_t* vmm_pub, size_t* out_total, size_t* out_resident) {
+void vmm_stats(vmm_t* vmm_pub, size_t* out_total, size_t* out_resident, size_t* out_zero) {
     vmm_ctx* vmm = vmm_get_instance(vmm_pub);
     if (!vmm) return;
 
@@ -1704,6 +2489,7 @@ void vmm_stats(vmm_t* vmm_pub, size_t* out_total, size_t* out_resident) {
 
     size_t total = 0;
     size_t resident = 0;
+    size_t zero = 0;
 
     avl_node_t* it = avl_min(&vmm->vma_tree);
     while (it) {
@@ -1716,18 +2502,38 @@ void vmm_stats(vmm_t* vmm_pub, size_t* out_total, size_t* out_resident) {
         for (uintptr_t virt = current->public.base;
              virt < current->public.base + current->public.length; virt += PAGE_SIZE) {
             uint64_t phys;
-            if (vmm_get_mapped_phys(vmm->public.pt_root, (void*)virt, &phys))
-                resident += PAGE_SIZE;
+            if (!vmm_get_mapped_phys(vmm->public.pt_root, (void*)virt, &phys)) continue;
+            if (vmm_is_zero_frame(phys)) zero += PAGE_SIZE;
+            else resident += PAGE_SIZE;
         }
         it = avl_next(it);
     }
 
     if (out_total) *out_total = total;
     if (out_resident) *out_resident = resident;
+    if (out_zero) *out_zero = zero;
 
     spinlock_release(&vmm->lock, lock_flags);
 }
 
+/*
+ * vmm_usage - Get the bytes backed by private frames now and at their peak, and the lazy fault counts
+ *
+ * Kept up to date by every path that maps or releases a private frame, so
+ * unlike vmm_stats() this never walks the page tables.
+ */
+void vmm_usage(vmm_t* vmm_pub, size_t* out_rss, size_t* out_peak_rss, uint64_t* out_minflt, uint64_t* out_majflt) {
+    vmm_ctx* vmm = vmm_get_instance(vmm_pub);
+    if (!vmm) return;
+
+    bool lock_flags = spinlock_acquire(&vmm->lock);
+    if (out_rss) *out_rss = vmm->rss;
+    if (out_peak_rss) *out_peak_rss = vmm->peak_rss;
+    if (out_minflt) *out_minflt = vmm->minflt;
+    if (out_majflt) *out_majflt = vmm->majflt;
+    spinlock_release(&vmm->lock, lock_flags);
+}
+
 /*
  * vmm_dump_pte_chain - Dumps the page table entries to get to the specified virtual address
  */
@@ -1809,6 +2615,7 @@ bool vmm_verify_integrity(vmm_t* vmm_pub) {
     avl_node_t* it = avl_min(&vmm->vma_tree);
     vmo_ext* prev = NULL;
     int count = 0;
+    size_t max_gap = 0;
 
     while (it) {
         vmo_ext* current = AVL_ENTRY(it, vmo_ext, vma_node);
@@ -1850,6 +2657,8 @@ bool vmm_verify_integrity(vmm_t* vmm_pub) {
                 spinlock_release(&vmm->lock, lock_flags);
                 return false;
             }
+            if (current->public.base - prev_end > max_gap)
+                max_gap = current->public.base - prev_end;
         }
 
         prev = current;
@@ -1857,6 +2666,16 @@ bool vmm_verify_integrity(vmm_t* vmm_pub) {
         count++;
     }
 
+    if (vmm->vma_tree.root) {
+        vmo_ext* top = AVL_ENTRY(vmm->vma_tree.root, vmo_ext, vma_node);
+        if (top->sub_max_gap != max_gap) {
+            LOGF("[VMM VERIFY] Gap augmentation stale (tree says 0x%lx, actual 0x%lx)\n",
+                 top->sub_max_gap, max_gap);
+            spinlock_release(&vmm->lock, lock_flags);
+            return false;
+        }
+    }
+
     LOGF("[VMM VERIFY] All checks passed (%d objects)\n", count);
     spinlock_release(&vmm->lock, lock_flags);
     return true;
@@ -22,6 +22,7 @@
 #define VM_FLAG_USER  (1 << 2)
 #define VM_FLAG_MMIO  (1 << 3)
 #define VM_FLAG_LAZY  (1 << 4)
+#define VM_FLAG_PHYS  (1 << 5)  // Maps RAM the caller owns at arg, like MMIO but not counted as MMIO or RSS
 
 // Return codes
 typedef enum {
@@ -93,18 +94,26 @@ bool vmm_check_buffer(vmm_t* vmm_pub, const void* ptr, size_t size, size_t requi
 
 vmm_status_t vmm_map_page(vmm_t* vmm, uint64_t phys, void* virt, size_t flags);
 vmm_status_t vmm_unmap_page(vmm_t* vmm, void* virt);
+vmm_status_t vmm_handle_lazy_fault(vmm_t* vmm, void* addr, bool is_write);
 vmm_status_t vmm_map_range(vmm_t* vmm, uint64_t phys, void* virt, size_t length, size_t flags);
 vmm_status_t vmm_unmap_range(vmm_t* vmm, void* virt, size_t length);
 vmm_status_t vmm_resize(vmm_t* vmm_pub, void* addr, size_t new_length);
+vmm_status_t vmm_remap(vmm_t* vmm_pub, void* addr, size_t new_length, bool may_move, void** out_addr);
 
 // Protection & Permissions
 
 vmm_status_t vmm_protect(vmm_t* vmm, void* addr, size_t new_flags);
 
+// Reclaim
+
+size_t vmm_reclaim(size_t target);
+size_t vmm_reclaim_from(vmm_t* vmm, size_t target);
+
 // Debugging
 
 void vmm_dump(vmm_t* vmm);
-void vmm_stats(vmm_t* vmm, size_t* out_total, size_t* out_resident);
+void vmm_stats(vmm_t* vmm, size_t* out_total, size_t* out_resident, size_t* out_zero);
+void vmm_usage(vmm_t* vmm, size_t* out_rss, size_t* out_peak_rss, uint64_t* out_minflt, uint64_t* out_majflt);
 void vmm_dump_pte_chain(uint64_t pt_root, void* virt);
 bool vmm_verify_integrity(vmm_t* vmm_pub);
 
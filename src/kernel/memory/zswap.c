@@ -0,0 +1,251 @@
+/*
+ * zswap.c - Compressed in-RAM swap pool
+ *
+ * A stored page is a singly linked chain of ZSWAP_CHUNK_SIZE slab objects.
+ * The head chunk records the compressed length; the handle given to the VMM
+ * is simply the head chunk address. The slab allocator caps objects at
+ * PAGE_SIZE/8, hence chains instead of one size class per compressed length.
+ *
+ * This file is on the page fault path and is compiled without SSE.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#include <kernel/memory/zswap.h>
+#include <kernel/memory/slab.h>
+#include <kernel/sys/spinlock.h>
+#include <kernel/sys/timers.h>
+#include <kernel/debug.h>
+#include <klibc/lz.h>
+#include <arch/x86_64/memory/paging.h>
+
+#define ZSWAP_CHUNK_SIZE 256
+#define ZSWAP_CHUNK_DATA (ZSWAP_CHUNK_SIZE - 16)
+
+typedef struct zswap_chunk {
+    struct zswap_chunk* next;
+    uint32_t len;       // compressed length of the page, head chunk only
+    uint32_t reserved;
+    uint8_t  data[ZSWAP_CHUNK_DATA];
+} zswap_chunk_t;
+
+_Static_assert(sizeof(zswap_chunk_t) == ZSWAP_CHUNK_SIZE, "zswap chunk layout");
+
+static slab_cache_t* chunk_cache = NULL;
+static spinlock_t zswap_lock;
+static zswap_stats_t stats;
+
+// Scratch shared by store and load, guarded by zswap_lock
+static uint16_t lz_table[LZ_HASH_ENTRIES];
+static uint8_t  lz_buf[ZSWAP_MAX_STORED];
+
+#pragma region Internal Functions
+
+/*
+ * zswap_free_chain - Return every chunk of a chain to the slab cache
+ */
+static size_t zswap_free_chain(zswap_chunk_t* c) {
+    size_t n = 0;
+    while (c) {
+        zswap_chunk_t* nx = c->next;
+        slab_free(chunk_cache, c);
+        c = nx;
+        n++;
+    }
+    return n;
+}
+
+#pragma endregion
+
+#pragma region Initialization
+
+/*
+ * zswap_init - Create the chunk cache, the VMM starts reclaiming once this succeeds
+ */
+bool zswap_init(void) {
+    if (chunk_cache) return true;
+
+    spinlock_init(&zswap_lock, "zswap");
+    chunk_cache = slab_cache_create("zswap_chunk", sizeof(zswap_chunk_t), 16);
+    if (!chunk_cache) {
+        LOGF("[ZSWAP] Failed to create chunk cache\n");
+        return false;
+    }
+
+    LOGF("[ZSWAP] Compressed swap pool online (%u byte chunks, store limit %lu bytes)\n",
+         ZSWAP_CHUNK_SIZE, (uint64_t)ZSWAP_MAX_STORED);
+    return true;
+}
+
+/*
+ * zswap_is_initialized - True once zswap_init succeeded
+ */
+bool zswap_is_initialized(void) {
+    return chunk_cache != NULL;
+}
+
+#pragma endregion
+
+#pragma region Pool Operations
+
+/*
+ * zswap_store - Compress the frame at phys into the pool
+ *
+ * The frame itself is left untouched, the caller frees it once the PTE holds
+ * the handle. Fails for incompressible pages or when no chunk can be had.
+ */
+bool zswap_store(uint64_t phys, uint64_t* out_handle) {
+    if (!chunk_cache || !out_handle) return false;
+
+    bool flags = spinlock_acquire(&zswap_lock);
+
+    size_t clen = lz_compress((const void*)PHYSMAP_P2V(phys), PAGE_SIZE,
+                              lz_buf, sizeof(lz_buf), lz_table);
+    if (!clen) {
+        stats.rejects++;
+        spinlock_release(&zswap_lock, flags);
+        return false;
+    }
+
+    zswap_chunk_t* head = NULL;
+    zswap_chunk_t** tail = &head;
+    size_t nchunks = 0;
+
+    for (size_t off = 0; off < clen; off += ZSWAP_CHUNK_DATA) {
+        void* obj;
+        if (slab_alloc(chunk_cache, &obj) != SLAB_OK) {
+            zswap_free_chain(head);
+            stats.rejects++;
+            spinlock_release(&zswap_lock, flags);
+            return false;
+        }
+
+        zswap_chunk_t* c = (zswap_chunk_t*)obj;
+        size_t n = clen - off < ZSWAP_CHUNK_DATA ? clen - off : ZSWAP_CHUNK_DATA;
+        for (size_t i = 0; i < n; i++) c->data[i] = lz_buf[off + i];
+        c->next = NULL;
+        c->len = 0;
+        *tail = c;
+        tail = &c->next;
+        nchunks++;
+    }
+
+    head->len = (uint32_t)clen;
+
+    stats.stores++;
+    stats.stored_pages++;
+    stats.stored_bytes += clen;
+    stats.pool_bytes += nchunks * ZSWAP_CHUNK_SIZE;
+
+    spinlock_release(&zswap_lock, flags);
+
+    *out_handle = (uint64_t)head;
+    return true;
+}
+
+/*
+ * zswap_load - Decompress a stored page into the frame at phys and release it
+ */
+bool zswap_load(uint64_t handle, uint64_t phys) {
+    zswap_chunk_t* head = (zswap_chunk_t*)handle;
+    if (!chunk_cache || !head) return false;
+
+    bool flags = spinlock_acquire(&zswap_lock);
+
+    size_t clen = head->len;
+    size_t off = 0;
+    for (zswap_chunk_t* c = head; c && off < clen; c = c->next) {
+        size_t n = clen - off < ZSWAP_CHUNK_DATA ? clen - off : ZSWAP_CHUNK_DATA;
+        for (size_t i = 0; i < n; i++) lz_buf[off + i] = c->data[i];
+        off += n;
+    }
+
+    size_t out = (off == clen)
+        ? lz_decompress(lz_buf, clen, (void*)PHYSMAP_P2V(phys), PAGE_SIZE)
+        : 0;
+
+    if (out != PAGE_SIZE) {
+        LOGF("[ZSWAP ERROR] Corrupted entry %p (len %zu, got %zu)\n", head, clen, out);
+        spinlock_release(&zswap_lock, flags);
+        return false;
+    }
+
+    size_t nchunks = zswap_free_chain(head);
+
+    stats.loads++;
+    stats.stored_pages--;
+    stats.stored_bytes -= clen;
+    stats.pool_bytes -= nchunks * ZSWAP_CHUNK_SIZE;
+
+    spinlock_release(&zswap_lock, flags);
+    return true;
+}
+
+/*
+ * zswap_drop - Release a stored page without reading it back
+ */
+void zswap_drop(uint64_t handle) {
+    zswap_chunk_t* head = (zswap_chunk_t*)handle;
+    if (!chunk_cache || !head) return;
+
+    bool flags = spinlock_acquire(&zswap_lock);
+
+    size_t clen = head->len;
+    size_t nchunks = zswap_free_chain(head);
+
+    stats.stored_pages--;
+    stats.stored_bytes -= clen;
+    stats.pool_bytes -= nchunks * ZSWAP_CHUNK_SIZE;
+
+    spinlock_release(&zswap_lock, flags);
+}
+
+#pragma endregion
+
+#pragma region Statistics
+
+/*
+ * zswap_record_fault - Account one swap-in fault and its latency
+ */
+void zswap_record_fault(uint64_t tsc_ticks) {
+    bool flags = spinlock_acquire(&zswap_lock);
+    stats.faults++;
+    stats.fault_tsc_total += tsc_ticks;
+    if (tsc_ticks > stats.fault_tsc_max) stats.fault_tsc_max = tsc_ticks;
+    spinlock_release(&zswap_lock, flags);
+}
+
+/*
+ * zswap_get_stats - Snapshot the pool counters
+ */
+void zswap_get_stats(zswap_stats_t* out_stats) {
+    if (!out_stats) return;
+    bool flags = spinlock_acquire(&zswap_lock);
+    *out_stats = stats;
+    spinlock_release(&zswap_lock, flags);
+}
+
+/*
+ * zswap_dump_stats - Print the pool state, compression ratio and fault latency
+ */
+void zswap_dump_stats(void) {
+    zswap_stats_t s;
+    zswap_get_stats(&s);
+
+    uint64_t raw = s.stored_pages * PAGE_SIZE;
+    uint64_t ratio = s.stored_bytes ? (raw * 100ULL) / s.stored_bytes : 0;
+    uint64_t eff = s.pool_bytes ? (raw * 100ULL) / s.pool_bytes : 0;
+    uint64_t avg_ns = s.faults ? tsc_ticks_to_ns(s.fault_tsc_total / s.faults) : 0;
+
+    LOGF("\n=== ZSWAP Statistics ===\n");
+    LOGF("Stored pages: %lu (%lu KiB raw, %lu KiB compressed, %lu KiB pool)\n",
+         s.stored_pages, raw / 1024, s.stored_bytes / 1024, s.pool_bytes / 1024);
+    LOGF("Compression ratio: %lu.%02lux (%lu.%02lux incl. chunk slack)\n",
+         ratio / 100, ratio % 100, eff / 100, eff % 100);
+    LOGF("Stores: %lu, loads: %lu, rejects: %lu\n", s.stores, s.loads, s.rejects);
+    LOGF("Swap-in faults: %lu, avg %lu ns, max %lu ns\n",
+         s.faults, avg_ns, tsc_ticks_to_ns(s.fault_tsc_max));
+    LOGF("========================\n");
+}
+
+#pragma endregion
@@ -0,0 +1,51 @@
+/*
+ * zswap.h - Compressed in-RAM swap pool
+ *
+ * Cold anonymous pages are compressed with the klibc LZ codec and parked in
+ * chains of fixed size slab chunks. The VMM stores the returned handle in the
+ * non-present PTE and hands it back on the next fault.
+ *
+ * VMM
+ * ├─→ zswap (reclaim / swap-in of VM_FLAG_LAZY user pages)
+ * │      └─→ Slab Allocator (chunk storage)
+ * └─→ PMM
+ *
+ * Init order: PMM → slab → VMM → zswap.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <arch/x86_64/memory/paging.h>
+
+// Pages that compress worse than this are left resident
+#define ZSWAP_MAX_STORED ((PAGE_SIZE * 3) / 4)
+
+typedef struct {
+    uint64_t stored_pages;    // pages currently held in the pool
+    uint64_t stored_bytes;    // compressed bytes currently held
+    uint64_t pool_bytes;      // chunk bytes currently held (incl. slack)
+    uint64_t stores;          // successful compressions since boot
+    uint64_t loads;           // successful decompressions since boot
+    uint64_t rejects;         // pages that did not compress or found no chunk memory
+    uint64_t faults;          // swap-in faults served by the VMM
+    uint64_t fault_tsc_total; // TSC ticks spent in those faults
+    uint64_t fault_tsc_max;
+} zswap_stats_t;
+
+bool zswap_init(void);
+bool zswap_is_initialized(void);
+
+// Pool operations, handles are 8 byte aligned and never 0
+bool zswap_store(uint64_t phys, uint64_t* out_handle);
+bool zswap_load(uint64_t handle, uint64_t phys);
+void zswap_drop(uint64_t handle);
+
+// Statistics
+void zswap_record_fault(uint64_t tsc_ticks);
+void zswap_get_stats(zswap_stats_t* out_stats);
+void zswap_dump_stats(void);
@@ -157,6 +157,27 @@ void lapic_send_ipi(uint32_t dest_id, uint8_t vector) {
     lapic_write(LAPIC_ICR_LOW, vector);
 }
 
+/*
+ * lapic_send_init - Send an INIT IPI, resetting the target core into wait-for-SIPI
+ */
+void lapic_send_init(uint32_t dest_id) {
+    while (lapic_read(LAPIC_ICR_LOW) & (1 << 12));
+
+    lapic_write(LAPIC_ICR_HIGH, dest_id << 24);
+    lapic_write(LAPIC_ICR_LOW, (5 << 8) | (1 << 14)); // INIT, level assert
+}
+
+/*
+ * lapic_send_sipi - Send a Startup IPI, the target starts in real mode at start_phys
+ */
+void lapic_send_sipi(uint32_t dest_id, uint64_t start_phys) {
+    while (lapic_read(LAPIC_ICR_LOW) & (1 << 12));
+
+    // the vector field holds the 4 KiB page number of the entry point, below 1 MiB
+    lapic_write(LAPIC_ICR_HIGH, dest_id << 24);
+    lapic_write(LAPIC_ICR_LOW, (6 << 8) | (uint32_t)((start_phys >> 12) & 0xFF));
+}
+
 /*
  * lapic_set_tpm - Sets the calibrated tick rate
  */
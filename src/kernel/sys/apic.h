@@ -135,6 +135,8 @@ void lapic_eoi(void);
 void lapic_write(uint32_t reg, uint32_t value);
 uint32_t lapic_read(uint32_t reg);
 void lapic_send_ipi(uint32_t dest_id, uint8_t vector);
+void lapic_send_init(uint32_t dest_id);
+void lapic_send_sipi(uint32_t dest_id, uint64_t start_phys);
 
 // virtual address of the mapped LAPIC MMIO region
 extern uint64_t lapic_base;
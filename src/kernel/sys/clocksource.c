@@ -0,0 +1,197 @@
+/*
+ * clocksource.c - Pluggable monotonic clock with mult/shift conversion
+ *
+ * Uptime is kept as a base pair: the current source's counter at the last
+ * switch and the uptime it stood for. clock_read_ns() adds the converted
+ * cycles since then, under a sequence count so readers never take a lock,
+ * from interrupt context included. A switch folds the time so far into the
+ * base and restarts from the new source's counter.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#include <kernel/sys/clocksource.h>
+#include <kernel/sys/spinlock.h>
+#include <kernel/sys/vvar.h>
+#include <klibc/string.h>
+#include <kernel/debug.h>
+
+static struct {
+    volatile uint32_t seq;  // Odd while a switch rewrites the fields
+    clocksource_t* cs;
+    uint64_t base_cyc;
+    uint64_t base_ns;
+} tk;
+
+static spinlock_t cs_lock;          // Guards the source list and tk writers
+static clocksource_t* sources;
+
+#pragma region Helpers
+
+/*
+ * div128 - (hi:lo) / d, the quotient must fit 64 bits
+ */
+static inline uint64_t div128(uint64_t hi, uint64_t lo, uint64_t d) {
+    uint64_t q, r;
+    __asm__("divq %4" : "=a"(q), "=d"(r) : "a"(lo), "d"(hi), "rm"(d));
+    (void)r;
+    return q;
+}
+
+/*
+ * ratio_fixed - (num << shift) / den rounded to nearest, 0 if it does not fit 64 bits
+ */
+static uint64_t ratio_fixed(uint64_t num, uint64_t den, uint32_t shift) {
+    if (den == 0 || (num / den) >> (64 - shift)) return 0;
+
+    unsigned __int128 n = ((unsigned __int128)num << shift) + den / 2;
+    return div128((uint64_t)(n >> 64), (uint64_t)n, den);
+}
+
+/*
+ * clock_sample - Reads the source and base of tk consistently
+ */
+static inline clocksource_t* clock_sample(uint64_t* base_cyc, uint64_t* base_ns, uint64_t* cyc) {
+    clocksource_t* cs;
+    uint32_t seq;
+
+    do {
+        seq = __atomic_load_n(&tk.seq, __ATOMIC_ACQUIRE);
+        cs = tk.cs;
+        *base_cyc = tk.base_cyc;
+        *base_ns = tk.base_ns;
+        *cyc = cs ? cs->read() : 0;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&tk.seq, __ATOMIC_RELAXED));
+
+    return cs;
+}
+
+/*
+ * clock_switch_locked - Makes cs drive the clock from now on, cs_lock held
+ */
+static void clock_switch_locked(clocksource_t* cs) {
+    uint64_t now = clock_read_ns();
+
+    __atomic_store_n(&tk.seq, tk.seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    tk.cs = cs;
+    tk.base_cyc = cs->read();
+    tk.base_ns = now;
+
+    __atomic_store_n(&tk.seq, tk.seq + 1, __ATOMIC_RELEASE);
+}
+
+#pragma endregion
+
+#pragma region Public API
+
+/*
+ * clocksource_init - Prepares the source list, before the first clocksource_register()
+ */
+void clocksource_init(void) {
+    spinlock_init(&cs_lock, "clocksource");
+}
+
+/*
+ * clocksource_set_rate - Sets the conversion of cs from its rate, ns nanoseconds per cycles counts
+ *
+ * Taking a ratio rather than a frequency keeps exact inputs exact: a HPET
+ * period in femtoseconds is (period, 1000000), a TSC calibrated per
+ * millisecond is (1000000, ticks).
+ */
+void clocksource_set_rate(clocksource_t* cs, uint64_t ns, uint64_t cycles) {
+    if (!cs || !ns || !cycles) return;
+
+    cs->shift = CLOCKSOURCE_SHIFT;
+    cs->mult = ratio_fixed(ns, cycles, cs->shift);
+    cs->inv_mult = ratio_fixed(cycles, ns, cs->shift);
+
+    unsigned __int128 hz = (unsigned __int128)cycles * 1000000000ULL + ns / 2;
+    cs->hz = (hz >> 64) < ns ? div128((uint64_t)(hz >> 64), (uint64_t)hz, ns) : 0;
+}
+
+/*
+ * clocksource_register - Adds a source whose rate is set, it takes over if it outrates the current one
+ */
+void clocksource_register(clocksource_t* cs) {
+    if (!cs || !cs->read || !cs->mult) return;
+
+    bool flags = spinlock_acquire(&cs_lock);
+    cs->next = sources;
+    sources = cs;
+
+    bool take = !tk.cs || cs->rating > tk.cs->rating;
+    if (take) clock_switch_locked(cs);
+    spinlock_release(&cs_lock, flags);
+
+    LOGF("[CLOCK] Registered %s, %lu Hz, rating %u%s\n", cs->name, cs->hz, cs->rating,
+         take ? ", now the clock" : "");
+
+    // User space reads the TSC straight, its base moves with the clock
+    if (take) vvar_update();
+}
+
+/*
+ * clocksource_select - Switches to the registered source called name, whatever its rating
+ */
+bool clocksource_select(const char* name) {
+    bool found = false;
+
+    bool flags = spinlock_acquire(&cs_lock);
+    for (clocksource_t* cs = sources; cs; cs = cs->next) {
+        if (kstrcmp(cs->name, name) != 0) continue;
+        if (cs != tk.cs) clock_switch_locked(cs);
+        found = true;
+        break;
+    }
+    spinlock_release(&cs_lock, flags);
+
+    if (found) vvar_update();
+    return found;
+}
+
+/*
+ * clocksource_current - The source clock_read_ns() reads, NULL before any registered
+ */
+const clocksource_t* clocksource_current(void) {
+    return tk.cs;
+}
+
+/*
+ * clock_read_ns - Nanoseconds of uptime, 0 before a source is registered
+ *
+ * Lock free and divide free, this is what every hot path reads the time with.
+ */
+uint64_t clock_read_ns(void) {
+    uint64_t base_cyc, base_ns, cyc;
+    clocksource_t* cs = clock_sample(&base_cyc, &base_ns, &cyc);
+    if (!cs) return 0;
+
+    // A counter a hair behind on another CPU must not wrap the delta
+    uint64_t delta = cyc - base_cyc;
+    if ((int64_t)delta < 0) delta = 0;
+    return base_ns + clocksource_cyc2ns(cs, delta);
+}
+
+/*
+ * clock_ns_to_cycles - Value of cs's counter at uptime ns
+ *
+ * Exact for the current source. For any other it is projected from a fresh
+ * reading of both, so it drifts as far as the two counters do.
+ */
+uint64_t clock_ns_to_cycles(const clocksource_t* cs, uint64_t ns) {
+    uint64_t base_cyc, base_ns, cyc;
+    clocksource_t* cur = clock_sample(&base_cyc, &base_ns, &cyc);
+
+    if (cur != cs) {
+        base_cyc = cs->read();
+        base_ns = clock_read_ns();
+    }
+
+    if (ns >= base_ns) return base_cyc + clocksource_ns2cyc(cs, ns - base_ns);
+    return base_cyc - clocksource_ns2cyc(cs, base_ns - ns);
+}
+
+#pragma endregion
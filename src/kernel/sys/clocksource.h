@@ -0,0 +1,57 @@
+/*
+ * clocksource.h - Pluggable monotonic clock with mult/shift conversion
+ *
+ * A clocksource is a free running counter and the fixed point factor that
+ * turns its cycles into nanoseconds:
+ *
+ *     ns = (cycles * mult) >> shift
+ *
+ * The product is 128 bits wide, so neither overflow nor a divide ever sits
+ * on the read path. The best rated registered source drives clock_read_ns(),
+ * the uptime the scheduler, timers and tracing all read. Switching sources
+ * carries the current time over, uptime never jumps or goes backwards.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 40 fraction bits keep the rounding error near 0.1 us per day of uptime
+#define CLOCKSOURCE_SHIFT 40
+
+typedef struct clocksource {
+    const char* name;
+    uint64_t (*read)(void);
+    uint32_t rating;        // Highest usable rating wins
+    uint32_t shift;
+    uint64_t mult;          // ns per cycle, fixed point with shift fraction bits
+    uint64_t inv_mult;      // Cycles per ns, same shift
+    uint64_t hz;            // Cycles per second, rounded
+    struct clocksource* next;
+} clocksource_t;
+
+void clocksource_init(void);
+void clocksource_set_rate(clocksource_t* cs, uint64_t ns, uint64_t cycles);
+void clocksource_register(clocksource_t* cs);
+bool clocksource_select(const char* name);
+const clocksource_t* clocksource_current(void);
+
+uint64_t clock_read_ns(void);
+uint64_t clock_ns_to_cycles(const clocksource_t* cs, uint64_t ns);
+
+/*
+ * clocksource_cyc2ns - Converts a cycle delta of cs to nanoseconds
+ */
+static inline uint64_t clocksource_cyc2ns(const clocksource_t* cs, uint64_t cycles) {
+    return (uint64_t)(((unsigned __int128)cycles * cs->mult) >> cs->shift);
+}
+
+/*
+ * clocksource_ns2cyc - Converts a duration in nanoseconds to cycles of cs
+ */
+static inline uint64_t clocksource_ns2cyc(const clocksource_t* cs, uint64_t ns) {
+    return (uint64_t)(((unsigned __int128)ns * cs->inv_mult) >> cs->shift);
+}
@@ -0,0 +1,222 @@
+/*
+ * futex.c - Wait queues keyed by a 32-bit word
+ *
+ * Waiters hang off one of FUTEX_BUCKETS hashed buckets, keyed by address
+ * space and virtual address. The blocking follows tty_block()/tty_wake():
+ * the thread marks itself T_BLOCKED and queues under the bucket lock,
+ * re-checks the word there so a wake between the caller's check and the
+ * sleep cannot be lost, then yields. Wakers unlink under the same lock and
+ * sched_add() outside it.
+ *
+ * GatOS shares no memory between address spaces, so the key needs no
+ * physical address. That would not be stable anyway: vmm_reclaim() can push
+ * a waiting word's page through zswap and fault it back to another frame.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#include <kernel/sys/futex.h>
+#include <kernel/sys/scheduler.h>
+#include <kernel/sys/process.h>
+#include <kernel/sys/spinlock.h>
+#include <kernel/sys/timers.h>
+#include <arch/x86_64/cpu/cpu.h>
+#include <arch/x86_64/cpu/usercopy.h>
+
+typedef struct {
+    spinlock_t lock;
+    futex_waiter_t* head;
+    futex_waiter_t* tail;
+} futex_bucket_t;
+
+static futex_bucket_t buckets[FUTEX_BUCKETS];
+
+/*
+ * futex_init - Sets up the bucket locks
+ */
+void futex_init(void) {
+    for (uint32_t i = 0; i < FUTEX_BUCKETS; i++)
+        spinlock_init(&buckets[i].lock, "futex");
+}
+
+/*
+ * futex_bucket - Bucket for a key, a multiplicative hash of space and address
+ */
+static futex_bucket_t* futex_bucket(uintptr_t space, uintptr_t addr) {
+    uint64_t h = ((uint64_t)space >> 6) ^ ((uint64_t)addr >> 2);
+    h *= 0x9E3779B97F4A7C15ULL;
+    return &buckets[h >> (64 - 6)];
+}
+
+/*
+ * futex_unlink_locked - Removes a waiter from its bucket, bucket lock held
+ */
+static void futex_unlink_locked(futex_bucket_t* b, futex_waiter_t* w) {
+    futex_waiter_t* prev = NULL;
+    for (futex_waiter_t* it = b->head; it; prev = it, it = it->next) {
+        if (it != w) continue;
+        if (prev) prev->next = w->next;
+        else b->head = w->next;
+        if (b->tail == w) b->tail = prev;
+        break;
+    }
+    w->next = NULL;
+    w->queued = false;
+}
+
+/*
+ * futex_timeout - hrtimer callback, wakes the waiter if futex_wake() did not get there first
+ */
+static void futex_timeout(hrtimer_t* timer, void* arg) {
+    (void)timer;
+    thread_t* thread = arg;
+    futex_waiter_t* w = &thread->futex;
+    futex_bucket_t* b = futex_bucket(w->space, w->addr);
+
+    bool flags = spinlock_acquire(&b->lock);
+    bool wake = w->queued;
+    if (wake) {
+        futex_unlink_locked(b, w);
+        w->timed_out = true;
+    }
+    spinlock_release(&b->lock, flags);
+
+    if (wake) sched_add(thread);
+
+    // Last touch, futex_cancel() and the waiter spin on this
+    __atomic_store_n(&w->firing, false, __ATOMIC_RELEASE);
+}
+
+/*
+ * futex_disarm - Stops the timeout and waits out a callback already running on another CPU
+ */
+static void futex_disarm(futex_waiter_t* w) {
+    if (!__atomic_load_n(&w->firing, __ATOMIC_ACQUIRE)) return;
+    if (hrtimer_cancel(&w->timeout)) {
+        w->firing = false;
+        return;
+    }
+    while (__atomic_load_n(&w->firing, __ATOMIC_ACQUIRE))
+        __asm__ volatile("pause");
+}
+
+/*
+ * futex_wait - Sleeps until woken while *addr == expected, timeout_ns 0 waits forever
+ *
+ * addr must be 4 byte aligned. A user word is read with copy_from_user(), the
+ * page may be unmapped by a sibling thread at any point, that fails with -1.
+ */
+int futex_wait(vmm_t* vmm, volatile uint32_t* addr, uint32_t expected, uint64_t timeout_ns) {
+    if (!addr || ((uintptr_t)addr & 3)) return -1;
+
+    thread_t* cur = sched_current();
+    if (!cur || !sched_active()) return -1;
+
+    futex_waiter_t* w = &cur->futex;
+    w->space = (uintptr_t)vmm;
+    w->addr = (uintptr_t)addr;
+    w->timed_out = false;
+    futex_bucket_t* b = futex_bucket(w->space, w->addr);
+
+    bool flags = spinlock_acquire(&b->lock);
+
+    // Under the bucket lock a waker that changed the word has either finished or will see us queued
+    uint32_t val;
+    if (vmm) {
+        if (copy_from_user(&val, (const void*)addr, sizeof(val))) {
+            spinlock_release(&b->lock, flags);
+            return -1;
+        }
+    } else {
+        val = __atomic_load_n(addr, __ATOMIC_ACQUIRE);
+    }
+    if (val != expected) {
+        spinlock_release(&b->lock, flags);
+        return FUTEX_AGAIN;
+    }
+
+    w->next = NULL;
+    if (b->tail) b->tail->next = w;
+    else b->head = w;
+    b->tail = w;
+    w->queued = true;
+    cur->state = T_BLOCKED;
+
+    if (timeout_ns) {
+        w->firing = true;
+        hrtimer_setup(&w->timeout, futex_timeout, cur);
+        hrtimer_arm(&w->timeout, get_uptime_ns() + timeout_ns);
+    }
+    spinlock_release(&b->lock, flags);
+
+    sched_yield();
+
+    futex_disarm(w);
+    return w->timed_out ? FUTEX_TIMEDOUT : FUTEX_WOKEN;
+}
+
+/*
+ * futex_wake - Wakes up to count threads waiting on addr in FIFO order, returns how many
+ */
+uint32_t futex_wake(vmm_t* vmm, volatile uint32_t* addr, uint32_t count) {
+    if (!addr || count == 0) return 0;
+
+    uintptr_t space = (uintptr_t)vmm;
+    futex_bucket_t* b = futex_bucket(space, (uintptr_t)addr);
+    thread_t* woken = NULL;
+    uint32_t n = 0;
+
+    bool flags = spinlock_acquire(&b->lock);
+    futex_waiter_t* prev = NULL;
+    futex_waiter_t* w = b->head;
+    while (w && n < count) {
+        futex_waiter_t* next = w->next;
+        if (w->space == space && w->addr == (uintptr_t)addr) {
+            if (prev) prev->next = next;
+            else b->head = next;
+            if (b->tail == w) b->tail = prev;
+            w->next = NULL;
+            w->queued = false;
+
+            // Same chaining as tty_wake(), a blocked thread sits on no queue
+            thread_t* t = (thread_t*)((uint8_t*)w - __builtin_offsetof(thread_t, futex));
+            t->rnext = woken;
+            woken = t;
+            n++;
+        } else {
+            prev = w;
+        }
+        w = next;
+    }
+    spinlock_release(&b->lock, flags);
+
+    while (woken) {
+        thread_t* t = woken;
+        woken = t->rnext;
+        t->rnext = NULL;
+        sched_add(t);
+    }
+    return n;
+}
+
+/*
+ * futex_cancel - Takes a thread off any futex queue and stops its timeout, true if it was waiting
+ *
+ * Called before a thread is destroyed or killed, the waiter lives inside thread_t.
+ */
+bool futex_cancel(thread_t* thread) {
+    if (!thread) return false;
+    futex_waiter_t* w = &thread->futex;
+
+    bool was_queued = false;
+    if (w->queued) {
+        futex_bucket_t* b = futex_bucket(w->space, w->addr);
+        bool flags = spinlock_acquire(&b->lock);
+        was_queued = w->queued;
+        if (was_queued) futex_unlink_locked(b, w);
+        spinlock_release(&b->lock, flags);
+    }
+
+    futex_disarm(w);
+    return was_queued;
+}
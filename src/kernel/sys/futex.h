@@ -0,0 +1,42 @@
+/*
+ * futex.h - Wait queues keyed by a 32-bit word, for blocking synchronization
+ *
+ * futex_wait() sleeps only while the word still holds the value the caller
+ * expects, futex_wake() wakes threads waiting on a word. Everything else
+ * (who owns a lock, how many units a semaphore has) lives in the word itself
+ * and is handled with atomics by the caller, see ulibc/sync.c.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <kernel/sys/hrtimer.h>
+#include <kernel/memory/vmm.h>
+
+// futex_wait() results, -1 for an invalid address
+#define FUTEX_WOKEN     0   // Woken by futex_wake()
+#define FUTEX_AGAIN     1   // The word no longer held the expected value, never slept
+#define FUTEX_TIMEDOUT  2   // The timeout ran out first
+
+#define FUTEX_BUCKETS   64
+
+struct thread;
+
+// Embedded in thread_t, a thread waits on at most one word at a time
+typedef struct futex_waiter {
+    struct futex_waiter* next;  // Bucket chain, FIFO
+    uintptr_t space;            // Address space of the word, 0 for kernel memory
+    uintptr_t addr;             // Virtual address of the word
+    hrtimer_t timeout;
+    volatile bool queued;       // In a bucket, guarded by the bucket lock
+    volatile bool timed_out;
+    volatile bool firing;       // Timeout armed and its callback not finished
+} futex_waiter_t;
+
+void futex_init(void);
+int futex_wait(vmm_t* vmm, volatile uint32_t* addr, uint32_t expected, uint64_t timeout_ns);
+uint32_t futex_wake(vmm_t* vmm, volatile uint32_t* addr, uint32_t count);
+bool futex_cancel(struct thread* thread);
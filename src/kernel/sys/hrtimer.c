@@ -0,0 +1,146 @@
+/*
+ * hrtimer.c - High resolution one shot kernel timers
+ *
+ * Every CPU keeps the timers armed on it in an AVL tree keyed by TSC deadline.
+ * timer_arm_next() folds the earliest one into the LAPIC TSC-deadline
+ * programming and the timer interrupt runs whatever expired, so a callback
+ * fires within interrupt latency of its deadline. Without TSC-deadline support
+ * the trees are only checked on the 10ms periodic tick.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#include <kernel/sys/hrtimer.h>
+#include <kernel/sys/timers.h>
+#include <kernel/sys/spinlock.h>
+#include <arch/x86_64/cpu/cpu.h>
+#include <arch/x86_64/cpu/interrupts.h>
+
+typedef struct {
+    spinlock_t lock;        // Guards the tree and the cpu field of every timer in it
+    avl_tree_t tree;
+} hrtimer_base_t;
+
+static hrtimer_base_t bases[MAX_CPUS];
+
+/*
+ * hrtimer_cmp - Comparison function for the timer trees
+ */
+static int hrtimer_cmp(const avl_node_t* a, const avl_node_t* b) {
+    const hrtimer_t* ta = AVL_ENTRY(a, hrtimer_t, node);
+    const hrtimer_t* tb = AVL_ENTRY(b, hrtimer_t, node);
+    if (ta->expires < tb->expires) return -1;
+    if (ta->expires > tb->expires) return  1;
+    if (ta < tb) return -1;
+    if (ta > tb) return  1;
+    return 0;
+}
+
+/*
+ * hrtimer_init - Sets up the per CPU timer trees, before any timer interrupt
+ */
+void hrtimer_init(void) {
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        spinlock_init(&bases[i].lock, "hrtimer");
+        avl_init(&bases[i].tree, hrtimer_cmp);
+    }
+}
+
+/*
+ * hrtimer_setup - Prepares a timer, it stays unarmed until hrtimer_arm()
+ */
+void hrtimer_setup(hrtimer_t* timer, hrtimer_fn_t fn, void* arg) {
+    if (!timer) return;
+    timer->expires = 0;
+    timer->fn = fn;
+    timer->arg = arg;
+    timer->cpu = HRTIMER_UNARMED;
+}
+
+/*
+ * hrtimer_cancel - Disarms a timer, true if it was still pending
+ *
+ * A false return does not mean the callback finished, it may be running on
+ * the arming CPU right now.
+ */
+bool hrtimer_cancel(hrtimer_t* timer) {
+    if (!timer) return false;
+
+    for (;;) {
+        uint32_t cpu = __atomic_load_n(&timer->cpu, __ATOMIC_ACQUIRE);
+        if (cpu == HRTIMER_UNARMED) return false;
+
+        hrtimer_base_t* base = &bases[cpu];
+        bool flags = spinlock_acquire(&base->lock);
+        if (timer->cpu == cpu) {
+            avl_remove(&base->tree, &timer->node);
+            __atomic_store_n(&timer->cpu, HRTIMER_UNARMED, __ATOMIC_RELEASE);
+            spinlock_release(&base->lock, flags);
+            return true;
+        }
+
+        // Fired between the load and the lock
+        spinlock_release(&base->lock, flags);
+    }
+}
+
+/*
+ * hrtimer_arm - Arms a timer on this CPU for an absolute uptime in ns, a pending timer is moved
+ */
+void hrtimer_arm(hrtimer_t* timer, uint64_t deadline_ns) {
+    if (!timer || !timer->fn) return;
+
+    hrtimer_cancel(timer);
+
+    // Stay on one CPU between picking the tree and reprogramming its LAPIC
+    bool iflag = intr_save();
+    uint32_t cpu = this_cpu()->index;
+    hrtimer_base_t* base = &bases[cpu];
+
+    bool flags = spinlock_acquire(&base->lock);
+    timer->expires = tsc_from_uptime_ns(deadline_ns);
+    avl_insert(&base->tree, &timer->node);
+    __atomic_store_n(&timer->cpu, cpu, __ATOMIC_RELEASE);
+    bool first = avl_min(&base->tree) == &timer->node;
+    spinlock_release(&base->lock, flags);
+
+    // The LAPIC may be set for a later event, or stopped if the CPU idles
+    if (first) timer_bring_forward(timer->expires);
+    intr_restore(iflag);
+}
+
+/*
+ * hrtimer_next - TSC deadline of the earliest timer on this CPU, UINT64_MAX if none
+ */
+uint64_t hrtimer_next(void) {
+    hrtimer_base_t* base = &bases[this_cpu()->index];
+    bool flags = spinlock_acquire(&base->lock);
+    avl_node_t* mn = avl_min(&base->tree);
+    uint64_t next = mn ? AVL_ENTRY(mn, hrtimer_t, node)->expires : UINT64_MAX;
+    spinlock_release(&base->lock, flags);
+    return next;
+}
+
+/*
+ * hrtimer_run - Fires every expired timer on this CPU, called from the timer interrupt
+ */
+void hrtimer_run(void) {
+    hrtimer_base_t* base = &bases[this_cpu()->index];
+
+    for (;;) {
+        bool flags = spinlock_acquire(&base->lock);
+        avl_node_t* mn = avl_min(&base->tree);
+        hrtimer_t* timer = mn ? AVL_ENTRY(mn, hrtimer_t, node) : NULL;
+        if (!timer || timer->expires > tsc_read()) {
+            spinlock_release(&base->lock, flags);
+            return;
+        }
+
+        avl_remove(&base->tree, mn);
+        __atomic_store_n(&timer->cpu, HRTIMER_UNARMED, __ATOMIC_RELEASE);
+        spinlock_release(&base->lock, flags);
+
+        // Without the lock, the callback is free to re-arm
+        timer->fn(timer, timer->arg);
+    }
+}
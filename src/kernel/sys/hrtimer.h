@@ -0,0 +1,41 @@
+/*
+ * hrtimer.h - High resolution one shot kernel timers
+ *
+ * A timer fires its callback once, in interrupt context on the CPU that
+ * armed it, as soon as possible after an absolute uptime in ns. The callback
+ * may re-arm its own timer and may call sched_add(), but must not sleep.
+ *
+ * Arming and cancelling one timer from several CPUs at once is the caller's
+ * problem to serialise.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <klibc/avl.h>
+
+// hrtimer_t.cpu while the timer is not armed
+#define HRTIMER_UNARMED 0xFFFFFFFFu
+
+struct hrtimer;
+typedef void (*hrtimer_fn_t)(struct hrtimer* timer, void* arg);
+
+typedef struct hrtimer {
+    avl_node_t node;        // AVL tree node in the arming CPU's timer tree
+    uint64_t expires;       // TSC deadline
+    hrtimer_fn_t fn;
+    void* arg;
+    volatile uint32_t cpu;  // CPU whose tree holds the timer, HRTIMER_UNARMED if none
+} hrtimer_t;
+
+void hrtimer_init(void);
+void hrtimer_setup(hrtimer_t* timer, hrtimer_fn_t fn, void* arg);
+void hrtimer_arm(hrtimer_t* timer, uint64_t deadline_ns);
+bool hrtimer_cancel(hrtimer_t* timer);
+
+// Timer interrupt side
+uint64_t hrtimer_next(void);
+void hrtimer_run(void);
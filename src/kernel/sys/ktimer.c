@@ -0,0 +1,276 @@
+/*
+ * ktimer.c - Millisecond kernel timeouts on a hierarchical timer wheel
+ *
+ * Every CPU has a wheel of KTIMER_LEVELS levels with KTIMER_LVL_SIZE slots
+ * each. Level 0 slots are 1 ms apart, each higher level is KTIMER_LVL_SIZE
+ * times coarser. A timer goes into the finest level its distance from the
+ * wheel clock fits, at the slot its expiry indexes. Whenever the clock
+ * crosses a level's slot boundary, that slot is cascaded: its timers move
+ * down to where their remaining distance now puts them, so they always end
+ * up in level 0 by the millisecond they expire.
+ *
+ * A bitmap of non empty slots per level lets ktimer_next() find the first
+ * jiffy with something to fire or cascade without scanning, which both
+ * timer_arm_next() and the catch-up after a tickless idle stretch use.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#include <kernel/sys/ktimer.h>
+#include <kernel/sys/timers.h>
+#include <kernel/sys/spinlock.h>
+#include <arch/x86_64/cpu/cpu.h>
+#include <arch/x86_64/cpu/interrupts.h>
+
+#define KTIMER_LVL_MASK (KTIMER_LVL_SIZE - 1)
+
+typedef struct {
+    spinlock_t lock;                    // Guards the wheel and the cpu field of every timer in it
+    uint64_t clk;                       // Jiffy (uptime ms) reached, its cascades already done
+    uint32_t count;                     // Armed timers
+    uint64_t pending[KTIMER_LEVELS];    // Bit per non empty slot
+    ktimer_t* slots[KTIMER_LEVELS * KTIMER_LVL_SIZE];
+} ktimer_base_t;
+
+static ktimer_base_t bases[MAX_CPUS];
+
+#pragma region Wheel
+
+/*
+ * ktimer_enqueue - Files a timer by its distance from the wheel clock, lock held
+ */
+static void ktimer_enqueue(ktimer_base_t* base, ktimer_t* timer) {
+    uint64_t expires = timer->expires;
+    if (expires < base->clk) expires = base->clk;
+    if (expires - base->clk > KTIMER_MAX_MS) expires = base->clk + KTIMER_MAX_MS;
+
+    uint64_t delta = expires - base->clk;
+    uint32_t lvl = delta ? (63 - __builtin_clzll(delta)) / KTIMER_LVL_BITS : 0;
+    uint32_t idx = (expires >> (KTIMER_LVL_BITS * lvl)) & KTIMER_LVL_MASK;
+    uint16_t slot = (uint16_t)(lvl * KTIMER_LVL_SIZE + idx);
+
+    ktimer_t** head = &base->slots[slot];
+    timer->expires = expires;
+    timer->slot = slot;
+    timer->next = *head;
+    if (timer->next) timer->next->pprev = &timer->next;
+    timer->pprev = head;
+    *head = timer;
+    base->pending[lvl] |= 1ull << idx;
+}
+
+/*
+ * ktimer_unlink - Takes a timer out of its slot, lock held
+ */
+static void ktimer_unlink(ktimer_base_t* base, ktimer_t* timer) {
+    *timer->pprev = timer->next;
+    if (timer->next) timer->next->pprev = timer->pprev;
+    if (!base->slots[timer->slot])
+        base->pending[timer->slot / KTIMER_LVL_SIZE] &= ~(1ull << (timer->slot & KTIMER_LVL_MASK));
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/*
+ * ktimer_cascade - Moves the slots the clock just reached on the upper levels down, lock held
+ *
+ * Lower levels go first, their re-filed timers never land in a slot the
+ * loop is about to empty.
+ */
+static void ktimer_cascade(ktimer_base_t* base) {
+    for (uint32_t lvl = 1; lvl < KTIMER_LEVELS; lvl++) {
+        uint32_t shift = KTIMER_LVL_BITS * lvl;
+        if (base->clk & ((1ull << shift) - 1)) break;
+
+        uint32_t idx = (base->clk >> shift) & KTIMER_LVL_MASK;
+        ktimer_t* timer = base->slots[lvl * KTIMER_LVL_SIZE + idx];
+        base->slots[lvl * KTIMER_LVL_SIZE + idx] = NULL;
+        base->pending[lvl] &= ~(1ull << idx);
+
+        while (timer) {
+            ktimer_t* next = timer->next;
+            ktimer_enqueue(base, timer);
+            timer = next;
+        }
+    }
+}
+
+/*
+ * ktimer_next_locked - First jiffy at or after the clock with a timer to fire or a slot to cascade, lock held
+ */
+static uint64_t ktimer_next_locked(ktimer_base_t* base) {
+    uint64_t next = UINT64_MAX;
+
+    for (uint32_t lvl = 0; lvl < KTIMER_LEVELS; lvl++) {
+        uint64_t map = base->pending[lvl];
+        if (!map) continue;
+
+        // Level 0 fires from the current slot on, upper levels already cascaded theirs
+        uint32_t shift = KTIMER_LVL_BITS * lvl;
+        uint64_t pos = base->clk >> shift;
+        uint32_t skip = lvl ? 1 : 0;
+        uint32_t start = (uint32_t)((pos + skip) & KTIMER_LVL_MASK);
+        uint64_t rot = start ? (map >> start) | (map << (KTIMER_LVL_SIZE - start)) : map;
+        uint64_t at = (pos + skip + __builtin_ctzll(rot)) << shift;
+        if (at < next) next = at;
+    }
+    return next;
+}
+
+#pragma endregion
+
+#pragma region Public API
+
+/*
+ * ktimer_init - Sets up the per CPU wheels, before any timer interrupt
+ */
+void ktimer_init(void) {
+    for (uint32_t i = 0; i < MAX_CPUS; i++)
+        spinlock_init(&bases[i].lock, "ktimer");
+}
+
+/*
+ * ktimer_setup - Prepares a timer, it stays unarmed until ktimer_arm()
+ */
+void ktimer_setup(ktimer_t* timer, ktimer_fn_t fn, void* arg) {
+    if (!timer) return;
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->expires = 0;
+    timer->fn = fn;
+    timer->arg = arg;
+    timer->slot = 0;
+    timer->cpu = KTIMER_UNARMED;
+}
+
+/*
+ * ktimer_pending - True while the timer is armed and has not fired
+ */
+bool ktimer_pending(const ktimer_t* timer) {
+    return timer && __atomic_load_n(&timer->cpu, __ATOMIC_ACQUIRE) != KTIMER_UNARMED;
+}
+
+/*
+ * ktimer_cancel - Disarms a timer, true if it was still pending
+ *
+ * A false return does not mean the callback finished, it may be running on
+ * the arming CPU right now.
+ */
+bool ktimer_cancel(ktimer_t* timer) {
+    if (!timer) return false;
+
+    for (;;) {
+        uint32_t cpu = __atomic_load_n(&timer->cpu, __ATOMIC_ACQUIRE);
+        if (cpu == KTIMER_UNARMED) return false;
+
+        ktimer_base_t* base = &bases[cpu];
+        bool flags = spinlock_acquire(&base->lock);
+        if (timer->cpu == cpu) {
+            ktimer_unlink(base, timer);
+            base->count--;
+            __atomic_store_n(&timer->cpu, KTIMER_UNARMED, __ATOMIC_RELEASE);
+            spinlock_release(&base->lock, flags);
+            return true;
+        }
+
+        // Fired between the load and the lock
+        spinlock_release(&base->lock, flags);
+    }
+}
+
+/*
+ * ktimer_arm - Arms a timer on this CPU to fire timeout_ms from now, a pending timer is moved
+ */
+void ktimer_arm(ktimer_t* timer, uint64_t timeout_ms) {
+    if (!timer || !timer->fn) return;
+    if (timeout_ms > KTIMER_MAX_MS) timeout_ms = KTIMER_MAX_MS;
+
+    ktimer_cancel(timer);
+
+    // Round the current time up, the timer must not fire early
+    uint64_t expires = (get_uptime_ns() + 999999) / 1000000 + timeout_ms;
+
+    // Stay on one CPU between picking the wheel and reprogramming its LAPIC
+    bool iflag = intr_save();
+    uint32_t cpu = this_cpu()->index;
+    ktimer_base_t* base = &bases[cpu];
+
+    bool flags = spinlock_acquire(&base->lock);
+
+    // An empty wheel may lag far behind after a long idle stretch, nothing in it needs those jiffies
+    if (base->count == 0) {
+        uint64_t now = get_uptime_ms();
+        if (now > base->clk) base->clk = now;
+    }
+
+    uint64_t before = ktimer_next_locked(base);
+    timer->expires = expires;
+    ktimer_enqueue(base, timer);
+    base->count++;
+    __atomic_store_n(&timer->cpu, cpu, __ATOMIC_RELEASE);
+    uint64_t after = ktimer_next_locked(base);
+    spinlock_release(&base->lock, flags);
+
+    // The LAPIC may be set for a later event, or stopped if the CPU idles
+    if (after < before) timer_bring_forward(tsc_from_uptime_ns(after * 1000000));
+    intr_restore(iflag);
+}
+
+#pragma endregion
+
+#pragma region Timer Interrupt
+
+/*
+ * ktimer_next - TSC deadline of the next jiffy this CPU's wheel has work at, UINT64_MAX if none
+ *
+ * For a timer still on an upper level that is its cascade, which comes
+ * before its expiry.
+ */
+uint64_t ktimer_next(void) {
+    ktimer_base_t* base = &bases[this_cpu()->index];
+    bool flags = spinlock_acquire(&base->lock);
+    uint64_t next = ktimer_next_locked(base);
+    spinlock_release(&base->lock, flags);
+    return next == UINT64_MAX ? UINT64_MAX : tsc_from_uptime_ns(next * 1000000);
+}
+
+/*
+ * ktimer_run - Fires every expired timer on this CPU, called from the timer interrupt
+ *
+ * Walks the clock forward to now, jumping straight over jiffies with nothing
+ * to fire or cascade, so a CPU back from a long idle stretch catches up in a
+ * few steps.
+ */
+void ktimer_run(void) {
+    ktimer_base_t* base = &bases[this_cpu()->index];
+    uint64_t now = get_uptime_ms();
+
+    for (;;) {
+        bool flags = spinlock_acquire(&base->lock);
+
+        ktimer_t* timer = base->slots[base->clk & KTIMER_LVL_MASK];
+        if (timer) {
+            ktimer_unlink(base, timer);
+            base->count--;
+            __atomic_store_n(&timer->cpu, KTIMER_UNARMED, __ATOMIC_RELEASE);
+            spinlock_release(&base->lock, flags);
+
+            // Without the lock, the callback is free to re-arm
+            timer->fn(timer, timer->arg);
+            continue;
+        }
+
+        if (base->clk >= now) {
+            spinlock_release(&base->lock, flags);
+            return;
+        }
+
+        // The current slot is empty, so the next event is strictly ahead of the clock
+        uint64_t next = ktimer_next_locked(base);
+        base->clk = next < now ? next : now;
+        ktimer_cascade(base);
+        spinlock_release(&base->lock, flags);
+    }
+}
+
+#pragma endregion
@@ -0,0 +1,49 @@
+/*
+ * ktimer.h - Millisecond kernel timeouts on a hierarchical timer wheel
+ *
+ * For timeouts that are usually cancelled before they fire, where hrtimer's
+ * tree is more precision than needed. Arming and cancelling are O(1), a
+ * timer fires in interrupt context on the CPU that armed it, within a
+ * millisecond after its timeout. Like hrtimer callbacks, it may re-arm its
+ * own timer and may call sched_add(), but must not sleep.
+ *
+ * Timeouts longer than KTIMER_MAX_MS are cut to KTIMER_MAX_MS.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define KTIMER_LVL_BITS 6
+#define KTIMER_LVL_SIZE (1u << KTIMER_LVL_BITS)
+#define KTIMER_LEVELS   5
+#define KTIMER_MAX_MS   ((1ull << (KTIMER_LVL_BITS * KTIMER_LEVELS)) - 1)   // About 12 days
+
+// ktimer_t.cpu while the timer is not armed
+#define KTIMER_UNARMED 0xFFFFFFFFu
+
+struct ktimer;
+typedef void (*ktimer_fn_t)(struct ktimer* timer, void* arg);
+
+typedef struct ktimer {
+    struct ktimer* next;    // Slot list link
+    struct ktimer** pprev;  // Link that points at us, for O(1) unlink
+    uint64_t expires;       // Uptime in ms
+    ktimer_fn_t fn;
+    void* arg;
+    uint16_t slot;          // level * KTIMER_LVL_SIZE + index
+    volatile uint32_t cpu;  // CPU whose wheel holds the timer, KTIMER_UNARMED if none
+} ktimer_t;
+
+void ktimer_init(void);
+void ktimer_setup(ktimer_t* timer, ktimer_fn_t fn, void* arg);
+void ktimer_arm(ktimer_t* timer, uint64_t timeout_ms);
+bool ktimer_cancel(ktimer_t* timer);
+bool ktimer_pending(const ktimer_t* timer);
+
+// Timer interrupt side
+uint64_t ktimer_next(void);
+void ktimer_run(void);
@@ -11,10 +11,15 @@
 #include <kernel/sys/process.h>
 #include <kernel/sys/scheduler.h>
 #include <kernel/sys/userspace.h>
+#include <kernel/sys/spinlock.h>
+#include <kernel/sys/timers.h>
+#include <kernel/sys/vvar.h>
+#include <kernel/sys/uring.h>
 #include <kernel/memory/heap.h>
 #include <kernel/memory/pmm.h>
 #include <kernel/memory/vmm.h>
 #include <arch/x86_64/cpu/gdt.h>
+#include <arch/x86_64/cpu/fpu.h>
 #include <arch/x86_64/memory/paging.h>
 #include <kernel/debug.h>
 #include <klibc/string.h>
@@ -25,6 +30,9 @@ static tid_t next_tid = 1;
 
 static process_t* proc_list = NULL;
 
+// Guards proc_list and every process's thread list, CPUs create and reap concurrently
+static spinlock_t proc_lock;
+
 /*
  * userspace_start - Global entry point for all Ring 3 threads
  * It calls the entry function and then exits via SYS_EXIT.
@@ -62,6 +70,7 @@ void process_init(void) {
     next_pid = 1;
     next_tid = 1;
     proc_list = NULL;
+    spinlock_init(&proc_lock, "proc");
     LOGF("[PROC] Process subsystem initialized.\n");
 }
 
@@ -96,7 +105,7 @@ process_t* process_create(const char* name, tty_t* existing_tty) {
     if (!proc) return NULL;
 
     kmemset(proc, 0, sizeof(process_t));
-    proc->pid = next_pid++;
+    proc->pid = __atomic_fetch_add(&next_pid, 1, __ATOMIC_RELAXED);
     kstrncpy(proc->name, name, MAX_PROCESS_NAME - 1);
 
     proc->vmm = vmm_create(USER_CODE_VIRT_ADDR, 0x00007FFFFFFFF000);
@@ -152,6 +161,9 @@ process_t* process_create(const char* name, tty_t* existing_tty) {
         }
     }
 
+    // Lets user code read the clock without a syscall
+    if (vvar_map(proc->vmm) != VMM_OK) goto map_fail;
+
     // If the caller provided a TTY, use it. Otherwise, create a new one for this process.
     if (existing_tty) {
         proc->tty = existing_tty;
@@ -163,8 +175,10 @@ process_t* process_create(const char* name, tty_t* existing_tty) {
         proc_hdr_update(proc);
     }
 
+    bool flags = spinlock_acquire(&proc_lock);
     proc->next = proc_list;
     proc_list = proc;
+    spinlock_release(&proc_lock, flags);
 
     LOGF("[PROC] Created process '%s' (PID: %u) with shared code mapping\n", proc->name, proc->pid);
     return proc;
@@ -183,28 +197,31 @@ thread_t* thread_create(process_t* process, const char* name, void (*entry)(void
     if (!thread) return NULL;
 
     kmemset(thread, 0, sizeof(thread_t));
-    thread->tid = next_tid++;
+    thread->tid = __atomic_fetch_add(&next_tid, 1, __ATOMIC_RELAXED);
     thread->process = process;
     thread->state = T_READY;
+    thread->cpu = THREAD_CPU_ANY;
+    thread->prio = SCHED_PRIO_DEFAULT;
+    thread->base_prio = SCHED_PRIO_DEFAULT;
     kstrncpy(thread->name, name, MAX_THREAD_NAME - 1);
 
     /*
      * Initialize FPU state to a clean architectural default.
-     * The thread struct is already fully zeroed by kmemset above, so all
-     * x87/MMX/XMM registers are zero. We only need to write the two control
-     * words that have non-zero reset values:
-     *
-     *   FCW  (offset  0) = 0x037F - x87: all exceptions masked, 64-bit precision
-     *   MXCSR(offset 24) = 0x1F80 - SSE: all exceptions masked
+     * fpu_state_alloc() hands back a zeroed area with only FCW and MXCSR set,
+     * sized for every component in XCR0.
      *
      * This avoids fninit + fxsave, which would capture the calling context's
      * live XMM registers and potentially leak kernel FPU state into the thread.
      */
-    *(uint16_t *)(&thread->fpu[0]) = 0x037F;
-    *(uint32_t *)(&thread->fpu[24]) = 0x1F80;
+    thread->fpu = fpu_state_alloc();
+    if (!thread->fpu) {
+        kfree(thread);
+        return NULL;
+    }
 
     thread->kstack = kmalloc(KERNEL_STACK_SIZE);
     if (!thread->kstack) {
+        fpu_state_free(thread->fpu);
         kfree(thread);
         return NULL;
     }
@@ -221,6 +238,7 @@ thread_t* thread_create(process_t* process, const char* name, void (*entry)(void
 
     thread->context.iret_flags = 0x202; // IF enabled
 
+    thread->is_user = is_user;
     if (is_user) {
         thread->context.iret_cs = USER_CS;
         thread->context.iret_ss = USER_DS;
@@ -240,6 +258,7 @@ thread_t* thread_create(process_t* process, const char* name, void (*entry)(void
 
             if (alloc_status != VMM_OK || !thread->ustack) {
                 kfree(thread->kstack);
+                fpu_state_free(thread->fpu);
                 kfree(thread);
                 return NULL;
             }
@@ -267,8 +286,10 @@ thread_t* thread_create(process_t* process, const char* name, void (*entry)(void
         thread->context.rsi = (uint64_t)arg;
     }
 
+    bool flags = spinlock_acquire(&proc_lock);
     thread->next = process->threads;
     process->threads = thread;
+    spinlock_release(&proc_lock, flags);
     proc_hdr_update(process);
 
     LOGF("[PROC] Created %s thread '%s' (TID: %u) in PID %u\n",
@@ -276,6 +297,18 @@ thread_t* thread_create(process_t* process, const char* name, void (*entry)(void
     return thread;
 }
 
+/*
+ * thread_create_user - Creates a user thread whose entry is already a userspace address
+ *
+ * thread_create() takes the kernel link address of a function in uproc.c,
+ * threads spawned through SYS_THREAD_CREATE only know where it was loaded.
+ */
+thread_t* thread_create_user(process_t* process, const char* name, uintptr_t entry, void* arg, uintptr_t user_rsp) {
+    thread_t* thread = thread_create(process, name, NULL, arg, true, user_rsp);
+    if (thread) thread->context.rdi = entry;
+    return thread;
+}
+
 /*
  * thread_create_bootstrap - Internal helper to wrap the current execution context into a thread
  */
@@ -284,20 +317,27 @@ thread_t* thread_create_bootstrap(process_t* process, const char* name) {
     if (!thread) return NULL;
 
     kmemset(thread, 0, sizeof(thread_t));
-    thread->tid = next_tid++;
+    thread->tid = __atomic_fetch_add(&next_tid, 1, __ATOMIC_RELAXED);
     thread->process = process;
     thread->state = T_RUNNING; 
+    thread->on_cpu = true;
+    thread->prio = SCHED_PRIO_DEFAULT;
+    thread->base_prio = SCHED_PRIO_DEFAULT;
     kstrncpy(thread->name, name, MAX_THREAD_NAME - 1);
 
-    __asm__ volatile (
-        "fxsave %0 \n"
-        : "=m"(thread->fpu)
-    );
+    thread->fpu = fpu_state_alloc();
+    if (!thread->fpu) {
+        kfree(thread);
+        return NULL;
+    }
+    fpu_save(thread->fpu);
 
     thread->kstack = NULL;
 
+    bool flags = spinlock_acquire(&proc_lock);
     thread->next = process->threads;
     process->threads = thread;
+    spinlock_release(&proc_lock, flags);
     proc_hdr_update(process);
 
     LOGF("[PROC] Bootstrapped current context as thread '%s' (TID: %u)\n", thread->name, thread->tid);
@@ -312,6 +352,12 @@ void thread_destroy(thread_t* thread) {
 
     LOGF("[PROC] Destroying thread '%s' (TID: %u)\n", thread->name, thread->tid);
 
+    // Nothing may still reach the thread through a futex queue or timeout
+    futex_cancel(thread);
+
+    // Hand the reserved bandwidth back to admission control
+    if (thread->dl_period) sched_set_deadline(thread, 0, 0, 0);
+
     // Free the user stack if it exists
     if (thread->ustack && thread->process && thread->process->vmm) {
         vmm_free(thread->process->vmm, thread->ustack);
@@ -322,10 +368,86 @@ void thread_destroy(thread_t* thread) {
         kfree(thread->kstack);
     }
 
+    fpu_state_free(thread->fpu);
+
     // The thread struct itself is always allocated with kmalloc, so we use kfree for it as well
     kfree(thread);
 }
 
+/*
+ * thread_unlink - Remove a thread from its process, true if it was the last one
+ *
+ * Only one of several CPUs reaping threads of the same process sees true.
+ */
+bool thread_unlink(thread_t* thread) {
+    process_t* proc = thread ? thread->process : NULL;
+    if (!proc) return false;
+
+    bool flags = spinlock_acquire(&proc_lock);
+
+    thread_t** prev = &proc->threads;
+    while (*prev && *prev != thread)
+        prev = &(*prev)->next;
+    if (*prev) {
+        *prev = thread->next;
+
+        // Keep the process total honest once the thread is gone
+        proc->exited_run_tsc += thread->run_tsc;
+        proc->exited_sys_tsc += thread->is_user ? thread->sys_tsc : thread->run_tsc;
+        proc->exited_nvcsw += thread->nvcsw;
+        proc->exited_nivcsw += thread->nivcsw;
+    }
+
+    bool last = proc->threads == NULL;
+    spinlock_release(&proc_lock, flags);
+    return last;
+}
+
+/*
+ * process_live_threads - Threads of a process not yet marked dead
+ */
+uint32_t process_live_threads(process_t* process) {
+    if (!process) return 0;
+
+    uint32_t n = 0;
+    bool flags = spinlock_acquire(&proc_lock);
+    for (thread_t* t = process->threads; t; t = t->next)
+        if (t->state != T_DEAD) n++;
+    spinlock_release(&proc_lock, flags);
+    return n;
+}
+
+/*
+ * thread_join - Blocks until thread tid of a process has exited, -1 when joining itself
+ *
+ * A tid that is not, or no longer, one of the process's threads has nothing
+ * left to wait for. Exiting threads bump exit_seq and wake it, see sched_exit().
+ */
+int thread_join(process_t* process, tid_t tid) {
+    thread_t* self = sched_current();
+    if (!process || (self && self->tid == tid)) return -1;
+
+    while (1) {
+        // Read before the state, an exit in between then fails the futex compare
+        uint32_t seq = __atomic_load_n(&process->exit_seq, __ATOMIC_ACQUIRE);
+
+        bool alive = false;
+        bool flags = spinlock_acquire(&proc_lock);
+        for (thread_t* t = process->threads; t; t = t->next) {
+            if (t->tid == tid) {
+                alive = t->state != T_DEAD;
+                break;
+            }
+        }
+        spinlock_release(&proc_lock, flags);
+
+        if (!alive) return 0;
+        if (self && self->state == T_DEAD) return -1;
+
+        futex_wait(process->vmm, &process->exit_seq, seq, 0);
+    }
+}
+
 /*
  * process_destroy - Cleans up a process, its heap, and all its threads
  */
@@ -347,6 +469,10 @@ void process_destroy(process_t* process) {
         vmm_destroy(process->vmm);
     }
 
+    // Its pages were only mapped, not owned, by the address space
+    uring_destroy(process->ring);
+
+    bool flags = spinlock_acquire(&proc_lock);
     process_t** prev = &proc_list;
     while (*prev) {
         if (*prev == process) {
@@ -355,6 +481,7 @@ void process_destroy(process_t* process) {
         }
         prev = &(*prev)->next;
     }
+    spinlock_release(&proc_lock, flags);
 
     kfree(process);
 }
@@ -366,22 +493,121 @@ process_t* process_get_all(void) {
     return proc_list;
 }
 
+/*
+ * process_list_lock - Keeps every process and thread list from changing or being freed while walked
+ *
+ * Returns the interrupt state for process_list_unlock(). Other process_*
+ * calls that take the list lock must not be made while holding it.
+ */
+bool process_list_lock(void) {
+    return spinlock_acquire(&proc_lock);
+}
+
+/*
+ * process_list_unlock - Releases process_list_lock()
+ */
+void process_list_unlock(bool flags) {
+    spinlock_release(&proc_lock, flags);
+}
+
 /*
  * procs_kill_tty - Marks all threads of processes using the given TTY as DEAD
  */
 void procs_kill_tty(tty_t* tty) {
     if (!tty) return;
 
+    bool flags = spinlock_acquire(&proc_lock);
     process_t* proc = proc_list;
     while (proc) {
         if (proc->tty == tty) {
             thread_t* thread = proc->threads;
             while (thread) {
                 thread->state = T_DEAD;
+
+                // A futex waiter has no TTY queue to be flushed from, send it to be reaped now
+                if (futex_cancel(thread)) sched_add(thread);
                 thread = thread->next;
             }
             proc->tty = NULL;
         }
         proc = proc->next;
     }
+    spinlock_release(&proc_lock, flags);
+}
+
+/*
+ * thread_times - A thread's run and kernel time in TSC ticks, including a slice still in progress
+ */
+static void thread_times(thread_t* thread, uint64_t now, uint64_t* run, uint64_t* sys) {
+    uint64_t r = thread->run_tsc;
+    uint64_t s = thread->sys_tsc;
+
+    // Folded into run_tsc and sys_tsc only when it switches out
+    if (thread->state == T_RUNNING) {
+        uint64_t stamp = thread->acct_stamp;
+        uint64_t sys_stamp = thread->sys_stamp;
+        if (now > stamp) r += now - stamp;
+        if (sys_stamp && now > sys_stamp) s += now - sys_stamp;
+    }
+
+    if (!thread->is_user) s = r;
+    *run = r;
+    *sys = s < r ? s : r;
+}
+
+/*
+ * rusage_memory - Fills the per process memory and fault fields
+ */
+static void rusage_memory(process_t* process, rusage_t* out) {
+    size_t rss = 0, peak = 0;
+    uint64_t minflt = 0, majflt = 0;
+    if (process && process->vmm) vmm_usage(process->vmm, &rss, &peak, &minflt, &majflt);
+    out->minflt = minflt;
+    out->majflt = majflt;
+    out->rss = rss;
+    out->peak_rss = peak;
+}
+
+/*
+ * thread_rusage - Times and switches of one thread, memory fields of its process
+ */
+void thread_rusage(thread_t* thread, rusage_t* out) {
+    kmemset(out, 0, sizeof(*out));
+    if (!thread) return;
+
+    uint64_t run, sys;
+    thread_times(thread, tsc_read(), &run, &sys);
+    out->utime_ns = tsc_ticks_to_ns(run - sys);
+    out->stime_ns = tsc_ticks_to_ns(sys);
+    out->nvcsw = thread->nvcsw;
+    out->nivcsw = thread->nivcsw;
+    rusage_memory(thread->process, out);
+}
+
+/*
+ * process_rusage - Totals over the live threads of a process and the ones already reaped
+ */
+void process_rusage(process_t* process, rusage_t* out) {
+    kmemset(out, 0, sizeof(*out));
+    if (!process) return;
+
+    uint64_t now = tsc_read();
+    bool flags = spinlock_acquire(&proc_lock);
+    uint64_t run = process->exited_run_tsc;
+    uint64_t sys = process->exited_sys_tsc;
+    out->nvcsw = process->exited_nvcsw;
+    out->nivcsw = process->exited_nivcsw;
+    for (thread_t* t = process->threads; t; t = t->next) {
+        uint64_t r, s;
+        thread_times(t, now, &r, &s);
+        run += r;
+        sys += s;
+        out->nvcsw += t->nvcsw;
+        out->nivcsw += t->nivcsw;
+    }
+    spinlock_release(&proc_lock, flags);
+
+    out->utime_ns = tsc_ticks_to_ns(run - sys);
+    out->stime_ns = tsc_ticks_to_ns(sys);
+    rusage_memory(process, out);
 }
@@ -12,6 +12,7 @@
 #include <kernel/memory/vmm.h>
 #include <kernel/memory/heap.h>
 #include <kernel/drivers/tty.h>
+#include <kernel/sys/futex.h>
 #include <klibc/avl.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -22,6 +23,11 @@
 #define MAX_PROCESS_NAME 64
 #define MAX_THREAD_NAME  64
 
+// thread_t.cpu before a thread first runs, the scheduler places it on the least loaded CPU
+#define THREAD_CPU_ANY   0xFFFFFFFFu
+
+struct uring;
+
 typedef uint32_t pid_t;
 typedef uint32_t tid_t;
 
@@ -45,16 +51,62 @@ typedef struct thread {
     void* kstack;           // Base of the kernel stack
     void* ustack;           // Virtual address of the user stack
     uint64_t fs_base;       // Thread Local Storage base
+    uint64_t ksp;           // Stack pointer saved by sched_switch, 0 while context holds the state
 
-    uint8_t fpu[512] __attribute__((aligned(16))); // FPU/SSE/AVX state
+    void* fpu;              // x87/SSE/AVX save area, fpu_state_size() bytes
 
-    uint64_t wake_at;       // Timestamp for waking up
+    uint64_t wake_at;       // TSC deadline for waking up
     avl_node_t sleep_node;  // AVL tree node for sleep queue
 
+    uint8_t prio;           // Effective priority level, 0 is the most urgent
+    uint8_t base_prio;      // Level set by sched_set_priority, boosts decay back to it
+    bool yielded;           // Gave the CPU up voluntarily, the slice check does not apply
+    uint64_t slice_end;     // Uptime in ms when the current slice runs out
+
+    // Deadline class, a constant bandwidth server per thread. dl_period is 0 for normal threads
+    uint64_t dl_runtime;    // Budget per period, ns
+    uint64_t dl_deadline;   // Relative deadline, ns
+    uint64_t dl_period;     // Period, ns
+    uint64_t dl_abs;        // Absolute deadline of the current job, uptime ns
+    int64_t  dl_budget;     // Budget left for the current job, ns
+    uint64_t dl_since;      // Uptime ns when the budget was last charged
+    uint64_t dl_misses;     // Jobs still unfinished at their absolute deadline
+    uint32_t dl_cpu;        // CPU whose bandwidth admitted the thread, it only runs there
+    bool dl_throttled;      // Out of budget, parked in the sleep tree until its next period
+    avl_node_t dl_node;     // AVL tree node for the deadline queue
+
+    // Accounting, kept on every switch
+    uint64_t acct_stamp;    // TSC when the thread last went on a CPU or became ready
+    uint64_t run_tsc;       // TSC ticks spent on a CPU
+    uint64_t wait_tsc;      // TSC ticks spent ready, waiting for a CPU
+    uint64_t nvcsw;         // Switches away because it yielded, slept or blocked
+    uint64_t nivcsw;        // Switches away because it was preempted
+    uint64_t sys_tsc;       // Part of run_tsc spent in the kernel on behalf of a user thread
+    uint64_t sys_stamp;     // TSC at the last kernel entry from ring 3 or switch in, 0 while in ring 3
+    bool is_user;           // Runs in ring 3, kernel threads count all their time as system time
+
+    futex_waiter_t futex;   // Queue entry and timeout while blocked in futex_wait()
+
+    uint32_t cpu;           // CPU index the thread last ran on
+    volatile bool on_cpu;   // Registers still live on a CPU, cleared once its context is saved
+    volatile bool reaping;  // Already pushed on the dead list
+
     struct thread* next;    // Next thread in the process (linked list)
     struct thread* rnext;   // Next thread in the scheduler's ready queue
 } thread_t;
 
+// Resource usage of a thread or a whole process, see process_rusage()
+typedef struct {
+    uint64_t utime_ns;      // Time in ring 3
+    uint64_t stime_ns;      // Time in the kernel, syscalls, faults and interrupts taken from ring 3
+    uint64_t nvcsw;         // Voluntary context switches
+    uint64_t nivcsw;        // Involuntary context switches
+    uint64_t minflt;        // Page faults served without I/O, per process
+    uint64_t majflt;        // Page faults that loaded from zswap, per process
+    uint64_t rss;           // Bytes backed by private frames, per process
+    uint64_t peak_rss;      // Largest rss so far, per process
+} rusage_t;
+
 typedef struct process {
     pid_t pid;
     char name[MAX_PROCESS_NAME];
@@ -62,6 +114,14 @@ typedef struct process {
     tty_t* tty;             // Associated terminal
     
     thread_t* threads;      // Linked list of threads in this process
+    uint64_t exited_run_tsc;// CPU time of threads already unlinked, TSC ticks
+    uint64_t exited_sys_tsc;// Kernel part of exited_run_tsc
+    uint64_t exited_nvcsw;
+    uint64_t exited_nivcsw;
+    volatile uint32_t exit_seq; // Bumped by every exiting thread, thread_join() sleeps on it
+    uint64_t syscalls;      // Syscalls made by any of its threads
+    uint64_t syscall_tsc;   // TSC cycles spent in them, blocking included
+    struct uring* ring;     // Submission ring from SYS_URING_SETUP, NULL without one
     
     struct process* next;   // Next process in the system
 } process_t;
@@ -69,9 +129,17 @@ typedef struct process {
 void process_init(void);
 process_t* process_create(const char* name, tty_t* existing_tty);
 thread_t* thread_create(process_t* process, const char* name, void (*entry)(void*), void* arg, bool is_user, uintptr_t user_rsp);
+thread_t* thread_create_user(process_t* process, const char* name, uintptr_t entry, void* arg, uintptr_t user_rsp);
 thread_t* thread_create_bootstrap(process_t* process, const char* name);
+int thread_join(process_t* process, tid_t tid);
 void thread_destroy(thread_t* thread);
+bool thread_unlink(thread_t* thread);
+uint32_t process_live_threads(process_t* process);
 void process_destroy(process_t* process);
 process_t* process_get_all(void);
+bool process_list_lock(void);
+void process_list_unlock(bool flags);
 void procs_kill_tty(tty_t* tty);
-void proc_hdr_update(process_t* proc);
\ No newline at end of file
+void proc_hdr_update(process_t* proc);
+void thread_rusage(thread_t* thread, rusage_t* out);
+void process_rusage(process_t* process, rusage_t* out);
\ No newline at end of file
@@ -1,18 +1,46 @@
 /*
- * scheduler.c - Round-Robin Scheduler implementation
+ * scheduler.c - Priority Round-Robin Scheduler implementation
  *
  * This file implements the core scheduling logic, including thread switching,
  * idle task management, and sleep/wakeup mechanisms.
  *
+ * Run queues hold one FIFO per priority level plus a bitmap of the non empty
+ * ones, so picking the next thread is a single TZCNT whatever the load.
+ * Higher levels get shorter slices. Threads woken from TTY input are boosted
+ * and decay back to their base level each time they burn a full slice.
+ *
+ * Every CPU owns a run queue, a sleep tree keyed by TSC deadline and an
+ * idle thread. Woken threads go back to the CPU they last ran on
+ * unless another CPU sits idle, and a CPU whose queue runs dry steals from
+ * its neighbours before idling.
+ *
+ * Deadline threads (sched_set_deadline) sit in front of every level. Each one
+ * is a constant bandwidth server: runtime ns of budget per period, queued by
+ * absolute deadline, throttled until its next period once the budget is gone.
+ * Admission control pins them to a CPU with enough bandwidth left, they are
+ * never stolen.
+ *
+ * Ticks, IPIs and exits switch through the cpu_context_t frame ISR.S builds.
+ * sched_yield() from thread context swaps kernel stacks directly instead
+ * (switch.S) and keeps only the callee saved registers, either path resumes
+ * a thread saved by the other.
+ *
+ * Exited threads go on a lock free list drained by the reaper thread, so
+ * neither path ever frees a stack or tears down an address space.
+ *
  * Author: u/ApparentlyPlus
  */
 
 #include <kernel/sys/scheduler.h>
 #include <kernel/sys/timers.h>
+#include <kernel/sys/clocksource.h>
 #include <kernel/sys/process.h>
 #include <kernel/sys/panic.h>
+#include <kernel/sys/spinlock.h>
+#include <kernel/sys/smp.h>
 #include <arch/x86_64/cpu/gdt.h>
 #include <arch/x86_64/cpu/cpu.h>
+#include <arch/x86_64/cpu/fpu.h>
 #include <arch/x86_64/cpu/msr.h>
 #include <arch/x86_64/cpu/interrupts.h>
 #include <kernel/memory/heap.h>
@@ -21,34 +49,102 @@
 #include <klibc/string.h>
 #include <klibc/stdio.h>
 
-// Scheduler state
-static thread_t* cur = NULL;
-static thread_t* rq_head = NULL;
-static thread_t* rq_tail = NULL;
+// Per CPU scheduler state, rqs[i] belongs to cpu_locals[i]
+typedef struct {
+    spinlock_t lock;                // Guards the ready queues and sleep tree
+    thread_t* heads[SCHED_PRIO_LEVELS];
+    thread_t* tails[SCHED_PRIO_LEVELS];
+    volatile uint32_t bitmap;       // Bit p set while heads[p] is non empty
+    volatile uint32_t nr_ready;
+
+    avl_tree_t dl_tree;             // Ready deadline threads, earliest absolute deadline first
+    volatile uint32_t nr_dl;
+    uint64_t dl_bw;                 // Admitted bandwidth, guarded by dl_lock
+
+    avl_tree_t sleep_tree;
+
+    thread_t* idle;
+
+    // Lazy FPU, track which thread's state is live in this core's FPU
+    thread_t* fpu_owner;
+
+    // Accounting, only written by the owning CPU
+    uint64_t online_tsc;            // TSC when the CPU joined the scheduler
+    uint64_t lat_hist[SCHED_LAT_BUCKETS];
+} sched_cpu_t;
+
+static sched_cpu_t rqs[MAX_CPUS];
 
 // MONITOR/MWAIT power state support
 static bool cpu_has_mwait = false;
 static uint32_t mwait_hint = 0;    // C-state hint for MWAIT EAX (target C-state)
 static uint32_t mwait_ext  = 0;    // MWAIT ECX extensions (bit 0 = IBE: interrupt break event)
 
-// CPU utilisation counters (incremented in IRQ context, no locking needed)
-static volatile uint64_t ticks_total = 0;
-static volatile uint64_t ticks_idle  = 0;
-
-static avl_tree_t sleep_tree;
-static thread_t*  dead_head = NULL;
-
-static thread_t* idle = NULL;
 static process_t* idle_proc = NULL;
 
+// Serialises admission control across CPUs
+static spinlock_t dl_lock;
+
 static bool sched_on = false;
 
-// Lazy FPU, track which thread's state is live in the FPU hardware
-static thread_t* fpu_owner = NULL;
+// Exited threads waiting for the reaper, pushed with CAS and taken whole with XCHG
+static thread_t* volatile dead_head = NULL;
+static thread_t* reaper = NULL;
+static volatile bool reaper_idle = false;
+static volatile uint64_t reaped = 0;
 
-// Top of the dedicated per-CPU scheduler stack
+// Voluntary yields switch stacks directly instead of going through int $32
+static bool direct_yield = true;
+
+// switch.S
+extern void sched_switch(uint64_t* save_sp, uint64_t next_sp, cpu_context_t* next_ctx, volatile bool* prev_on_cpu);
+extern char sched_switch_resume[];
+
+// Non zero once the BSP has a scheduler stack, ISR.S then switches to this CPU's own
 uint64_t sched_stack_top = 0;
-static void* sched_stack = NULL;
+
+/*
+ * this_rq - Run queue of the executing CPU
+ */
+static inline sched_cpu_t* this_rq(void) {
+    return &rqs[this_cpu()->index];
+}
+
+/*
+ * sched_tzcnt - Index of the lowest set bit, map must be non zero
+ *
+ * TZCNT decodes as REP BSF on CPUs without BMI1, which gives the same
+ * result for a non zero operand.
+ */
+static inline uint32_t sched_tzcnt(uint32_t map) {
+    uint32_t idx;
+    __asm__("tzcnt %1, %0" : "=r"(idx) : "rm"(map) : "cc");
+    return idx;
+}
+
+/*
+ * sched_quantum_ms - Slice length for a priority level, SCHED_QUANTUM_MS at the default level
+ */
+static inline uint64_t sched_quantum_ms(uint8_t prio) {
+    return (uint64_t)(SCHED_QUANTUM_MS + ((int)prio - SCHED_PRIO_DEFAULT) / 2);
+}
+
+/*
+ * rq_top_prio - Best priority queued on a run queue, SCHED_PRIO_LEVELS if empty
+ */
+static inline uint32_t rq_top_prio(sched_cpu_t* rq) {
+    uint32_t map = rq->bitmap;
+    return map ? sched_tzcnt(map) : SCHED_PRIO_LEVELS;
+}
+
+/*
+ * sched_lat_bucket - Run queue latency histogram bucket for a wait in TSC ticks
+ */
+static inline uint32_t sched_lat_bucket(uint64_t wait_tsc) {
+    uint64_t us = tsc_ticks_to_ns(wait_tsc) / 1000;
+    uint32_t b = us ? 64 - (uint32_t)__builtin_clzll(us) : 0;
+    return b < SCHED_LAT_BUCKETS ? b : SCHED_LAT_BUCKETS - 1;
+}
 
 /*
  * sleep_cmp - Comparison function for the sleep tree
@@ -63,6 +159,19 @@ static int sleep_cmp(const avl_node_t* a, const avl_node_t* b) {
     return 0;
 }
 
+/*
+ * dl_cmp - Comparison function for the deadline queue
+ */
+static int dl_cmp(const avl_node_t* a, const avl_node_t* b) {
+    const thread_t* ta = AVL_ENTRY(a, thread_t, dl_node);
+    const thread_t* tb = AVL_ENTRY(b, thread_t, dl_node);
+    if (ta->dl_abs < tb->dl_abs) return -1;
+    if (ta->dl_abs > tb->dl_abs) return  1;
+    if (ta->tid < tb->tid) return -1;
+    if (ta->tid > tb->tid) return  1;
+    return 0;
+}
+
 /*
  * fpu_nm_handler - Handles the FPU not available interrupt
  */
@@ -72,37 +181,405 @@ static cpu_context_t* fpu_nm_handler(cpu_context_t* ctx) {
     // This avoids unnecessary FPU state saves/restores on every context switch, which can be expensive
 
     __asm__ volatile("clts" ::: "memory");
+    fpu_count_trap();
+
+    sched_cpu_t* rq = this_rq();
+    thread_t* cur = this_cpu_thread();
 
     if (!cur) {
-        if (fpu_owner) {
-            __asm__ volatile("fxsave %0" : "=m"(fpu_owner->fpu));
-            fpu_owner = NULL;
+        if (rq->fpu_owner) {
+            fpu_save(rq->fpu_owner->fpu);
+            rq->fpu_owner = NULL;
         }
         return ctx;
     }
 
-    if (fpu_owner != cur) {
-        if (fpu_owner)
-            __asm__ volatile("fxsave %0" : "=m"(fpu_owner->fpu));
-        __asm__ volatile("fxrstor %0" :: "m"(cur->fpu));
-        fpu_owner = cur;
+    // XSAVEOPT skips what the owner left untouched, XRSTOR loads only the components in use
+    if (rq->fpu_owner != cur) {
+        if (rq->fpu_owner)
+            fpu_save(rq->fpu_owner->fpu);
+        fpu_restore(cur->fpu);
+        rq->fpu_owner = cur;
     }
     return ctx;
 }
 
-static void sched_add_dead(thread_t* thread);
-static void sched_add_sleep(thread_t* thread);
+/*
+ * sched_ipi_handler - INT_IPI_RESCHEDULE handler, a better thread became ready for this CPU
+ */
+static cpu_context_t* sched_ipi_handler(cpu_context_t* ctx) {
+    return sched_schedule(ctx);
+}
+
+#pragma region Queue Helpers
+
+/*
+ * rq_push_locked - Append a thread to the queue of its priority level, or the deadline queue, rq->lock held
+ */
+static void rq_push_locked(sched_cpu_t* rq, thread_t* thread) {
+    uint8_t p = thread->prio;
+    thread->state = T_READY;
+    thread->rnext = NULL;
+    thread->acct_stamp = tsc_read();
+
+    if (thread->dl_period) {
+        avl_insert(&rq->dl_tree, &thread->dl_node);
+        rq->nr_dl++;
+    } else if (!rq->heads[p]) {
+        rq->heads[p] = thread;
+        rq->tails[p] = thread;
+        rq->bitmap |= 1u << p;
+    } else {
+        rq->tails[p]->rnext = thread;
+        rq->tails[p] = thread;
+    }
+    rq->nr_ready++;
+}
+
+/*
+ * rq_pop_prio_locked - Take the head of the best non empty level, rq->lock held
+ */
+static thread_t* rq_pop_prio_locked(sched_cpu_t* rq) {
+    if (!rq->bitmap) return NULL;
+
+    uint32_t p = sched_tzcnt(rq->bitmap);
+    thread_t* thread = rq->heads[p];
+
+    rq->heads[p] = thread->rnext;
+    if (!rq->heads[p]) {
+        rq->tails[p] = NULL;
+        rq->bitmap &= ~(1u << p);
+    }
+    thread->rnext = NULL;
+    rq->nr_ready--;
+    return thread;
+}
+
+/*
+ * rq_pop_locked - Take the earliest deadline thread, else the head of the best level, rq->lock held
+ */
+static thread_t* rq_pop_locked(sched_cpu_t* rq) {
+    avl_node_t* dn = avl_min(&rq->dl_tree);
+    if (!dn) return rq_pop_prio_locked(rq);
+
+    avl_remove(&rq->dl_tree, dn);
+    rq->nr_dl--;
+    rq->nr_ready--;
+    return AVL_ENTRY(dn, thread_t, dl_node);
+}
+
+/*
+ * rq_dl_first - Earliest deadline queued on a run queue, NULL if none, rq->lock held
+ */
+static inline thread_t* rq_dl_first(sched_cpu_t* rq) {
+    avl_node_t* dn = avl_min(&rq->dl_tree);
+    return dn ? AVL_ENTRY(dn, thread_t, dl_node) : NULL;
+}
+
+/*
+ * sched_add_sleep - Inserts a thread into the AVL sleep tree, rq->lock held
+ */
+static void sched_add_sleep(sched_cpu_t* rq, thread_t* thread) {
+    if (!thread) return;
+    thread->rnext = NULL;
+    avl_insert(&rq->sleep_tree, &thread->sleep_node);
+}
+
+/*
+ * sched_add_dead - Pushes a thread on the dead list, queueing the reaper on *remote if it sleeps
+ *
+ * A thread killed while blocking can reach here from both its own CPU and a
+ * waker, only the first caller queues it. Safe with or without rq->lock, the
+ * reaper is only added once the caller hands *remote to sched_add_remote().
+ */
+static void sched_add_dead(thread_t* thread, thread_t** remote) {
+    if (!thread) return;
+    if (__atomic_exchange_n(&thread->reaping, true, __ATOMIC_ACQ_REL)) return;
+
+    thread_t* head = __atomic_load_n(&dead_head, __ATOMIC_RELAXED);
+    do {
+        thread->rnext = head;
+    } while (!__atomic_compare_exchange_n(&dead_head, &head, thread, true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+
+    // Whoever clears the idle flag owns the wake up
+    if (reaper && __atomic_exchange_n(&reaper_idle, false, __ATOMIC_SEQ_CST)) {
+        reaper->rnext = *remote;
+        *remote = reaper;
+    }
+}
+
+/*
+ * sched_add_remote - Hands deadline threads admitted on other CPUs, or the reaper, to sched_add after unlock
+ */
+static void sched_add_remote(thread_t* remote) {
+    while (remote) {
+        thread_t* thread = remote;
+        remote = thread->rnext;
+        thread->rnext = NULL;
+        sched_add(thread);
+    }
+}
+
+/*
+ * dl_replenish - Start a new job: full budget, deadline measured from now
+ */
+static inline void dl_replenish(thread_t* thread, uint64_t now_ns) {
+    thread->dl_abs = now_ns + thread->dl_deadline;
+    thread->dl_budget = (int64_t)thread->dl_runtime;
+}
+
+/*
+ * dl_wakeup - CBS wake up rule, keep the current job only if its leftover budget fits before the deadline
+ *
+ * Reusing the old deadline with more budget than runtime / period allows for
+ * the time left would let a thread that slept exceed its reserved bandwidth.
+ */
+static void dl_wakeup(thread_t* thread, uint64_t now_ns) {
+    if (now_ns >= thread->dl_abs || thread->dl_budget <= 0 ||
+        (uint64_t)thread->dl_budget * thread->dl_period > thread->dl_runtime * (thread->dl_abs - now_ns))
+        dl_replenish(thread, now_ns);
+}
+
+/*
+ * dl_charge - Take the time run since the last charge out of a deadline thread's budget
+ */
+static inline void dl_charge(thread_t* thread, uint64_t now_ns) {
+    thread->dl_budget -= (int64_t)(now_ns - thread->dl_since);
+    thread->dl_since = now_ns;
+}
+
+/*
+ * dl_check_miss - Count a miss if a runnable job is past its deadline, then give it a fresh one
+ */
+static void dl_check_miss(thread_t* thread, uint64_t now_ns) {
+    if (now_ns <= thread->dl_abs) return;
+    thread->dl_misses++;
+    dl_replenish(thread, now_ns);
+}
+
+/*
+ * dl_throttle - Park a deadline thread until its next period, false if that period already started, rq->lock held
+ */
+static bool dl_throttle(sched_cpu_t* rq, thread_t* thread, uint64_t now_ns) {
+    uint64_t release = thread->dl_abs - thread->dl_deadline + thread->dl_period;
+    if (release <= now_ns) {
+        dl_replenish(thread, now_ns);
+        return false;
+    }
+
+    thread->dl_abs = release + thread->dl_deadline;
+    thread->dl_budget = (int64_t)thread->dl_runtime;
+    thread->dl_throttled = true;
+    thread->state = T_SLEEPING;
+    thread->wake_at = tsc_from_uptime_ns(release);
+    sched_add_sleep(rq, thread);
+    return true;
+}
+
+/*
+ * rq_requeue_locked - Put a thread back on this CPU's queue, deadline threads admitted elsewhere go on *remote for sched_add()
+ */
+static void rq_requeue_locked(sched_cpu_t* rq, uint32_t self, thread_t* thread, thread_t** remote) {
+    if (thread->dl_period && thread->dl_cpu != self) {
+        thread->rnext = *remote;
+        *remote = thread;
+        return;
+    }
+    rq_push_locked(rq, thread);
+}
+
+/*
+ * sched_cpu_idle - True if a CPU runs its idle thread with nothing queued
+ */
+static bool sched_cpu_idle(uint32_t index) {
+    return cpu_locals[index].online
+        && cpu_locals[index].thread == rqs[index].idle
+        && rqs[index].nr_ready == 0;
+}
+
+/*
+ * sched_pick_cpu - Choose the run queue for a thread becoming ready
+ */
+static uint32_t sched_pick_cpu(thread_t* thread) {
+    uint32_t n = smp_cpu_count();
+    uint32_t self = this_cpu()->index;
+
+    // Deadline threads only run where their bandwidth was admitted
+    if (thread->dl_period) return thread->dl_cpu;
+    if (n <= 1) return self;
+
+    // Stay cache hot on the previous CPU unless it is busy and another one idles
+    uint32_t prev = thread->cpu;
+    if (prev < n && cpu_locals[prev].online) {
+        if (sched_cpu_idle(prev)) return prev;
+        for (uint32_t i = 0; i < n; i++)
+            if (sched_cpu_idle(i)) return i;
+        return prev;
+    }
+
+    // Never ran, least loaded CPU
+    uint32_t best = self;
+    uint32_t load = rqs[self].nr_ready + (cpu_locals[self].thread != rqs[self].idle);
+    for (uint32_t i = 0; i < n; i++) {
+        if (!cpu_locals[i].online) continue;
+        uint32_t l = rqs[i].nr_ready + (cpu_locals[i].thread != rqs[i].idle);
+        if (l < load) {
+            best = i;
+            load = l;
+        }
+    }
+    return best;
+}
+
+/*
+ * sched_steal - Take a ready thread from another CPU's queue, NULL if all are empty
+ */
+static thread_t* sched_steal(uint32_t self) {
+    uint32_t n = smp_cpu_count();
+
+    for (uint32_t k = 1; k < n; k++) {
+        sched_cpu_t* rq = &rqs[(self + k) % n];
+        if (!rq->nr_ready) continue;
+
+        // Never wait on a remote queue from inside the scheduler
+        bool flags;
+        if (!spinlock_try_acquire(&rq->lock, &flags)) continue;
+        thread_t* thread = rq_pop_prio_locked(rq);
+        spinlock_release(&rq->lock, flags);
+
+        if (thread) return thread;
+    }
+    return NULL;
+}
+
+/*
+ * sched_keep_running - True if cur has slice or budget left and nothing more urgent is queued, rq->lock held
+ */
+static bool sched_keep_running(sched_cpu_t* rq, thread_t* cur, uint64_t now_ns) {
+    if (cur == rq->idle || cur->state != T_RUNNING || cur->yielded) return false;
+
+    if (cur->dl_period) {
+        if (cur->dl_budget <= 0 || now_ns > cur->dl_abs || cur->dl_cpu != cur->cpu) return false;
+        thread_t* first = rq_dl_first(rq);
+        return !first || first->dl_abs >= cur->dl_abs;
+    }
+
+    if (rq->nr_dl) return false;
+    if (now_ns / 1000000 >= cur->slice_end) return false;
+    return rq_top_prio(rq) >= cur->prio;
+}
+
+/*
+ * sched_preempts - True if a thread becoming ready should take the CPU from running
+ */
+static bool sched_preempts(const thread_t* thread, const thread_t* running) {
+    if (thread->dl_period)
+        return !running->dl_period || thread->dl_abs < running->dl_abs;
+    return !running->dl_period && thread->prio < running->prio;
+}
+
+/*
+ * sched_kick_idle - Wake one idle CPU so it steals the surplus of this queue
+ */
+static void sched_kick_idle(uint32_t self) {
+    uint32_t n = smp_cpu_count();
+    for (uint32_t k = 1; k < n; k++) {
+        uint32_t i = (self + k) % n;
+        if (sched_cpu_idle(i)) {
+            smp_send_resched(i);
+            return;
+        }
+    }
+}
+
+#pragma endregion
+
+/*
+ * sched_reap - Destroys a detached list of dead threads and any process they leave empty
+ */
+static void sched_reap(thread_t* dead) {
+    while (dead) {
+        thread_t* thread = dead;
+        dead = thread->rnext;
+
+        // Still switching out, the stack it runs on is about to be freed
+        while (__atomic_load_n(&thread->on_cpu, __ATOMIC_ACQUIRE))
+            __asm__ volatile("pause");
+
+        process_t* proc = thread->process;
+        bool last = thread_unlink(thread);
+
+        // Lazy FPU ownership outlives the thread on a single CPU, never let a trap save into freed state
+        for (uint32_t i = 0; i < smp_cpu_count(); i++) {
+            thread_t* owner = thread;
+            __atomic_compare_exchange_n(&rqs[i].fpu_owner, &owner, NULL, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+        }
+
+        thread_destroy(thread);
+        __atomic_fetch_add(&reaped, 1, __ATOMIC_RELAXED);
+
+        // We protect PID 1 (Idle) and PID 2 (Kernel Main)
+        if (proc && last && proc->pid > 2) {
+            // The CPU that ran the last thread loads another CR3 right after clearing on_cpu
+            for (uint32_t i = 0; i < smp_cpu_count(); i++) {
+                while (__atomic_load_n(&cpu_locals[i].vmm, __ATOMIC_ACQUIRE) == proc->vmm)
+                    __asm__ volatile("pause");
+            }
+
+            if (proc->tty) {
+                char term_msg[128];
+                int len = ksnprintf(term_msg, sizeof(term_msg),
+                                   "\n[Process %s (PID %u) has terminated]\n",
+                                   proc->name, proc->pid);
+                tty_write(proc->tty, term_msg, (size_t)len);
+            }
+            process_destroy(proc);
+        }
+    }
+}
+
+/*
+ * reaper_entry - Kernel thread that frees exited threads and processes outside the scheduler
+ *
+ * Blocks with reaper_idle set while the dead list is empty. sched_add_dead()
+ * pushes before it checks the flag and the reaper sets it before it checks
+ * the list, so a push is never missed.
+ */
+static void reaper_entry(void* arg) {
+    (void)arg;
+    thread_t* self = sched_current();
+
+    while (1) {
+        thread_t* dead = __atomic_exchange_n(&dead_head, NULL, __ATOMIC_ACQUIRE);
+        if (dead) {
+            sched_reap(dead);
+            continue;
+        }
+
+        bool iflag = intr_save();
+        self->state = T_BLOCKED;
+        __atomic_store_n(&reaper_idle, true, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&dead_head, __ATOMIC_SEQ_CST) && __atomic_exchange_n(&reaper_idle, false, __ATOMIC_SEQ_CST)) {
+            self->state = T_RUNNING;
+        } else {
+            sched_yield();
+        }
+        intr_restore(iflag);
+    }
+}
 
 /*
  * idle_thread_entry - MONITOR/MWAIT idle loop (falls back to HLT).
- * Watches rq_head so any sched_add() store wakes MWAIT immediately.
+ * Watches this CPU's queue bitmap so any sched_add() store wakes MWAIT immediately.
  */
 static void idle_thread_entry(void* arg) {
     (void)arg;
+    sched_cpu_t* rq = this_rq();
+
     while (1) {
         if (cpu_has_mwait) {
-            __asm__ volatile("monitor" :: "a"(&rq_head), "c"(0), "d"(0) : "memory");
-            if (rq_head) { sched_yield(); continue; }
+            __asm__ volatile("monitor" :: "a"(&rq->bitmap), "c"(0), "d"(0) : "memory");
+            if (rq->bitmap || rq->nr_dl) { sched_yield(); continue; }
             __asm__ volatile("mwait" :: "a"(mwait_hint), "c"(mwait_ext) : "memory");
         } else {
             __asm__ volatile("hlt");
@@ -110,36 +587,69 @@ static void idle_thread_entry(void* arg) {
     }
 }
 
+/*
+ * sched_init_cpu - Per CPU half of the scheduler setup: queues, idle thread, scheduler stack
+ */
+static void sched_init_cpu(void) {
+    cpu_local_t* cpu = this_cpu();
+    sched_cpu_t* rq = &rqs[cpu->index];
+
+    avl_init(&rq->sleep_tree, sleep_cmp);
+    avl_init(&rq->dl_tree, dl_cmp);
+
+    rq->idle = thread_create(idle_proc, "idle", idle_thread_entry, NULL, false, 0);
+    if (!rq->idle) panic("Failed to create idle thread!");
+    rq->idle->cpu = cpu->index;
+    rq->idle->acct_stamp = tsc_read();
+    rq->online_tsc = rq->idle->acct_stamp;
+
+    // Below every real level, anything that becomes ready preempts it
+    rq->idle->prio = SCHED_PRIO_IDLE;
+    rq->idle->base_prio = SCHED_PRIO_IDLE;
+
+    // Allocate the per CPU scheduler stack
+    void* stack = kmalloc(KERNEL_STACK_SIZE);
+    if (!stack) panic("Failed to allocate scheduler stack!");
+    cpu->sched_stack_top = (uint64_t)stack + KERNEL_STACK_SIZE;
+    LOGF("[SCHED] CPU %u scheduler stack allocated at 0x%lx\n", cpu->index, cpu->sched_stack_top);
+}
+
 /*
  * sched_init - Initializes the scheduler and creates the idle thread
  */
 void sched_init(void) {
+    for (uint32_t i = 0; i < MAX_CPUS; i++)
+        spinlock_init(&rqs[i].lock, "runqueue");
+    spinlock_init(&dl_lock, "sched_dl");
+
     idle_proc = process_create("idle_proc", active_tty);
     if (!idle_proc) panic("Failed to create idle process!");
 
-    idle = thread_create(idle_proc, "idle", idle_thread_entry, NULL, false, 0);
-    if (!idle) panic("Failed to create idle thread!");
+    sched_init_cpu();
 
     process_t* kproc = process_create("kproc", active_tty);
     if (!kproc) panic("Failed to create kernel main process!");
 
     // Wrap current context into a thread so it can be preempted and resumed
-    cur = thread_create_bootstrap(kproc, "kernel_main");
+    thread_t* cur = thread_create_bootstrap(kproc, "kernel_main");
     if (!cur) panic("Failed to bootstrap kernel main thread!");
+    cur->cpu = this_cpu()->index;
+    cur->acct_stamp = tsc_read();
+    this_cpu()->thread = cur;
 
     // Use the boot stack for kernel_main to keep the current execution stack valid
     // The boot stack is 32 KiB, we treat the top 16 KiB as the kernel stack
     extern char KERNEL_STACK_TOP;
     cur->kstack = (void *)((uintptr_t)&KERNEL_STACK_TOP - KERNEL_STACK_SIZE);
 
-    avl_init(&sleep_tree, sleep_cmp);
     irq_register(INT_DEVICE_NOT_AVAILABLE, fpu_nm_handler);
+    irq_register(INT_IPI_RESCHEDULE, sched_ipi_handler);
 
-    // Allocate the per CPU scheduler stack
-    sched_stack = kmalloc(KERNEL_STACK_SIZE);
-    if (!sched_stack) panic("Failed to allocate scheduler stack!");
-    sched_stack_top = (uint64_t)sched_stack + KERNEL_STACK_SIZE;
-    LOGF("[SCHED] Scheduler stack allocated at 0x%lx\n", sched_stack_top);
+    sched_stack_top = this_cpu()->sched_stack_top;
+
+    reaper = thread_create(kproc, "reaper", reaper_entry, NULL, false, 0);
+    if (!reaper) panic("Failed to create reaper thread!");
+    sched_add(reaper);
 
     // Detect MONITOR/MWAIT (CPUID.01H:ECX[3]), pick deepest C-state from CPUID.05H
     {
@@ -169,6 +679,13 @@ void sched_init(void) {
     LOGF("[SCHED] Scheduler initialized and enabled.\n");
 }
 
+/*
+ * sched_init_ap - Gives an AP its idle thread and scheduler stack, runs before it goes online
+ */
+void sched_init_ap(void) {
+    sched_init_cpu();
+}
+
 /*
  * sched_active - Returns whether the scheduler is initialized and enabled
  */
@@ -177,227 +694,406 @@ bool sched_active(void) {
 }
 
 /*
- * sched_next_wake - Returns the timestamp of the next sleeping thread to wake up, or UINT64_MAX if none
+ * sched_next_wake - Returns the TSC deadline of the next sleeping thread on this CPU to wake up, or UINT64_MAX if none
  */
 uint64_t sched_next_wake(void) {
-    avl_node_t *mn = avl_min(&sleep_tree);
-    if (!mn) return UINT64_MAX;
-    return AVL_ENTRY(mn, thread_t, sleep_node)->wake_at;
+    sched_cpu_t* rq = this_rq();
+    bool flags = spinlock_acquire(&rq->lock);
+    avl_node_t *mn = avl_min(&rq->sleep_tree);
+    uint64_t wake = mn ? AVL_ENTRY(mn, thread_t, sleep_node)->wake_at : UINT64_MAX;
+    spinlock_release(&rq->lock, flags);
+    return wake;
 }
 
 /*
- * sched_cpu_usage - Returns total and idle tick counts for CPU usage calculation
+ * sched_cpu_usage - Returns idle and total TSC ticks since each CPU came online, summed over all CPUs
  */
 void sched_cpu_usage(uint64_t *out_idle, uint64_t *out_total) {
-    *out_idle  = ticks_idle;
-    *out_total = ticks_total;
+    uint64_t idle = 0, total = 0;
+    uint64_t now = tsc_read();
+
+    for (uint32_t i = 0; i < smp_cpu_count(); i++) {
+        sched_cpu_t* rq = &rqs[i];
+        if (!rq->idle || !rq->online_tsc) continue;
+
+        // Idle time so far plus the stretch the idle thread is in right now
+        uint64_t cpu_total = now - rq->online_tsc;
+        uint64_t cpu_idle = rq->idle->run_tsc;
+        if (cpu_locals[i].thread == rq->idle) cpu_idle += now - rq->idle->acct_stamp;
+
+        // Unlocked reads can briefly count a stretch twice
+        idle  += cpu_idle < cpu_total ? cpu_idle : cpu_total;
+        total += cpu_total;
+    }
+    *out_idle  = idle;
+    *out_total = total;
 }
 
 /*
- * sched_add - Adds a thread to the scheduler's ready queue
+ * sched_latency_histogram - Run queue latency counts summed over all CPUs, out holds SCHED_LAT_BUCKETS entries
+ *
+ * Bucket 0 counts waits under 1 us, bucket i waits in [2^(i-1), 2^i) us, the
+ * last bucket everything longer.
+ */
+void sched_latency_histogram(uint64_t* out) {
+    for (uint32_t b = 0; b < SCHED_LAT_BUCKETS; b++) out[b] = 0;
+    for (uint32_t i = 0; i < smp_cpu_count(); i++)
+        for (uint32_t b = 0; b < SCHED_LAT_BUCKETS; b++)
+            out[b] += rqs[i].lat_hist[b];
+}
+
+/*
+ * sched_dump_stats - Print per thread accounting and the run queue latency histogram to serial
+ */
+void sched_dump_stats(void) {
+    uint64_t idle, total;
+    sched_cpu_usage(&idle, &total);
+
+    LOGF("\n=== Scheduler Statistics ===\n");
+    LOGF("CPUs: %u, busy %lu%%\n", smp_cpu_count(), total ? (total - idle) * 100 / total : 0);
+
+    // The reaper frees threads and processes on other CPUs, hold them still while printing
+    LOGF("\n  PID    TID  NAME                 RUN ms    WAIT ms    VOL   INVOL\n");
+    bool flags = process_list_lock();
+    for (process_t* proc = process_get_all(); proc; proc = proc->next) {
+        for (thread_t* t = proc->threads; t; t = t->next) {
+            LOGF("%5u  %5u  %-18s %8lu  %9lu  %5lu  %6lu\n", proc->pid, t->tid, t->name,
+                 tsc_ticks_to_ns(t->run_tsc) / 1000000, tsc_ticks_to_ns(t->wait_tsc) / 1000000,
+                 t->nvcsw, t->nivcsw);
+        }
+    }
+    process_list_unlock(flags);
+
+    uint64_t hist[SCHED_LAT_BUCKETS];
+    sched_latency_histogram(hist);
+
+    LOGF("\nRun queue latency:\n");
+    for (uint32_t b = 0; b < SCHED_LAT_BUCKETS; b++) {
+        if (!hist[b]) continue;
+        if (b == 0) LOGF("  <1 us          %lu\n", hist[b]);
+        else        LOGF("  <%-8lu us    %lu\n", 1ULL << b, hist[b]);
+    }
+
+    // Eager switching would save and restore on every switch, lazy only on a trap
+    fpu_stats_t fs;
+    fpu_get_stats(&fs);
+    LOGF("\nReaped threads: %lu\n", __atomic_load_n(&reaped, __ATOMIC_RELAXED));
+
+    LOGF("\nFPU (%s, %u bytes): %lu switches, %lu #NM traps, %lu saves, %lu restores\n",
+         fpu_mode_name(), fpu_state_size(), fs.switches, fs.traps, fs.saves, fs.restores);
+}
+
+/*
+ * sched_add - Adds a thread to a ready queue, kicking the owning CPU if it idles
  */
 void sched_add(thread_t* thread) {
     if (!thread) return;
 
     if (thread->state == T_DEAD) {
-        sched_add_dead(thread);
+        thread_t* remote = NULL;
+        sched_add_dead(thread, &remote);
+        sched_add_remote(remote);
         return;
     }
 
-    thread->state = T_READY;
-    thread->rnext = NULL;
+    if (thread->dl_period) dl_wakeup(thread, clock_read_ns());
 
-    if (!rq_head) {
-        rq_head = thread;
-        rq_tail = thread;
-    } else {
-        rq_tail->rnext = thread;
-        rq_tail = thread;
-    }
+    uint32_t target = sched_pick_cpu(thread);
+    sched_cpu_t* rq = &rqs[target];
+
+    bool flags = spinlock_acquire(&rq->lock);
+    rq_push_locked(rq, thread);
+    spinlock_release(&rq->lock, flags);
+
+    // Preempt the target if it runs something less urgent, idle included
+    thread_t* running = cpu_locals[target].thread;
+    if (sched_on && running && sched_preempts(thread, running))
+        smp_send_resched(target);
 }
 
 /*
- * sched_add_sleep - Inserts a thread into the AVL sleep tree
+ * sched_boost - Raise a thread woken by terminal input above the CPU bound crowd
  */
-static void sched_add_sleep(thread_t* thread) {
+void sched_boost(thread_t* thread) {
     if (!thread) return;
-    thread->rnext = NULL;
-    avl_insert(&sleep_tree, &thread->sleep_node);
+    uint8_t base = thread->base_prio;
+    uint8_t boosted = base > SCHED_PRIO_BOOST ? base - SCHED_PRIO_BOOST : 0;
+    if (boosted < thread->prio) thread->prio = boosted;
 }
 
 /*
- * sched_add_dead - Adds a thread to the dead queue to be reaped
+ * sched_set_priority - Set a thread's base level, any pending boost is dropped
  */
-static void sched_add_dead(thread_t* thread) {
-    if (!thread) return;
+bool sched_set_priority(thread_t* thread, uint8_t prio) {
+    if (!thread || prio >= SCHED_PRIO_LEVELS) return false;
 
-    thread->rnext = dead_head;
-    dead_head = thread;
+    // Takes effect at the next enqueue, a queued thread stays on its current level
+    thread->base_prio = prio;
+    thread->prio = prio;
+    return true;
 }
 
 /*
- * sched_drop_proc - Removes all threads belonging to a process from all scheduler queues
+ * sched_set_deadline - Move a thread into the deadline class, or back out with runtime_ns 0
+ *
+ * Needs runtime <= deadline <= period, all in ns. The thread is admitted on
+ * the CPU it runs on if that CPU has the bandwidth, else on the least loaded
+ * one that does. Returns false if no CPU can take it, the thread then keeps
+ * its old parameters. Only call it on the running thread or one that is not
+ * queued, a ready thread would be stranded in the wrong queue.
  */
-void sched_drop_proc(process_t* proc) {
-    if (!proc) return;
+bool sched_set_deadline(thread_t* thread, uint64_t runtime_ns, uint64_t deadline_ns, uint64_t period_ns) {
+    if (!thread) return false;
+    if (runtime_ns && (runtime_ns < SCHED_DL_MIN_NS || runtime_ns > deadline_ns ||
+                       deadline_ns > period_ns || period_ns > SCHED_DL_MAX_NS))
+        return false;
+
+    bool flags = spinlock_acquire(&dl_lock);
+
+    // Give the old reservation back first so a thread can shrink or move its own
+    uint64_t old_bw = thread->dl_period ? (thread->dl_runtime << SCHED_DL_BW_SHIFT) / thread->dl_period : 0;
+    if (old_bw) rqs[thread->dl_cpu].dl_bw -= old_bw;
+
+    if (!runtime_ns) {
+        thread->dl_runtime = 0;
+        thread->dl_deadline = 0;
+        thread->dl_period = 0;
+        spinlock_release(&dl_lock, flags);
+        return true;
+    }
 
-    bool iflag = intr_save();
+    uint64_t bw = (runtime_ns << SCHED_DL_BW_SHIFT) / period_ns;
+    uint32_t n = smp_cpu_count();
+    uint32_t self = this_cpu()->index;
+    uint32_t best = MAX_CPUS;
 
-    thread_t* prev = NULL;
-    thread_t* curr = rq_head;
-    while (curr) {
-        if (curr->process == proc) {
-            if (prev) {
-                prev->rnext = curr->rnext;
-            } else {
-                rq_head = curr->rnext;
-            }
-            if (rq_tail == curr) {
-                rq_tail = prev;
-            }
-            curr = curr->rnext;
-        } else {
-            prev = curr;
-            curr = curr->rnext;
+    if (thread->cpu < n && rqs[thread->cpu].dl_bw + bw <= SCHED_DL_BW_MAX) {
+        best = thread->cpu;
+    } else {
+        for (uint32_t i = 0; i < n; i++) {
+            if ((!cpu_locals[i].online && i != self) || rqs[i].dl_bw + bw > SCHED_DL_BW_MAX) continue;
+            if (best == MAX_CPUS || rqs[i].dl_bw < rqs[best].dl_bw) best = i;
         }
     }
 
-    // Remove from sleep tree
-    avl_node_t* sn = avl_min(&sleep_tree);
-    while (sn) {
-        thread_t* t = AVL_ENTRY(sn, thread_t, sleep_node);
-        avl_node_t* next_sn = avl_next(sn);
-        if (t->process == proc)
-            avl_remove(&sleep_tree, sn);
-        sn = next_sn;
+    if (best == MAX_CPUS) {
+        if (old_bw) rqs[thread->dl_cpu].dl_bw += old_bw;
+        spinlock_release(&dl_lock, flags);
+        return false;
     }
 
-    // Remove from dead queue
-    prev = NULL;
-    curr = dead_head;
-    while (curr) {
-        if (curr->process == proc) {
-            if (prev) {
-                prev->rnext = curr->rnext;
-            } else {
-                dead_head = curr->rnext;
-            }
-            curr = curr->rnext;
-        } else {
-            prev = curr;
-            curr = curr->rnext;
-        }
-    }
+    rqs[best].dl_bw += bw;
+    thread->dl_cpu = best;
+    thread->dl_runtime = runtime_ns;
+    thread->dl_deadline = deadline_ns;
+    thread->dl_period = period_ns;
 
-    intr_restore(iflag);
+    uint64_t now_ns = clock_read_ns();
+    thread->dl_since = now_ns;
+    dl_replenish(thread, now_ns);
+
+    spinlock_release(&dl_lock, flags);
+    return true;
 }
 
 /*
- * sched_schedule - Picks the next thread to run and performs context switch
+ * sched_drop_proc - Removes all threads belonging to a process from all scheduler queues
  */
-cpu_context_t* sched_schedule(cpu_context_t* ctx) {
-    if (!sched_on) return ctx;
-
-    uint64_t now = get_uptime_ms();
+void sched_drop_proc(process_t* proc) {
+    if (!proc) return;
 
-    if (cur) {
-        // Copy the cpu_context_t from wherever ISR.S built it into the embedded field in the thread struct
-        // From this point the kstack is no longer referenced by any live pointer, so thread_destroy may free it freely.
-        cur->context = *ctx;
-        cur->fs_base = read_msr(MSR_FS_BASE);
+    for (uint32_t i = 0; i < smp_cpu_count(); i++) {
+        sched_cpu_t* rq = &rqs[i];
+        bool flags = spinlock_acquire(&rq->lock);
+
+        thread_t* prev;
+        thread_t* curr;
+        for (uint32_t p = 0; p < SCHED_PRIO_LEVELS; p++) {
+            prev = NULL;
+            curr = rq->heads[p];
+            while (curr) {
+                if (curr->process == proc) {
+                    if (prev) {
+                        prev->rnext = curr->rnext;
+                    } else {
+                        rq->heads[p] = curr->rnext;
+                    }
+                    if (rq->tails[p] == curr) {
+                        rq->tails[p] = prev;
+                    }
+                    rq->nr_ready--;
+                    curr = curr->rnext;
+                } else {
+                    prev = curr;
+                    curr = curr->rnext;
+                }
+            }
+            if (!rq->heads[p]) rq->bitmap &= ~(1u << p);
+        }
 
-        if (cur->state == T_RUNNING) {
-            cur->state = T_READY;
-            if (cur != idle) {
-                sched_add(cur);
+        // Remove from deadline queue
+        avl_node_t* dn = avl_min(&rq->dl_tree);
+        while (dn) {
+            thread_t* t = AVL_ENTRY(dn, thread_t, dl_node);
+            avl_node_t* next_dn = avl_next(dn);
+            if (t->process == proc) {
+                avl_remove(&rq->dl_tree, dn);
+                rq->nr_dl--;
+                rq->nr_ready--;
             }
-        } else if (cur->state == T_SLEEPING) {
-            sched_add_sleep(cur);
-        } else if (cur->state == T_DEAD) {
-            sched_add_dead(cur);
+            dn = next_dn;
         }
+
+        // Remove from sleep tree
+        avl_node_t* sn = avl_min(&rq->sleep_tree);
+        while (sn) {
+            thread_t* t = AVL_ENTRY(sn, thread_t, sleep_node);
+            avl_node_t* next_sn = avl_next(sn);
+            if (t->process == proc)
+                avl_remove(&rq->sleep_tree, sn);
+            sn = next_sn;
+        }
+
+        // Nothing to do for the dead list, the process only goes once its last thread was reaped
+
+        spinlock_release(&rq->lock, flags);
     }
+}
 
-    // Check the sleep tree for any threads that need to be woken up
-    avl_node_t* sn = avl_min(&sleep_tree);
+/*
+ * sched_wake_locked - Moves every sleeper whose TSC deadline passed back to a queue, rq->lock held
+ */
+static void sched_wake_locked(sched_cpu_t* rq, uint32_t self, uint64_t now_tsc, uint64_t now_ns, thread_t** remote) {
+    avl_node_t* sn = avl_min(&rq->sleep_tree);
     while (sn) {
         thread_t* sleeper = AVL_ENTRY(sn, thread_t, sleep_node);
-        if (sleeper->wake_at > now) break;
+        if (sleeper->wake_at > now_tsc) break;
         avl_node_t* next_sn = avl_next(sn);
-        avl_remove(&sleep_tree, sn);
-        sched_add(sleeper);
-        sn = next_sn;
-    }
+        avl_remove(&rq->sleep_tree, sn);
 
-    process_t* old_proc = cur ? cur->process : NULL;
+        // A throttled thread got its new job when it was parked
+        if (sleeper->dl_throttled) sleeper->dl_throttled = false;
+        else if (sleeper->dl_period) dl_wakeup(sleeper, now_ns);
 
-    // If there are no ready threads, run the idle thread
-    while (dead_head) {
-        thread_t* thread = dead_head;
-        dead_head = thread->rnext;
+        rq_requeue_locked(rq, self, sleeper, remote);
+        sn = next_sn;
+    }
+}
 
-        process_t* proc = thread->process;
+/*
+ * sched_put_prev_locked - Accounts the outgoing thread and files it by state, rq->lock held
+ *
+ * The caller has already saved its registers, or is about to in sched_switch.
+ */
+static void sched_put_prev_locked(sched_cpu_t* rq, uint32_t self, thread_t* cur, uint64_t now_tsc, uint64_t now_ns, thread_t** remote) {
+    // Voluntary if it gave the CPU up itself, involuntary if a tick or a better thread took it
+    cur->run_tsc += now_tsc - cur->acct_stamp;
+    if (cur->sys_stamp) {
+        cur->sys_tsc += now_tsc - cur->sys_stamp;
+        cur->sys_stamp = now_tsc;
+    }
+    if (cur->state == T_RUNNING && !cur->yielded) cur->nivcsw++;
+    else cur->nvcsw++;
+
+    // Another CPU may pick this thread up next, its FPU state cannot stay in our registers
+    if (rq->fpu_owner == cur && smp_cpu_count() > 1) {
+        __asm__ volatile("clts" ::: "memory");
+        fpu_save(cur->fpu);
+        rq->fpu_owner = NULL;
+    }
 
-        if (proc) {
-            if (proc->threads == thread) {
-                proc->threads = thread->next;
+    if (cur->state == T_RUNNING) {
+        cur->state = T_READY;
+        if (cur->dl_period) {
+            // Out of budget, or yielded to end the job early
+            if (cur->dl_budget <= 0 || cur->yielded) {
+                if (cur->yielded && now_ns > cur->dl_abs) cur->dl_misses++;
+                if (!dl_throttle(rq, cur, now_ns)) rq_requeue_locked(rq, self, cur, remote);
             } else {
-                thread_t* curr = proc->threads;
-                while (curr && curr->next != thread) {
-                    curr = curr->next;
-                }
-                if (curr) {
-                    curr->next = thread->next;
-                }
+                rq_requeue_locked(rq, self, cur, remote);
             }
+        } else if (cur != rq->idle) {
+            // Burnt a whole slice, step back towards the base level
+            if (!cur->yielded && cur->prio < cur->base_prio) cur->prio++;
+            rq_push_locked(rq, cur);
         }
-
-        if (thread == cur) {
-            cur = NULL;
-        }
-        if (thread == fpu_owner) {
-            fpu_owner = NULL;
-        }
-
-        thread_destroy(thread);
-
-        // We protect PID 1 (Idle) and PID 2 (Kernel Main)
-        if (proc && proc->threads == NULL && proc->pid > 2) {
-            if (proc == old_proc) {
-                old_proc = NULL;
-            }
-            if (proc->tty) {
-                char term_msg[128];
-                int len = ksnprintf(term_msg, sizeof(term_msg),
-                                   "\n[Process %s (PID %u) has terminated]\n",
-                                   proc->name, proc->pid);
-                tty_write(proc->tty, term_msg, (size_t)len);
-            }
-            process_destroy(proc);
-        }
+    } else if (cur->state == T_SLEEPING) {
+        sched_add_sleep(rq, cur);
+    } else if (cur->state == T_DEAD) {
+        sched_add_dead(cur, remote);
     }
 
+    cur->yielded = false;
+}
+
+/*
+ * sched_pick_next - Picks the next thread and loads its CPU wide state: address space, timer, TSS, FS_BASE
+ *
+ * cur is the outgoing thread, or NULL. It may come back when nothing else is ready.
+ */
+static thread_t* sched_pick_next(cpu_local_t* cpu, sched_cpu_t* rq, thread_t* cur, process_t* old_proc, uint64_t now) {
+    // If there are no ready threads, run the idle thread
     thread_t* nxt = NULL;
-    while (rq_head) {
-        nxt = rq_head;
-        rq_head = nxt->rnext;
-        if (!rq_head) {
-            rq_tail = NULL;
-        }
-        nxt->rnext = NULL;
+    while (!nxt) {
+        bool flags = spinlock_acquire(&rq->lock);
+        nxt = rq_pop_locked(rq);
+        spinlock_release(&rq->lock, flags);
+
+        if (!nxt) nxt = sched_steal(cpu->index);
+        if (!nxt) break;
 
         if (nxt->state == T_DEAD) {
-            sched_add_dead(nxt);
+            thread_t* remote = NULL;
+            sched_add_dead(nxt, &remote);
+            sched_add_remote(remote);
             nxt = NULL;
-        } else {
-            break;
         }
     }
 
     if (!nxt) {
-        nxt = idle;
+        nxt = rq->idle;
     }
 
+    // Waited past its deadline behind earlier ones, start the budget clock either way
+    if (nxt->dl_period) {
+        uint64_t pick_ns = clock_read_ns();
+        dl_check_miss(nxt, pick_ns);
+        nxt->dl_since = pick_ns;
+    }
+
+    // A direct yield keeps cur marked on_cpu until sched_switch leaves its stack, so
+    // spinning on another thread here could close a cycle with a CPU spinning on cur.
+    // Queue it again and let the idle thread wait, nothing ever waits on an idle thread
+    if (cur && cur != rq->idle && nxt != cur && __atomic_load_n(&nxt->on_cpu, __ATOMIC_ACQUIRE)) {
+        bool flags = spinlock_acquire(&rq->lock);
+        rq_push_locked(rq, nxt);
+        spinlock_release(&rq->lock, flags);
+        nxt = rq->idle;
+    }
+
+    // A woken thread may still be switching out on the CPU it blocked on
+    if (nxt != cur) {
+        while (__atomic_load_n(&nxt->on_cpu, __ATOMIC_ACQUIRE)) {
+            smp_poll();
+            __asm__ volatile("pause");
+        }
+    }
+    nxt->on_cpu = true;
+    nxt->cpu = cpu->index;
+
+    // Time spent queued, the idle thread never is
+    uint64_t pick_tsc = tsc_read();
+    if (nxt != rq->idle) {
+        uint64_t wait = pick_tsc - nxt->acct_stamp;
+        nxt->wait_tsc += wait;
+        rq->lat_hist[sched_lat_bucket(wait)]++;
+    }
+    nxt->acct_stamp = pick_tsc;
+    if (nxt->sys_stamp) nxt->sys_stamp = pick_tsc;
+
+    // Surplus work here while a neighbour idles, let it steal
+    if (rq->nr_ready) sched_kick_idle(cpu->index);
+
     // Only switch VMM if address space actually changed
     if (old_proc != nxt->process) {
         if (nxt->process && nxt->process->vmm) {
@@ -408,80 +1104,257 @@ cpu_context_t* sched_schedule(cpu_context_t* ctx) {
         }
     }
 
-    cur = nxt;
-    cur->state = T_RUNNING;
-
-    ticks_total++;
-    if (cur == idle) ticks_idle++;
+    cpu->thread = nxt;
+    nxt->state = T_RUNNING;
 
-    timer_arm_next(cur == idle);
+    // Deadline threads run until their budget is gone, everything else for its slice
+    uint64_t slice_ns;
+    if (nxt->dl_period) {
+        slice_ns = nxt->dl_budget > 0 ? (uint64_t)nxt->dl_budget : 0;
+    } else {
+        uint64_t quantum = sched_quantum_ms(nxt->prio);
+        nxt->slice_end = now + quantum;
+        slice_ns = quantum * 1000000;
+    }
+    timer_arm_next(nxt == rq->idle, slice_ns);
 
     // fpu_nm_handler will lazily restore state on first use
     set_cr0_ts();
+    fpu_count_switch();
 
-    if (cur->kstack) {
-        uint64_t stack_top = (uint64_t)cur->kstack + KERNEL_STACK_SIZE;
+    if (nxt->kstack) {
+        uint64_t stack_top = (uint64_t)nxt->kstack + KERNEL_STACK_SIZE;
         tss_set_rsp0(stack_top);
 
         // Update local CPU structure for syscall entries
-        cpu_local.kernel_stack = stack_top;
+        cpu->kernel_stack = stack_top;
+    }
+
+    // Kernel threads all run with FS_BASE 0, the MSR write only matters around TLS users
+    if (cpu->fs_base != nxt->fs_base) {
+        write_msr(MSR_FS_BASE, nxt->fs_base);
+        cpu->fs_base = nxt->fs_base;
     }
 
-    write_msr(MSR_FS_BASE, cur->fs_base);
+    return nxt;
+}
 
-    /* 
-    Author's Note: 
-    
-    Return a pointer to the embedded context struct.
-    ISR.S will do "mov rsp, rax" to use it as a staging area 
-    for the pop/iretq sequence, and iretq then restores the real 
-    RSP from context.iret_rsp
-    */
+/*
+ * sched_resume_ctx - Returns the cpu_context_t that resumes nxt through iretq
+ *
+ * A thread that left through sched_switch only has its callee saved registers
+ * on its kernel stack, so the frame sends it to sched_switch_resume to pop them.
+ */
+static cpu_context_t* sched_resume_ctx(thread_t* nxt) {
+    cpu_context_t* next_ctx = &nxt->context;
+
+    if (nxt->ksp) {
+        next_ctx->iret_rip = (uint64_t)sched_switch_resume;
+        next_ctx->iret_cs = KERNEL_CS;
+        next_ctx->iret_ss = KERNEL_DS;
+        next_ctx->iret_rsp = nxt->ksp;
+        next_ctx->iret_flags = 0x2; // IF clear, the yield restores its own flag
+        nxt->ksp = 0;
+        return next_ctx;
+    }
 
-    cpu_context_t *next_ctx = &cur->context;
+#ifndef NDEBUG
     uint16_t cs = (uint16_t)next_ctx->iret_cs;
     uint16_t ss = (uint16_t)next_ctx->iret_ss;
     bool is_user = (cs & 3) == 3;
     if (!is_user && (cs != KERNEL_CS || (ss != 0 && ss != KERNEL_DS)))
-        panicf_c(next_ctx, "sched: corrupt kernel ctx for '%s' (cs=0x%x ss=0x%x)", cur->name, cs, ss);
+        panicf_c(next_ctx, "sched: corrupt kernel ctx for '%s' (cs=0x%x ss=0x%x)", nxt->name, cs, ss);
     if (is_user && (cs != USER_CS || ss != USER_DS))
-        panicf_c(next_ctx, "sched: corrupt user ctx for '%s' (cs=0x%x ss=0x%x)", cur->name, cs, ss);
+        panicf_c(next_ctx, "sched: corrupt user ctx for '%s' (cs=0x%x ss=0x%x)", nxt->name, cs, ss);
+#endif
+
     return next_ctx;
 }
 
+/*
+ * sched_schedule - Picks the next thread to run and performs context switch
+ */
+cpu_context_t* sched_schedule(cpu_context_t* ctx) {
+    if (!sched_on) return ctx;
+
+    cpu_local_t* cpu = this_cpu();
+    sched_cpu_t* rq = &rqs[cpu->index];
+    if (!rq->idle) return ctx;
+
+    uint64_t now_tsc = tsc_read();
+    uint64_t now_ns = clock_read_ns();
+    uint64_t now = now_ns / 1000000;
+    thread_t* cur = cpu->thread;
+    thread_t* remote = NULL;
+
+    bool flags = spinlock_acquire(&rq->lock);
+
+    // Check the sleep tree for any threads that need to be woken up
+    sched_wake_locked(rq, cpu->index, now_tsc, now_ns, &remote);
+
+    // Charge the running deadline thread, a job still going past its deadline is a miss
+    if (cur && cur->dl_period) {
+        dl_charge(cur, now_ns);
+        if (cur->state == T_RUNNING && !cur->yielded) dl_check_miss(cur, now_ns);
+    }
+
+    // Ticks and preemption IPIs inside the slice only switch for a better level
+    if (cur && !remote && sched_keep_running(rq, cur, now_ns)) {
+        spinlock_release(&rq->lock, flags);
+        timer_arm_next(false, cur->dl_period ? (uint64_t)cur->dl_budget : (cur->slice_end - now) * 1000000);
+        return ctx;
+    }
+
+    if (cur) {
+        // Copy the cpu_context_t from wherever ISR.S built it into the embedded field in the thread struct
+        // From this point the kstack is no longer referenced by any live pointer, so thread_destroy may free it freely.
+        cur->context = *ctx;
+        sched_put_prev_locked(rq, cpu->index, cur, now_tsc, now_ns, &remote);
+
+        // Everything this CPU needed from cur is saved, other CPUs may run it now
+        __atomic_store_n(&cur->on_cpu, false, __ATOMIC_RELEASE);
+    }
+
+    spinlock_release(&rq->lock, flags);
+
+    // Deadline threads that woke or ran here but were admitted on another CPU
+    sched_add_remote(remote);
+
+    // An exiting process is only destroyed by the reaper once this CPU is off its address space
+    process_t* old_proc = cur ? cur->process : NULL;
+
+    thread_t* nxt = sched_pick_next(cpu, rq, NULL, old_proc, now);
+
+    /*
+    Author's Note:
+
+    Return a pointer to the embedded context struct.
+    ISR.S will do "mov rsp, rax" to use it as a staging area
+    for the pop/iretq sequence, and iretq then restores the real
+    RSP from context.iret_rsp
+    */
+    return sched_resume_ctx(nxt);
+}
+
+/*
+ * sched_yield_direct - Switches away from the current thread without an interrupt frame
+ *
+ * Runs on the yielding thread's own kernel stack with interrupts disabled.
+ * Returns false when the caller is an interrupt handler on the scheduler
+ * stack, only the ISR path can switch away from there. An exiting thread is
+ * fine, the reaper waits for sched_switch to clear on_cpu before freeing
+ * the stack it leaves.
+ */
+static bool sched_yield_direct(void) {
+    cpu_local_t* cpu = this_cpu();
+    sched_cpu_t* rq = &rqs[cpu->index];
+    thread_t* cur = cpu->thread;
+    if (!rq->idle || !cur) return false;
+
+    uint64_t sp = (uint64_t)__builtin_frame_address(0);
+    if (sp - (cpu->sched_stack_top - KERNEL_STACK_SIZE) < KERNEL_STACK_SIZE) return false;
+
+    uint64_t now_tsc = tsc_read();
+    uint64_t now_ns = clock_read_ns();
+    uint64_t now = now_ns / 1000000;
+    thread_t* remote = NULL;
+
+    bool flags = spinlock_acquire(&rq->lock);
+    sched_wake_locked(rq, cpu->index, now_tsc, now_ns, &remote);
+    if (cur->dl_period) dl_charge(cur, now_ns);
+    sched_put_prev_locked(rq, cpu->index, cur, now_tsc, now_ns, &remote);
+    spinlock_release(&rq->lock, flags);
+
+    sched_add_remote(remote);
+
+    thread_t* nxt = sched_pick_next(cpu, rq, cur, cur->process, now);
+    if (nxt == cur) return true;
+
+    if (nxt->ksp) {
+        uint64_t next_sp = nxt->ksp;
+        nxt->ksp = 0;
+        sched_switch(&cur->ksp, next_sp, NULL, &cur->on_cpu);
+    } else {
+        sched_switch(&cur->ksp, 0, sched_resume_ctx(nxt), &cur->on_cpu);
+    }
+
+    // Back on this thread, possibly on another CPU
+    return true;
+}
+
+/*
+ * sched_set_direct_yield - Routes voluntary yields through sched_switch (default) or int $32
+ */
+void sched_set_direct_yield(bool enable) {
+    direct_yield = enable;
+}
+
 /*
  * sched_yield - Voluntarily gives up the remaining time slice
  */
 void sched_yield(void) {
     if (!sched_on) return;
-    __asm__ volatile("int $32");
+
+    // Without the mark a tick inside the slice would hand the CPU straight back
+    bool iflag = intr_save();
+    thread_t* cur = this_cpu_thread();
+    if (cur) cur->yielded = true;
+
+    if (!direct_yield || !sched_yield_direct())
+        __asm__ volatile("int $32");
+    intr_restore(iflag);
 }
 
 /*
- * sched_current - Returns the currently running thread
+ * sched_current - Returns the thread running on this CPU
  */
 thread_t* sched_current(void) {
-    return cur;
+    return this_cpu_thread();
 }
 
 /*
- * sched_sleep - Puts the current thread to sleep for X ms
+ * sched_acct_enter - Marks a user thread as entering the kernel, from a syscall or an interrupt
  */
-void sched_sleep(uint64_t ms) {
+void sched_acct_enter(thread_t* thread) {
+    if (thread && thread->is_user) thread->sys_stamp = tsc_read();
+}
+
+/*
+ * sched_acct_exit - Marks a user thread as going back to ring 3, folding in its system time
+ */
+void sched_acct_exit(thread_t* thread) {
+    if (!thread || !thread->sys_stamp) return;
+    thread->sys_tsc += tsc_read() - thread->sys_stamp;
+    thread->sys_stamp = 0;
+}
+
+/*
+ * sched_sleep_ns - Puts the current thread to sleep for X ns
+ */
+void sched_sleep_ns(uint64_t ns) {
+    thread_t* cur = sched_current();
     if (!cur || !sched_on) return;
 
     bool iflag = intr_save();
     cur->state = T_SLEEPING;
-    cur->wake_at = get_uptime_ms() + ms;
+    cur->wake_at = tsc_read() + tsc_ns_to_ticks(ns);
 
     sched_yield();
     intr_restore(iflag);
 }
 
+/*
+ * sched_sleep - Puts the current thread to sleep for X ms
+ */
+void sched_sleep(uint64_t ms) {
+    sched_sleep_ns(ms * 1000000);
+}
+
 /*
  * sched_exit - Terminates the current thread
  */
 void sched_exit(void) {
+    thread_t* cur = sched_current();
     if (!cur) return;
 
     bool iflag = intr_save();
@@ -490,6 +1363,13 @@ void sched_exit(void) {
 
     proc_hdr_update(cur->process);
 
+    // Let thread_join() callers recheck
+    process_t* proc = cur->process;
+    if (proc) {
+        __atomic_fetch_add(&proc->exit_seq, 1, __ATOMIC_RELEASE);
+        futex_wake(proc->vmm, &proc->exit_seq, UINT32_MAX);
+    }
+
     sched_yield();
 
     // the scheduler will never reschedule a T_DEAD thread
@@ -1,5 +1,5 @@
 /*
- * scheduler.h - Round-Robin Scheduler interface
+ * scheduler.h - Priority Round-Robin Scheduler interface
  *
  * This file defines the interface for the GatOS task scheduler.
  * It manages the execution of threads across the system.
@@ -12,14 +12,40 @@
 #include <kernel/sys/process.h>
 #include <arch/x86_64/cpu/interrupts.h>
 
+// Priority levels, 0 is the most urgent. One bit per level in the run queue bitmap
+#define SCHED_PRIO_LEVELS   32
+#define SCHED_PRIO_DEFAULT  16
+#define SCHED_PRIO_USER_MAX 8                   // Best level userspace may ask for
+#define SCHED_PRIO_BOOST    8                   // Levels gained when woken by TTY input
+#define SCHED_PRIO_IDLE     SCHED_PRIO_LEVELS   // Idle threads, never queued
+
+// Run queue latency histogram, power of two buckets in us, see sched_latency_histogram()
+#define SCHED_LAT_BUCKETS   24
+
+// Deadline class, runs ahead of every priority level in earliest deadline order
+#define SCHED_DL_MIN_NS     100000ULL           // Shortest runtime, 100 us
+#define SCHED_DL_MAX_NS     1000000000ULL       // Longest period, 1 s
+#define SCHED_DL_BW_SHIFT   20                  // Bandwidth is runtime / period in 1.20 fixed point
+#define SCHED_DL_BW_MAX     ((1ULL << SCHED_DL_BW_SHIFT) * 90 / 100) // Per CPU cap, the rest stays with normal threads
+
 void sched_init(void);
+void sched_init_ap(void);
 void sched_add(thread_t* thread);
 cpu_context_t* sched_schedule(cpu_context_t* current_context);
 void sched_yield(void);
+void sched_set_direct_yield(bool enable);
 thread_t* sched_current(void);
+void sched_acct_enter(thread_t* thread);
+void sched_acct_exit(thread_t* thread);
 void sched_sleep(uint64_t ms);
+void sched_sleep_ns(uint64_t ns);
 void sched_exit(void);
 bool sched_active(void);
 void sched_drop_proc(process_t* proc);
 uint64_t sched_next_wake(void);
 void sched_cpu_usage(uint64_t *out_idle, uint64_t *out_total);
+void sched_latency_histogram(uint64_t* out);
+void sched_dump_stats(void);
+void sched_boost(thread_t* thread);
+bool sched_set_priority(thread_t* thread, uint8_t prio);
+bool sched_set_deadline(thread_t* thread, uint64_t runtime_ns, uint64_t deadline_ns, uint64_t period_ns);
@@ -0,0 +1,346 @@
+/*
+ * smp.c - Symmetric multiprocessing bring-up and cross CPU requests
+ *
+ * APs are started one at a time, the BSP busy waits on the TSC until the AP
+ * reports online, so the shared trampoline slots only ever describe one AP.
+ * An AP that misses the timeout ends bring-up: its slots and cpu_local stay
+ * as they are, and if it wakes late it finds the slot given up and parks.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#include <kernel/sys/smp.h>
+#include <kernel/sys/scheduler.h>
+#include <kernel/sys/spinlock.h>
+#include <kernel/sys/syscall.h>
+#include <kernel/sys/timers.h>
+#include <kernel/sys/acpi.h>
+#include <kernel/sys/apic.h>
+#include <kernel/memory/heap.h>
+#include <kernel/memory/vmm.h>
+#include <arch/x86_64/cpu/interrupts.h>
+#include <arch/x86_64/cpu/gdt.h>
+#include <arch/x86_64/cpu/msr.h>
+#include <arch/x86_64/memory/paging.h>
+#include <kernel/debug.h>
+#include <klibc/string.h>
+
+// Linker visible labels of the trampoline image, see ap_trampoline.S
+extern uint8_t ap_trampoline_start[];
+extern uint8_t ap_trampoline_end[];
+extern uint8_t ap_tramp_pml4[];
+extern uint8_t ap_tramp_efer[];
+extern uint8_t ap_tramp_stack[];
+extern uint8_t ap_tramp_cpu[];
+extern uint8_t ap_tramp_entry[];
+
+#define TRAMP_SLOT(sym) \
+    (*(volatile uint64_t*)(PHYSMAP_P2V(AP_TRAMPOLINE_PHYS) + (uint64_t)((sym) - ap_trampoline_start)))
+
+#define AP_START_TIMEOUT_US 100000
+
+static volatile uint32_t cpus_online = 1;
+
+// Who owns the AP being started, the AP claims it on entry or the BSP gives up on it
+enum { AP_WAITING, AP_CLAIMED, AP_ABANDONED };
+static volatile uint32_t ap_claim = AP_WAITING;
+
+// One shootdown in flight at a time, the address is stable while tlb_lock is held
+static spinlock_t tlb_lock;
+static void* volatile tlb_addr = NULL;
+
+#pragma region Cross CPU Requests
+
+/*
+ * smp_tlb_service - Drop this CPU's translation for the pending shootdown address
+ */
+static void smp_tlb_service(cpu_local_t* cpu) {
+    invlpg(tlb_addr);
+    __atomic_store_n(&cpu->tlb_pending, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * smp_tlb_handler - INT_IPI_TLB_SHOOTDOWN handler
+ */
+static cpu_context_t* smp_tlb_handler(cpu_context_t* ctx) {
+    cpu_local_t* cpu = this_cpu();
+    if (__atomic_load_n(&cpu->tlb_pending, __ATOMIC_ACQUIRE))
+        smp_tlb_service(cpu);
+    return ctx;
+}
+
+/*
+ * smp_poll - Serve a pending shootdown, called from spin loops that run with IF=0
+ *
+ * A CPU spinning on a lock with interrupts off never takes the IPI, and the
+ * lock holder may be the one waiting for our acknowledgement.
+ */
+void smp_poll(void) {
+    if (cpus_online <= 1) return;
+
+    cpu_local_t* cpu = this_cpu();
+    if (__atomic_load_n(&cpu->tlb_pending, __ATOMIC_ACQUIRE))
+        smp_tlb_service(cpu);
+}
+
+/*
+ * smp_send_resched - Ask a CPU to run its scheduler, a self IPI fires once the current handler returns
+ */
+void smp_send_resched(uint32_t index) {
+    if (index >= cpus_online) return;
+
+    // The ICR is written in two halves, an IRQ sending its own IPI in between would retarget ours
+    bool iflag = intr_save();
+    lapic_send_ipi(cpu_locals[index].lapic_id, INT_IPI_RESCHEDULE);
+    intr_restore(iflag);
+}
+
+/*
+ * smp_tlb_flush - Invalidate virt on every other CPU that may cache it
+ *
+ * Kernel half addresses are flushed everywhere, user addresses only on CPUs
+ * that currently run on pt_root. vmm_switch() publishes the new address space
+ * before loading CR3, so a CPU skipped here reloads CR3 after the PTE store
+ * and cannot hold a stale entry. The caller already invalidated locally.
+ */
+void smp_tlb_flush(uint64_t pt_root, void* virt) {
+    uint32_t n = cpus_online;
+    if (n <= 1) return;
+
+    bool kernel_half = (uint64_t)virt >= PHYSMAP_VIRTUAL_BASE;
+    bool flags = spinlock_acquire(&tlb_lock);
+
+    cpu_local_t* self = this_cpu();
+    tlb_addr = virt;
+
+    // The PTE store must be visible before a target can observe the request
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    uint32_t sent = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        cpu_local_t* c = &cpu_locals[i];
+        if (c == self || !c->online) continue;
+        if (!kernel_half && (!c->vmm || ((vmm_t*)c->vmm)->pt_root != pt_root)) continue;
+
+        __atomic_store_n(&c->tlb_pending, 1, __ATOMIC_RELEASE);
+        lapic_send_ipi(c->lapic_id, INT_IPI_TLB_SHOOTDOWN);
+        sent++;
+    }
+
+    if (sent) {
+        for (uint32_t i = 0; i < n; i++) {
+            cpu_local_t* c = &cpu_locals[i];
+            while (__atomic_load_n(&c->tlb_pending, __ATOMIC_ACQUIRE))
+                __asm__ volatile("pause");
+        }
+    }
+
+    spinlock_release(&tlb_lock, flags);
+}
+
+#pragma endregion
+
+#pragma region Topology
+
+/*
+ * smp_cpu_count - Number of CPUs that completed bring-up, the BSP included
+ */
+uint32_t smp_cpu_count(void) {
+    return cpus_online;
+}
+
+/*
+ * smp_cpu - CPU local block by dense index
+ */
+cpu_local_t* smp_cpu(uint32_t index) {
+    return index < MAX_CPUS ? &cpu_locals[index] : NULL;
+}
+
+#pragma endregion
+
+#pragma region AP Bring-up
+
+/*
+ * smp_ap_main - First C code on an AP, called by the trampoline on its boot stack
+ */
+static void smp_ap_main(cpu_local_t* cpu) {
+    uint32_t index = cpu->index;
+
+    // Woke after the BSP timed out, the CPU was never counted, stay out of everything
+    uint32_t waiting = AP_WAITING;
+    if (!__atomic_compare_exchange_n(&ap_claim, &waiting, AP_CLAIMED, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        while (1) __asm__ volatile("cli; hlt");
+    }
+
+    // GS first, contended spinlocks reach smp_poll() and this_cpu()
+    cpu_init_ap(index);
+    gdt_init_cpu(index);
+    load_idt((void*)idt);
+
+    // Leave the trampoline tables for the real kernel PML4
+    vmm_switch(NULL);
+
+    lapic_init();
+    syscall_init();
+    timer_init_ap();
+    sched_init_ap();
+
+    __atomic_store_n(&cpu->online, 1, __ATOMIC_RELEASE);
+
+    // Shootdowns only target counted CPUs, flush whatever we cached before that
+    while (__atomic_load_n(&cpus_online, __ATOMIC_ACQUIRE) <= index)
+        __asm__ volatile("pause");
+    flush_tlb();
+
+    LOGF("[SMP] CPU %u (LAPIC %u) online\n", index, cpu->lapic_id);
+
+    // The boot stack is abandoned here, there is no thread to save it into
+    intr_on();
+    sched_yield();
+
+    while (1) __asm__ volatile("hlt");
+}
+
+/*
+ * smp_prepare_trampoline - Copy the trampoline below 1 MiB and build its page tables
+ */
+static bool smp_prepare_trampoline(void) {
+    size_t len = (size_t)(ap_trampoline_end - ap_trampoline_start);
+    if (len > PAGE_SIZE) {
+        LOGF("[SMP] Trampoline too large (%zu bytes)\n", len);
+        return false;
+    }
+
+    uint8_t* tramp = (uint8_t*)PHYSMAP_P2V(AP_TRAMPOLINE_PHYS);
+    kmemcpy(tramp, ap_trampoline_start, len);
+
+    uint64_t pml4_phys = AP_TRAMPOLINE_PHYS + PAGE_SIZE;
+    uint64_t pdpt_phys = AP_TRAMPOLINE_PHYS + 2 * PAGE_SIZE;
+    uint64_t pd_phys   = AP_TRAMPOLINE_PHYS + 3 * PAGE_SIZE;
+
+    uint64_t* pml4 = (uint64_t*)PHYSMAP_P2V(pml4_phys);
+    uint64_t* pdpt = (uint64_t*)PHYSMAP_P2V(pdpt_phys);
+    uint64_t* pd   = (uint64_t*)PHYSMAP_P2V(pd_phys);
+
+    kmemset(pml4, 0, PAGE_SIZE);
+    kmemset(pdpt, 0, PAGE_SIZE);
+    kmemset(pd, 0, PAGE_SIZE);
+
+    // Identity map the first 2 MiB so the trampoline survives turning paging on
+    pml4[0] = pdpt_phys | PAGE_PRESENT | PAGE_WRITABLE;
+    pdpt[0] = pd_phys | PAGE_PRESENT | PAGE_WRITABLE;
+    pd[0]   = PAGE_PRESENT | PAGE_WRITABLE | PAGE_HUGE;
+
+    // Share the kernel half, the AP jumps to smp_ap_main through it
+    uint64_t* kpml4 = (uint64_t*)PHYSMAP_P2V(vmm_kernel_get()->pt_root);
+    for (size_t i = 256; i < 512; i++) pml4[i] = kpml4[i];
+
+    // CR3 is loaded from 32-bit code, the tables must sit below 4 GiB, as they do
+    TRAMP_SLOT(ap_tramp_pml4) = pml4_phys;
+    TRAMP_SLOT(ap_tramp_efer) = read_msr(MSR_EFER) & ~(uint64_t)EFER_LMA;
+    TRAMP_SLOT(ap_tramp_entry) = (uint64_t)smp_ap_main;
+
+    return true;
+}
+
+/*
+ * smp_start_ap - INIT-SIPI-SIPI one AP and wait for it to come online
+ */
+static bool smp_start_ap(uint32_t index, uint32_t apic_id) {
+    void* stack = kmalloc(KERNEL_STACK_SIZE);
+    if (!stack) {
+        LOGF("[SMP] No boot stack for LAPIC %u\n", apic_id);
+        return false;
+    }
+
+    cpu_local_t* cpu = &cpu_locals[index];
+    kmemset(cpu, 0, sizeof(*cpu));
+    cpu->index = index;
+    cpu->lapic_id = apic_id;
+
+    TRAMP_SLOT(ap_tramp_stack) = (uint64_t)stack + KERNEL_STACK_SIZE;
+    TRAMP_SLOT(ap_tramp_cpu) = (uint64_t)cpu;
+    ap_claim = AP_WAITING;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    // Intel SDM 8.4.4.1: INIT, 10ms, SIPI, 200us, SIPI
+    lapic_send_init(apic_id);
+    sleep_us(10000);
+
+    for (int i = 0; i < 2 && !__atomic_load_n(&cpu->online, __ATOMIC_ACQUIRE); i++) {
+        lapic_send_sipi(apic_id, AP_TRAMPOLINE_PHYS);
+        sleep_us(200);
+    }
+
+    for (uint32_t waited = 0; waited < AP_START_TIMEOUT_US; waited += 100) {
+        if (__atomic_load_n(&cpu->online, __ATOMIC_ACQUIRE)) break;
+        sleep_us(100);
+    }
+
+    if (!__atomic_load_n(&cpu->online, __ATOMIC_ACQUIRE)) {
+        // The AP may still wake up later and run off the trampoline, keep the stack
+        uint32_t waiting = AP_WAITING;
+        if (__atomic_compare_exchange_n(&ap_claim, &waiting, AP_ABANDONED, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            LOGF("[SMP] LAPIC %u did not come online\n", apic_id);
+            return false;
+        }
+
+        // It claimed the slot just now, the rest of its bring-up is short
+        while (!__atomic_load_n(&cpu->online, __ATOMIC_ACQUIRE))
+            __asm__ volatile("pause");
+    }
+
+    __atomic_store_n(&cpus_online, index + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+#pragma endregion
+
+#pragma region Initialization
+
+/*
+ * smp_init - Start every enabled AP from the MADT, runs on the BSP after sched_init()
+ */
+void smp_init(void) {
+    cpu_local_t* bsp = this_cpu();
+    bsp->lapic_id = lapic_get_id();
+    bsp->online = 1;
+
+    // INT_IPI_RESCHEDULE belongs to the scheduler, it preempts locally as well
+    spinlock_init(&tlb_lock, "tlb_shootdown");
+    irq_register(INT_IPI_TLB_SHOOTDOWN, smp_tlb_handler);
+
+    MADTHeader* madt = (MADTHeader*)acpi_find_table("APIC");
+    if (!madt) {
+        LOGF("[SMP] No MADT, running on the BSP only\n");
+        return;
+    }
+
+    if (!smp_prepare_trampoline()) return;
+
+    uint32_t seen = 1;
+    bool stalled = false;
+    uint8_t* start = (uint8_t*)(madt + 1);
+    uint8_t* end = (uint8_t*)madt + madt->header.Length;
+
+    while (start < end) {
+        MADTRecordHeader* header = (MADTRecordHeader*)start;
+        start += header->length;
+
+        if (header->type != MADT_TYPE_LAPIC) continue;
+
+        MADT_LAPIC* rec = (MADT_LAPIC*)header;
+        if (!(rec->flags & 1) || rec->apic_id == bsp->lapic_id) continue;
+        seen++;
+
+        // After a failure the trampoline and that index stay with the missing AP
+        if (stalled || cpus_online >= MAX_CPUS) continue;
+        stalled = !smp_start_ap(cpus_online, rec->apic_id);
+    }
+
+    LOGF("[SMP] %u of %u CPUs online\n", cpus_online, seen);
+}
+
+#pragma endregion
@@ -0,0 +1,31 @@
+/*
+ * smp.h - Symmetric multiprocessing bring-up and cross CPU requests
+ *
+ * The BSP starts every enabled LAPIC listed in the MADT with INIT-SIPI-SIPI
+ * through the real mode trampoline in ap_trampoline.S. Each AP builds its own
+ * GDT/TSS, CPU local block, LAPIC timer and idle thread, then joins the
+ * scheduler. Cross CPU work is limited to reschedule kicks and TLB shootdowns.
+ *
+ * Init order: ACPI → APIC → timers → syscalls → process → scheduler → SMP.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <arch/x86_64/cpu/cpu.h>
+
+void smp_init(void);
+
+// Topology
+uint32_t smp_cpu_count(void);
+cpu_local_t* smp_cpu(uint32_t index);
+
+// Cross CPU requests
+void smp_send_resched(uint32_t index);
+void smp_tlb_flush(uint64_t pt_root, void* virt);
+
+// Serve pending requests while spinning with interrupts disabled
+void smp_poll(void);
@@ -11,6 +11,7 @@
 #include <kernel/sys/spinlock.h>
 #include <arch/x86_64/cpu/interrupts.h>
 #include <kernel/sys/apic.h>
+#include <kernel/sys/smp.h>
 #include <kernel/debug.h>
 
 /*
@@ -30,6 +31,8 @@ bool spinlock_acquire(spinlock_t* lock) {
 
     // this is built in as of C11 I believe
     while (__atomic_test_and_set(&lock->locked, __ATOMIC_ACQUIRE)) {
+        // The holder may be waiting on our TLB shootdown ack, IF is off here
+        smp_poll();
         __asm__ volatile("pause");
     }
 
@@ -2,7 +2,11 @@
  * syscall.c - Syscall initialization and dispatching
  *
  * Configures the MSRs for the syscall/sysret instructions and
- * dispatches syscalls from userspace.
+ * dispatches syscalls from userspace through a table of handlers.
+ *
+ * Every call is counted per CPU with its latency in TSC cycles, blocking
+ * included, in a log2 histogram, and per process. With tracing on, each
+ * call also lands in a ring buffer with its arguments and result.
  *
  * Author: u/ApparentlyPlus
  */
@@ -11,8 +15,13 @@
 #include <arch/x86_64/cpu/cpu.h>
 #include <arch/x86_64/cpu/gdt.h>
 #include <arch/x86_64/cpu/msr.h>
+#include <arch/x86_64/cpu/usercopy.h>
 #include <kernel/sys/scheduler.h>
 #include <kernel/sys/process.h>
+#include <kernel/sys/futex.h>
+#include <kernel/sys/uring.h>
+#include <kernel/sys/timers.h>
+#include <kernel/sys/smp.h>
 #include <klibc/stdio.h>
 #include <kernel/memory/vmm.h>
 #include <kernel/drivers/tty.h>
@@ -22,6 +31,17 @@
 
 extern void syscall_entry(void);
 
+typedef struct {
+    syscall_stat_t calls[SYSCALL_TABLE_SIZE];
+} syscall_cpu_stats_t;
+
+static syscall_cpu_stats_t cpu_stats[MAX_CPUS];
+
+static volatile bool trace_on = false;
+static spinlock_t trace_lock;
+static syscall_trace_t trace_ring[SYSCALL_TRACE_SIZE];
+static uint64_t trace_head = 0;     // Records ever written, the ring holds the last SYSCALL_TRACE_SIZE
+
 void syscall_init(void) {
     uint64_t efer = read_msr(MSR_EFER);
     efer |= EFER_SCE; 
@@ -49,213 +69,730 @@ void syscall_init(void) {
     // FMASK MSR - RFLAGS to clear on syscall. We clear IF (bit 9), DF (bit 10).
     write_msr(MSR_FMASK, 0x200 | 0x400);
 
+    spinlock_init(&trace_lock, "syscall_trace");
+
     LOGF("[SYSCALL] Syscall interface initialized.\n");
 }
 
+#pragma region Handlers
+
+static void sys_exit(cpu_context_t* regs, thread_t* current) {
+    (void)regs; (void)current;
+    sched_exit();
+}
+
 /*
- * syscall_dispatcher - Called from syscall_entry.S with a pointer to
- * the full cpu_context_t built on the per-thread kernel stack
+ * syscall_from_user - True if regs came in through the syscall instruction rather than syscall_invoke()
  */
-void syscall_dispatcher(cpu_context_t* regs) {
-    thread_t* current = sched_current();
-    if (!current) return;
+static inline bool syscall_from_user(const cpu_context_t* regs) {
+    return (regs->iret_cs & 3) == 3;
+}
 
-    uint64_t syscall_num = regs->rax;
+/*
+ * write_user - Feeds len bytes at user address buf to tty, returns how many made it
+ *
+ * The copy survives the buffer being unmapped under it, so nothing needs interrupts
+ * off. Chunks go through the stack, a write of any length allocates nothing.
+ */
+static size_t write_user(tty_t* tty, const char* buf, size_t len) {
+    char chunk[SYSCALL_IO_CHUNK];
+    size_t done = 0;
 
-    switch (syscall_num) {
-        case SYS_EXIT:
-            sched_exit();
-            break;
-            
-        case SYS_WRITE: {
-            const char* buf = (const char*)regs->rdi;
-            size_t len = (size_t)regs->rsi;
-
-            if (!buf || len == 0) {
-                regs->rax = (uint64_t)-1;
-                break;
-            }
-
-            if (len > 65536) len = 65536;
-            char* kbuf = kmalloc(len);
-            if (!kbuf) {
-                regs->rax = (uint64_t)-1;
-                break;
-            }
-
-            // Validate the user buffer before copying. We need to disable interrupts to prevent
-            // a malicious user from changing the buffer after validation and before copying.
-            bool ints = intr_save();
-            if (!vmm_check_buffer(current->process->vmm, buf, len, VM_FLAG_USER)) {
-                intr_restore(ints);
-                kfree(kbuf);
-                LOGF("[SYSCALL] SYS_WRITE: Invalid buffer pointer 0x%lx (len: %zu) from thread '%s' (PID %u)\n", (uintptr_t)buf, len, current->name, current->process ? current->process->pid : 0);
-                sched_exit();
-                break;
-            }
-
-            // Copy the data into the kernel and write to the TTY
-            // We need to allow SMAP here because the user buffer is in a high memory 
-            // region that SMAP would normally prevent us from accessing.
-            smap_allow();
-            kmemcpy(kbuf, buf, len);
-            smap_deny();
-            intr_restore(ints);
-
-            if (current->process && current->process->tty) {
-                tty_write(current->process->tty, kbuf, len);
-            }
-            kfree(kbuf);
-            regs->rax = (uint64_t)len;
+    while (done < len) {
+        size_t n = len - done < sizeof(chunk) ? len - done : sizeof(chunk);
+        size_t left = copy_from_user(chunk, buf + done, n);
+        n -= left;
+        if (n) tty_write(tty, chunk, n);
+        done += n;
+        if (left) break;
+    }
+    return done;
+}
+
+/*
+ * read_user - Reads up to count bytes from tty into user address buf, returns how many or -1
+ *
+ * tty_read() stops at a newline, a read only goes on while chunks come back
+ * full. *more is left true if buf filled up before the line ended.
+ */
+static int64_t read_user(tty_t* tty, char* buf, size_t count, bool* more) {
+    char chunk[SYSCALL_IO_CHUNK];
+    size_t done = 0;
+
+    *more = true;
+    while (done < count) {
+        size_t want = count - done < sizeof(chunk) ? count - done : sizeof(chunk);
+        size_t n = tty_read(tty, chunk, want);
+
+        // Unmapped since the check, what was read is lost with it
+        if (copy_to_user(buf + done, chunk, n)) return -1;
+        done += n;
+        if (n < want || chunk[n - 1] == '\n') {
+            *more = false;
             break;
         }
-            
-        case SYS_MMAP: {
-            void* addr = (void*)regs->rdi;
-            size_t length = (size_t)regs->rsi;
-            size_t vm_flags = (size_t)regs->rdx;
-            
-            // Don't allow userspace to set flags other than these
-            size_t user_allowed_flags = VM_FLAG_WRITE | VM_FLAG_EXEC | VM_FLAG_LAZY;
-            vm_flags &= user_allowed_flags;
-
-            void* out_addr = NULL;
-            vmm_status_t status;
-            
-            if (addr) {
-                status = vmm_alloc_at(current->process->vmm, addr, length, vm_flags | VM_FLAG_USER, NULL, &out_addr);
-            } else {
-                status = vmm_alloc(current->process->vmm, length, vm_flags | VM_FLAG_USER, NULL, &out_addr);
-            }
-            
-            if (status == VMM_OK) {
-                regs->rax = (uint64_t)out_addr;
-            } else {
-                regs->rax = (uint64_t)-1;
-            }
-            break;
+    }
+    return (int64_t)done;
+}
+
+/*
+ * iov_fetch - Copies in and checks a user iovec array, returns the byte total or -1
+ *
+ * Every segment is checked once up front, so a bad one fails the whole call
+ * before anything is written or read.
+ */
+static int64_t iov_fetch(thread_t* current, iovec_t* iov, const iovec_t* uiov, size_t cnt, size_t flags) {
+    if (cnt > SYSCALL_IOV_MAX || copy_from_user(iov, uiov, cnt * sizeof(iovec_t))) return -1;
+
+    size_t total = 0;
+    for (size_t i = 0; i < cnt; i++) {
+        if (!iov[i].iov_len) continue;
+        if (total + iov[i].iov_len < total ||
+            !vmm_check_buffer(current->process->vmm, iov[i].iov_base, iov[i].iov_len, flags)) {
+            LOGF("[SYSCALL] Invalid iovec %zu (0x%lx, len: %zu) from '%s'\n", i, (uintptr_t)iov[i].iov_base,
+                 iov[i].iov_len, current->name);
+            return -1;
         }
-        
-        case SYS_MUNMAP: {
-            void* addr = (void*)regs->rdi;
-            vmm_free(current->process->vmm, addr);
-            regs->rax = 0;
-            break;
+        total += iov[i].iov_len;
+    }
+    return (int64_t)total;
+}
+
+static void sys_write(cpu_context_t* regs, thread_t* current) {
+    const char* buf = (const char*)regs->rdi;
+    size_t len = (size_t)regs->rsi;
+
+    if (!buf || len == 0) {
+        regs->rax = (uint64_t)-1;
+        return;
+    }
+
+    // Ending the caller only makes sense for the thread that passed the buffer, a ring's poller just reports it
+    if (!vmm_check_buffer(current->process->vmm, buf, len, VM_FLAG_USER)) {
+        LOGF("[SYSCALL] SYS_WRITE: Invalid buffer pointer 0x%lx (len: %zu) from thread '%s' (PID %u)\n", (uintptr_t)buf, len, current->name, current->process ? current->process->pid : 0);
+        if (syscall_from_user(regs)) sched_exit();
+        regs->rax = (uint64_t)-1;
+        return;
+    }
+
+    tty_t* tty = current->process->tty;
+    bool ints = intr_enabled();
+    intr_on();
+    tty_write_begin(tty);
+    size_t done = write_user(tty, buf, len);
+    tty_write_end(tty);
+    if (!ints) intr_off();
+
+    regs->rax = done ? (uint64_t)done : (uint64_t)-1;
+}
+
+/*
+ * sys_writev - Writes every segment of an iovec array in order as one write
+ *
+ * All of it lands inside a single console batch, a prefix, a body and a
+ * few escape sequences cost one kernel entry and one flush. A bad segment
+ * fails the call with -1 rather than ending the thread, so rings can
+ * submit it unchecked.
+ */
+static void sys_writev(cpu_context_t* regs, thread_t* current) {
+    const iovec_t* uiov = (const iovec_t*)regs->rdi;
+    size_t cnt = (size_t)regs->rsi;
+    iovec_t iov[SYSCALL_IOV_MAX];
+    size_t done = 0;
+
+    bool ints = intr_enabled();
+    intr_on();
+
+    int64_t total = iov_fetch(current, iov, uiov, cnt, VM_FLAG_USER);
+    if (total > 0) {
+        tty_t* tty = current->process->tty;
+        tty_write_begin(tty);
+        for (size_t i = 0; i < cnt; i++) {
+            size_t n = write_user(tty, iov[i].iov_base, iov[i].iov_len);
+            done += n;
+            if (n < iov[i].iov_len) break;
         }
-        
-        case SYS_YIELD:
-            sched_yield();
-            break;
+        tty_write_end(tty);
+    }
+
+    if (!ints) intr_off();
+
+    // Nothing to write is 0, a segment failing from the very first byte is -1
+    if (total <= 0) regs->rax = (uint64_t)total;
+    else regs->rax = done ? (uint64_t)done : (uint64_t)-1;
+}
 
-        case SYS_SLEEP_MS: {
-            uint64_t ms = regs->rdi;
-            sched_sleep(ms);
+static void sys_mmap(cpu_context_t* regs, thread_t* current) {
+    void* addr = (void*)regs->rdi;
+    size_t length = (size_t)regs->rsi;
+    size_t vm_flags = (size_t)regs->rdx;
+    
+    // Don't allow userspace to set flags other than these
+    size_t user_allowed_flags = VM_FLAG_WRITE | VM_FLAG_EXEC | VM_FLAG_LAZY;
+    vm_flags &= user_allowed_flags;
+
+    void* out_addr = NULL;
+    vmm_status_t status;
+    
+    if (addr) {
+        status = vmm_alloc_at(current->process->vmm, addr, length, vm_flags | VM_FLAG_USER, NULL, &out_addr);
+    } else {
+        status = vmm_alloc(current->process->vmm, length, vm_flags | VM_FLAG_USER, NULL, &out_addr);
+    }
+    
+    if (status == VMM_OK) {
+        regs->rax = (uint64_t)out_addr;
+    } else {
+        regs->rax = (uint64_t)-1;
+    }
+}
+
+static void sys_munmap(cpu_context_t* regs, thread_t* current) {
+    void* addr = (void*)regs->rdi;
+    vmm_free(current->process->vmm, addr);
+    regs->rax = 0;
+}
+
+static void sys_mremap(cpu_context_t* regs, thread_t* current) {
+    void* addr = (void*)regs->rdi;
+    size_t length = (size_t)regs->rsi;
+    bool may_move = (regs->rdx & MREMAP_MAYMOVE) != 0;
+
+    // Only mappings userspace could have created itself may be remapped
+    vm_object* obj = vmm_find_mapped_object(current->process->vmm, addr);
+    if (!obj || obj->base != (uintptr_t)addr || !(obj->flags & VM_FLAG_USER)) {
+        regs->rax = (uint64_t)-1;
+        return;
+    }
+
+    void* out_addr = NULL;
+    vmm_status_t status = vmm_remap(current->process->vmm, addr, length, may_move, &out_addr);
+    regs->rax = (status == VMM_OK) ? (uint64_t)out_addr : (uint64_t)-1;
+}
+
+static void sys_yield(cpu_context_t* regs, thread_t* current) {
+    (void)regs; (void)current;
+    sched_yield();
+}
+
+static void sys_sleep_ms(cpu_context_t* regs, thread_t* current) {
+    (void)current;
+    uint64_t ms = regs->rdi;
+    sched_sleep(ms);
+}
+
+static void sys_nanosleep(cpu_context_t* regs, thread_t* current) {
+    (void)current;
+    uint64_t ns = regs->rdi;
+    sched_sleep_ns(ns);
+}
+
+static void sys_read(cpu_context_t* regs, thread_t* current) {
+    char* buf = (char*)regs->rdi;
+    size_t count = (size_t)regs->rsi;
+
+    if (!buf || count == 0) {
+        regs->rax = (uint64_t)-1;
+        return;
+    }
+
+    if (!vmm_check_buffer(current->process->vmm, buf, count, VM_FLAG_USER | VM_FLAG_WRITE)) {
+        LOGF("[SYSCALL] SYS_READ: invalid buffer 0x%lx (len: %zu) from '%s'\n", (uintptr_t)buf, count, current->name);
+        regs->rax = (uint64_t)-1;
+        return;
+    }
+
+    tty_t* tty = current->process->tty;
+    if (!tty) {
+        regs->rax = (uint64_t)-1;
+        return;
+    }
+
+    bool more;
+    regs->rax = (uint64_t)read_user(tty, buf, count, &more);
+}
+
+/*
+ * sys_readv - Reads one line across the segments of an iovec array, filling them in order
+ *
+ * Moves on to the next segment only while the line keeps going. Returns
+ * the bytes read, or -1 for a bad segment.
+ */
+static void sys_readv(cpu_context_t* regs, thread_t* current) {
+    const iovec_t* uiov = (const iovec_t*)regs->rdi;
+    size_t cnt = (size_t)regs->rsi;
+    tty_t* tty = current->process->tty;
+    iovec_t iov[SYSCALL_IOV_MAX];
+
+    if (!tty) {
+        regs->rax = (uint64_t)-1;
+        return;
+    }
+
+    int64_t total = iov_fetch(current, iov, uiov, cnt, VM_FLAG_USER | VM_FLAG_WRITE);
+    int64_t done = 0;
+    bool more = true;
+
+    for (size_t i = 0; total > 0 && more && i < cnt; i++) {
+        if (!iov[i].iov_len) continue;
+        int64_t n = read_user(tty, iov[i].iov_base, iov[i].iov_len, &more);
+        if (n < 0) {
+            done = -1;
             break;
         }
+        done += n;
+    }
+
+    regs->rax = total < 0 ? (uint64_t)-1 : (uint64_t)done;
+}
 
-        case SYS_READ: {
-            char* buf = (char*)regs->rdi;
-            size_t count = (size_t)regs->rsi;
-
-            if (!buf || count == 0) {
-                regs->rax = (uint64_t)-1;
-                break;
-            }
-
-            // Don't allow reading more than 4096 bytes at once to prevent abuse
-            // The TTY buffer is only 1024 bytes anyway, so this is more than enough
-            if (count > 4096) count = 4096;
-
-            if (!vmm_check_buffer(current->process->vmm, buf, count, VM_FLAG_USER | VM_FLAG_WRITE)) {
-                LOGF("[SYSCALL] SYS_READ: invalid buffer 0x%lx (len: %zu) from '%s'\n", (uintptr_t)buf, count, current->name);
-                regs->rax = (uint64_t)-1;
-                break;
-            }
-
-            tty_t* tty = current->process->tty;
-            if (!tty) {
-                regs->rax = (uint64_t)-1;
-                break;
-            }
-
-            char* kbuf = kmalloc(count);
-            if (!kbuf) {
-                regs->rax = (uint64_t)-1;
-                break;
-            }
-
-            size_t n = tty_read(tty, kbuf, count);
-
-            bool ints = intr_save();
-            if (!vmm_check_buffer(current->process->vmm, buf, n, VM_FLAG_USER | VM_FLAG_WRITE)) {
-                intr_restore(ints);
-                kfree(kbuf);
-                sched_exit();
-                break;
-            }
-
-            smap_allow();
-            kmemcpy(buf, kbuf, n);
-            smap_deny();
-            intr_restore(ints);
-            kfree(kbuf);
-
-            regs->rax = (uint64_t)n;
+static void sys_tty_ctrl(cpu_context_t* regs, thread_t* current) {
+    uint64_t cmd = regs->rdi;
+    uint64_t arg2 = regs->rsi;
+    
+    tty_t* tty = current->process->tty;
+    if (!tty || !tty->console) {
+        regs->rax = (uint64_t)-1;
+        return;
+    }
+    
+    switch (cmd) {
+        case TTY_CTRL_CLEAR:
+            con_clear(tty->console, CONSOLE_COLOR_BLACK);
+            regs->rax = 0;
+            break;
+        case TTY_CTRL_CURSOR: {
+            uint8_t enabled = arg2 & 0xFF;
+            con_enable_cursor(tty->console, enabled);
+            regs->rax = 0;
             break;
         }
-        
-        case SYS_TTY_CTRL: {
-            uint64_t cmd = regs->rdi;
-            uint64_t arg2 = regs->rsi;
-            
-            tty_t* tty = current->process->tty;
-            if (!tty || !tty->console) {
-                regs->rax = (uint64_t)-1;
-                break;
-            }
-            
-            switch (cmd) {
-                case TTY_CTRL_CLEAR:
-                    con_clear(tty->console, CONSOLE_COLOR_BLACK);
-                    regs->rax = 0;
-                    break;
-                case TTY_CTRL_CURSOR: {
-                    uint8_t enabled = arg2 & 0xFF;
-                    con_enable_cursor(tty->console, enabled);
-                    regs->rax = 0;
-                    break;
-                }
-                case TTY_CTRL_GET_DIMS: {
-                    // height in high 32 bits, width in low 32
-                    uint32_t width = (uint32_t)tty->console->width;
-                    uint32_t height = (uint32_t)(tty->console->height - tty->console->header_rows);
-                    regs->rax = ((uint64_t)height << 32) | (uint64_t)width;
-                    break;
-                }
-                default:
-                    regs->rax = (uint64_t)-1;
-                    break;
-            }
+        case TTY_CTRL_GET_DIMS: {
+            // height in high 32 bits, width in low 32
+            uint32_t width = (uint32_t)tty->console->width;
+            uint32_t height = (uint32_t)(tty->console->height - tty->console->header_rows);
+            regs->rax = ((uint64_t)height << 32) | (uint64_t)width;
             break;
         }
-
-        case SYS_SET_FS_BASE: {
-            uint64_t base = regs->rdi;
-            // don't let userspace point FS into kernel memory
-            if (base >= 0x0000800000000000ULL) {
-                regs->rax = (uint64_t)-1;
-                break;
-            }
-            current->fs_base = base;
-            write_msr(MSR_FS_BASE, base);
-            regs->rax = 0;
+        default:
+            regs->rax = (uint64_t)-1;
             break;
+    }
+}
+
+static void sys_set_fs_base(cpu_context_t* regs, thread_t* current) {
+    uint64_t base = regs->rdi;
+    // don't let userspace point FS into kernel memory
+    if (base >= 0x0000800000000000ULL) {
+        regs->rax = (uint64_t)-1;
+        return;
+    }
+    // The scheduler skips the MSR write when the CPU's cached value already matches
+    bool ints = intr_save();
+    current->fs_base = base;
+    this_cpu()->fs_base = base;
+    write_msr(MSR_FS_BASE, base);
+    intr_restore(ints);
+    regs->rax = 0;
+}
+
+static void sys_set_priority(cpu_context_t* regs, thread_t* current) {
+    uint64_t prio = regs->rdi;
+
+    // The top levels are kept for kernel threads and input boosts
+    if (prio < SCHED_PRIO_USER_MAX || prio >= SCHED_PRIO_LEVELS) {
+        regs->rax = (uint64_t)-1;
+        return;
+    }
+
+    uint8_t old = current->base_prio;
+    sched_set_priority(current, (uint8_t)prio);
+    regs->rax = old;
+}
+
+static void sys_sched_deadline(cpu_context_t* regs, thread_t* current) {
+    uint64_t runtime  = regs->rdi;
+    uint64_t deadline = regs->rsi;
+    uint64_t period   = regs->rdx;
+
+    // Admission control decides, a refusal leaves the thread where it was
+    regs->rax = sched_set_deadline(current, runtime, deadline, period) ? 0 : (uint64_t)-1;
+}
+
+static void sys_futex_wait(cpu_context_t* regs, thread_t* current) {
+    volatile uint32_t* addr = (volatile uint32_t*)regs->rdi;
+    uint32_t expected = (uint32_t)regs->rsi;
+    uint64_t timeout_ns = regs->rdx;
+
+    // A user word only, futex_wait() reads it fault safe in case it is unmapped meanwhile
+    vmm_t* vmm = current->process ? current->process->vmm : NULL;
+    if (!vmm || ((uintptr_t)addr & 3) ||
+        !vmm_check_buffer(vmm, (const void*)addr, sizeof(uint32_t), VM_FLAG_USER)) {
+        regs->rax = (uint64_t)-1;
+        return;
+    }
+
+    regs->rax = (uint64_t)(int64_t)futex_wait(vmm, addr, expected, timeout_ns);
+}
+
+static void sys_futex_wake(cpu_context_t* regs, thread_t* current) {
+    volatile uint32_t* addr = (volatile uint32_t*)regs->rdi;
+    uint32_t count = regs->rsi > UINT32_MAX ? UINT32_MAX : (uint32_t)regs->rsi;
+
+    // The word is never touched, an address nobody waits on just wakes no one
+    vmm_t* vmm = current->process ? current->process->vmm : NULL;
+    regs->rax = vmm ? futex_wake(vmm, addr, count) : 0;
+}
+
+static void sys_thread_create(cpu_context_t* regs, thread_t* current) {
+    uintptr_t entry = regs->rdi;
+    void* arg = (void*)regs->rsi;
+    uintptr_t stack_top = regs->rdx;
+
+    // 0 gets a lazily backed USER_STACK_SIZE stack, anything else is the caller's to free
+    if (!entry || entry >= 0x0000800000000000ULL || stack_top >= 0x0000800000000000ULL ||
+        (stack_top & 15)) {
+        regs->rax = (uint64_t)-1;
+        return;
+    }
+
+    // Entered as if called, (%rsp + 8) is 16 byte aligned
+    uintptr_t user_rsp = stack_top ? stack_top - 8 : 0;
+    thread_t* thread = thread_create_user(current->process, "uthread", entry, arg, user_rsp);
+    if (!thread) {
+        regs->rax = (uint64_t)-1;
+        return;
+    }
+
+    // Inherit the creator's level, a boost does not carry over
+    sched_set_priority(thread, current->base_prio);
+    regs->rax = thread->tid;
+    sched_add(thread);
+}
+
+static void sys_thread_join(cpu_context_t* regs, thread_t* current) {
+    regs->rax = (uint64_t)(int64_t)thread_join(current->process, (tid_t)regs->rdi);
+}
+
+static void sys_getrusage(cpu_context_t* regs, thread_t* current) {
+    uint64_t who = regs->rdi;
+    rusage_t* out = (rusage_t*)regs->rsi;
+
+    rusage_t usage;
+    if (who == RUSAGE_SELF) {
+        process_rusage(current->process, &usage);
+    } else if (who == RUSAGE_THREAD) {
+        thread_rusage(current, &usage);
+    } else {
+        regs->rax = (uint64_t)-1;
+        return;
+    }
+
+    // Fault safe, a buffer unmapped or read-only by the time it is written just fails the call
+    regs->rax = copy_to_user(out, &usage, sizeof(usage)) ? (uint64_t)-1 : 0;
+}
+
+static void sys_uring_setup(cpu_context_t* regs, thread_t* current) {
+    regs->rax = (uint64_t)uring_setup(current, (uint32_t)regs->rdi, (uint32_t)regs->rsi);
+}
+
+static void sys_uring_enter(cpu_context_t* regs, thread_t* current) {
+    uint32_t to_submit = regs->rdi > UINT32_MAX ? UINT32_MAX : (uint32_t)regs->rdi;
+    uint32_t min_complete = regs->rsi > UINT32_MAX ? UINT32_MAX : (uint32_t)regs->rsi;
+    regs->rax = (uint64_t)uring_enter(current, to_submit, min_complete, (uint32_t)regs->rdx);
+}
+
+#pragma endregion
+
+#pragma region Table
+
+// Argument kinds in register order rdi, rsi, rdx, the tracer prints by them
+static syscall_desc_t syscall_table[SYSCALL_TABLE_SIZE] = {
+    [SYS_EXIT]           = { "exit",           sys_exit,           0, { 0 } },
+    [SYS_WRITE]          = { "write",          sys_write,          2, { SYSARG_PTR, SYSARG_UINT } },
+    [SYS_MMAP]           = { "mmap",           sys_mmap,           3, { SYSARG_PTR, SYSARG_UINT, SYSARG_HEX } },
+    [SYS_MUNMAP]         = { "munmap",         sys_munmap,         1, { SYSARG_PTR } },
+    [SYS_SET_FS_BASE]    = { "set_fs_base",    sys_set_fs_base,    1, { SYSARG_PTR } },
+    [SYS_YIELD]          = { "yield",          sys_yield,          0, { 0 } },
+    [SYS_SLEEP_MS]       = { "sleep_ms",       sys_sleep_ms,       1, { SYSARG_UINT } },
+    [SYS_READ]           = { "read",           sys_read,           2, { SYSARG_PTR, SYSARG_UINT } },
+    [SYS_TTY_CTRL]       = { "tty_ctrl",       sys_tty_ctrl,       2, { SYSARG_UINT, SYSARG_UINT } },
+    [SYS_MREMAP]         = { "mremap",         sys_mremap,         3, { SYSARG_PTR, SYSARG_UINT, SYSARG_HEX } },
+    [SYS_SET_PRIORITY]   = { "set_priority",   sys_set_priority,   1, { SYSARG_UINT } },
+    [SYS_SCHED_DEADLINE] = { "sched_deadline", sys_sched_deadline, 3, { SYSARG_UINT, SYSARG_UINT, SYSARG_UINT } },
+    [SYS_NANOSLEEP]      = { "nanosleep",      sys_nanosleep,      1, { SYSARG_UINT } },
+    [SYS_FUTEX_WAIT]     = { "futex_wait",     sys_futex_wait,     3, { SYSARG_PTR, SYSARG_UINT, SYSARG_UINT } },
+    [SYS_FUTEX_WAKE]     = { "futex_wake",     sys_futex_wake,     2, { SYSARG_PTR, SYSARG_UINT } },
+    [SYS_THREAD_CREATE]  = { "thread_create",  sys_thread_create,  3, { SYSARG_PTR, SYSARG_PTR, SYSARG_PTR } },
+    [SYS_THREAD_JOIN]    = { "thread_join",    sys_thread_join,    1, { SYSARG_UINT } },
+    [SYS_GETRUSAGE]      = { "getrusage",      sys_getrusage,      2, { SYSARG_UINT, SYSARG_PTR } },
+    [SYS_URING_SETUP]    = { "uring_setup",    sys_uring_setup,    2, { SYSARG_UINT, SYSARG_HEX } },
+    [SYS_URING_ENTER]    = { "uring_enter",    sys_uring_enter,    3, { SYSARG_UINT, SYSARG_UINT, SYSARG_HEX } },
+    [SYS_WRITEV]         = { "writev",         sys_writev,         2, { SYSARG_PTR, SYSARG_UINT } },
+    [SYS_READV]          = { "readv",          sys_readv,          2, { SYSARG_PTR, SYSARG_UINT } },
+};
+
+/*
+ * syscall_register - Installs the handler for syscall nr, false if nr is out of range or taken
+ */
+bool syscall_register(uint32_t nr, const syscall_desc_t* desc) {
+    if (nr >= SYSCALL_TABLE_SIZE || !desc || !desc->fn || desc->nargs > SYSCALL_MAX_ARGS) return false;
+    if (syscall_table[nr].fn) return false;
+    syscall_table[nr] = *desc;
+    return true;
+}
+
+/*
+ * syscall_desc - The table entry for nr, NULL if nothing handles it
+ */
+const syscall_desc_t* syscall_desc(uint32_t nr) {
+    if (nr >= SYSCALL_TABLE_SIZE || !syscall_table[nr].fn) return NULL;
+    return &syscall_table[nr];
+}
+
+#pragma endregion
+
+#pragma region Accounting
+
+/*
+ * syscall_lat_bucket - Histogram bucket for a latency, bucket i holds [2^(i-1), 2^i) cycles
+ */
+static inline uint32_t syscall_lat_bucket(uint64_t cycles) {
+    uint32_t b = cycles ? 64 - __builtin_clzll(cycles) : 0;
+    return b < SYSCALL_LAT_BUCKETS ? b : SYSCALL_LAT_BUCKETS - 1;
+}
+
+/*
+ * syscall_account - Adds one finished call to this CPU's counters and its process's totals
+ */
+static void syscall_account(thread_t* current, uint32_t nr, uint64_t cycles) {
+    bool ints = intr_save();
+    syscall_stat_t* st = &cpu_stats[this_cpu()->index].calls[nr];
+    st->calls++;
+    st->cycles += cycles;
+    if (cycles > st->max_cycles) st->max_cycles = cycles;
+    st->hist[syscall_lat_bucket(cycles)]++;
+    intr_restore(ints);
+
+    process_t* proc = current->process;
+    if (proc) {
+        __atomic_fetch_add(&proc->syscalls, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&proc->syscall_tsc, cycles, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+ * syscall_get_stats - Counters for nr summed over all CPUs
+ */
+void syscall_get_stats(uint32_t nr, syscall_stat_t* out) {
+    kmemset(out, 0, sizeof(*out));
+    if (nr >= SYSCALL_TABLE_SIZE) return;
+
+    for (uint32_t i = 0; i < smp_cpu_count(); i++) {
+        const syscall_stat_t* st = &cpu_stats[i].calls[nr];
+        out->calls += st->calls;
+        out->cycles += st->cycles;
+        if (st->max_cycles > out->max_cycles) out->max_cycles = st->max_cycles;
+        for (uint32_t b = 0; b < SYSCALL_LAT_BUCKETS; b++)
+            out->hist[b] += st->hist[b];
+    }
+}
+
+/*
+ * syscall_percentile - Upper bound in cycles of the bucket holding the pct-th percentile call
+ */
+uint64_t syscall_percentile(const syscall_stat_t* st, uint32_t pct) {
+    if (!st->calls) return 0;
+
+    uint64_t want = (st->calls * pct + 99) / 100, seen = 0;
+    for (uint32_t b = 0; b < SYSCALL_LAT_BUCKETS; b++) {
+        seen += st->hist[b];
+        if (seen >= want) return 1ULL << b;
+    }
+    return st->max_cycles;
+}
+
+/*
+ * syscall_dump_stats - Print per syscall counts and latencies and per process totals to serial
+ */
+void syscall_dump_stats(void) {
+    LOGF("\n=== Syscall Statistics ===\n");
+    LOGF("\n  NR  NAME               CALLS    AVG us    P50 us    P99 us    MAX us\n");
+
+    for (uint32_t nr = 0; nr < SYSCALL_TABLE_SIZE; nr++) {
+        const syscall_desc_t* d = syscall_desc(nr);
+        if (!d) continue;
+
+        syscall_stat_t st;
+        syscall_get_stats(nr, &st);
+        if (!st.calls) continue;
+
+        LOGF("%4u  %-16s %7lu  %8lu  %8lu  %8lu  %8lu\n", nr, d->name, st.calls,
+             tsc_ticks_to_ns(st.cycles / st.calls) / 1000,
+             tsc_ticks_to_ns(syscall_percentile(&st, 50)) / 1000,
+             tsc_ticks_to_ns(syscall_percentile(&st, 99)) / 1000,
+             tsc_ticks_to_ns(st.max_cycles) / 1000);
+    }
+
+    // The reaper frees processes on other CPUs, hold the list still while printing
+    LOGF("\n  PID  NAME                  CALLS    TIME ms\n");
+    bool flags = process_list_lock();
+    for (process_t* proc = process_get_all(); proc; proc = proc->next) {
+        if (!proc->syscalls) continue;
+        LOGF("%5u  %-18s %9lu  %9lu\n", proc->pid, proc->name, proc->syscalls,
+             tsc_ticks_to_ns(proc->syscall_tsc) / 1000000);
+    }
+    process_list_unlock(flags);
+}
+
+#pragma endregion
+
+#pragma region Tracing
+
+/*
+ * syscall_trace_enable - Turns logging of every call into the trace ring on or off
+ */
+void syscall_trace_enable(bool on) {
+    __atomic_store_n(&trace_on, on, __ATOMIC_RELEASE);
+    LOGF("[SYSCALL] Tracing %s\n", on ? "on" : "off");
+}
+
+bool syscall_trace_enabled(void) {
+    return __atomic_load_n(&trace_on, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * syscall_trace_record - Appends one call to the ring, overwriting the oldest once it is full
+ */
+static void syscall_trace_record(thread_t* current, uint32_t nr, const uint64_t* args, uint64_t ret,
+                                 uint64_t start_ns, uint64_t cycles) {
+    bool flags = spinlock_acquire(&trace_lock);
+    syscall_trace_t* e = &trace_ring[trace_head % SYSCALL_TRACE_SIZE];
+    trace_head++;
+
+    e->ns = start_ns;
+    e->cycles = cycles;
+    e->nr = nr;
+    e->tid = current->tid;
+    e->pid = current->process ? current->process->pid : 0;
+    for (uint32_t i = 0; i < SYSCALL_MAX_ARGS; i++) e->args[i] = args[i];
+    e->ret = ret;
+    spinlock_release(&trace_lock, flags);
+}
+
+/*
+ * syscall_trace_read - Copies up to max records, oldest first, returns how many
+ */
+uint32_t syscall_trace_read(syscall_trace_t* out, uint32_t max) {
+    bool flags = spinlock_acquire(&trace_lock);
+    uint64_t avail = trace_head < SYSCALL_TRACE_SIZE ? trace_head : SYSCALL_TRACE_SIZE;
+    if (avail > max) avail = max;
+
+    uint64_t first = trace_head - avail;
+    for (uint64_t i = 0; i < avail; i++)
+        out[i] = trace_ring[(first + i) % SYSCALL_TRACE_SIZE];
+    spinlock_release(&trace_lock, flags);
+    return (uint32_t)avail;
+}
+
+/*
+ * syscall_trace_dump - Print the trace ring to serial, one call per line with its arguments
+ */
+void syscall_trace_dump(void) {
+    // Too big for a kernel stack
+    syscall_trace_t* recs = kmalloc(sizeof(syscall_trace_t) * SYSCALL_TRACE_SIZE);
+    if (!recs) return;
+
+    uint32_t n = syscall_trace_read(recs, SYSCALL_TRACE_SIZE);
+    LOGF("\n=== Syscall Trace (%u calls) ===\n", n);
+
+    for (uint32_t i = 0; i < n; i++) {
+        syscall_trace_t* e = &recs[i];
+        const syscall_desc_t* d = syscall_desc(e->nr);
+        char line[160];
+        int len = ksnprintf(line, sizeof(line), "%10lu us  %u:%u  %s(", e->ns / 1000, e->pid, e->tid, d ? d->name : "?");
+
+        for (uint32_t a = 0; d && a < d->nargs && len < (int)sizeof(line); a++) {
+            const char* sep = a ? ", " : "";
+            if (d->args[a] == SYSARG_UINT)
+                len += ksnprintf(line + len, sizeof(line) - len, "%s%lu", sep, e->args[a]);
+            else
+                len += ksnprintf(line + len, sizeof(line) - len, "%s0x%lx", sep, e->args[a]);
         }
 
-        default:
-            LOGF("[SYSCALL] Unknown syscall: %lu from thread '%s' (PID %u)\n", syscall_num, current->name, current->process ? current->process->pid : 0);
+        if (len < (int)sizeof(line))
+            ksnprintf(line + len, sizeof(line) - len, ") = %ld  [%lu us]\n", (int64_t)e->ret, tsc_ticks_to_ns(e->cycles) / 1000);
+        LOGF("%s", line);
+    }
+    kfree(recs);
+}
 
-            sched_exit();
-            break;
+#pragma endregion
+
+#pragma region Dispatcher
+
+/*
+ * syscall_run - Runs the handler for nr with its accounting and tracing, the result is left in regs->rax
+ */
+static void syscall_run(const syscall_desc_t* d, uint32_t nr, cpu_context_t* regs, thread_t* current) {
+    // The handler overwrites rax and may clobber the rest, the trace wants what came in
+    uint64_t args[SYSCALL_MAX_ARGS] = { regs->rdi, regs->rsi, regs->rdx };
+    uint64_t start_ns = __atomic_load_n(&trace_on, __ATOMIC_RELAXED) ? clock_read_ns() : 0;
+    uint64_t start = tsc_read();
+
+    d->fn(regs, current);
+
+    // A blocking call may have moved us to another CPU, the thread is still ours
+    thread_t* self = sched_current();
+    uint64_t cycles = tsc_read() - start;
+    syscall_account(self, nr, cycles);
+    if (__atomic_load_n(&trace_on, __ATOMIC_RELAXED))
+        syscall_trace_record(self, nr, args, regs->rax, start_ns, cycles);
+}
+
+/*
+ * syscall_invoke - Runs syscall nr with args for current from inside the kernel, returns its rax
+ *
+ * For batched submissions, the call is counted and traced like one that
+ * came through the syscall instruction. -1 for an unknown nr. Handlers
+ * fail a bad buffer with -1 here instead of ending current.
+ */
+uint64_t syscall_invoke(uint32_t nr, const uint64_t* args, thread_t* current) {
+    const syscall_desc_t* d = syscall_desc(nr);
+    if (!d || !current) return (uint64_t)-1;
+
+    // Handlers with nothing to return leave 0, and a kernel iret_cs tells them nobody trapped in
+    cpu_context_t regs;
+    kmemset(&regs, 0, sizeof(regs));
+    regs.iret_cs = KERNEL_CS;
+    regs.rdi = args[0];
+    regs.rsi = args[1];
+    regs.rdx = args[2];
+
+    syscall_run(d, nr, &regs, current);
+    return regs.rax;
+}
+
+/*
+ * syscall_dispatcher - Called from syscall_entry.S with a pointer to
+ * the full cpu_context_t built on the per-thread kernel stack
+ */
+void syscall_dispatcher(cpu_context_t* regs) {
+    thread_t* current = sched_current();
+    if (!current) return;
+
+    uint64_t syscall_num = regs->rax;
+    sched_acct_enter(current);
+
+    const syscall_desc_t* d = syscall_num < SYSCALL_TABLE_SIZE ? syscall_desc((uint32_t)syscall_num) : NULL;
+    if (!d) {
+        LOGF("[SYSCALL] Unknown syscall: %lu from thread '%s' (PID %u)\n", syscall_num, current->name, current->process ? current->process->pid : 0);
+        sched_exit();
+        return;
     }
+
+    syscall_run(d, (uint32_t)syscall_num, regs, current);
+    sched_acct_exit(sched_current());
 }
+
+#pragma endregion
@@ -9,8 +9,12 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 #include <arch/x86_64/cpu/interrupts.h>
 
+struct thread;
+
 #define SYS_EXIT 1
 #define SYS_WRITE 2
 #define SYS_MMAP 3
@@ -20,11 +24,92 @@
 #define SYS_SLEEP_MS 7
 #define SYS_READ 8
 #define SYS_TTY_CTRL 9
+#define SYS_MREMAP 10
+#define SYS_SET_PRIORITY 11
+#define SYS_SCHED_DEADLINE 12
+#define SYS_NANOSLEEP 13
+#define SYS_FUTEX_WAIT 14
+#define SYS_FUTEX_WAKE 15
+#define SYS_THREAD_CREATE 16
+#define SYS_THREAD_JOIN 17
+#define SYS_GETRUSAGE 18
+#define SYS_URING_SETUP 19
+#define SYS_URING_ENTER 20
+#define SYS_WRITEV 21
+#define SYS_READV 22
 
 // TTY Control Commands
 #define TTY_CTRL_CLEAR    0
 #define TTY_CTRL_CURSOR   1
 #define TTY_CTRL_GET_DIMS 2
 
+// SYS_MREMAP flags
+#define MREMAP_MAYMOVE 1
+
+// SYS_GETRUSAGE targets
+#define RUSAGE_SELF   0
+#define RUSAGE_THREAD 1
+
+#define SYSCALL_TABLE_SIZE  32  // Every syscall number is below this
+#define SYSCALL_MAX_ARGS    3   // rdi, rsi, rdx
+#define SYSCALL_LAT_BUCKETS 32  // Power of two buckets in TSC cycles, see syscall_get_stats()
+#define SYSCALL_TRACE_SIZE  256 // Calls the trace ring keeps
+#define SYSCALL_IO_CHUNK    256 // Bytes SYS_WRITE and SYS_READ stage on the kernel stack at a time
+#define SYSCALL_IOV_MAX     64  // Segments one SYS_WRITEV or SYS_READV takes
+
+// One SYS_WRITEV or SYS_READV segment
+typedef struct {
+    void* iov_base;
+    size_t iov_len;
+} iovec_t;
+
+// How the tracer prints an argument
+typedef enum {
+    SYSARG_UINT,
+    SYSARG_HEX,
+    SYSARG_PTR,
+} syscall_arg_t;
+
+// Sets regs->rax to the result, if there is one
+typedef void (*syscall_fn_t)(cpu_context_t* regs, struct thread* current);
+
+typedef struct {
+    const char* name;
+    syscall_fn_t fn;
+    uint8_t nargs;
+    uint8_t args[SYSCALL_MAX_ARGS];     // syscall_arg_t per argument register
+} syscall_desc_t;
+
+// Bucket 0 counts calls under 1 cycle, bucket i [2^(i-1), 2^i) cycles, the last everything longer
+typedef struct {
+    uint64_t calls;
+    uint64_t cycles;        // Entry to return, blocking included
+    uint64_t max_cycles;
+    uint64_t hist[SYSCALL_LAT_BUCKETS];
+} syscall_stat_t;
+
+typedef struct {
+    uint64_t ns;            // Uptime at entry
+    uint64_t cycles;
+    uint64_t args[SYSCALL_MAX_ARGS];
+    uint64_t ret;
+    uint32_t pid;
+    uint32_t tid;
+    uint32_t nr;
+} syscall_trace_t;
+
 void syscall_init(void);
 void syscall_dispatcher(cpu_context_t* regs);
+
+bool syscall_register(uint32_t nr, const syscall_desc_t* desc);
+const syscall_desc_t* syscall_desc(uint32_t nr);
+uint64_t syscall_invoke(uint32_t nr, const uint64_t* args, struct thread* current);
+
+void syscall_get_stats(uint32_t nr, syscall_stat_t* out);
+uint64_t syscall_percentile(const syscall_stat_t* st, uint32_t pct);
+void syscall_dump_stats(void);
+
+void syscall_trace_enable(bool on);
+bool syscall_trace_enabled(void);
+uint32_t syscall_trace_read(syscall_trace_t* out, uint32_t max);
+void syscall_trace_dump(void);
@@ -4,6 +4,8 @@
  * This module implements the core timing functionality for GatOS.
  * It handles hardware discovery for PIT and HPET, performs calibration
  * of the Local APIC and TSC, and provides high-level sleep and uptime APIs.
+ * The TSC and the HPET are registered as clocksources, uptime is whatever
+ * clock_read_ns() says.
  *
  * Author: u/ApparentlyPlus
  */
@@ -12,10 +14,15 @@
 #include <arch/x86_64/memory/paging.h>
 #include <kernel/drivers/serial.h>
 #include <kernel/sys/scheduler.h>
+#include <kernel/sys/clocksource.h>
+#include <kernel/sys/hrtimer.h>
+#include <kernel/sys/ktimer.h>
+#include <arch/x86_64/cpu/msr.h>
 #include <arch/x86_64/cpu/cpu.h>
 #include <arch/x86_64/cpu/io.h>
 #include <kernel/memory/vmm.h>
 #include <kernel/sys/timers.h>
+#include <kernel/sys/vvar.h>
 #include <kernel/sys/acpi.h>
 #include <kernel/sys/apic.h>
 #include <kernel/debug.h>
@@ -27,7 +34,9 @@ static hpet_regs_t* hpet = NULL;
 static uint32_t hpet_period = 0; // Femtoseconds per tick
 
 static uint64_t tsc_tpm = 0;
-static uint64_t boot_tsc = 0;
+
+static clocksource_t tsc_cs = { .name = "tsc", .read = tsc_read, .rating = 300 };
+static clocksource_t hpet_cs = { .name = "hpet", .read = hpet_read_counter, .rating = 250 };
 
 static volatile uint64_t ticks = 0;
 
@@ -127,6 +136,10 @@ static void hpet_init(void) {
 
     LOGF("[TIMER] HPET initialized. Period: %u fs (%u MHz)\n", 
          hpet_period, (uint32_t)(FEMTOSECONDS_PER_SECOND / hpet_period / 1000000));
+
+    // The clock until the TSC is calibrated, and the fallback if it never is
+    clocksource_set_rate(&hpet_cs, hpet_period, FEMTOSECONDS_PER_NANO);
+    clocksource_register(&hpet_cs);
 }
 
 /*
@@ -152,19 +165,48 @@ uint64_t hpet_read_counter(void) {
  * timer_handler - Periodic timer interrupt handler
  */
 static cpu_context_t* timer_handler(cpu_context_t* ctx) {
-    ticks++;
-    
+    __atomic_fetch_add(&ticks, 1, __ATOMIC_RELAXED);
+
+    // Callbacks first, they may wake threads the scheduler should see
+    hrtimer_run();
+    ktimer_run();
+
     // Call the scheduler to perform a context switch
     return sched_schedule(ctx);
 }
 
 /*
- * timer_calibrate_all - Calibrates LAPIC and TSC against HPET or PIT
+ * tsc_cpuid_hz - TSC frequency the CPU reports in leaf 0x15 or 0x16, 0 if it does not
+ *
+ * Leaf 0x15 gives the TSC to core crystal ratio and usually the crystal
+ * frequency, which makes the result exact. Where the crystal is left 0,
+ * it is derived from the nominal base frequency in leaf 0x16, and failing
+ * that the base frequency is taken as the TSC frequency.
  */
-static void timer_calibrate_all(void) {
-    LOGF("[TIMER] Calibrating high-precision timers...\n");
+static uint64_t tsc_cpuid_hz(void) {
+    uint32_t max, b, c, d;
+    cpuid(0, 0, &max, &b, &c, &d);
+
+    uint32_t base_mhz = 0;
+    if (max >= 0x16) cpuid(0x16, 0, &base_mhz, &b, &c, &d);
+    base_mhz &= 0xFFFF;
+
+    if (max >= 0x15) {
+        uint32_t den, num, crystal;
+        cpuid(0x15, 0, &den, &num, &crystal, &d);
+        if (den && num) {
+            if (crystal) return (uint64_t)crystal * num / den;
+            if (base_mhz) return (uint64_t)base_mhz * 1000000ULL;
+        }
+    }
 
-    const uint32_t CALIBRATE_MS = 10;
+    return base_mhz ? (uint64_t)base_mhz * 1000000ULL : 0;
+}
+
+/*
+ * timer_measure - Counts LAPIC and TSC ticks over ms milliseconds of HPET or PIT time
+ */
+static void timer_measure(uint32_t ms, uint64_t* lapic_ticks, uint64_t* tsc_ticks) {
     uint64_t lapic_start, lapic_end;
     uint64_t tsc_start, tsc_end;
 
@@ -173,7 +215,7 @@ static void timer_calibrate_all(void) {
     lapic_write(LAPIC_TICR, 0xFFFFFFFF); // Max count
 
     if (hpet_is_available()) {
-        uint64_t hpet_target = (CALIBRATE_MS * 1000000000000ULL) / hpet_period;
+        uint64_t hpet_target = (ms * 1000000000000ULL) / hpet_period;
         uint64_t hpet_start = hpet_read_counter();
         
         lapic_start = lapic_read(LAPIC_TCCR);
@@ -189,7 +231,7 @@ static void timer_calibrate_all(void) {
     } else {
         // Fallback to PIT
         pit_set_oneshot(0xFFFF); 
-        uint32_t pit_target = (PIT_FREQUENCY / 1000) * CALIBRATE_MS;
+        uint32_t pit_target = (PIT_FREQUENCY / 1000) * ms;
         
         outb(0x43, 0x00);
         uint8_t low = inb(0x40);
@@ -214,13 +256,62 @@ static void timer_calibrate_all(void) {
         tsc_end = tsc_read();
     }
 
-    uint64_t lapic_ticks_per_ms = (lapic_start - lapic_end) / CALIBRATE_MS;
-    tsc_tpm = (tsc_end - tsc_start) / CALIBRATE_MS;
+    *lapic_ticks = lapic_start - lapic_end;
+    *tsc_ticks = tsc_end - tsc_start;
+}
+
+/*
+ * timer_calibrate_all - Calibrates LAPIC and TSC, registers the TSC clocksource
+ *
+ * With the TSC frequency from CPUID only the LAPIC needs measuring, over a
+ * short window that also cross checks the CPUID figure. Without it, or if
+ * the two disagree, both are measured over the full window.
+ */
+static void timer_calibrate_all(void) {
+    LOGF("[TIMER] Calibrating high-precision timers...\n");
+
+    const uint32_t CALIBRATE_MS = 10;
+    const uint32_t CALIBRATE_FAST_MS = 1;
+    uint64_t lapic_ticks, tsc_ticks;
+
+    uint64_t tsc_hz = tsc_cpuid_hz();
+    uint32_t window = tsc_hz ? CALIBRATE_FAST_MS : CALIBRATE_MS;
+    timer_measure(window, &lapic_ticks, &tsc_ticks);
+
+    if (tsc_hz) {
+        // The short window is good to a few percent, a wrong CPUID figure is usually way off
+        uint64_t measured = tsc_ticks * 1000 / window;
+        uint64_t diff = measured > tsc_hz ? measured - tsc_hz : tsc_hz - measured;
+        if (diff > tsc_hz / 20) {
+            LOGF("[TIMER] CPUID TSC %lu Hz disagrees with measured %lu Hz, calibrating\n", tsc_hz, measured);
+            tsc_hz = 0;
+            window = CALIBRATE_MS;
+            timer_measure(window, &lapic_ticks, &tsc_ticks);
+        }
+    }
+
+    uint64_t lapic_ticks_per_ms = lapic_ticks / window;
+    tsc_tpm = tsc_hz ? tsc_hz / 1000 : tsc_ticks / window;
 
     lapic_set_tpm(lapic_ticks_per_ms);
 
-    LOGF("[TIMER] LAPIC: %lu ticks/ms, TSC: %lu ticks/ms\n", 
-         lapic_ticks_per_ms, tsc_tpm);
+    LOGF("[TIMER] LAPIC: %lu ticks/ms, TSC: %lu ticks/ms (%s)\n", 
+         lapic_ticks_per_ms, tsc_tpm, tsc_hz ? "CPUID" : "measured");
+
+    if (tsc_tpm == 0) {
+        LOGF("[TIMER] TSC unusable, staying on %s\n", hpet_is_available() ? "HPET" : "no clocksource");
+        return;
+    }
+
+    uint32_t a, b, c, d;
+    cpuid(0x80000000, 0, &a, &b, &c, &d);
+    if (a >= 0x80000007) cpuid(0x80000007, 0, &a, &b, &c, &d);
+    else d = 0;
+    if (!(d & (1u << 8))) LOGF("[TIMER] TSC is not invariant, uptime may drift under frequency changes\n");
+
+    if (tsc_hz) clocksource_set_rate(&tsc_cs, 1000000000ULL, tsc_hz);
+    else clocksource_set_rate(&tsc_cs, 1000000ULL, tsc_tpm);
+    clocksource_register(&tsc_cs);
 }
 
 #pragma endregion
@@ -231,8 +322,9 @@ static void timer_calibrate_all(void) {
  * timer_init - Initializes the timer subsystem and determines TSC/LAPIC frequency
  */
 void timer_init(void) {
-    boot_tsc = tsc_read();
-    
+    clocksource_init();
+    hrtimer_init();
+    ktimer_init();
     hpet_init();
     timer_calibrate_all();
 
@@ -252,6 +344,14 @@ void timer_init(void) {
     }
 }
 
+/*
+ * timer_init_ap - Starts an AP's LAPIC timer, calibration from the BSP applies to every core
+ */
+void timer_init_ap(void) {
+    if (!tsc_deadline_mode)
+        lapic_timer_periodic(10000, INT_FIRST_INTERRUPT);
+}
+
 /*
  * sleep_ms - Blocks execution for at least the specified number of milliseconds
  */
@@ -281,6 +381,14 @@ void sleep_ms(uint64_t ms) {
  * sleep_us - Blocks execution for at least the specified number of microseconds
  */
 void sleep_us(uint64_t us) {
+    if (us == 0) return;
+
+    // Only block where a switch is safe: a thread context with interrupts on, and a timer that can wake it in time
+    if (tsc_deadline_mode && us >= SLEEP_BLOCK_MIN_US && sched_active() && sched_current() && intr_enabled()) {
+        sched_sleep_ns(us * 1000);
+        return;
+    }
+
     if (tsc_tpm > 0) {
         uint64_t target = tsc_read() + (us * tsc_tpm / 1000);
         while (tsc_read() < target) __asm__ volatile("pause");
@@ -299,60 +407,105 @@ void sleep_us(uint64_t us) {
  * get_uptime_ms - Returns the number of milliseconds since the kernel booted
  */
 uint64_t get_uptime_ms(void) {
-    if (tsc_tpm == 0) return 0;
-    return (tsc_read() - boot_tsc) / tsc_tpm;
+    return clock_read_ns() / 1000000;
 }
 
 /*
  * get_uptime_ns - Returns the number of nanoseconds since the kernel booted
  */
 uint64_t get_uptime_ns(void) {
-    if (tsc_tpm == 0) return 0;
-    return ((tsc_read() - boot_tsc) * 1000000) / tsc_tpm;
+    return clock_read_ns();
 }
 
 /*
- * timer_arm_next - Arms the LAPIC timer for the next scheduler event
+ * tsc_ticks_to_ns - Converts a TSC tick delta to nanoseconds
  */
-void timer_arm_next(bool going_idle) {
+uint64_t tsc_ticks_to_ns(uint64_t ticks) {
+    return clocksource_cyc2ns(&tsc_cs, ticks);
+}
+
+/*
+ * tsc_ns_to_ticks - Converts a duration in nanoseconds to TSC ticks
+ */
+uint64_t tsc_ns_to_ticks(uint64_t ns) {
+    return clocksource_ns2cyc(&tsc_cs, ns);
+}
+
+/*
+ * tsc_get_tpm - Calibrated TSC ticks per millisecond, 0 before timer_init()
+ */
+uint64_t tsc_get_tpm(void) {
+    return tsc_tpm;
+}
+
+/*
+ * tsc_get_boot - TSC value at uptime 0
+ */
+uint64_t tsc_get_boot(void) {
+    return tsc_from_uptime_ns(0);
+}
+
+/*
+ * tsc_clocksource - The TSC's clocksource, its rate is unset before timer_init()
+ */
+const clocksource_t* tsc_clocksource(void) {
+    return &tsc_cs;
+}
+
+/*
+ * tsc_from_uptime_ns - TSC value at which the uptime reaches ns
+ */
+uint64_t tsc_from_uptime_ns(uint64_t ns) {
+    return clock_ns_to_cycles(&tsc_cs, ns);
+}
+
+/*
+ * timer_tickless - True if the LAPIC runs in TSC-deadline mode rather than a periodic tick
+ */
+bool timer_tickless(void) {
+    return tsc_deadline_mode;
+}
+
+/*
+ * timer_bring_forward - Make the next timer interrupt on this CPU come no later than deadline_tsc, interrupts off
+ */
+void timer_bring_forward(uint64_t deadline_tsc) {
+    if (!tsc_deadline_mode) return;
+
+    // The MSR reads back 0 once the deadline fired or the timer was stopped
+    uint64_t armed = read_msr(MSR_IA32_TSC_DEADLINE);
+    if (armed == 0 || deadline_tsc < armed)
+        lapic_tsc_arm(deadline_tsc, INT_FIRST_INTERRUPT);
+}
+
+/*
+ * timer_arm_next - Arms the LAPIC timer for the next scheduler event, slice_ns is the slice or budget of the picked thread
+ */
+void timer_arm_next(bool going_idle, uint64_t slice_ns) {
     if (!tsc_deadline_mode) return;
 
     // this is a cool function for efficiency
     uint64_t now_tsc = tsc_read();
+    uint64_t deadline = going_idle ? UINT64_MAX : now_tsc + tsc_ns_to_ticks(slice_ns);
 
-    if (going_idle) {
-        uint64_t next_ms = sched_next_wake();
+    // Sleepers and both kinds of timers are keyed on TSC deadlines
+    uint64_t wake = sched_next_wake();
+    if (wake < deadline) deadline = wake;
 
-        if (next_ms == UINT64_MAX) {
-            lapic_timer_stop();
-            return;
-        }
-
-        uint64_t now_ms = get_uptime_ms();
-        if (next_ms <= now_ms) {
-            lapic_tsc_arm(now_tsc, INT_FIRST_INTERRUPT);
-            return;
-        }
-        uint64_t deadline_tsc = now_tsc + ((next_ms - now_ms) * tsc_tpm);
-        lapic_tsc_arm(deadline_tsc, INT_FIRST_INTERRUPT);
+    uint64_t hr = hrtimer_next();
+    if (hr < deadline) deadline = hr;
 
-    } else {
-        uint64_t quantum_tsc = now_tsc + ((uint64_t)SCHED_QUANTUM_MS * tsc_tpm);
-
-        uint64_t next_ms = sched_next_wake();
-        if (next_ms != UINT64_MAX) {
-            uint64_t now_ms = get_uptime_ms();
-            if (next_ms <= now_ms) {
-                lapic_tsc_arm(now_tsc, INT_FIRST_INTERRUPT);
-                return;
-            }
-            uint64_t sleep_tsc = now_tsc + ((next_ms - now_ms) * tsc_tpm);
-            if (sleep_tsc < quantum_tsc)
-                quantum_tsc = sleep_tsc;
-        }
+    uint64_t kt = ktimer_next();
+    if (kt < deadline) deadline = kt;
 
-        lapic_tsc_arm(quantum_tsc, INT_FIRST_INTERRUPT);
+    // Nothing to wake for, the idle CPU sleeps until an interrupt
+    if (deadline == UINT64_MAX) {
+        lapic_timer_stop();
+        return;
     }
+
+    // A deadline already behind us fires straight away
+    lapic_tsc_arm(deadline > now_tsc ? deadline : now_tsc, INT_FIRST_INTERRUPT);
 }
 
 #pragma endregion
@@ -13,6 +13,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <kernel/sys/clocksource.h>
 
 // Timer Constants
 
@@ -36,16 +37,20 @@ typedef struct {
     uint64_t reserved4;
 } __attribute__((packed)) hpet_regs_t;
 
-#define SCHED_QUANTUM_MS 10
+#define SCHED_QUANTUM_MS 10    // Slice at SCHED_PRIO_DEFAULT, see sched_quantum_ms()
+#define SLEEP_BLOCK_MIN_US 20  // Shorter sleep_us() calls spin, a context switch would cost more
 
 // Timer API
 
 void timer_init(void);
+void timer_init_ap(void);
 void sleep_ms(uint64_t ms);
 void sleep_us(uint64_t us);
 uint64_t get_uptime_ms(void);
 uint64_t get_uptime_ns(void);
-void timer_arm_next(bool going_idle);
+bool timer_tickless(void);
+void timer_arm_next(bool going_idle, uint64_t slice_ns);
+void timer_bring_forward(uint64_t deadline_tsc);
 
 // Local APIC Timer API
 
@@ -56,6 +61,12 @@ void lapic_timer_stop(void);
 // TSC Timer API
 
 uint64_t tsc_read(void);
+uint64_t tsc_ticks_to_ns(uint64_t ticks);
+uint64_t tsc_ns_to_ticks(uint64_t ns);
+uint64_t tsc_from_uptime_ns(uint64_t ns);
+uint64_t tsc_get_tpm(void);
+uint64_t tsc_get_boot(void);
+const clocksource_t* tsc_clocksource(void);
 void tsc_deadline_arm(uint64_t target_tsc);
 
 // HPET API
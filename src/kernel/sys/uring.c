@@ -0,0 +1,293 @@
+/*
+ * uring.c - Shared memory submission and completion rings for batched syscalls
+ *
+ * The region is kernel owned physical memory mapped into the process the way
+ * vvar_map() maps the time page, so the kernel always reaches it through the
+ * physmap: no SMAP window, and an munmap of the user view cannot pull it out
+ * from under a poller. SQEs are copied out before sq_head moves past them
+ * and the kernel keeps its own head and tail, a process scribbling over the
+ * header only confuses itself.
+ *
+ * The consumer is whoever holds busy in enter mode, or the poller thread
+ * with URING_SETUP_SQPOLL. A CQ without room for another result stops
+ * consumption until user space catches up.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#include <kernel/sys/uring.h>
+#include <kernel/sys/syscall.h>
+#include <kernel/sys/process.h>
+#include <kernel/sys/scheduler.h>
+#include <kernel/sys/timers.h>
+#include <kernel/memory/pmm.h>
+#include <kernel/memory/vmm.h>
+#include <kernel/memory/heap.h>
+#include <arch/x86_64/memory/layout.h>
+#include <arch/x86_64/memory/paging.h>
+#include <kernel/debug.h>
+#include <klibc/string.h>
+
+typedef struct {
+    uring_t* ring;
+    uint32_t want;
+} uring_cq_wait_t;
+
+#pragma region Helpers
+
+/*
+ * uring_cq_ready - Completions user space has not consumed yet
+ */
+static inline uint32_t uring_cq_ready(const uring_t* ring) {
+    return __atomic_load_n(&ring->cq_tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->hdr->cq_head, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * uring_op_valid - Whether sqe is an op the ring accepts
+ *
+ * Buffers are not checked here, a sibling could unmap them before the
+ * handler runs anyway. Through syscall_invoke() the handlers copy fault
+ * safely and complete a bad buffer with -1, they never end the poller.
+ */
+static bool uring_op_valid(const uring_sqe_t* sqe) {
+    switch (sqe->op) {
+        case SYS_WRITE:
+        case SYS_READ:
+        case SYS_WRITEV:
+        case SYS_READV:
+        case SYS_MMAP:
+        case SYS_MUNMAP:
+        case SYS_SLEEP_MS:
+        case SYS_NANOSLEEP:
+        case SYS_FUTEX_WAKE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ * uring_run - Runs one SQE on behalf of current, returns the CQE result
+ */
+static int64_t uring_run(thread_t* current, const uring_sqe_t* sqe) {
+    if (sqe->flags) return -1;
+    if (sqe->op == URING_OP_NOP) return 0;
+    if (!uring_op_valid(sqe)) return -1;
+    return (int64_t)syscall_invoke(sqe->op, sqe->args, current);
+}
+
+/*
+ * uring_consume - Runs up to max queued SQEs in order and posts their results, returns how many ran
+ *
+ * Caller is the ring's only consumer for the duration.
+ */
+static uint32_t uring_consume(uring_t* ring, thread_t* current, uint32_t max) {
+    uring_hdr_t* hdr = ring->hdr;
+    uint32_t n = 0;
+
+    // A tail more than a ring ahead is garbage, never run a slot twice in one pass
+    if (max > ring->sq_entries) max = ring->sq_entries;
+
+    while (n < max) {
+        uint32_t tail = __atomic_load_n(&hdr->sq_tail, __ATOMIC_ACQUIRE);
+        if (tail == ring->sq_head) break;
+
+        // No room for the result, user space has to drain the CQ first
+        if (ring->cq_tail - __atomic_load_n(&hdr->cq_head, __ATOMIC_ACQUIRE) >= ring->cq_entries) break;
+
+        // Copy out first, user space may refill the slot as soon as sq_head passes it
+        uring_sqe_t sqe = ring->sqes[ring->sq_head & (ring->sq_entries - 1)];
+        ring->sq_head++;
+        __atomic_store_n(&hdr->sq_head, ring->sq_head, __ATOMIC_RELEASE);
+
+        int64_t res = uring_run(current, &sqe);
+
+        uring_cqe_t* cqe = &ring->cqes[ring->cq_tail & (ring->cq_entries - 1)];
+        cqe->user_data = sqe.user_data;
+        cqe->res = res;
+        __atomic_store_n(&ring->cq_tail, ring->cq_tail + 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&hdr->cq_tail, ring->cq_tail, __ATOMIC_RELEASE);
+        n++;
+    }
+
+    if (n) {
+        ring->submitted += n;
+        ring->batches++;
+    }
+    return n;
+}
+
+static bool uring_sq_pending(void* arg) {
+    uring_t* ring = arg;
+    return __atomic_load_n(&ring->hdr->sq_tail, __ATOMIC_ACQUIRE) != ring->sq_head;
+}
+
+static bool uring_cq_enough(void* arg) {
+    uring_cq_wait_t* w = arg;
+    return uring_cq_ready(w->ring) >= w->want || !w->ring->poller;
+}
+
+/*
+ * uring_sqpoll - Poller thread, runs SQEs as they appear and sleeps after URING_SQPOLL_IDLE_MS without any
+ *
+ * Exits once it is the last live thread of its process, nobody is left to
+ * submit and the process can be reaped.
+ */
+static void uring_sqpoll(void* arg) {
+    uring_t* ring = arg;
+    thread_t* self = sched_current();
+    uint64_t idle_since = get_uptime_ms();
+
+    for (;;) {
+        if (uring_consume(ring, self, ring->sq_entries)) {
+            waitq_wake_all(&ring->cq_wait);
+            idle_since = get_uptime_ms();
+            continue;
+        }
+
+        if (get_uptime_ms() - idle_since < URING_SQPOLL_IDLE_MS) {
+            sched_yield();
+            continue;
+        }
+
+        // Set before the queue is checked under the waitq lock, a submitter that misses it finds us awake
+        __atomic_or_fetch(&ring->hdr->flags, URING_SQ_NEED_WAKEUP, __ATOMIC_SEQ_CST);
+        bool woken = waitq_wait_timeout(&ring->sq_wait, uring_sq_pending, ring, URING_WAIT_SLICE_MS);
+        __atomic_and_fetch(&ring->hdr->flags, ~URING_SQ_NEED_WAKEUP, __ATOMIC_SEQ_CST);
+        idle_since = get_uptime_ms();
+
+        if (!woken && process_live_threads(self->process) <= 1) break;
+    }
+
+    ring->poller = NULL;
+    waitq_wake_all(&ring->cq_wait);
+    LOGF("[URING] Poller of '%s' (PID %u) exiting after %lu entries in %lu batches\n",
+         self->process->name, self->process->pid, ring->submitted, ring->batches);
+}
+
+#pragma endregion
+
+#pragma region Public API
+
+/*
+ * uring_setup - Creates the calling process's ring with entries SQ slots, returns its user address or -1
+ *
+ * entries is rounded up to a power of two, at most URING_MAX_ENTRIES. One
+ * ring per process.
+ */
+int64_t uring_setup(thread_t* current, uint32_t entries, uint32_t flags) {
+    process_t* proc = current ? current->process : NULL;
+    if (!proc || !proc->vmm || proc->ring) return -1;
+    if (entries == 0 || entries > URING_MAX_ENTRIES || (flags & ~URING_SETUP_SQPOLL)) return -1;
+
+    uint32_t sq = 1;
+    while (sq < entries) sq <<= 1;
+    uint32_t cq = sq * 2;
+
+    // Header, SQEs and CQEs each start on their own cache line
+    uint32_t sq_off = (uint32_t)align_up(sizeof(uring_hdr_t), 64);
+    uint32_t cq_off = (uint32_t)align_up(sq_off + sq * sizeof(uring_sqe_t), 64);
+    uint32_t size = (uint32_t)align_up(cq_off + cq * sizeof(uring_cqe_t), PAGE_SIZE);
+
+    uring_t* ring = kmalloc(sizeof(uring_t));
+    if (!ring) return -1;
+    kmemset(ring, 0, sizeof(uring_t));
+
+    if (pmm_alloc(size, &ring->phys) != PMM_OK) {
+        kfree(ring);
+        return -1;
+    }
+
+    ring->size = size;
+    ring->hdr = (uring_hdr_t*)PHYSMAP_P2V(ring->phys);
+    kmemset(ring->hdr, 0, size);
+    ring->sqes = (uring_sqe_t*)((uint8_t*)ring->hdr + sq_off);
+    ring->cqes = (uring_cqe_t*)((uint8_t*)ring->hdr + cq_off);
+    ring->sq_entries = sq;
+    ring->cq_entries = cq;
+    ring->sqpoll = (flags & URING_SETUP_SQPOLL) != 0;
+    waitq_init(&ring->sq_wait, "uring_sq");
+    waitq_init(&ring->cq_wait, "uring_cq");
+
+    ring->hdr->sq_entries = sq;
+    ring->hdr->cq_entries = cq;
+    ring->hdr->sq_off = sq_off;
+    ring->hdr->cq_off = cq_off;
+    ring->hdr->size = size;
+
+    void* out = NULL;
+    if (vmm_alloc(proc->vmm, size, VM_FLAG_USER | VM_FLAG_WRITE | VM_FLAG_PHYS, (void*)ring->phys, &out) != VMM_OK) {
+        pmm_free(ring->phys, size);
+        kfree(ring);
+        return -1;
+    }
+    ring->user_addr = (uintptr_t)out;
+
+    // Created before the ring is published, but only scheduled once it is
+    thread_t* poller = NULL;
+    if (ring->sqpoll) {
+        poller = thread_create(proc, "uring_sqpoll", uring_sqpoll, ring, false, 0);
+        if (!poller) goto fail;
+        ring->poller = poller;
+    }
+
+    uring_t* none = NULL;
+    if (!__atomic_compare_exchange_n(&proc->ring, &none, ring, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        if (poller) {
+            thread_unlink(poller);
+            thread_destroy(poller);
+        }
+        goto fail;
+    }
+
+    if (poller) sched_add(poller);
+
+    LOGF("[URING] '%s' (PID %u) set up %u/%u entries at 0x%lx%s\n", proc->name, proc->pid, sq, cq,
+         ring->user_addr, ring->sqpoll ? ", polled" : "");
+    return (int64_t)ring->user_addr;
+
+fail:
+    vmm_free(proc->vmm, out);
+    pmm_free(ring->phys, size);
+    kfree(ring);
+    return -1;
+}
+
+/*
+ * uring_enter - Runs up to to_submit queued SQEs, returns how many, or -1
+ *
+ * Everything submitted this way has completed by the time it returns. With
+ * a poller nothing is consumed here: URING_ENTER_SQ_WAKEUP wakes it, and
+ * min_complete waits until that many results are ready, returning how many
+ * are. A second thread entering while the SQ is being consumed gets 0.
+ */
+int64_t uring_enter(thread_t* current, uint32_t to_submit, uint32_t min_complete, uint32_t flags) {
+    process_t* proc = current ? current->process : NULL;
+    uring_t* ring = proc ? __atomic_load_n(&proc->ring, __ATOMIC_ACQUIRE) : NULL;
+    if (!ring || (flags & ~URING_ENTER_SQ_WAKEUP)) return -1;
+
+    if (ring->sqpoll) {
+        if (flags & URING_ENTER_SQ_WAKEUP) waitq_wake_all(&ring->sq_wait);
+
+        uring_cq_wait_t w = { ring, min_complete < ring->cq_entries ? min_complete : ring->cq_entries };
+        while (!uring_cq_enough(&w))
+            waitq_wait_timeout(&ring->cq_wait, uring_cq_enough, &w, URING_WAIT_SLICE_MS);
+        return uring_cq_ready(ring);
+    }
+
+    if (__atomic_exchange_n(&ring->busy, 1, __ATOMIC_ACQUIRE)) return 0;
+    uint32_t n = uring_consume(ring, current, to_submit);
+    __atomic_store_n(&ring->busy, 0, __ATOMIC_RELEASE);
+    return n;
+}
+
+/*
+ * uring_destroy - Frees a ring, once every thread of its process is gone
+ */
+void uring_destroy(uring_t* ring) {
+    if (!ring) return;
+    pmm_free(ring->phys, ring->size);
+    kfree(ring);
+}
+
+#pragma endregion
@@ -0,0 +1,98 @@
+/*
+ * uring.h - Shared memory submission and completion rings for batched syscalls
+ *
+ * A process sets up one ring with SYS_URING_SETUP and gets back the address
+ * of a user mapped region holding a header, a submission queue (SQ) of
+ * uring_sqe_t and a completion queue (CQ) twice its size of uring_cqe_t.
+ * User space fills SQEs and advances sq_tail, the kernel runs them in order
+ * and posts a CQE for each, advancing cq_tail. User space consumes CQEs and
+ * advances cq_head. Each index is only ever written by one side.
+ *
+ * An SQE op is a syscall number, run by the same handler SYS_* would run,
+ * or URING_OP_NOP. Only calls that make sense out of order with the caller's
+ * own registers are accepted: write, read, mmap, munmap, the sleeps and
+ * futex_wake. Anything else completes with -1.
+ *
+ * Entries are consumed either by SYS_URING_ENTER, a whole batch for one
+ * syscall entry, or with URING_SETUP_SQPOLL by a kernel thread of the
+ * process that polls the SQ and sleeps once it has been idle for a while.
+ * While it sleeps URING_SQ_NEED_WAKEUP is set and the next enter must pass
+ * URING_ENTER_SQ_WAKEUP. ulibc/uring.h mirrors the layout.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <kernel/sys/waitq.h>
+
+struct process;
+struct thread;
+
+#define URING_MAX_ENTRIES   256     // SQ size limit, the CQ holds twice as many
+#define URING_SQPOLL_IDLE_MS 2      // Poller spins this long after its last entry before sleeping
+#define URING_WAIT_SLICE_MS 100     // Sleepers recheck whether they were killed this often
+
+// SYS_URING_SETUP flags
+#define URING_SETUP_SQPOLL 1
+
+// SYS_URING_ENTER flags
+#define URING_ENTER_SQ_WAKEUP 1
+
+// uring_hdr_t.flags
+#define URING_SQ_NEED_WAKEUP 1
+
+#define URING_OP_NOP 0
+
+typedef struct {
+    uint32_t op;            // SYS_* number or URING_OP_NOP
+    uint32_t flags;         // Reserved, 0
+    uint64_t user_data;     // Copied to the CQE untouched
+    uint64_t args[3];       // rdi, rsi, rdx of the equivalent syscall
+} uring_sqe_t;
+
+typedef struct {
+    uint64_t user_data;
+    int64_t res;            // What the syscall would have returned in rax
+} uring_cqe_t;
+
+// Start of the shared region, the SQE and CQE arrays follow at the given offsets
+typedef struct {
+    volatile uint32_t sq_head;  // Written by the kernel
+    volatile uint32_t sq_tail;  // Written by user space
+    volatile uint32_t cq_head;  // Written by user space
+    volatile uint32_t cq_tail;  // Written by the kernel
+    uint32_t sq_entries;        // Power of two
+    uint32_t cq_entries;
+    volatile uint32_t flags;    // URING_SQ_*
+    uint32_t sq_off;            // Byte offset of the SQE array
+    uint32_t cq_off;            // Byte offset of the CQE array
+    uint32_t size;              // Bytes mapped
+} uring_hdr_t;
+
+typedef struct uring {
+    uring_hdr_t* hdr;           // Kernel view through the physmap
+    uring_sqe_t* sqes;
+    uring_cqe_t* cqes;
+    uint64_t phys;
+    uint32_t size;
+    uintptr_t user_addr;
+    // The kernel's own copies, user space may scribble over the header
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    uint32_t sq_head;
+    uint32_t cq_tail;
+    volatile uint32_t busy;     // A thread is consuming the SQ
+    bool sqpoll;
+    struct thread* volatile poller;     // NULL once the poller has exited
+    waitq_t sq_wait;            // The poller sleeps here while idle
+    waitq_t cq_wait;            // Enter sleeps here for completions from the poller
+    uint64_t submitted;         // SQEs run since setup
+    uint64_t batches;           // Enter calls or poller passes that ran at least one
+} uring_t;
+
+int64_t uring_setup(struct thread* current, uint32_t entries, uint32_t flags);
+int64_t uring_enter(struct thread* current, uint32_t to_submit, uint32_t min_complete, uint32_t flags);
+void uring_destroy(uring_t* ring);
@@ -0,0 +1,58 @@
+/*
+ * vvar.c - Read only time page shared with every process
+ *
+ * The page is a page aligned kernel object, so mapping it needs no frame
+ * of its own: vvar_map() points a read only user page at its physical
+ * address, the same way process_create() maps the shared user text.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#include <kernel/sys/vvar.h>
+#include <kernel/sys/timers.h>
+#include <arch/x86_64/memory/paging.h>
+#include <arch/x86_64/memory/layout.h>
+
+// Padded to a full page, user space must not see anything else
+static union {
+    vvar_t data;
+    uint8_t page[PAGE_SIZE];
+} vvar_page __attribute__((aligned(PAGE_SIZE)));
+
+/*
+ * vvar_update - Republishes the TSC conversion, after calibration or a clock change
+ *
+ * The kernel's own TSC clocksource factors, so both sides agree to the
+ * nanosecond while the TSC is the clock.
+ */
+void vvar_update(void) {
+    vvar_t* v = &vvar_page.data;
+    const clocksource_t* tsc = tsc_clocksource();
+    uint64_t boot = tsc_get_boot();
+
+    __atomic_store_n(&v->seq, v->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    v->shift = tsc->shift;
+    v->boot_tsc = boot;
+    v->tsc_per_ms = tsc_get_tpm();
+    v->mult = tsc->mult;
+
+    __atomic_store_n(&v->seq, v->seq + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * vvar_map - Maps the time page read only at USER_VVAR_VIRT_ADDR in vmm
+ */
+vmm_status_t vvar_map(vmm_t* vmm) {
+    void* out = NULL;
+    return vmm_alloc_at(vmm, (void*)USER_VVAR_VIRT_ADDR, PAGE_SIZE, VM_FLAG_USER | VM_FLAG_PHYS,
+                        (void*)KERNEL_V2P((uintptr_t)&vvar_page), &out);
+}
+
+/*
+ * vvar_get - The kernel's view of the page
+ */
+const vvar_t* vvar_get(void) {
+    return &vvar_page.data;
+}
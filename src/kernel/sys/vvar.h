@@ -0,0 +1,32 @@
+/*
+ * vvar.h - Read only time page shared with every process
+ *
+ * One kernel page, mapped read only at USER_VVAR_VIRT_ADDR in every address
+ * space, holds what user code needs to turn a rdtsc into uptime on its own:
+ *
+ *     ns = ((tsc - boot_tsc) * mult) >> shift
+ *
+ * The product is 128 bits wide. A reader samples seq, reads the fields and
+ * retries if seq was odd or moved, the kernel bumps it to odd before a
+ * rewrite and back to even after. mult and shift are the kernel's TSC
+ * clocksource factors. ulibc/time.h mirrors the layout.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <kernel/memory/vmm.h>
+
+typedef struct {
+    volatile uint32_t seq;  // Odd while the kernel rewrites the page
+    uint32_t shift;
+    uint64_t boot_tsc;      // TSC at uptime 0
+    uint64_t mult;          // ns per TSC tick, fixed point with shift fraction bits
+    uint64_t tsc_per_ms;    // TSC ticks per ms as calibrated, 0 before calibration
+} vvar_t;
+
+void vvar_update(void);
+vmm_status_t vvar_map(vmm_t* vmm);
+const vvar_t* vvar_get(void);
@@ -0,0 +1,168 @@
+/*
+ * waitq.c - Kernel wait queues with an optional timeout
+ *
+ * The blocking follows futex_wait(): the thread marks itself T_BLOCKED and
+ * queues under the queue lock after checking the condition there, then
+ * yields. Wakers unlink under the same lock and sched_add() outside it. The
+ * timeout callback races a wake for the queued flag, whoever clears it
+ * wakes the thread.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#include <kernel/sys/waitq.h>
+#include <kernel/sys/scheduler.h>
+#include <kernel/sys/process.h>
+#include <kernel/sys/timers.h>
+
+/*
+ * waitq_init - Prepares an empty queue
+ */
+void waitq_init(waitq_t* wq, const char* name) {
+    spinlock_init(&wq->lock, name);
+    wq->head = NULL;
+}
+
+/*
+ * waitq_unlink_locked - Removes an entry from its queue, queue lock held
+ */
+static void waitq_unlink_locked(waitq_t* wq, waitq_entry_t* e) {
+    waitq_entry_t** link = &wq->head;
+    while (*link && *link != e) link = &(*link)->next;
+    if (*link) *link = e->next;
+    e->next = NULL;
+    e->queued = false;
+}
+
+/*
+ * waitq_timeout - ktimer callback, wakes the waiter if waitq_wake_all() did not get there first
+ */
+static void waitq_timeout(ktimer_t* timer, void* arg) {
+    (void)timer;
+    waitq_entry_t* e = arg;
+    waitq_t* wq = e->wq;
+    thread_t* thread = e->thread;
+
+    bool flags = spinlock_acquire(&wq->lock);
+    bool wake = e->queued;
+    if (wake) {
+        waitq_unlink_locked(wq, e);
+        e->timed_out = true;
+    }
+    spinlock_release(&wq->lock, flags);
+
+    if (wake) sched_add(thread);
+
+    // Last touch, the entry is on the waiter's stack and it spins on this
+    __atomic_store_n(&e->firing, false, __ATOMIC_RELEASE);
+}
+
+/*
+ * waitq_disarm - Stops the timeout and waits out a callback already running on another CPU
+ */
+static void waitq_disarm(waitq_entry_t* e) {
+    if (!__atomic_load_n(&e->firing, __ATOMIC_ACQUIRE)) return;
+    if (ktimer_cancel(&e->timeout)) {
+        e->firing = false;
+        return;
+    }
+    while (__atomic_load_n(&e->firing, __ATOMIC_ACQUIRE))
+        __asm__ volatile("pause");
+}
+
+/*
+ * waitq_wait_timeout - Sleeps on wq until cond(arg) holds, true if it does, false once timeout_ms ran out
+ *
+ * timeout_ms 0 waits forever. cond is evaluated with the queue lock held,
+ * so it must not block. Before the scheduler runs this polls instead.
+ */
+bool waitq_wait_timeout(waitq_t* wq, waitq_cond_t cond, void* arg, uint64_t timeout_ms) {
+    if (cond(arg)) return true;
+
+    uint64_t start = get_uptime_ms();
+    thread_t* cur = sched_current();
+    if (!cur || !sched_active()) {
+        while (!cond(arg)) {
+            if (timeout_ms && get_uptime_ms() - start >= timeout_ms) return false;
+            __asm__ volatile("pause");
+        }
+        return true;
+    }
+
+    for (;;) {
+        // Woken for someone else's condition, sleep again for what is left
+        uint64_t left = 0;
+        if (timeout_ms) {
+            uint64_t spent = get_uptime_ms() - start;
+            if (spent >= timeout_ms) return cond(arg);
+            left = timeout_ms - spent;
+        }
+
+        waitq_entry_t e;
+        e.thread = cur;
+        e.wq = wq;
+        e.timed_out = false;
+        e.firing = false;
+
+        bool flags = spinlock_acquire(&wq->lock);
+
+        // Under the queue lock a waker that made cond true has either finished or will see us queued
+        if (cond(arg)) {
+            spinlock_release(&wq->lock, flags);
+            return true;
+        }
+
+        e.next = wq->head;
+        wq->head = &e;
+        e.queued = true;
+        cur->state = T_BLOCKED;
+
+        if (left) {
+            e.firing = true;
+            ktimer_setup(&e.timeout, waitq_timeout, &e);
+            ktimer_arm(&e.timeout, left);
+        }
+        spinlock_release(&wq->lock, flags);
+
+        sched_yield();
+
+        waitq_disarm(&e);
+        if (cond(arg)) return true;
+    }
+}
+
+/*
+ * waitq_wake_all - Wakes every thread sleeping on wq, returns how many
+ *
+ * Make the condition true before calling, a waiter that finds it false
+ * goes back to sleep.
+ */
+uint32_t waitq_wake_all(waitq_t* wq) {
+    thread_t* woken = NULL;
+    uint32_t n = 0;
+
+    bool flags = spinlock_acquire(&wq->lock);
+    waitq_entry_t* e = wq->head;
+    wq->head = NULL;
+    while (e) {
+        waitq_entry_t* next = e->next;
+        e->next = NULL;
+        e->queued = false;
+
+        // Same chaining as futex_wake(), a blocked thread sits on no queue
+        thread_t* t = e->thread;
+        t->rnext = woken;
+        woken = t;
+        n++;
+        e = next;
+    }
+    spinlock_release(&wq->lock, flags);
+
+    while (woken) {
+        thread_t* t = woken;
+        woken = t->rnext;
+        t->rnext = NULL;
+        sched_add(t);
+    }
+    return n;
+}
@@ -0,0 +1,47 @@
+/*
+ * waitq.h - Kernel wait queues with an optional timeout
+ *
+ * A waitq_t is what a kernel thread sleeps on until some condition, owned
+ * by whoever makes it true, holds. waitq_wait_timeout() is the equivalent of
+ * wait_event_timeout(): it checks the condition, queues the thread, checks
+ * again under the queue lock so a waitq_wake_all() in between is not lost,
+ * and sleeps until woken or the timeout runs out. The waker makes the
+ * condition true first, then calls waitq_wake_all(), from interrupt context
+ * too.
+ *
+ * The timeout is a ktimer_t, arming and cancelling it costs O(1) however
+ * many threads wait across the system.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <kernel/sys/spinlock.h>
+#include <kernel/sys/ktimer.h>
+
+struct thread;
+
+// Lives on the waiting thread's stack for the duration of one sleep
+typedef struct waitq_entry {
+    struct waitq_entry* next;
+    struct thread* thread;
+    struct waitq* wq;
+    ktimer_t timeout;
+    volatile bool queued;       // On wq, guarded by its lock
+    volatile bool timed_out;
+    volatile bool firing;       // Timeout armed and its callback not finished
+} waitq_entry_t;
+
+typedef struct waitq {
+    spinlock_t lock;
+    waitq_entry_t* head;
+} waitq_t;
+
+typedef bool (*waitq_cond_t)(void* arg);
+
+void waitq_init(waitq_t* wq, const char* name);
+bool waitq_wait_timeout(waitq_t* wq, waitq_cond_t cond, void* arg, uint64_t timeout_ms);
+uint32_t waitq_wake_all(waitq_t* wq);
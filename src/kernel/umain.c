@@ -11,6 +11,7 @@
 
 #include <kernel/sys/scheduler.h>
 #include <kernel/sys/process.h>
+#include <kernel/sys/uring.h>
 #include <kernel/drivers/tty.h>
 #include <kernel/uproc.h>
 
@@ -24,4 +25,16 @@ void uapps(void) {
 
     process_t* proc2 = process_create("donut", NULL);
     sched_add(thread_create(proc2, "donut_thread", donut_sim, NULL, true, 0));
+
+    process_t* proc3 = process_create("fibers", NULL);
+    sched_add(thread_create(proc3, "fiber_bench", fiber_bench, NULL, true, 0));
+
+    process_t* proc4 = process_create("clock", NULL);
+    sched_add(thread_create(proc4, "clock_bench", clock_bench, NULL, true, 0));
+
+    process_t* proc5 = process_create("uring", NULL);
+    sched_add(thread_create(proc5, "uring_bench", uring_bench, NULL, true, 0));
+
+    process_t* proc6 = process_create("uring_sqpoll", NULL);
+    sched_add(thread_create(proc6, "uring_bench", uring_bench, (void*)URING_SETUP_SQPOLL, true, 0));
 }
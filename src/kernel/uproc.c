@@ -14,8 +14,21 @@
 #include <ulibc/stdio.h>
 #include <ulibc/math.h>
 #include <ulibc/string.h>
+#include <ulibc/fiber.h>
+#include <ulibc/time.h>
+#include <ulibc/uring.h>
 #include <stdint.h>
 
+// Round trips timed by fiber_bench, per side
+#define BENCH_ROUNDS 100000
+
+// Submission ring size for uring_bench, one batch per enter
+#define URING_BENCH_BATCH 32
+
+// Donut frame reservation, 8 ms of CPU every 33 ms for a steady ~30 fps
+#define DONUT_RUNTIME_NS 8000000ULL
+#define DONUT_PERIOD_NS  33000000ULL
+
 /*
  * donut - Renders a spinning ASCII donut in the console using only syscalls
  */
@@ -35,9 +48,8 @@ void donut(void) {
 
     char* b = (char*)malloc(buffer_size);
     float* z = (float*)malloc(buffer_size * sizeof(float));
-    char* out_buf = (char*)malloc(buffer_size + 3);
 
-    if (!b || !z || !out_buf) return;
+    if (!b || !z) return;
 
     const float SIN_DJ = sin(0.07f), COS_DJ = cos(0.07f);
     const float SIN_DI = sin(0.02f), COS_DI = cos(0.02f);
@@ -46,9 +58,11 @@ void donut(void) {
 
     static const char shading[12] = ".,-~:;=!*#$@";
 
-    out_buf[0] = '\x1b';
-    out_buf[1] = '[';
-    out_buf[2] = 'H';
+    // Cursor home and the frame go out together, one write per frame without copying it
+    iovec_t frame[2] = {
+        { "\x1b[H", 3 },
+        { b, (size_t)buffer_size },
+    };
 
     float A = 0.0f, B = 0.0f;
 
@@ -109,11 +123,13 @@ void donut(void) {
             sinj = ns; cosj = nc;
         }
 
-        memcpy(out_buf + 3, b, buffer_size);
-        syscall_write(out_buf, buffer_size + 3);
+        syscall_writev(frame, 2);
 
         A += 0.04f;
         B += 0.02f;
+
+        // Frame done, under a deadline reservation this sleeps until the next period
+        syscall_yield();
     }
 }
 
@@ -151,5 +167,127 @@ void demo_threadB(void* arg) {
  */
 void donut_sim(void* arg) {
     (void)arg;
+
+    // Pure eye candy, a small reservation keeps frames steady without starving the shell,
+    // and if no CPU has the bandwidth it never competes with the shell at all
+    if (syscall_sched_deadline(DONUT_RUNTIME_NS, DONUT_PERIOD_NS, DONUT_PERIOD_NS) < 0)
+        syscall_set_priority(PRIO_LOWEST);
     donut();
-}   
\ No newline at end of file
+}
+
+static inline uint64_t bench_rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static void bench_fiber(void* arg) {
+    (void)arg;
+    for (int i = 0; i < BENCH_ROUNDS; i++)
+        fiber_yield();
+}
+
+/*
+ * fiber_bench - Compares a user mode fiber switch against a SYS_YIELD round trip, in TSC cycles
+ */
+void fiber_bench(void* arg) {
+    (void)arg;
+
+    fiber_spawn(bench_fiber, NULL);
+    fiber_spawn(bench_fiber, NULL);
+    uint64_t t0 = bench_rdtsc();
+    fiber_run();
+    uint64_t fiber_cycles = (bench_rdtsc() - t0) / (fiber_switches() ? fiber_switches() : 1);
+
+    t0 = bench_rdtsc();
+    for (int i = 0; i < BENCH_ROUNDS; i++)
+        syscall_yield();
+    uint64_t yield_cycles = (bench_rdtsc() - t0) / BENCH_ROUNDS;
+
+    printf("Fiber switch: %lu cycles, SYS_YIELD: %lu cycles (%lux)\n",
+           fiber_cycles, yield_cycles, fiber_cycles ? yield_cycles / fiber_cycles : 0);
+}
+
+static volatile uint32_t bench_word;
+
+/*
+ * clock_bench - Compares uptime_ns() from the time page against a minimal syscall round trip, in TSC cycles
+ */
+void clock_bench(void* arg) {
+    (void)arg;
+
+    // Every reading must be at or past the one before
+    uint64_t last = uptime_ns();
+    uint64_t backwards = 0;
+    uint64_t t0 = bench_rdtsc();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        uint64_t now = uptime_ns();
+        if (now < last) backwards++;
+        last = now;
+    }
+    uint64_t clock_cycles = (bench_rdtsc() - t0) / BENCH_ROUNDS;
+
+    // Waking a futex nobody waits on is about the cheapest a SYS_CLOCK_GETTIME could be
+    t0 = bench_rdtsc();
+    for (int i = 0; i < BENCH_ROUNDS; i++)
+        syscall_futex_wake(&bench_word, 1);
+    uint64_t syscall_cycles = (bench_rdtsc() - t0) / BENCH_ROUNDS;
+
+    timespec_t ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    printf("uptime_ns: %lu cycles, empty syscall: %lu cycles (%lux), %lu backwards, uptime %ld.%03ld s\n",
+           clock_cycles, syscall_cycles, clock_cycles ? syscall_cycles / clock_cycles : 0,
+           backwards, ts.tv_sec, ts.tv_nsec / 1000000);
+}
+
+/*
+ * bench_rate - Operations per second, ops done in ns nanoseconds, ops below 2^34
+ */
+static uint64_t bench_rate(uint64_t ops, uint64_t ns) {
+    return ns ? ops * 1000000000ULL / ns : 0;
+}
+
+/*
+ * uring_bench - Compares ops/sec of SYS_FUTEX_WAKE through the submission ring against direct syscalls
+ *
+ * arg carries the uring_init() flags, URING_SETUP_SQPOLL runs the same loop
+ * against the kernel's poller instead of one enter per batch.
+ */
+void uring_bench(void* arg) {
+    uint32_t flags = (uint32_t)(uintptr_t)arg;
+    const char* mode = (flags & URING_SETUP_SQPOLL) ? "sqpoll" : "enter";
+
+    uring_t ring;
+    if (uring_init(&ring, URING_BENCH_BATCH, flags) < 0) {
+        printf("uring %s: setup failed\n", mode);
+        return;
+    }
+
+    uint64_t t0 = uptime_ns();
+    for (int i = 0; i < BENCH_ROUNDS; i++)
+        syscall_futex_wake(&bench_word, 1);
+    uint64_t direct_ns = uptime_ns() - t0;
+
+    uint64_t sent = 0, done = 0, failed = 0;
+    t0 = uptime_ns();
+    while (done < BENCH_ROUNDS) {
+        uring_sqe_t* sqe;
+        while (sent < BENCH_ROUNDS && (sqe = uring_get_sqe(&ring)))
+            uring_prep(sqe, SYS_FUTEX_WAKE, (uint64_t)&bench_word, 1, 0, sent++);
+        uring_submit(&ring, 0);
+
+        uring_cqe_t* cqe;
+        while ((cqe = uring_peek_cqe(&ring))) {
+            if (cqe->res < 0) failed++;
+            done++;
+            uring_cqe_seen(&ring);
+        }
+    }
+    uint64_t ring_ns = uptime_ns() - t0;
+
+    uint64_t ring_rate = bench_rate(BENCH_ROUNDS, ring_ns);
+    uint64_t direct_rate = bench_rate(BENCH_ROUNDS, direct_ns);
+    uint64_t x100 = direct_rate ? ring_rate * 100 / direct_rate : 0;
+    printf("uring %s: %lu ops/s, direct syscalls: %lu ops/s (%lu.%02lux), %lu failed\n",
+           mode, ring_rate, direct_rate, x100 / 100, x100 % 100, failed);
+}
@@ -8,4 +8,7 @@
 
 void demo_threadA(void* arg);
 void demo_threadB(void* arg);
-void donut_sim(void* arg);
\ No newline at end of file
+void donut_sim(void* arg);
+void fiber_bench(void* arg);
+void clock_bench(void* arg);
+void uring_bench(void* arg);
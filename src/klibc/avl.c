@@ -9,6 +9,12 @@
 void avl_init(avl_tree_t* tree, avl_cmp_fn cmp) {
     tree->root = NULL;
     tree->cmp  = cmp;
+    tree->aug  = NULL;
+}
+
+void avl_init_augmented(avl_tree_t* tree, avl_cmp_fn cmp, avl_aug_fn aug) {
+    avl_init(tree, cmp);
+    tree->aug = aug;
 }
 
 #pragma region Internal AVL Helpers
@@ -17,9 +23,13 @@ static inline int node_h(const avl_node_t* n) {
     return n ? n->height : 0;
 }
 
-static inline void upd_height(avl_node_t* n) {
+/*
+ * Recompute height and, for augmented trees, the subtree data of n.
+ */
+static inline void upd_node(avl_tree_t* tree, avl_node_t* n) {
     int l = node_h(n->left), r = node_h(n->right);
     n->height = 1 + (l > r ? l : r);
+    if (tree->aug) tree->aug(n);
 }
 
 static inline int bal(avl_node_t* n) {
@@ -47,8 +57,8 @@ static avl_node_t* rot_right(avl_tree_t* tree, avl_node_t* y) {
     relink(tree, y->parent, y, x);
     x->right = y;  y->parent = x;
     y->left  = T;  if (T) T->parent = y;
-    upd_height(y);
-    upd_height(x);
+    upd_node(tree, y);
+    upd_node(tree, x);
     return x;
 }
 
@@ -58,8 +68,8 @@ static avl_node_t* rot_left(avl_tree_t* tree, avl_node_t* x) {
     relink(tree, x->parent, x, y);
     y->left  = x;  x->parent = y;
     x->right = T;  if (T) T->parent = x;
-    upd_height(x);
-    upd_height(y);
+    upd_node(tree, x);
+    upd_node(tree, y);
     return y;
 }
 
@@ -68,7 +78,7 @@ static avl_node_t* rot_left(avl_tree_t* tree, avl_node_t* x) {
  */
 static void fix_up(avl_tree_t* tree, avl_node_t* n) {
     while (n) {
-        upd_height(n);
+        upd_node(tree, n);
         int b = bal(n);
         if (b > 1) {
             if (bal(n->left) < 0)
@@ -93,6 +103,7 @@ static avl_node_t* subtree_min(avl_node_t* n) {
 void avl_insert(avl_tree_t* tree, avl_node_t* node) {
     node->left = node->right = node->parent = NULL;
     node->height = 1;
+    if (tree->aug) tree->aug(node);
 
     if (!tree->root) { tree->root = node; return; }
 
@@ -136,6 +147,11 @@ void avl_remove(avl_tree_t* tree, avl_node_t* node) {
     fix_up(tree, fix);
 }
 
+void avl_update(avl_tree_t* tree, avl_node_t* node) {
+    for (avl_node_t* n = node; n; n = n->parent)
+        upd_node(tree, n);
+}
+
 avl_node_t* avl_find(avl_tree_t* tree, avl_node_t* key) {
     avl_node_t* n = tree->root;
     while (n) {
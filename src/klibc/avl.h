@@ -4,6 +4,10 @@
  * Embed avl_node_t in any struct, create an avl_tree_t with a comparator,
  * and use the provided O(log N) operations. All traversal is non-recursive.
  *
+ * A tree may be augmented: the callback recomputes per-subtree data kept in
+ * the enclosing struct from the node's own key and its children, and is run
+ * bottom-up for every node whose subtree changed, rotations included.
+ *
  * Author: u/ApparentlyPlus
  */
 
@@ -26,14 +30,26 @@ typedef struct avl_node {
  */
 typedef int (*avl_cmp_fn)(const avl_node_t* a, const avl_node_t* b);
 
+/*
+ * Augmentation: recompute n's subtree data. Children are already up to date.
+ */
+typedef void (*avl_aug_fn)(avl_node_t* n);
+
 typedef struct {
     avl_node_t *root;
     avl_cmp_fn  cmp;
+    avl_aug_fn  aug;   /* NULL for a plain tree */
 } avl_tree_t;
 
 /* Initialize an empty tree with a comparator. */
 void avl_init(avl_tree_t* tree, avl_cmp_fn cmp);
 
+/* Initialize an empty augmented tree. */
+void avl_init_augmented(avl_tree_t* tree, avl_cmp_fn cmp, avl_aug_fn aug);
+
+/* Re-run the augmentation from node up to the root after its key data changed in place. */
+void avl_update(avl_tree_t* tree, avl_node_t* node);
+
 /* Insert node into tree. node must not already be in any tree. */
 void avl_insert(avl_tree_t* tree, avl_node_t* node);
 
@@ -0,0 +1,164 @@
+/*
+ * lz.c - Small LZ77 block codec
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#include <klibc/lz.h>
+#include <stdbool.h>
+
+#define LZ_MIN_MATCH 4
+
+static inline uint32_t lz_read32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t lz_hash(uint32_t seq) {
+    return (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/*
+ * lz_put_len - Emit the extension bytes for a nibble that saturated at 15
+ */
+static inline bool lz_put_len(uint8_t** op, uint8_t* oend, size_t len) {
+    uint8_t* o = *op;
+    while (len >= 255) {
+        if (o >= oend) return false;
+        *o++ = 255;
+        len -= 255;
+    }
+    if (o >= oend) return false;
+    *o++ = (uint8_t)len;
+    *op = o;
+    return true;
+}
+
+/*
+ * lz_emit - Emit one sequence. mlen == 0 marks the final literal only sequence
+ */
+static bool lz_emit(uint8_t** op, uint8_t* oend, const uint8_t* lit, size_t lit_len,
+                    size_t offset, size_t mlen) {
+    uint8_t* o = *op;
+    if (o >= oend) return false;
+
+    size_t mcode = mlen ? mlen - LZ_MIN_MATCH : 0;
+    uint8_t* token = o++;
+    *token = (uint8_t)(((lit_len < 15 ? lit_len : 15) << 4) | (mcode < 15 ? mcode : 15));
+
+    if (lit_len >= 15 && !lz_put_len(&o, oend, lit_len - 15)) return false;
+
+    if ((size_t)(oend - o) < lit_len) return false;
+    for (size_t i = 0; i < lit_len; i++) o[i] = lit[i];
+    o += lit_len;
+
+    if (mlen) {
+        if (oend - o < 2) return false;
+        *o++ = (uint8_t)offset;
+        *o++ = (uint8_t)(offset >> 8);
+        if (mcode >= 15 && !lz_put_len(&o, oend, mcode - 15)) return false;
+    }
+
+    *op = o;
+    return true;
+}
+
+/*
+ * lz_compress - Greedy single probe compressor
+ */
+size_t lz_compress(const void* src_v, size_t n, void* dst_v, size_t cap, uint16_t* table) {
+    const uint8_t* src = (const uint8_t*)src_v;
+    uint8_t* op = (uint8_t*)dst_v;
+    uint8_t* oend = op + cap;
+
+    if (!src || !op || !table || n == 0 || n > LZ_MAX_INPUT) return 0;
+
+    // Entries hold position + 1 so that 0 means empty
+    for (size_t i = 0; i < LZ_HASH_ENTRIES; i++) table[i] = 0;
+
+    size_t anchor = 0;
+    size_t ip = 0;
+
+    while (ip + LZ_MIN_MATCH <= n) {
+        uint32_t seq = lz_read32(src + ip);
+        uint32_t h = lz_hash(seq);
+        size_t ref = table[h];
+        table[h] = (uint16_t)(ip + 1);
+
+        if (!ref || lz_read32(src + ref - 1) != seq) {
+            ip++;
+            continue;
+        }
+
+        size_t mpos = ref - 1;
+        size_t mlen = LZ_MIN_MATCH;
+        while (ip + mlen < n && src[mpos + mlen] == src[ip + mlen]) mlen++;
+
+        if (!lz_emit(&op, oend, src + anchor, ip - anchor, ip - mpos, mlen)) return 0;
+
+        ip += mlen;
+        anchor = ip;
+    }
+
+    if (!lz_emit(&op, oend, src + anchor, n - anchor, 0, 0)) return 0;
+
+    return (size_t)(op - (uint8_t*)dst_v);
+}
+
+/*
+ * lz_get_len - Read extension bytes following a saturated nibble
+ */
+static inline bool lz_get_len(const uint8_t** ip, const uint8_t* iend, size_t* len) {
+    const uint8_t* i = *ip;
+    uint8_t b;
+    do {
+        if (i >= iend) return false;
+        b = *i++;
+        *len += b;
+    } while (b == 255);
+    *ip = i;
+    return true;
+}
+
+/*
+ * lz_decompress - Bounds checked decoder
+ */
+size_t lz_decompress(const void* src_v, size_t n, void* dst_v, size_t cap) {
+    const uint8_t* ip = (const uint8_t*)src_v;
+    const uint8_t* iend = ip + n;
+    uint8_t* dst = (uint8_t*)dst_v;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + cap;
+
+    if (!ip || !dst || n == 0) return 0;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && !lz_get_len(&ip, iend, &lit_len)) return 0;
+        if ((size_t)(iend - ip) < lit_len || (size_t)(oend - op) < lit_len) return 0;
+        for (size_t i = 0; i < lit_len; i++) op[i] = ip[i];
+        ip += lit_len;
+        op += lit_len;
+
+        // Final sequence has no match part
+        if (ip == iend) break;
+
+        if (iend - ip < 2) return 0;
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) return 0;
+
+        size_t mlen = token & 15;
+        if (mlen == 15 && !lz_get_len(&ip, iend, &mlen)) return 0;
+        mlen += LZ_MIN_MATCH;
+        if ((size_t)(oend - op) < mlen) return 0;
+
+        // Byte copy on purpose: overlapping matches encode runs
+        const uint8_t* m = op - offset;
+        for (size_t i = 0; i < mlen; i++) op[i] = m[i];
+        op += mlen;
+    }
+
+    return (size_t)(op - dst);
+}
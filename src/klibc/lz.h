@@ -0,0 +1,33 @@
+/*
+ * lz.h - Small LZ77 block codec
+ *
+ * LZ4-style byte oriented format: each sequence is a token (literal length
+ * in the high nibble, match length - 4 in the low nibble), optional length
+ * extension bytes, the literals, and a 16-bit little endian match offset.
+ * The final sequence carries literals only. No allocation, no SSE, so it is
+ * safe to call from the page fault path.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LZ_HASH_BITS    10
+#define LZ_HASH_ENTRIES (1u << LZ_HASH_BITS)
+#define LZ_MAX_INPUT    0xFFFF  // positions are kept in 16 bits
+
+/*
+ * Compress n bytes of src into dst. table is caller provided scratch of
+ * LZ_HASH_ENTRIES entries. Returns the compressed size, or 0 if the output
+ * does not fit in cap bytes.
+ */
+size_t lz_compress(const void* src, size_t n, void* dst, size_t cap, uint16_t* table);
+
+/*
+ * Decompress n bytes of src into dst. Returns the decompressed size, or 0 if
+ * the stream is malformed or would overflow cap bytes.
+ */
+size_t lz_decompress(const void* src, size_t n, void* dst, size_t cap);
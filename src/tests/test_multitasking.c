@@ -4,9 +4,12 @@
  * Tests every public function: process_create/destroy, thread_create,
  * thread_create_bootstrap, thread_destroy, process_get_all,
  * procs_kill_tty, proc_hdr_update, sched_active,
- * sched_current, sched_add, sched_yield.
+ * sched_current, sched_add, sched_yield, sched_set_priority, sched_boost,
+ * smp_cpu_count.
  * Covers PID/TID uniqueness, context layout, stack alignment, name truncation,
- * global process list, and shared TTY.
+ * global process list, shared TTY, CPU bound scaling across cores, reclaim
+ * racing a writer on another core, and keystroke wakeup latency under CPU
+ * bound load.
  * 
  * Author: Claude Code
  */
@@ -14,10 +17,21 @@
 #include <kernel/sys/process.h>
 #include <kernel/sys/scheduler.h>
 #include <kernel/sys/userspace.h>
+#include <kernel/sys/smp.h>
+#include <kernel/sys/timers.h>
+#include <kernel/sys/hrtimer.h>
+#include <kernel/sys/futex.h>
+#include <kernel/sys/waitq.h>
+#include <kernel/sys/vvar.h>
+#include <kernel/sys/syscall.h>
+#include <kernel/sys/uring.h>
 #include <kernel/memory/heap.h>
 #include <kernel/memory/vmm.h>
 #include <arch/x86_64/cpu/gdt.h>
+#include <arch/x86_64/cpu/fpu.h>
+#include <arch/x86_64/cpu/usercopy.h>
 #include <arch/x86_64/memory/layout.h>
+#include <arch/x86_64/memory/paging.h>
 #include <kernel/debug.h>
 #include <tests/tests.h>
 #include <klibc/string.h>
@@ -378,6 +392,32 @@ static bool t_shared_tty(void) {
     process_destroy(owner);
     return true;
 }
+
+/* Every process sees the kernel's time page, read only */
+static bool t_vvar_mapped(void) {
+    process_t* p = process_create("t_vvar", NULL);
+    TEST_ASSERT(p != NULL);
+    uint64_t phys = 0;
+    TEST_ASSERT(vmm_get_physical(p->vmm, (void*)USER_VVAR_VIRT_ADDR, &phys));
+    TEST_ASSERT(phys == KERNEL_V2P((uintptr_t)vvar_get()));
+    TEST_ASSERT(vmm_check_buffer(p->vmm, (void*)USER_VVAR_VIRT_ADDR, sizeof(vvar_t), VM_FLAG_USER));
+    TEST_ASSERT(!vmm_check_buffer(p->vmm, (void*)USER_VVAR_VIRT_ADDR, sizeof(vvar_t), VM_FLAG_USER | VM_FLAG_WRITE));
+    process_destroy(p);
+    return true;
+}
+
+/* The fixed point conversion user space does agrees with the kernel's clock */
+static bool t_vvar_uptime(void) {
+    const vvar_t* v = vvar_get();
+    TEST_ASSERT((v->seq & 1) == 0);
+    TEST_ASSERT(v->mult != 0);
+    uint64_t before = get_uptime_ns();
+    uint64_t ns = (uint64_t)(((unsigned __int128)(tsc_read() - v->boot_tsc) * v->mult) >> v->shift);
+    uint64_t after = get_uptime_ns();
+    LOGF("(%lu ns vs %lu) ", ns, before);
+    TEST_ASSERT(ns + 100000 >= before && ns <= after + 100000);
+    return true;
+}
 #pragma endregion
 
 #pragma region Header Update
@@ -422,6 +462,1172 @@ static bool t_bootstrap(void) {
 }
 #pragma endregion
 
+#pragma region SMP
+
+#define SPIN_ITERS 20000000ULL
+
+static volatile uint32_t spin_done = 0;
+
+static void spin_entry(void* arg) {
+    (void)arg;
+    for (volatile uint64_t i = 0; i < SPIN_ITERS; i++) { }
+    __atomic_fetch_add(&spin_done, 1, __ATOMIC_RELEASE);
+    sched_exit();
+}
+
+/* Runs n CPU bound threads, returns the wall time in ms, spin_done tells how many finished */
+static uint64_t spin_run(uint32_t n) {
+    process_t* p = process_create("t_spin", active_tty);
+    if (!p) return 0;
+
+    spin_done = 0;
+    uint64_t start = get_uptime_ms();
+    for (uint32_t i = 0; i < n; i++)
+        sched_add(thread_create(p, "spin", spin_entry, NULL, false, 0));
+
+    while (__atomic_load_n(&spin_done, __ATOMIC_ACQUIRE) < n && get_uptime_ms() - start < 10000)
+        sched_sleep(1);
+    return get_uptime_ms() - start;
+}
+
+static bool t_smp_topology(void) {
+    TEST_ASSERT(smp_cpu_count() >= 1);
+    TEST_ASSERT(smp_cpu(0)->online);
+
+    /* No migration between the two reads */
+    bool iflag = intr_save();
+    uint32_t index = this_cpu()->index;
+    uint32_t last = sched_current()->cpu;
+    intr_restore(iflag);
+
+    TEST_ASSERT(index < smp_cpu_count());
+    TEST_ASSERT(last == index);
+    return true;
+}
+
+static bool t_smp_speedup(void) {
+    uint32_t n = smp_cpu_count();
+    uint64_t one = spin_run(1);
+    TEST_ASSERT(spin_done == 1);
+    uint64_t all = spin_run(n);
+    TEST_ASSERT(spin_done == n);
+
+    /* Reported only, emulated vCPUs need not run in parallel */
+    uint64_t x100 = all ? one * n * 100 / all : 0;
+    LOGF("(%u CPUs: 1 thread %lu ms, %u threads %lu ms, %lu.%02lux) ", n, one, n, all, x100 / 100, x100 % 100);
+    return true;
+}
+
+static volatile bool swp_stop = false;
+static volatile bool swp_done = false;
+static volatile bool swp_lost = false;
+static volatile uint64_t swp_writes = 0;
+
+/* Counts up in a user word and checks every step survived, the page is swapped out under it */
+static void swp_writer(void* arg) {
+    uint64_t* u = arg;
+    uint64_t k = 0;
+
+    while (!swp_stop) {
+        // Brief gaps let the clock find the page unreferenced, the writes between race the swap-out
+        if ((k & 63) == 63)
+            for (int i = 0; i < 2000; i++) __asm__ volatile("pause");
+
+        uint64_t v = ~0ULL;
+        if (copy_from_user(&v, u, sizeof(v)) || v != k) {
+            swp_lost = true;
+            break;
+        }
+        k++;
+        if (copy_to_user(u, &k, sizeof(k))) {
+            swp_lost = true;
+            break;
+        }
+    }
+
+    swp_writes = k;
+    __atomic_store_n(&swp_done, true, __ATOMIC_RELEASE);
+    sched_exit();
+}
+
+/* Reclaim racing a writer of the same address space on another CPU must not drop a write */
+static bool t_smp_swap_race(void) {
+    process_t* p = process_create("t_swap_race", NULL);
+    TEST_ASSERT(p != NULL);
+    void* u = NULL;
+    TEST_ASSERT(vmm_alloc(p->vmm, PAGE_SIZE, VM_FLAG_USER | VM_FLAG_WRITE | VM_FLAG_LAZY, NULL, &u) == VMM_OK);
+
+    swp_stop = false;
+    swp_done = false;
+    swp_lost = false;
+    sched_add(thread_create(p, "swp", swp_writer, u, false, 0));
+
+    uint64_t t0 = get_uptime_ms();
+    while (!swp_lost && get_uptime_ms() - t0 < 200)
+        vmm_reclaim(64);
+
+    // Read while the writer still keeps the process alive
+    uint64_t majflt = 0;
+    vmm_usage(p->vmm, NULL, NULL, NULL, &majflt);
+
+    swp_stop = true;
+    t0 = get_uptime_ms();
+    while (!__atomic_load_n(&swp_done, __ATOMIC_ACQUIRE) && get_uptime_ms() - t0 < 1000)
+        sched_sleep(1);
+    LOGF("(%lu writes, %lu swap-ins) ", swp_writes, majflt);
+
+    TEST_ASSERT(swp_done);
+    TEST_ASSERT(!swp_lost);
+    TEST_ASSERT(majflt > 0);
+    return true;
+}
+#pragma endregion
+
+#pragma region Priorities
+
+static volatile bool hog_stop = false;
+static volatile uint32_t prio_exited = 0;
+static volatile uint64_t echo_ns = 0;
+
+static void hog_entry(void* arg) {
+    (void)arg;
+    while (!hog_stop) __asm__ volatile("pause");
+    __atomic_fetch_add(&prio_exited, 1, __ATOMIC_RELEASE);
+    sched_exit();
+}
+
+static void echo_entry(void* arg) {
+    tty_read_char((tty_t*)arg);
+    echo_ns = get_uptime_ns();
+    __atomic_fetch_add(&prio_exited, 1, __ATOMIC_RELEASE);
+    sched_exit();
+}
+
+static bool t_prio_default(void) {
+    process_t* p = process_create("t_prio", NULL);
+    thread_t* t = thread_create(p, "t", kentry, NULL, false, 0);
+    TEST_ASSERT(t->prio == SCHED_PRIO_DEFAULT);
+    TEST_ASSERT(t->base_prio == SCHED_PRIO_DEFAULT);
+    process_destroy(p);
+    return true;
+}
+
+static bool t_prio_set(void) {
+    process_t* p = process_create("t_prio_set", NULL);
+    thread_t* t = thread_create(p, "t", kentry, NULL, false, 0);
+    TEST_ASSERT(sched_set_priority(t, 24));
+    TEST_ASSERT(t->prio == 24 && t->base_prio == 24);
+    TEST_ASSERT(!sched_set_priority(t, SCHED_PRIO_LEVELS));
+    TEST_ASSERT(t->base_prio == 24);
+    process_destroy(p);
+    return true;
+}
+
+static bool t_prio_boost(void) {
+    process_t* p = process_create("t_prio_boost", NULL);
+    thread_t* t = thread_create(p, "t", kentry, NULL, false, 0);
+    sched_boost(t);
+    TEST_ASSERT(t->prio == SCHED_PRIO_DEFAULT - SCHED_PRIO_BOOST);
+    TEST_ASSERT(t->base_prio == SCHED_PRIO_DEFAULT);
+    sched_set_priority(t, 2);
+    sched_boost(t);
+    TEST_ASSERT(t->prio == 0);
+    process_destroy(p);
+    return true;
+}
+
+/* A key press must reach a blocked reader within a few slices even with every CPU busy */
+static bool t_prio_echo_latency(void) {
+    process_t* p = process_create("t_echo", NULL);
+    TEST_ASSERT(p != NULL);
+
+    uint32_t nhogs = smp_cpu_count() * 2;
+    hog_stop = false;
+    prio_exited = 0;
+    echo_ns = 0;
+
+    for (uint32_t i = 0; i < nhogs; i++)
+        sched_add(thread_create(p, "hog", hog_entry, NULL, false, 0));
+    sched_add(thread_create(p, "echo", echo_entry, p->tty, false, 0));
+
+    /* Let the reader block and the hogs saturate every CPU */
+    sched_sleep(50);
+
+    uint64_t start = get_uptime_ns();
+    tty_input(p->tty, 'k');
+    tty_input(p->tty, '\n');
+    while (!echo_ns && get_uptime_ns() - start < 1000000000ULL)
+        sched_sleep(1);
+
+    uint64_t latency = echo_ns ? echo_ns - start : UINT64_MAX;
+    hog_stop = true;
+    while (__atomic_load_n(&prio_exited, __ATOMIC_ACQUIRE) < nhogs + 1)
+        sched_sleep(1);
+
+    LOGF("(%u hogs, echo after %lu us) ", nhogs, latency / 1000);
+
+    /* Wall clock under emulation is noisy, the log above shows the boost, this only catches starvation */
+    TEST_ASSERT(latency < (uint64_t)SCHED_QUANTUM_MS * 1000000ULL * 4);
+    return true;
+}
+#pragma endregion
+
+#pragma region Deadline Class
+
+#define DL_MS       1000000ULL
+#define DL_JOBS     20
+#define DL_SLACK    2   // misses tolerated, an emulated or shared host loses a period now and then
+
+static volatile uint32_t dl_jobs = 0;
+static volatile uint64_t dl_misses = 0;
+static volatile bool dl_stop = false;
+
+static void dl_periodic_entry(void* arg) {
+    (void)arg;
+    for (uint32_t i = 0; i < DL_JOBS; i++) {
+        __atomic_fetch_add(&dl_jobs, 1, __ATOMIC_RELEASE);
+        sched_yield();
+    }
+    dl_misses = sched_current()->dl_misses;
+    __atomic_fetch_add(&prio_exited, 1, __ATOMIC_RELEASE);
+    sched_exit();
+}
+
+static void dl_spin_entry(void* arg) {
+    (void)arg;
+    while (!dl_stop) __asm__ volatile("pause");
+    dl_misses = sched_current()->dl_misses;
+    __atomic_fetch_add(&prio_exited, 1, __ATOMIC_RELEASE);
+    sched_exit();
+}
+
+static bool t_dl_reject(void) {
+    process_t* p = process_create("t_dl_reject", NULL);
+    thread_t* t = thread_create(p, "t", kentry, NULL, false, 0);
+    TEST_ASSERT(!sched_set_deadline(t, 5 * DL_MS, 2 * DL_MS, 10 * DL_MS));
+    TEST_ASSERT(!sched_set_deadline(t, 1 * DL_MS, 20 * DL_MS, 10 * DL_MS));
+    TEST_ASSERT(!sched_set_deadline(t, SCHED_DL_MIN_NS - 1, 10 * DL_MS, 10 * DL_MS));
+    TEST_ASSERT(!sched_set_deadline(t, 1 * DL_MS, 10 * DL_MS, SCHED_DL_MAX_NS + 1));
+    TEST_ASSERT(t->dl_period == 0);
+    process_destroy(p);
+    return true;
+}
+
+/* 30% reservations until a refusal, freeing one must make room again */
+static bool t_dl_admission(void) {
+    process_t* p = process_create("t_dl_admit", NULL);
+    uint32_t limit = smp_cpu_count() * 3;
+    thread_t* ts[MAX_CPUS * 3 + 1];
+    uint32_t n = 0;
+
+    while (n <= limit) {
+        ts[n] = thread_create(p, "dl", kentry, NULL, false, 0);
+        if (!sched_set_deadline(ts[n], 3 * DL_MS, 10 * DL_MS, 10 * DL_MS)) break;
+        n++;
+    }
+
+    TEST_ASSERT(n >= 1 && n <= limit);
+    TEST_ASSERT(ts[n]->dl_period == 0);
+    TEST_ASSERT(sched_set_deadline(ts[0], 0, 0, 0));
+    TEST_ASSERT(ts[0]->dl_period == 0);
+    TEST_ASSERT(sched_set_deadline(ts[n], 3 * DL_MS, 10 * DL_MS, 10 * DL_MS));
+
+    /* Destroying the threads hands their bandwidth back */
+    process_destroy(p);
+    p = process_create("t_dl_admit2", NULL);
+    thread_t* t = thread_create(p, "dl", kentry, NULL, false, 0);
+    TEST_ASSERT(sched_set_deadline(t, 3 * DL_MS, 10 * DL_MS, 10 * DL_MS));
+    process_destroy(p);
+    return true;
+}
+
+/* Periodic jobs keep their deadlines, give or take DL_SLACK, while hogs saturate all CPUs */
+static bool t_dl_periodic(void) {
+    process_t* p = process_create("t_dl_periodic", NULL);
+    TEST_ASSERT(p != NULL);
+
+    uint32_t nhogs = smp_cpu_count() * 2;
+    hog_stop = false;
+    prio_exited = 0;
+    dl_jobs = 0;
+    dl_misses = UINT64_MAX;
+
+    for (uint32_t i = 0; i < nhogs; i++)
+        sched_add(thread_create(p, "hog", hog_entry, NULL, false, 0));
+
+    thread_t* t = thread_create(p, "dl", dl_periodic_entry, NULL, false, 0);
+    TEST_ASSERT(sched_set_deadline(t, 2 * DL_MS, 20 * DL_MS, 20 * DL_MS));
+
+    uint64_t start = get_uptime_ms();
+    sched_add(t);
+    while (__atomic_load_n(&prio_exited, __ATOMIC_ACQUIRE) < 1 && get_uptime_ms() - start < 5000)
+        sched_sleep(1);
+    uint64_t took = get_uptime_ms() - start;
+
+    hog_stop = true;
+    while (__atomic_load_n(&prio_exited, __ATOMIC_ACQUIRE) < nhogs + 1)
+        sched_sleep(1);
+
+    LOGF("(%u jobs in %lu ms, %lu misses) ", dl_jobs, took, dl_misses);
+    TEST_ASSERT(dl_jobs == DL_JOBS);
+    TEST_ASSERT(dl_misses <= DL_SLACK);
+
+    /* One job per period, yielding must not have run them back to back, a missed one may start early */
+    TEST_ASSERT(took >= (DL_JOBS - 2 - DL_SLACK) * 20);
+    return true;
+}
+
+/* A thread that never yields is throttled once its budget is gone */
+static bool t_dl_throttle(void) {
+    process_t* p = process_create("t_dl_throttle", NULL);
+    TEST_ASSERT(p != NULL);
+
+    prio_exited = 0;
+    dl_stop = false;
+
+    thread_t* t = thread_create(p, "dl_spin", dl_spin_entry, NULL, false, 0);
+    TEST_ASSERT(sched_set_deadline(t, 2 * DL_MS, 20 * DL_MS, 20 * DL_MS));
+    sched_add(t);
+
+    uint32_t throttled = 0;
+    for (int i = 0; i < 200; i++) {
+        if (t->dl_throttled) throttled++;
+        sched_sleep(1);
+    }
+
+    dl_stop = true;
+    while (__atomic_load_n(&prio_exited, __ATOMIC_ACQUIRE) < 1)
+        sched_sleep(1);
+
+    LOGF("(throttled in %u/200 samples) ", throttled);
+    TEST_ASSERT(throttled > 0);
+    TEST_ASSERT(dl_misses <= DL_SLACK);
+    return true;
+}
+#pragma endregion
+
+#pragma region Sleep Resolution
+
+#define JIT_SAMPLES 200
+
+/* Periodic fallback wakes ride the 10 ms tick */
+#define JIT_TICK_NS 10000000ULL
+
+static uint64_t jit_err[JIT_SAMPLES];
+static volatile uint64_t jit_fired_ns = 0;
+static volatile bool us_done = false;
+static volatile bool us_release = false;
+
+static void jit_cb(hrtimer_t* timer, void* arg) {
+    (void)timer;
+    (void)arg;
+    jit_fired_ns = get_uptime_ns();
+}
+
+static void us_sleeper(void* arg) {
+    (void)arg;
+    sleep_us(20000);
+    us_done = true;
+    while (!us_release) sched_sleep(1);
+    __atomic_fetch_add(&prio_exited, 1, __ATOMIC_RELEASE);
+    sched_exit();
+}
+
+/* Sorts the wake errors and logs their percentiles, returns the median */
+static uint64_t jitter_report(const char* what, uint64_t* err, uint32_t n) {
+    for (uint32_t i = 1; i < n; i++) {
+        uint64_t v = err[i];
+        uint32_t j = i;
+        for (; j > 0 && err[j - 1] > v; j--) err[j] = err[j - 1];
+        err[j] = v;
+    }
+
+    LOGF("(%s error p50 %lu us, p90 %lu us, p99 %lu us, max %lu us) ", what,
+         err[n / 2] / 1000, err[n * 9 / 10] / 1000, err[n * 99 / 100] / 1000, err[n - 1] / 1000);
+    return err[n / 2];
+}
+
+/* Blocking sleeps from 50 us to 950 us, never early and close to the deadline when tickless */
+static bool t_nsleep_jitter(void) {
+    bool early = false;
+
+    for (uint32_t i = 0; i < JIT_SAMPLES; i++) {
+        uint64_t want = 50000ULL + (i % 10) * 100000ULL;
+        uint64_t start = get_uptime_ns();
+        sched_sleep_ns(want);
+        uint64_t took = get_uptime_ns() - start;
+        if (took < want) early = true;
+        jit_err[i] = took > want ? took - want : 0;
+    }
+
+    uint64_t p50 = jitter_report("sleep", jit_err, JIT_SAMPLES);
+    TEST_ASSERT(!early);
+    TEST_ASSERT(p50 < (timer_tickless() ? 1000000ULL : 2 * JIT_TICK_NS));
+    return true;
+}
+
+/* hrtimer callbacks from 20 us to 470 us out */
+static bool t_hrtimer_jitter(void) {
+    hrtimer_t t;
+    hrtimer_setup(&t, jit_cb, NULL);
+    bool early = false;
+
+    for (uint32_t i = 0; i < JIT_SAMPLES; i++) {
+        uint64_t deadline = get_uptime_ns() + 20000ULL + (i % 10) * 50000ULL;
+        jit_fired_ns = 0;
+        hrtimer_arm(&t, deadline);
+        while (!jit_fired_ns && get_uptime_ns() < deadline + 4 * JIT_TICK_NS)
+            __asm__ volatile("pause");
+        hrtimer_cancel(&t);
+
+        uint64_t fired = jit_fired_ns ? jit_fired_ns : UINT64_MAX;
+        if (fired < deadline) early = true;
+        jit_err[i] = fired > deadline ? fired - deadline : 0;
+    }
+
+    uint64_t p50 = jitter_report("hrtimer", jit_err, JIT_SAMPLES);
+    TEST_ASSERT(!early);
+    TEST_ASSERT(p50 < (timer_tickless() ? 1000000ULL : 2 * JIT_TICK_NS));
+    return true;
+}
+
+/* A 20 ms sleep_us() from a thread must put it to sleep rather than spin */
+static bool t_sleep_us_blocks(void) {
+    if (!timer_tickless()) { LOGF("[SKIP] "); return true; }
+
+    process_t* p = process_create("t_sleep_us", NULL);
+    TEST_ASSERT(p != NULL);
+
+    prio_exited = 0;
+    us_done = false;
+    us_release = false;
+    thread_t* t = thread_create(p, "us_sleeper", us_sleeper, NULL, false, 0);
+    sched_add(t);
+
+    bool slept = false;
+    while (!us_done) {
+        if (t->state == T_SLEEPING) slept = true;
+        sched_sleep_ns(500000);
+    }
+
+    us_release = true;
+    while (__atomic_load_n(&prio_exited, __ATOMIC_ACQUIRE) < 1)
+        sched_sleep(1);
+
+    TEST_ASSERT(slept);
+    return true;
+}
+#pragma endregion
+
+#pragma region Accounting
+
+static volatile uint64_t acct_run = 0, acct_wait = 0, acct_vol = 0, acct_invol = 0;
+
+/* Spins for ms of wall time, sleeps once so the last stretch is charged, then reports */
+static void acct_entry(void* arg) {
+    uint64_t until = get_uptime_ms() + (uint64_t)(uintptr_t)arg;
+    while (get_uptime_ms() < until) __asm__ volatile("pause");
+    sched_sleep(1);
+
+    thread_t* self = sched_current();
+    acct_run = self->run_tsc;
+    acct_wait = self->wait_tsc;
+    acct_vol = self->nvcsw;
+    acct_invol = self->nivcsw;
+    __atomic_fetch_add(&prio_exited, 1, __ATOMIC_RELEASE);
+    sched_exit();
+}
+
+static bool t_acct_runtime(void) {
+    process_t* p = process_create("t_acct", NULL);
+    TEST_ASSERT(p != NULL);
+
+    prio_exited = 0;
+    sched_add(thread_create(p, "acct", acct_entry, (void*)(uintptr_t)30, false, 0));
+    while (__atomic_load_n(&prio_exited, __ATOMIC_ACQUIRE) < 1)
+        sched_sleep(1);
+
+    uint64_t run_ms = tsc_ticks_to_ns(acct_run) / 1000000;
+    uint64_t wait_ms = tsc_ticks_to_ns(acct_wait) / 1000000;
+    LOGF("(ran %lu ms, waited %lu ms, %lu voluntary) ", run_ms, wait_ms, acct_vol);
+
+    /* 30 ms of wall time spinning is spent either on a CPU or queued for one */
+    TEST_ASSERT(run_ms + wait_ms >= 29);
+    TEST_ASSERT(run_ms > 0);
+    TEST_ASSERT(acct_vol >= 1);
+    return true;
+}
+
+/* Against two hogs per CPU the spinner must be preempted and wait its turn */
+static bool t_acct_preempt(void) {
+    process_t* p = process_create("t_acct_pre", NULL);
+    TEST_ASSERT(p != NULL);
+
+    uint32_t nhogs = smp_cpu_count() * 2;
+    hog_stop = false;
+    prio_exited = 0;
+
+    uint64_t hist0[SCHED_LAT_BUCKETS], hist1[SCHED_LAT_BUCKETS];
+    sched_latency_histogram(hist0);
+
+    for (uint32_t i = 0; i < nhogs; i++)
+        sched_add(thread_create(p, "hog", hog_entry, NULL, false, 0));
+    sched_add(thread_create(p, "acct", acct_entry, (void*)(uintptr_t)100, false, 0));
+
+    while (__atomic_load_n(&prio_exited, __ATOMIC_ACQUIRE) < 1)
+        sched_sleep(1);
+    hog_stop = true;
+    while (__atomic_load_n(&prio_exited, __ATOMIC_ACQUIRE) < nhogs + 1)
+        sched_sleep(1);
+
+    sched_latency_histogram(hist1);
+    uint64_t switches = 0;
+    for (uint32_t b = 0; b < SCHED_LAT_BUCKETS; b++) switches += hist1[b] - hist0[b];
+
+    LOGF("(%lu involuntary, waited %lu ms, %lu picks) ", acct_invol,
+         tsc_ticks_to_ns(acct_wait) / 1000000, switches);
+    TEST_ASSERT(acct_invol >= 1);
+    TEST_ASSERT(acct_wait > 0);
+    TEST_ASSERT(switches > nhogs);
+    return true;
+}
+
+static bool t_acct_usage(void) {
+    uint64_t idle0, total0, idle1, total1;
+    sched_cpu_usage(&idle0, &total0);
+    sched_sleep(20);
+    sched_cpu_usage(&idle1, &total1);
+
+    /* Every online CPU contributes wall time */
+    uint64_t d_total_ms = tsc_ticks_to_ns(total1 - total0) / 1000000;
+    TEST_ASSERT(d_total_ms >= 19 * smp_cpu_count());
+    TEST_ASSERT(idle1 >= idle0 && idle1 - idle0 <= total1 - total0);
+
+    sched_dump_stats(); /* must not crash */
+    return true;
+}
+
+/* A kernel thread never leaves ring 0, all of its time is system time, the running slice included */
+static bool t_acct_rusage(void) {
+    thread_t* self = sched_current();
+    rusage_t r0, r1, rp;
+    thread_rusage(self, &r0);
+
+    uint64_t until = get_uptime_ms() + 10;
+    while (get_uptime_ms() < until) __asm__ volatile("pause");
+
+    thread_rusage(self, &r1);
+    process_rusage(self->process, &rp);
+    TEST_ASSERT(r1.utime_ns == 0);
+    TEST_ASSERT(r1.stime_ns - r0.stime_ns >= 9000000);
+    TEST_ASSERT(rp.stime_ns >= r1.stime_ns);
+    TEST_ASSERT(rp.nvcsw >= r1.nvcsw);
+    return true;
+}
+#pragma endregion
+
+#pragma region Context Switch
+
+#define PP_ROUNDS 2000
+
+static volatile uint32_t pp_turn = 0;
+static volatile uint64_t pp_yields = 0;
+
+/* Passes the turn back and forth, yielding while it is the partner's, and checks its locals survive */
+static void pp_entry(void* arg) {
+    uint32_t me = (uint32_t)(uintptr_t)arg;
+    uint64_t sum = 0, yields = 0;
+
+    for (uint32_t i = 0; i < PP_ROUNDS; i++) {
+        while (__atomic_load_n(&pp_turn, __ATOMIC_ACQUIRE) != me) {
+            sched_yield();
+            yields++;
+        }
+        sum += i;
+        __atomic_store_n(&pp_turn, me ^ 1, __ATOMIC_RELEASE);
+    }
+
+    /* Callee saved registers come back intact through either switch path */
+    if (sum != (uint64_t)PP_ROUNDS * (PP_ROUNDS - 1) / 2) yields = 0;
+    __atomic_fetch_add(&pp_yields, yields, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&prio_exited, 1, __ATOMIC_RELEASE);
+    sched_exit();
+}
+
+/* Runs one ping-pong and returns TSC ticks per yield, 0 if a thread saw corrupt state */
+static uint64_t pp_run(bool direct) {
+    process_t* p = process_create("t_pingpong", NULL);
+    if (!p) return 0;
+
+    sched_set_direct_yield(direct);
+    pp_turn = 0;
+    pp_yields = 0;
+    prio_exited = 0;
+
+    uint64_t t0 = tsc_read();
+    sched_add(thread_create(p, "ping", pp_entry, (void*)0, false, 0));
+    sched_add(thread_create(p, "pong", pp_entry, (void*)1, false, 0));
+    while (__atomic_load_n(&prio_exited, __ATOMIC_ACQUIRE) < 2)
+        sched_sleep(1);
+    uint64_t t1 = tsc_read();
+
+    sched_set_direct_yield(true);
+    return pp_yields ? (t1 - t0) / pp_yields : 0;
+}
+
+static bool t_switch_pingpong(void) {
+    uint64_t slow = pp_run(false);
+    uint64_t fast = pp_run(true);
+    LOGF("(int $32 %lu ns, direct %lu ns per yield) ", tsc_ticks_to_ns(slow), tsc_ticks_to_ns(fast));
+    TEST_ASSERT(slow > 0);
+    TEST_ASSERT(fast > 0);
+    return true;
+}
+
+/* A thread parked by a direct yield is resumed through the ISR path when a tick picks it */
+static volatile bool mix_stop = false;
+
+static void mix_yielder(void* arg) {
+    (void)arg;
+    uint64_t a = 0x1111, b = 0x2222, n = 0;
+    while (!mix_stop) {
+        sched_yield();
+        a += 3; b ^= a; n++;
+    }
+    if (a != 0x1111 + 3 * n) n = 0;
+    pp_yields = n;
+    __atomic_fetch_add(&prio_exited, 1, __ATOMIC_RELEASE);
+    sched_exit();
+}
+
+static bool t_switch_mixed(void) {
+    process_t* p = process_create("t_switch_mix", NULL);
+    TEST_ASSERT(p != NULL);
+
+    uint32_t nhogs = smp_cpu_count();
+    hog_stop = false;
+    mix_stop = false;
+    pp_yields = 0;
+    prio_exited = 0;
+
+    for (uint32_t i = 0; i < nhogs; i++)
+        sched_add(thread_create(p, "hog", hog_entry, NULL, false, 0));
+    sched_add(thread_create(p, "yielder", mix_yielder, NULL, false, 0));
+
+    sched_sleep(50);
+    mix_stop = true;
+    hog_stop = true;
+    while (__atomic_load_n(&prio_exited, __ATOMIC_ACQUIRE) < nhogs + 1)
+        sched_sleep(1);
+
+    TEST_ASSERT(pp_yields > 0);
+    return true;
+}
+#pragma endregion
+
+#pragma region FPU
+
+static bool t_fpu_area(void) {
+    uint32_t size = fpu_state_size();
+    TEST_ASSERT(size >= 512);
+    if (cpu_is_feature_enabled(CF_XSAVE)) TEST_ASSERT(size >= 576);          /* legacy area + XSAVE header */
+    if (cpu_is_feature_enabled(CF_AVX))   TEST_ASSERT(size >= 576 + 256);    /* YMM upper halves */
+
+    uint8_t* area = fpu_state_alloc();
+    TEST_ASSERT(area != NULL);
+    TEST_ASSERT(((uintptr_t)area & (FPU_AREA_ALIGN - 1)) == 0);
+    TEST_ASSERT(*(uint16_t*)&area[0] == 0x037F);
+    TEST_ASSERT(*(uint32_t*)&area[24] == 0x1F80);
+    fpu_state_free(area);
+
+    LOGF("(%s, %u bytes) ", fpu_mode_name(), size);
+    return true;
+}
+
+static volatile uint32_t fpu_bad = 0;
+
+/* Keeps a per thread pattern in ymm0 (xmm0 without AVX) across yields and checks it survives */
+static void fpu_entry(void* arg) {
+    uint64_t seed = (uint64_t)(uintptr_t)arg;
+    uint64_t in[4] __attribute__((aligned(32)));
+    uint64_t out[4] __attribute__((aligned(32)));
+    for (int i = 0; i < 4; i++) in[i] = seed * 0x9E3779B97F4A7C15ULL + (uint64_t)i;
+
+    bool avx = cpu_is_feature_enabled(CF_AVX);
+    uint32_t words = avx ? 4 : 2;
+    if (avx) __asm__ volatile("vmovdqa (%0), %%ymm0" :: "r"(in) : "xmm0", "memory");
+    else     __asm__ volatile("movdqa (%0), %%xmm0" :: "r"(in) : "xmm0", "memory");
+
+    for (int round = 0; round < 200; round++) {
+        sched_yield();
+        if (avx) __asm__ volatile("vmovdqa %%ymm0, (%0)" :: "r"(out) : "memory");
+        else     __asm__ volatile("movdqa %%xmm0, (%0)" :: "r"(out) : "memory");
+        for (uint32_t i = 0; i < words; i++)
+            if (out[i] != in[i]) __atomic_fetch_add(&fpu_bad, 1, __ATOMIC_RELAXED);
+    }
+
+    __atomic_fetch_add(&prio_exited, 1, __ATOMIC_RELEASE);
+    sched_exit();
+}
+
+static bool t_fpu_vector_state(void) {
+    process_t* p = process_create("t_fpu", NULL);
+    TEST_ASSERT(p != NULL);
+
+    uint32_t n = smp_cpu_count() * 2 + 2;
+    fpu_bad = 0;
+    prio_exited = 0;
+
+    fpu_stats_t s0, s1;
+    fpu_get_stats(&s0);
+
+    for (uint32_t i = 0; i < n; i++)
+        sched_add(thread_create(p, "fpu", fpu_entry, (void*)(uintptr_t)(i + 1), false, 0));
+    while (__atomic_load_n(&prio_exited, __ATOMIC_ACQUIRE) < n)
+        sched_sleep(1);
+
+    fpu_get_stats(&s1);
+    uint64_t sw = s1.switches - s0.switches, traps = s1.traps - s0.traps;
+    LOGF("(%lu switches, %lu #NM) ", sw, traps);
+
+    TEST_ASSERT(fpu_bad == 0);
+    TEST_ASSERT(traps >= n);
+    TEST_ASSERT(sw >= traps);
+    return true;
+}
+#pragma endregion
+
+#pragma region Futex
+
+static volatile uint32_t fx_word = 0;
+static volatile uint32_t fx_entered = 0;
+static volatile uint32_t fx_woken = 0;
+
+static bool t_futex_again(void) {
+    fx_word = 7;
+    TEST_ASSERT(futex_wait(NULL, &fx_word, 6, 0) == FUTEX_AGAIN);
+    TEST_ASSERT(futex_wake(NULL, &fx_word, 1) == 0);
+    return true;
+}
+
+static bool t_futex_timeout(void) {
+    fx_word = 0;
+    uint64_t t0 = get_uptime_ns();
+    int r = futex_wait(NULL, &fx_word, 0, 2000000);
+    uint64_t dt = get_uptime_ns() - t0;
+    LOGF("(%lu us) ", dt / 1000);
+    TEST_ASSERT(r == FUTEX_TIMEDOUT);
+    TEST_ASSERT(dt >= 2000000);
+    return true;
+}
+
+/* Parks on fx_word until woken, then reports back */
+static void fx_waiter(void* arg) {
+    (void)arg;
+    __atomic_fetch_add(&fx_entered, 1, __ATOMIC_RELEASE);
+    if (futex_wait(NULL, &fx_word, 0, 0) == FUTEX_WOKEN)
+        __atomic_fetch_add(&fx_woken, 1, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&prio_exited, 1, __ATOMIC_RELEASE);
+    sched_exit();
+}
+
+static bool t_futex_wake_count(void) {
+    process_t* p = process_create("t_futex", NULL);
+    TEST_ASSERT(p != NULL);
+
+    fx_word = 0;
+    fx_entered = 0;
+    fx_woken = 0;
+    prio_exited = 0;
+
+    for (int i = 0; i < 3; i++)
+        sched_add(thread_create(p, "fx", fx_waiter, NULL, false, 0));
+    while (__atomic_load_n(&fx_entered, __ATOMIC_ACQUIRE) < 3)
+        sched_sleep(1);
+    sched_sleep(20);
+
+    TEST_ASSERT(futex_wake(NULL, &fx_word, 1) == 1);
+    while (__atomic_load_n(&fx_woken, __ATOMIC_ACQUIRE) < 1)
+        sched_sleep(1);
+    sched_sleep(5);
+    TEST_ASSERT(fx_woken == 1);
+
+    TEST_ASSERT(futex_wake(NULL, &fx_word, UINT32_MAX) == 2);
+    while (__atomic_load_n(&prio_exited, __ATOMIC_ACQUIRE) < 3)
+        sched_sleep(1);
+    TEST_ASSERT(fx_woken == 3);
+    TEST_ASSERT(futex_wake(NULL, &fx_word, UINT32_MAX) == 0);
+    return true;
+}
+
+static volatile int fx_result = 0;
+
+/* Waits on a word whose page it unmapped itself, the read must fail instead of faulting */
+static void fx_unmapped(void* arg) {
+    process_t* p = arg;
+    void* u = NULL;
+    fx_result = 1;
+    if (vmm_alloc(p->vmm, PAGE_SIZE, VM_FLAG_USER | VM_FLAG_WRITE, NULL, &u) == VMM_OK &&
+        copy_to_user(u, (const void*)&fx_word, sizeof(uint32_t)) == 0 &&
+        vmm_free(p->vmm, u) == VMM_OK)
+        fx_result = futex_wait(p->vmm, (volatile uint32_t*)u, 0, 0);
+    __atomic_store_n(&fx_entered, 1, __ATOMIC_RELEASE);
+    sched_exit();
+}
+
+static bool t_futex_unmapped(void) {
+    process_t* p = process_create("t_futex_unmap", NULL);
+    TEST_ASSERT(p != NULL);
+
+    fx_word = 0;
+    fx_entered = 0;
+    sched_add(thread_create(p, "fx_unmap", fx_unmapped, p, false, 0));
+
+    uint64_t t0 = get_uptime_ms();
+    while (!__atomic_load_n(&fx_entered, __ATOMIC_ACQUIRE) && get_uptime_ms() - t0 < 1000)
+        sched_sleep(1);
+    TEST_ASSERT(fx_entered);
+    TEST_ASSERT(fx_result == -1);
+    return true;
+}
+#pragma endregion
+
+#pragma region Wait Queue
+
+static waitq_t wq_test;
+static volatile uint32_t wq_flag = 0;
+
+static bool wq_cond(void* arg) {
+    (void)arg;
+    return __atomic_load_n(&wq_flag, __ATOMIC_ACQUIRE) != 0;
+}
+
+static bool t_waitq_timeout(void) {
+    waitq_init(&wq_test, "t_waitq");
+    wq_flag = 0;
+    uint64_t t0 = get_uptime_ns();
+    bool ok = waitq_wait_timeout(&wq_test, wq_cond, NULL, 3);
+    uint64_t dt = get_uptime_ns() - t0;
+    LOGF("(%lu us) ", dt / 1000);
+    TEST_ASSERT(!ok);
+    TEST_ASSERT(dt >= 3000000);
+    TEST_ASSERT(wq_test.head == NULL);
+    return true;
+}
+
+/* Sets the flag after a while, the waiter must wake long before its timeout */
+static void wq_setter(void* arg) {
+    (void)arg;
+    sched_sleep(5);
+    __atomic_store_n(&wq_flag, 1, __ATOMIC_RELEASE);
+    waitq_wake_all(&wq_test);
+    __atomic_fetch_add(&prio_exited, 1, __ATOMIC_RELEASE);
+    sched_exit();
+}
+
+static bool t_waitq_wake(void) {
+    process_t* p = process_create("t_waitq", NULL);
+    TEST_ASSERT(p != NULL);
+
+    waitq_init(&wq_test, "t_waitq");
+    wq_flag = 0;
+    prio_exited = 0;
+    uint64_t t0 = get_uptime_ms();
+    sched_add(thread_create(p, "wq", wq_setter, NULL, false, 0));
+    bool ok = waitq_wait_timeout(&wq_test, wq_cond, NULL, 1000);
+    uint64_t dt = get_uptime_ms() - t0;
+    while (__atomic_load_n(&prio_exited, __ATOMIC_ACQUIRE) < 1)
+        sched_sleep(1);
+
+    TEST_ASSERT(ok);
+    TEST_ASSERT(dt < 500);
+    TEST_ASSERT(wq_test.head == NULL);
+    return true;
+}
+#pragma endregion
+
+#pragma region Syscall Table
+
+static void sys_test_nop(cpu_context_t* regs, thread_t* current) {
+    (void)current;
+    regs->rax = 0;
+}
+
+/* Every number is described once, taken and out of range slots are refused */
+static bool t_syscall_table(void) {
+    const syscall_desc_t* d = syscall_desc(SYS_WRITE);
+    TEST_ASSERT(d != NULL);
+    TEST_ASSERT(kstrcmp(d->name, "write") == 0);
+    TEST_ASSERT(d->nargs == 2);
+    TEST_ASSERT(syscall_desc(SYSCALL_TABLE_SIZE) == NULL);
+
+    syscall_desc_t nop = { .name = "nop", .fn = sys_test_nop, .nargs = 0 };
+    TEST_ASSERT(!syscall_register(SYS_WRITE, &nop));
+    TEST_ASSERT(!syscall_register(SYSCALL_TABLE_SIZE, &nop));
+    TEST_ASSERT(syscall_desc(SYS_WRITE)->fn != sys_test_nop);
+    return true;
+}
+
+/* Percentiles report the upper edge of the bucket the call falls in */
+static bool t_syscall_percentile(void) {
+    syscall_stat_t st;
+    kmemset(&st, 0, sizeof(st));
+    TEST_ASSERT(syscall_percentile(&st, 50) == 0);
+
+    // 90 calls of 100-127 cycles, 10 of 4096-8191
+    st.calls = 100;
+    st.hist[7] = 90;
+    st.hist[13] = 10;
+    st.max_cycles = 5000;
+    TEST_ASSERT(syscall_percentile(&st, 50) == 128);
+    TEST_ASSERT(syscall_percentile(&st, 90) == 128);
+    TEST_ASSERT(syscall_percentile(&st, 99) == 8192);
+    return true;
+}
+#pragma endregion
+
+#pragma region Submission Ring
+
+static volatile uint32_t ur_done = 0;
+static volatile uint32_t ur_fail = 0;    // Line of the first failed check in the ring thread
+
+#define UR_CHECK(cond) do { if (!(cond) && !ur_fail) ur_fail = __LINE__; } while (0)
+
+static void ur_push(uring_t* ring, uint32_t op, uint32_t flags, uint64_t a0, uint64_t user_data) {
+    uring_sqe_t* sqe = &ring->sqes[ring->hdr->sq_tail & (ring->sq_entries - 1)];
+    kmemset(sqe, 0, sizeof(*sqe));
+    sqe->op = op;
+    sqe->flags = flags;
+    sqe->args[0] = a0;
+    sqe->user_data = user_data;
+    __atomic_store_n(&ring->hdr->sq_tail, ring->hdr->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+/* Runs in its own process, the ring belongs to whoever sets it up */
+static void ur_enter_thread(void* arg) {
+    (void)arg;
+    thread_t* self = sched_current();
+
+    UR_CHECK(uring_setup(self, 3, 0) != -1);
+    uring_t* ring = self->process->ring;
+    UR_CHECK(ring && ring->sq_entries == 4 && ring->cq_entries == 8);
+    UR_CHECK(uring_setup(self, 4, 0) == -1);
+
+    if (ring) {
+        // A NOP, a real call, one the ring refuses and a bad flag
+        ur_push(ring, URING_OP_NOP, 0, 0, 1);
+        ur_push(ring, SYS_NANOSLEEP, 0, 1000, 2);
+        ur_push(ring, SYS_EXIT, 0, 0, 3);
+        ur_push(ring, URING_OP_NOP, 1, 0, 4);
+        UR_CHECK(uring_enter(self, 4, 0, 0) == 4);
+        UR_CHECK(ring->hdr->sq_head == 4 && ring->hdr->cq_tail == 4);
+        UR_CHECK(ring->cqes[0].user_data == 1 && ring->cqes[0].res == 0);
+        UR_CHECK(ring->cqes[1].user_data == 2 && ring->cqes[1].res == 0);
+        UR_CHECK(ring->cqes[2].user_data == 3 && ring->cqes[2].res == -1);
+        UR_CHECK(ring->cqes[3].user_data == 4 && ring->cqes[3].res == -1);
+
+        // A full CQ holds the rest back until it is drained
+        for (int i = 0; i < 4; i++) ur_push(ring, URING_OP_NOP, 0, 0, 10 + i);
+        UR_CHECK(uring_enter(self, 4, 0, 0) == 4);
+        ur_push(ring, URING_OP_NOP, 0, 0, 20);
+        UR_CHECK(uring_enter(self, 1, 0, 0) == 0);
+        ring->hdr->cq_head = 8;
+        UR_CHECK(uring_enter(self, 1, 0, 0) == 1);
+        UR_CHECK(ring->cqes[0].user_data == 20);
+
+        // A buffer that is not user memory fails the entry, not the submitting thread
+        ur_push(ring, SYS_WRITE, 0, (uint64_t)&ur_done, 21);
+        ring->sqes[(ring->hdr->sq_tail - 1) & (ring->sq_entries - 1)].args[1] = sizeof(ur_done);
+        UR_CHECK(uring_enter(self, 1, 0, 0) == 1);
+        UR_CHECK(ring->cqes[1].user_data == 21 && ring->cqes[1].res == -1);
+    }
+
+    __atomic_store_n(&ur_done, 1, __ATOMIC_RELEASE);
+}
+
+/* Entries run in order on enter, each with its result, and never past a full CQ */
+static bool t_uring_enter(void) {
+    process_t* p = process_create("t_uring", NULL);
+    TEST_ASSERT(p != NULL);
+
+    ur_done = 0;
+    ur_fail = 0;
+    sched_add(thread_create(p, "ur", ur_enter_thread, NULL, false, 0));
+
+    uint64_t t0 = get_uptime_ms();
+    while (!__atomic_load_n(&ur_done, __ATOMIC_ACQUIRE) && get_uptime_ms() - t0 < 1000)
+        sched_sleep(1);
+    if (ur_fail) LOGF("(line %u) ", ur_fail);
+    TEST_ASSERT(ur_done);
+    TEST_ASSERT(!ur_fail);
+    return true;
+}
+
+static void ur_sqpoll_thread(void* arg) {
+    (void)arg;
+    thread_t* self = sched_current();
+
+    UR_CHECK(uring_setup(self, 8, URING_SETUP_SQPOLL) != -1);
+    uring_t* ring = self->process->ring;
+    UR_CHECK(ring && ring->poller);
+
+    if (ring) {
+        // Let the poller go idle first, the wakeup has to bring it back
+        sched_sleep(2 * URING_SQPOLL_IDLE_MS + 5);
+        for (int i = 0; i < 6; i++) ur_push(ring, URING_OP_NOP, 0, 0, i);
+        UR_CHECK(uring_enter(self, 0, 6, URING_ENTER_SQ_WAKEUP) >= 6);
+        UR_CHECK(ring->hdr->cq_tail == 6 && ring->cqes[5].user_data == 5);
+    }
+
+    __atomic_store_n(&ur_done, 1, __ATOMIC_RELEASE);
+}
+
+/* The poller runs entries without an enter per batch and leaves with the last submitter */
+static bool t_uring_sqpoll(void) {
+    process_t* p = process_create("t_uring_poll", NULL);
+    TEST_ASSERT(p != NULL);
+
+    ur_done = 0;
+    ur_fail = 0;
+    sched_add(thread_create(p, "ur", ur_sqpoll_thread, NULL, false, 0));
+
+    uint64_t t0 = get_uptime_ms();
+    while (!__atomic_load_n(&ur_done, __ATOMIC_ACQUIRE) && get_uptime_ms() - t0 < 1000)
+        sched_sleep(1);
+    if (ur_fail) LOGF("(line %u) ", ur_fail);
+    TEST_ASSERT(ur_done);
+    TEST_ASSERT(!ur_fail);
+
+    t0 = get_uptime_ms();
+    while (proc_in_list(p) && get_uptime_ms() - t0 < 2000)
+        sched_sleep(5);
+    TEST_ASSERT(!proc_in_list(p));
+    return true;
+}
+#pragma endregion
+
+#pragma region Vectored I/O
+
+static int64_t iov_call(thread_t* self, uint32_t nr, void* iov, uint64_t cnt) {
+    uint64_t args[SYSCALL_MAX_ARGS] = { (uint64_t)iov, cnt, 0 };
+    return (int64_t)syscall_invoke(nr, args, self);
+}
+
+/* Runs in a process without a TTY, writes still count what they consumed */
+static void iov_thread(void* arg) {
+    (void)arg;
+    thread_t* self = sched_current();
+    uint8_t* u = NULL;
+
+    UR_CHECK(vmm_alloc(self->process->vmm, PAGE_SIZE, VM_FLAG_USER | VM_FLAG_WRITE, NULL, (void**)&u) == VMM_OK);
+    if (u) {
+        iovec_t iov[3] = {
+            { u + 256, 5 },
+            { u + 512, 0 },
+            { u + 768, 7 },
+        };
+        UR_CHECK(copy_to_user(u, iov, sizeof(iov)) == 0);
+        UR_CHECK(iov_call(self, SYS_WRITEV, u, 3) == 12);
+        UR_CHECK(iov_call(self, SYS_WRITEV, u, 0) == 0);
+        UR_CHECK(iov_call(self, SYS_WRITEV, u, SYSCALL_IOV_MAX + 1) == -1);
+
+        // One segment off the end of the mapping fails the call before any of it is written
+        iov[2].iov_len = PAGE_SIZE;
+        UR_CHECK(copy_to_user(u, iov, sizeof(iov)) == 0);
+        UR_CHECK(iov_call(self, SYS_WRITEV, u, 3) == -1);
+
+        // The array itself has to be user memory, and a read needs a TTY
+        UR_CHECK(iov_call(self, SYS_WRITEV, iov, 1) == -1);
+        UR_CHECK(iov_call(self, SYS_READV, u, 1) == -1);
+        vmm_free(self->process->vmm, u);
+    }
+
+    __atomic_store_n(&ur_done, 1, __ATOMIC_RELEASE);
+}
+
+/* Segments are checked once up front and written back to back, a bad one only fails the call */
+static bool t_syscall_writev(void) {
+    process_t* p = process_create("t_iov", NULL);
+    TEST_ASSERT(p != NULL);
+
+    ur_done = 0;
+    ur_fail = 0;
+    sched_add(thread_create(p, "iov", iov_thread, NULL, false, 0));
+
+    uint64_t t0 = get_uptime_ms();
+    while (!__atomic_load_n(&ur_done, __ATOMIC_ACQUIRE) && get_uptime_ms() - t0 < 1000)
+        sched_sleep(1);
+    if (ur_fail) LOGF("(line %u) ", ur_fail);
+    TEST_ASSERT(ur_done);
+    TEST_ASSERT(!ur_fail);
+    return true;
+}
+#pragma endregion
+
+#pragma region Reaper
+
+/* Exited threads and their empty process are freed by the reaper thread, not by the exiting CPU */
+static bool t_reaper_frees_proc(void) {
+    process_t* p = process_create("t_reap", NULL);
+    TEST_ASSERT(p != NULL);
+
+    for (int i = 0; i < 8; i++)
+        sched_add(thread_create(p, "reap", kentry, NULL, false, 0));
+
+    uint64_t t0 = get_uptime_ms();
+    while (proc_in_list(p) && get_uptime_ms() - t0 < 1000)
+        sched_sleep(1);
+    TEST_ASSERT(!proc_in_list(p));
+    return true;
+}
+#pragma endregion
+
+#pragma region Thread Join
+
+static volatile bool join_done = false;
+
+static void join_entry(void* arg) {
+    (void)arg;
+    sched_sleep(20);
+    join_done = true;
+    sched_exit();
+}
+
+static bool t_join_waits(void) {
+    process_t* p = process_create("t_join", NULL);
+    TEST_ASSERT(p != NULL);
+
+    join_done = false;
+    thread_t* t = thread_create(p, "joinee", join_entry, NULL, false, 0);
+    TEST_ASSERT(t != NULL);
+    tid_t tid = t->tid;
+    sched_add(t);
+
+    TEST_ASSERT(thread_join(p, tid) == 0);
+    TEST_ASSERT(join_done);
+
+    /* Gone already, or never there */
+    TEST_ASSERT(thread_join(p, tid) == 0);
+    TEST_ASSERT(thread_join(p, sched_current()->tid) == -1);
+    return true;
+}
+
+static bool t_create_user_entry(void) {
+    process_t* p = process_create("t_uentry", NULL);
+    TEST_ASSERT(p != NULL);
+
+    uintptr_t entry = USER_CODE_VIRT_ADDR + 0x40;
+    thread_t* t = thread_create_user(p, "u", entry, (void*)0x1234, 0x7000000FF8ULL);
+    TEST_ASSERT(t != NULL);
+    TEST_ASSERT(t->context.rdi == entry);
+    TEST_ASSERT(t->context.rsi == 0x1234);
+    TEST_ASSERT(t->context.iret_rsp == 0x7000000FF8ULL);
+    TEST_ASSERT(t->ustack == NULL);
+    process_destroy(p);
+    return true;
+}
+#pragma endregion
+
 #pragma region Runner
 
 static void run_test(const char* name, bool (*fn)(void)) {
@@ -473,10 +1679,48 @@ void test_multitasking(void) {
     run_test("process name truncation",       t_proc_ntrunc);
     run_test("thread name truncation",        t_thr_ntrunc);
     run_test("shared tty between processes",  t_shared_tty);
+    run_test("vvar: mapped read only",        t_vvar_mapped);
+    run_test("vvar: agrees with uptime",      t_vvar_uptime);
     run_test("proc_hdr_update no crash",t_hdr_update);
     run_test("proc_hdr_update+thread",  t_hdr_update_thr);
     run_test("terminate_by_tty no crash",     t_term_tty);
     run_test("thread_create_bootstrap",       t_bootstrap);
+    run_test("smp: topology",                 t_smp_topology);
+    run_test("smp: CPU bound threads scale",  t_smp_speedup);
+    run_test("smp: swap-out races a writer",  t_smp_swap_race);
+    run_test("prio: default level",           t_prio_default);
+    run_test("prio: set and reject",          t_prio_set);
+    run_test("prio: tty boost",               t_prio_boost);
+    run_test("prio: echo latency under load", t_prio_echo_latency);
+    run_test("deadline: invalid params",      t_dl_reject);
+    run_test("deadline: admission control",   t_dl_admission);
+    run_test("deadline: periodic under load", t_dl_periodic);
+    run_test("deadline: budget throttling",   t_dl_throttle);
+    run_test("nanosleep: wake jitter",        t_nsleep_jitter);
+    run_test("hrtimer: fire jitter",          t_hrtimer_jitter);
+    run_test("sleep_us: blocks when tickless",t_sleep_us_blocks);
+    run_test("acct: run time and voluntary",  t_acct_runtime);
+    run_test("acct: preemption and wait",     t_acct_preempt);
+    run_test("acct: TSC based CPU usage",     t_acct_usage);
+    run_test("acct: kernel thread rusage",    t_acct_rusage);
+    run_test("switch: yield ping-pong",       t_switch_pingpong);
+    run_test("switch: direct and ISR mixed",  t_switch_mixed);
+    run_test("fpu: save area sizing",         t_fpu_area);
+    run_test("fpu: vector state per thread",  t_fpu_vector_state);
+    run_test("futex: value mismatch",         t_futex_again);
+    run_test("futex: wait timeout",           t_futex_timeout);
+    run_test("futex: wake count",             t_futex_wake_count);
+    run_test("futex: unmapped word fails",    t_futex_unmapped);
+    run_test("waitq: timeout",                t_waitq_timeout);
+    run_test("waitq: woken before timeout",   t_waitq_wake);
+    run_test("syscall: table lookup",         t_syscall_table);
+    run_test("syscall: latency percentiles",  t_syscall_percentile);
+    run_test("uring: batched enter",          t_uring_enter);
+    run_test("uring: kernel poller",          t_uring_sqpoll);
+    run_test("syscall: writev segments",      t_syscall_writev);
+    run_test("reaper: frees exited process",  t_reaper_frees_proc);
+    run_test("join: waits for exit",          t_join_waits);
+    run_test("thread_create_user entry",      t_create_user_entry);
 
     LOGF("--- END MULTITASKING TEST ---\n");
     LOGF("Multitasking Test Results: %d/%d\n\n", npass, ntests);
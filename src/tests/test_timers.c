@@ -14,6 +14,9 @@
 
 #include <arch/x86_64/cpu/interrupts.h>
 #include <kernel/sys/timers.h>
+#include <kernel/sys/clocksource.h>
+#include <kernel/sys/hrtimer.h>
+#include <kernel/sys/ktimer.h>
 #include <kernel/sys/apic.h>
 #include <kernel/debug.h>
 #include <tests/tests.h>
@@ -230,6 +233,62 @@ static bool t_up_res(void) {
 }
 #pragma endregion
 
+#pragma region Clocksource
+
+static bool t_cs_rate(void) {
+    /* One second worth of cycles must convert back to one second */
+    const clocksource_t* cs = clocksource_current();
+    TEST_ASSERT(cs != NULL);
+    TEST_ASSERT(cs->mult != 0 && cs->hz != 0);
+    uint64_t ns = clocksource_cyc2ns(cs, cs->hz);
+    uint64_t diff = (ns > 1000000000ULL) ? (ns - 1000000000ULL) : (1000000000ULL - ns);
+    TEST_ASSERT(diff < 1000);
+    LOGF("[INFO] clocksource %s\n", cs->name);
+    return true;
+}
+
+static bool t_cs_year(void) {
+    /* A year of TSC ticks must not overflow on the way to ns */
+    uint64_t year_ns = 365ULL * 86400ULL * 1000000000ULL;
+    uint64_t ns = tsc_ticks_to_ns(tsc_get_tpm() * 365ULL * 86400ULL * 1000ULL);
+    uint64_t diff = (ns > year_ns) ? (ns - year_ns) : (year_ns - ns);
+    TEST_ASSERT(diff < year_ns / 100000);
+    return true;
+}
+
+static bool t_cs_inverse(void) {
+    /* Uptime mapped to a TSC deadline must land on the TSC now */
+    uint64_t tsc = tsc_from_uptime_ns(get_uptime_ns());
+    uint64_t now = tsc_read();
+    uint64_t diff = (tsc > now) ? (tsc - now) : (now - tsc);
+    TEST_ASSERT(diff < tsc_get_tpm());
+    return true;
+}
+
+static bool t_cs_switch(void) {
+    /* Uptime stays monotonic across a switch to the HPET and back */
+    TEST_ASSERT(!clocksource_select("none"));
+    if (!hpet_is_available()) return true;
+
+    const char* name = clocksource_current()->name;
+    uint64_t prev = get_uptime_ns();
+    TEST_ASSERT(clocksource_select("hpet"));
+    for (int i = 0; i < 1000; i++) {
+        uint64_t cur = get_uptime_ns();
+        TEST_ASSERT(cur >= prev);
+        prev = cur;
+    }
+    sleep_ms(2);
+    TEST_ASSERT(get_uptime_ns() - prev >= 2000000ULL);
+
+    prev = get_uptime_ns();
+    TEST_ASSERT(clocksource_select(name));
+    TEST_ASSERT(get_uptime_ns() >= prev);
+    TEST_ASSERT(clocksource_current()->name == name);
+    return true;
+}
+#pragma endregion
+
 #pragma region sleep_ms
 
 static bool t_ms_lo(void) {
@@ -369,6 +428,123 @@ static bool t_drift_10x(void) {
 }
 #pragma endregion
 
+#pragma region hrtimer
+
+static volatile uint32_t hr_fired = 0;
+static volatile uint64_t hr_at[3];
+static volatile uint32_t hr_order[3];
+
+static void hr_cb(hrtimer_t* timer, void* arg) {
+    (void)timer;
+    uint32_t i = __atomic_fetch_add(&hr_fired, 1, __ATOMIC_RELAXED);
+    if (i < 3) {
+        hr_at[i] = get_uptime_ns();
+        hr_order[i] = (uint32_t)(uintptr_t)arg;
+    }
+}
+
+static bool t_hr_fires(void) {
+    calibrate();
+    hrtimer_t t;
+    hrtimer_setup(&t, hr_cb, NULL);
+    hr_fired = 0;
+    uint64_t deadline = get_uptime_ns() + 2000000ULL;
+    hrtimer_arm(&t, deadline);
+    for (int i = 0; i < 100 && hr_fired == 0; i++) sleep_ms(1);
+    hrtimer_cancel(&t);
+    TEST_ASSERT(hr_fired == 1);
+    TEST_ASSERT(hr_at[0] >= deadline);
+    TEST_ASSERT(t.cpu == HRTIMER_UNARMED);
+    return true;
+}
+
+static bool t_hr_cancel(void) {
+    calibrate();
+    hrtimer_t t;
+    hrtimer_setup(&t, hr_cb, NULL);
+    hr_fired = 0;
+    hrtimer_arm(&t, get_uptime_ns() + 20000000ULL);
+    TEST_ASSERT(hrtimer_cancel(&t));
+    sleep_ms(40);
+    TEST_ASSERT(hr_fired == 0);
+    TEST_ASSERT(!hrtimer_cancel(&t));
+    return true;
+}
+
+static bool t_hr_order(void) {
+    calibrate();
+    hrtimer_t t[3];
+    uint64_t now = get_uptime_ns();
+    hr_fired = 0;
+    for (uint32_t i = 0; i < 3; i++) hrtimer_setup(&t[i], hr_cb, (void*)(uintptr_t)i);
+    hrtimer_arm(&t[0], now + 3000000ULL);
+    hrtimer_arm(&t[1], now + 1000000ULL);
+    hrtimer_arm(&t[2], now + 2000000ULL);
+    for (int i = 0; i < 100 && hr_fired < 3; i++) sleep_ms(1);
+    for (uint32_t i = 0; i < 3; i++) hrtimer_cancel(&t[i]);
+    TEST_ASSERT(hr_fired == 3);
+    TEST_ASSERT(hr_order[0] == 1 && hr_order[1] == 2 && hr_order[2] == 0);
+    return true;
+}
+#pragma endregion
+
+#pragma region ktimer
+
+static volatile uint32_t kt_fired = 0;
+static volatile uint64_t kt_at = 0;
+
+static void kt_cb(ktimer_t* timer, void* arg) {
+    (void)timer; (void)arg;
+    kt_at = get_uptime_ns();
+    __atomic_fetch_add(&kt_fired, 1, __ATOMIC_RELAXED);
+}
+
+static bool t_kt_fires(void) {
+    calibrate();
+    ktimer_t t;
+    ktimer_setup(&t, kt_cb, NULL);
+    kt_fired = 0;
+    uint64_t start = get_uptime_ns();
+    ktimer_arm(&t, 5);
+    for (int i = 0; i < 100 && kt_fired == 0; i++) sleep_ms(1);
+    ktimer_cancel(&t);
+    TEST_ASSERT(kt_fired == 1);
+    TEST_ASSERT(kt_at - start >= 5000000ULL);
+    TEST_ASSERT(!ktimer_pending(&t));
+    return true;
+}
+
+static bool t_kt_cancel(void) {
+    calibrate();
+    ktimer_t t;
+    ktimer_setup(&t, kt_cb, NULL);
+    kt_fired = 0;
+    ktimer_arm(&t, 20);
+    TEST_ASSERT(ktimer_pending(&t));
+    TEST_ASSERT(ktimer_cancel(&t));
+    sleep_ms(40);
+    TEST_ASSERT(kt_fired == 0);
+    TEST_ASSERT(!ktimer_cancel(&t));
+    return true;
+}
+
+/* Past one level 0 revolution the timer has to cascade down before it fires */
+static bool t_kt_cascade(void) {
+    calibrate();
+    ktimer_t t;
+    ktimer_setup(&t, kt_cb, NULL);
+    kt_fired = 0;
+    uint64_t start = get_uptime_ns();
+    ktimer_arm(&t, 150);
+    for (int i = 0; i < 400 && kt_fired == 0; i++) sleep_ms(1);
+    ktimer_cancel(&t);
+    TEST_ASSERT(kt_fired == 1);
+    uint64_t ms = (kt_at - start) / 1000000ULL;
+    TEST_ASSERT(ms >= 150 && ms < 150 + 20 + ms_ovhd);
+    return true;
+}
+#pragma endregion
+
 #pragma region LAPIC
 
 static volatile uint32_t irq_cnt = 0;
@@ -517,6 +693,10 @@ void test_timers(void) {
     run_test("Uptime Advances After Sleep",  t_up_adv);
     run_test("Uptime NS/MS Coherent",        t_up_coh);
     run_test("Uptime NS Resolution",         t_up_res);
+    run_test("Clocksource Rate Round Trip",  t_cs_rate);
+    run_test("Clocksource Year No Overflow", t_cs_year);
+    run_test("Clocksource Uptime To TSC",    t_cs_inverse);
+    run_test("Clocksource Switch Monotonic", t_cs_switch);
     run_test("sleep_ms(100) Lower Bound",    t_ms_lo);
     run_test("sleep_ms(100) Upper Bound",    t_ms_hi);
     run_test("sleep_ms(1) Lower Bound",      t_ms1_lo);
@@ -530,6 +710,12 @@ void test_timers(void) {
     run_test("Drift Lower (50x2ms)",         t_drift_lo);
     run_test("Drift Upper (50x2ms)",         t_drift_hi);
     run_test("Drift Lower (10x10ms)",        t_drift_10x);
+    run_test("hrtimer Fires After Deadline", t_hr_fires);
+    run_test("hrtimer Cancel Before Fire",   t_hr_cancel);
+    run_test("hrtimer Deadline Order",       t_hr_order);
+    run_test("ktimer Fires After Timeout",   t_kt_fires);
+    run_test("ktimer Cancel Before Fire",    t_kt_cancel);
+    run_test("ktimer Cascades Level 1",      t_kt_cascade);
     run_test("LAPIC One-Shot Fires",         t_os_fires);
     run_test("LAPIC One-Shot No Extras",     t_os_noextra);
     run_test("LAPIC One-Shot Within Window", t_os_window);
@@ -4,7 +4,8 @@
  * Tests every public VMM function: kernel_get, create, destroy, switch,
  * get_current, alloc, alloc_at, free, resize, protect, map/unmap page+range,
  * get_physical, check_flags, check_buffer, find_mapped_object,
- * verify_integrity, get_alloc_base/end/size, vmm_stats, vmm_dump.
+ * verify_integrity, get_alloc_base/end/size, vmm_stats, vmm_dump,
+ * handle_lazy_fault, reclaim, and the zswap pool behind it.
  *
  * Machine-adaptive: the OOM test queries the actual VMM address range.
  * 
@@ -12,8 +13,11 @@
  */
 
 #include <arch/x86_64/memory/paging.h>
+#include <arch/x86_64/cpu/usercopy.h>
+#include <arch/x86_64/cpu/interrupts.h>
 #include <kernel/memory/pmm.h>
 #include <kernel/memory/vmm.h>
+#include <kernel/memory/zswap.h>
 #include <kernel/debug.h>
 #include <tests/tests.h>
 #include <klibc/string.h>
@@ -240,6 +244,42 @@ static bool t_resize_collision(void) {
     TEST_ASSERT_STATUS(vmm_resize(v, p1, PG * 2), VMM_ERR_OOM);
     tr_free(); return true;
 }
+
+static bool t_remap_in_place(void) {
+    tr_reset();
+    vmm_t* v = vmm_kernel_get(); void *p, *out;
+    TEST_ASSERT_STATUS(vmm_alloc(v, PG * 2, VM_FLAG_WRITE, NULL, &p), VMM_OK);
+    tr_alloc(v, p, PG * 4);
+    TEST_ASSERT_STATUS(vmm_remap(v, p, PG * 4, true, &out), VMM_OK);
+    TEST_ASSERT(out == p);
+    ((volatile uint8_t*)p)[PG * 3] = 0x5A;
+    TEST_ASSERT(((volatile uint8_t*)p)[PG * 3] == 0x5A);
+    tr_free(); return true;
+}
+
+static bool t_remap_move(void) {
+    tr_reset();
+    vmm_t* v = vmm_kernel_get(); void *p1, *p2, *out;
+    TEST_ASSERT_STATUS(vmm_alloc(v, PG * 2, VM_FLAG_WRITE, NULL, &p1), VMM_OK);
+    TEST_ASSERT_STATUS(vmm_alloc(v, PG, VM_FLAG_WRITE, NULL, &p2), VMM_OK); tr_alloc(v,p2,PG);
+    for (size_t i = 0; i < 2; i++) ((volatile uint8_t*)p1)[i * PG] = (uint8_t)(0xC0 + i);
+    uint64_t ph0 = 0, ph1 = 0;
+    TEST_ASSERT(vmm_get_physical(v, p1, &ph0));
+    TEST_ASSERT(vmm_get_physical(v, (uint8_t*)p1 + PG, &ph1));
+    /* p2 blocks in place growth */
+    TEST_ASSERT_STATUS(vmm_remap(v, p1, PG * 4, false, &out), VMM_ERR_OOM);
+    TEST_ASSERT_STATUS(vmm_remap(v, p1, PG * 4, true, &out), VMM_OK);
+    tr_alloc(v, out, PG * 4);
+    TEST_ASSERT(out != p1);
+    TEST_ASSERT(!pte_present(v->pt_root, p1));
+    uint64_t nph0 = 0, nph1 = 0;
+    TEST_ASSERT(vmm_get_physical(v, out, &nph0) && nph0 == ph0);
+    TEST_ASSERT(vmm_get_physical(v, (uint8_t*)out + PG, &nph1) && nph1 == ph1);
+    TEST_ASSERT(((volatile uint8_t*)out)[0] == 0xC0 && ((volatile uint8_t*)out)[PG] == 0xC1);
+    ((volatile uint8_t*)out)[PG * 3] = 0x11;
+    TEST_ASSERT(vmm_verify_integrity(v));
+    tr_free(); return true;
+}
 #pragma endregion
 
 #pragma region Protect
@@ -283,6 +323,31 @@ static bool t_mmio_map(void) {
     return true;
 }
 
+/* Caller owned RAM maps like MMIO, but is neither counted as MMIO nor freed with the mapping */
+static bool t_phys_map(void) {
+    tr_reset();
+    vmm_t* v = vmm_create(USER_BASE, USER_END); tr_vmm(v);
+    uint64_t phys; TEST_ASSERT(pmm_alloc(PG, &phys) == PMM_OK);
+    size_t mmio0 = vmm_mmio_total();
+    void* p;
+    TEST_ASSERT_STATUS(vmm_alloc(v, PG, VM_FLAG_PHYS | VM_FLAG_USER, (void*)phys, &p), VMM_OK);
+    uint64_t mp;
+    TEST_ASSERT(vmm_get_physical(v, p, &mp));
+    TEST_ASSERT(mp == phys);
+    TEST_ASSERT(vmm_mmio_total() == mmio0);
+    size_t rss = 1;
+    vmm_usage(v, &rss, NULL, NULL, NULL);
+    TEST_ASSERT(rss == 0);
+    /* A freed frame gets a PMM free list header written over its start */
+    volatile uint64_t* frame = (volatile uint64_t*)PHYSMAP_P2V(phys);
+    frame[0] = 0x5A5A5A5A5A5A5A5AULL; frame[1] = ~frame[0];
+    TEST_ASSERT_STATUS(vmm_free(v, p), VMM_OK);
+    TEST_ASSERT(vmm_mmio_total() == mmio0);
+    TEST_ASSERT(frame[0] == 0x5A5A5A5A5A5A5A5AULL && frame[1] == ~0x5A5A5A5A5A5A5A5AULL);
+    pmm_free(phys, PG);
+    tr_free(); return true;
+}
+
 static bool t_map_unmap_pg(void) {
     tr_reset();
     vmm_t* v = vmm_kernel_get(); void* ptr;
@@ -481,6 +546,37 @@ static bool t_buf_partial_unmap(void) {
 }
 #pragma endregion
 
+#pragma region User Copy
+
+/* A copy running off the end of a user mapping stops there instead of faulting the kernel */
+static bool t_user_copy_fault(void) {
+    tr_reset();
+    vmm_t* orig = vmm_kernel_get();
+    vmm_t* task = vmm_create(USER_BASE, USER_END); tr_vmm(task);
+    void* p;
+    TEST_ASSERT_STATUS(vmm_alloc(task, PG, VM_FLAG_WRITE | VM_FLAG_USER, NULL, &p), VMM_OK);
+
+    char src[16], dst[16];
+    kmemset(src, 0x5A, sizeof(src));
+    kmemset(dst, 0, sizeof(dst));
+    char* tail = (char*)p + PG - 8;
+
+    bool ints = intr_save();
+    vmm_switch(task);
+    size_t to_left = copy_to_user(tail, src, sizeof(src));
+    size_t from_left = copy_from_user(dst, tail, sizeof(dst));
+    size_t kern_left = copy_from_user(dst, (const void*)orig, sizeof(dst));
+    vmm_switch(orig);
+    intr_restore(ints);
+
+    TEST_ASSERT(to_left == 8);
+    TEST_ASSERT(from_left == 8);
+    TEST_ASSERT(dst[0] == 0x5A && dst[7] == 0x5A && dst[8] == 0);
+    TEST_ASSERT(kern_left == sizeof(dst));
+    tr_free(); return true;
+}
+#pragma endregion
+
 #pragma region find_mapped_object
 
 static bool t_find_hit(void) {
@@ -501,6 +597,26 @@ static bool t_find_miss(void) {
     TEST_ASSERT(obj == NULL);
     return true;
 }
+
+static bool t_find_tracks_changes(void) {
+    tr_reset();
+    vmm_t* v = vmm_create(USER_BASE, USER_END); tr_vmm(v);
+    void *p, *q;
+    TEST_ASSERT_STATUS(vmm_alloc(v, PG * 4, VM_FLAG_WRITE | VM_FLAG_LAZY, NULL, &p), VMM_OK);
+    TEST_ASSERT(vmm_check_flags(v, (uint8_t*)p + PG * 3, VM_FLAG_WRITE));
+    /* Shrink, reprotect and free must all be visible to the lockless lookup */
+    TEST_ASSERT_STATUS(vmm_resize(v, p, PG * 2), VMM_OK);
+    TEST_ASSERT(vmm_find_mapped_object(v, (uint8_t*)p + PG * 3) == NULL);
+    TEST_ASSERT_STATUS(vmm_protect(v, p, VM_FLAG_LAZY), VMM_OK);
+    TEST_ASSERT(!vmm_check_flags(v, p, VM_FLAG_WRITE));
+    TEST_ASSERT_STATUS(vmm_free(v, p), VMM_OK);
+    TEST_ASSERT(vmm_find_mapped_object(v, p) == NULL);
+    /* The retired object must not leak into the next allocation */
+    TEST_ASSERT_STATUS(vmm_alloc(v, PG, VM_FLAG_WRITE, NULL, &q), VMM_OK);
+    vm_object* obj = vmm_find_mapped_object(v, q);
+    TEST_ASSERT(obj != NULL && obj->base == (uintptr_t)q && obj->length == PG);
+    tr_free(); return true;
+}
 #pragma endregion
 
 #pragma region Lazy Allocation
@@ -523,6 +639,40 @@ static bool t_lazy_after(void) {
     TEST_ASSERT(*q == 0x1234ABCD);
     tr_free(); return true;
 }
+
+static bool t_lazy_read_zero(void) {
+    tr_reset();
+    vmm_t* v = vmm_kernel_get(); void* p;
+    TEST_ASSERT_STATUS(vmm_alloc(v, PG * 2, VM_FLAG_WRITE | VM_FLAG_LAZY, NULL, &p), VMM_OK); tr_alloc(v,p,PG*2);
+    volatile uint64_t* a = (volatile uint64_t*)p;
+    volatile uint64_t* b = (volatile uint64_t*)((uintptr_t)p + PG);
+    TEST_ASSERT(*a == 0 && *b == 0);
+    uint64_t fa = 0, pa = 0, pb = 0;
+    TEST_ASSERT(pte_flags(v->pt_root, p, &fa));
+    TEST_ASSERT(!(fa & PAGE_WRITABLE));
+    TEST_ASSERT(vmm_get_physical(v, p, &pa));
+    TEST_ASSERT(vmm_get_physical(v, (void*)b, &pb));
+    TEST_ASSERT(pa == pb);
+    tr_free(); return true;
+}
+
+static bool t_lazy_write_after_read(void) {
+    tr_reset();
+    vmm_t* v = vmm_kernel_get(); void* p;
+    TEST_ASSERT_STATUS(vmm_alloc(v, PG * 2, VM_FLAG_WRITE | VM_FLAG_LAZY, NULL, &p), VMM_OK); tr_alloc(v,p,PG*2);
+    volatile uint64_t* a = (volatile uint64_t*)p;
+    volatile uint64_t* b = (volatile uint64_t*)((uintptr_t)p + PG);
+    TEST_ASSERT(*a == 0 && *b == 0);
+    uint64_t zero_phys = 0, priv_phys = 0, fa = 0;
+    TEST_ASSERT(vmm_get_physical(v, (void*)b, &zero_phys));
+    *a = 0xC0FFEE;
+    TEST_ASSERT(*a == 0xC0FFEE && *b == 0);
+    TEST_ASSERT(pte_flags(v->pt_root, p, &fa));
+    TEST_ASSERT(fa & PAGE_WRITABLE);
+    TEST_ASSERT(vmm_get_physical(v, p, &priv_phys));
+    TEST_ASSERT(priv_phys != zero_phys);
+    tr_free(); return true;
+}
 #pragma endregion
 
 #pragma region OOM
@@ -578,6 +728,30 @@ static bool t_frag(void) {
     }
     tr_free(); return true;
 }
+
+static bool t_gap_first_fit(void) {
+    tr_reset();
+    vmm_t* v = vmm_create(USER_BASE, USER_END); tr_vmm(v);
+    void* ptrs[16]; void* p;
+    for (int i = 0; i < 16; i++)
+        TEST_ASSERT_STATUS(vmm_alloc(v, PG, VM_FLAG_WRITE | VM_FLAG_LAZY, NULL, &ptrs[i]), VMM_OK);
+    /* Holes of 1, 2 and 3 pages, in that address order */
+    vmm_free(v, ptrs[3]);
+    vmm_free(v, ptrs[7]);  vmm_free(v, ptrs[8]);
+    vmm_free(v, ptrs[12]); vmm_free(v, ptrs[13]); vmm_free(v, ptrs[14]);
+    TEST_ASSERT(vmm_verify_integrity(v));
+    TEST_ASSERT_STATUS(vmm_alloc(v, PG * 3, VM_FLAG_WRITE | VM_FLAG_LAZY, NULL, &p), VMM_OK);
+    TEST_ASSERT(p == ptrs[12]);
+    TEST_ASSERT_STATUS(vmm_alloc(v, PG * 2, VM_FLAG_WRITE | VM_FLAG_LAZY, NULL, &p), VMM_OK);
+    TEST_ASSERT(p == ptrs[7]);
+    TEST_ASSERT_STATUS(vmm_alloc(v, PG, VM_FLAG_WRITE | VM_FLAG_LAZY, NULL, &p), VMM_OK);
+    TEST_ASSERT(p == ptrs[3]);
+    /* Everything below is full now, the next page lands after the last object */
+    TEST_ASSERT_STATUS(vmm_alloc(v, PG, VM_FLAG_WRITE | VM_FLAG_LAZY, NULL, &p), VMM_OK);
+    TEST_ASSERT((uintptr_t)p == (uintptr_t)ptrs[15] + PG);
+    TEST_ASSERT(vmm_verify_integrity(v));
+    tr_free(); return true;
+}
 #pragma endregion
 
 #pragma region Dirty Reuse / Security
@@ -605,12 +779,48 @@ static bool t_dirty_reuse(void) {
 #pragma region vmm_stats
 
 static bool t_stats_smoke(void) {
-    size_t total, resident;
-    vmm_stats(vmm_kernel_get(), &total, &resident);
-    /* Must not crash; total >= resident */
-    TEST_ASSERT(total >= resident);
+    size_t total, resident, zero;
+    vmm_stats(vmm_kernel_get(), &total, &resident, &zero);
+    /* Must not crash; total >= resident + zero */
+    TEST_ASSERT(total >= resident + zero);
     return true;
 }
+
+static bool t_stats_zero(void) {
+    tr_reset();
+    vmm_t* v = vmm_create(USER_BASE, USER_END); void* p;
+    TEST_ASSERT(v != NULL); tr_vmm(v);
+    TEST_ASSERT_STATUS(vmm_alloc(v, PG * 4, VM_FLAG_WRITE | VM_FLAG_LAZY, NULL, &p), VMM_OK);
+    TEST_ASSERT_STATUS(vmm_handle_lazy_fault(v, p, false), VMM_OK);
+    TEST_ASSERT_STATUS(vmm_handle_lazy_fault(v, (void*)((uintptr_t)p + PG), false), VMM_OK);
+    TEST_ASSERT_STATUS(vmm_handle_lazy_fault(v, (void*)((uintptr_t)p + PG), true), VMM_OK);
+    size_t total, resident, zero;
+    vmm_stats(v, &total, &resident, &zero);
+    TEST_ASSERT(total == PG * 4);
+    TEST_ASSERT(resident == PG);
+    TEST_ASSERT(zero == PG);
+    tr_free(); return true;
+}
+
+static bool t_usage_rss(void) {
+    tr_reset();
+    vmm_t* v = vmm_create(USER_BASE, USER_END); void* p; void* q;
+    TEST_ASSERT(v != NULL); tr_vmm(v);
+    TEST_ASSERT_STATUS(vmm_alloc(v, PG * 4, VM_FLAG_WRITE | VM_FLAG_LAZY, NULL, &p), VMM_OK);
+    TEST_ASSERT_STATUS(vmm_alloc(v, PG * 2, VM_FLAG_WRITE, NULL, &q), VMM_OK);
+    TEST_ASSERT_STATUS(vmm_handle_lazy_fault(v, p, false), VMM_OK);
+    TEST_ASSERT_STATUS(vmm_handle_lazy_fault(v, p, true), VMM_OK);
+    TEST_ASSERT_STATUS(vmm_handle_lazy_fault(v, (void*)((uintptr_t)p + PG), true), VMM_OK);
+    size_t rss, peak; uint64_t minflt, majflt;
+    vmm_usage(v, &rss, &peak, &minflt, &majflt);
+    TEST_ASSERT(rss == PG * 4);
+    TEST_ASSERT(minflt == 3 && majflt == 0);
+    TEST_ASSERT_STATUS(vmm_free(v, q), VMM_OK);
+    vmm_usage(v, &rss, &peak, NULL, NULL);
+    TEST_ASSERT(rss == PG * 2);
+    TEST_ASSERT(peak == PG * 4);
+    tr_free(); return true;
+}
 #pragma endregion
 
 #pragma region Swiss Cheese Destroy
@@ -639,6 +849,140 @@ static bool t_swiss_cheese(void) {
 }
 #pragma endregion
 
+#pragma region zswap
+
+static uint64_t free_bytes(void) {
+    pmm_stats_t st; pmm_get_stats(&st);
+    uint64_t f = 0;
+    for (int i = 0; i < PMM_MAX_ORDERS; i++) f += st.free_blocks[i] * (1ULL<<i) * 4096;
+    return f;
+}
+
+/* Access user memory of v through real page faults, false if any byte stayed unreachable */
+static bool touch(vmm_t* v, void* va, void* buf, size_t len, bool wr) {
+    vmm_t* orig = vmm_get_current();
+    bool ints = intr_save();
+    vmm_switch(v);
+    size_t left = wr ? copy_to_user(va, buf, len) : copy_from_user(buf, va, len);
+    vmm_switch(orig);
+    intr_restore(ints);
+    return left == 0;
+}
+
+/* Non-present but non-zero leaf, i.e. a swap marker */
+static bool pte_swapped(uint64_t root, void* virt) {
+    uint64_t* pml4 = (uint64_t*)PHYSMAP_P2V(root);
+    uint64_t e = pml4[PML4_INDEX(virt)];
+    if (!(e & PAGE_PRESENT)) return false;
+    uint64_t* pdpt = (uint64_t*)PHYSMAP_P2V(PT_ENTRY_ADDR(e));
+    e = pdpt[PDPT_INDEX(virt)];
+    if (!(e & PAGE_PRESENT)) return false;
+    uint64_t* pd = (uint64_t*)PHYSMAP_P2V(PT_ENTRY_ADDR(e));
+    e = pd[PD_INDEX(virt)];
+    if (!(e & PAGE_PRESENT)) return false;
+    uint64_t* pt = (uint64_t*)PHYSMAP_P2V(PT_ENTRY_ADDR(e));
+    uint64_t pte = pt[PT_INDEX(virt)];
+    return pte && !(pte & PAGE_PRESENT);
+}
+
+static bool t_zswap_roundtrip(void) {
+    TEST_ASSERT(zswap_is_initialized());
+    uint64_t phys;
+    TEST_ASSERT(pmm_alloc(PG, &phys) == PMM_OK);
+    uint8_t* pg = (uint8_t*)PHYSMAP_P2V(phys);
+    for (int i = 0; i < PG; i++) pg[i] = (uint8_t)((i % 64 == 0) ? i / 64 : (i & 3));
+    uint64_t h = 0;
+    bool ok = zswap_store(phys, &h);
+    if (ok) {
+        kmemset(pg, 0xAA, PG);
+        ok = zswap_load(h, phys);
+        for (int i = 0; ok && i < PG; i++)
+            if (pg[i] != (uint8_t)((i % 64 == 0) ? i / 64 : (i & 3))) ok = false;
+    }
+    pmm_free(phys, PG);
+    TEST_ASSERT(ok);
+    TEST_ASSERT((h & 7) == 0 && h != 0);
+    return true;
+}
+
+static bool t_zswap_swap_in(void) {
+    tr_reset();
+    vmm_t* v = vmm_create(USER_BASE, USER_END); void* p;
+    TEST_ASSERT(v != NULL); tr_vmm(v);
+    TEST_ASSERT_STATUS(vmm_alloc(v, PG * 8, VM_FLAG_USER | VM_FLAG_WRITE | VM_FLAG_LAZY, NULL, &p), VMM_OK);
+    for (int i = 0; i < 8; i++) {
+        uint64_t val = 0x5A5A0000ULL + i;
+        TEST_ASSERT(touch(v, (void*)((uintptr_t)p + i * PG), &val, sizeof(val), true));
+    }
+    zswap_stats_t s0; zswap_get_stats(&s0);
+    TEST_ASSERT(vmm_reclaim_from(v, 8) == 8);
+    for (int i = 0; i < 8; i++)
+        TEST_ASSERT(pte_swapped(v->pt_root, (void*)((uintptr_t)p + i * PG)));
+    for (int i = 0; i < 8; i++) {
+        uint64_t val = 0;
+        TEST_ASSERT(touch(v, (void*)((uintptr_t)p + i * PG), &val, sizeof(val), false));
+        TEST_ASSERT(val == 0x5A5A0000ULL + i);
+        TEST_ASSERT(pte_present(v->pt_root, (void*)((uintptr_t)p + i * PG)));
+    }
+    uint64_t majflt = 0;
+    vmm_usage(v, NULL, NULL, NULL, &majflt);
+    TEST_ASSERT(majflt == 8);
+    zswap_stats_t s1; zswap_get_stats(&s1);
+    TEST_ASSERT(s1.faults >= s0.faults + 8);
+    tr_free(); return true;
+}
+
+/* Sparse touch of twice the free RAM, every page must come back intact */
+static bool t_zswap_oversubscribe(void) {
+    tr_reset();
+    size_t npages = (size_t)(free_bytes() / PG) * 2;
+    zswap_stats_t s0; zswap_get_stats(&s0);
+
+    vmm_t* v = vmm_create(USER_BASE, USER_BASE + (npages + 16) * PG); void* p;
+    TEST_ASSERT(v != NULL); tr_vmm(v);
+    TEST_ASSERT_STATUS(vmm_alloc(v, npages * PG, VM_FLAG_USER | VM_FLAG_WRITE | VM_FLAG_LAZY, NULL, &p), VMM_OK);
+
+    // Head word plus one at a page dependent offset, both written through the fault path
+    for (size_t i = 0; i < npages; i++) {
+        uint64_t* q = (uint64_t*)((uintptr_t)p + i * PG);
+        size_t k = (i * 7) % (PG / 8);
+        uint64_t head = 0xC0DE000000000000ULL | i;
+        if (k == 0) head ^= i;
+        TEST_ASSERT(touch(v, &q[0], &head, sizeof(head), true));
+        if (k) TEST_ASSERT(touch(v, &q[k], &i, sizeof(i), true));
+    }
+
+    for (size_t i = 0; i < npages; i += 61) {
+        uint64_t* q = (uint64_t*)((uintptr_t)p + i * PG);
+        size_t k = (i * 7) % (PG / 8);
+        uint64_t head = 0xC0DE000000000000ULL | i, got = 0, at_k = 0;
+        TEST_ASSERT(touch(v, &q[0], &got, sizeof(got), false));
+        TEST_ASSERT(got == (k == 0 ? head ^ i : head));
+        if (k) {
+            TEST_ASSERT(touch(v, &q[k], &at_k, sizeof(at_k), false));
+            TEST_ASSERT(at_k == i);
+        }
+    }
+
+    uint64_t majflt = 0;
+    vmm_usage(v, NULL, NULL, NULL, &majflt);
+    TEST_ASSERT(majflt > 0);
+
+    // Destroying the VMM must drop exactly the entries it still holds in the pool
+    size_t held = 0;
+    for (size_t i = 0; i < npages; i++)
+        if (pte_swapped(v->pt_root, (void*)((uintptr_t)p + i * PG))) held++;
+    zswap_stats_t s1; zswap_get_stats(&s1);
+    TEST_ASSERT(s1.stores > s0.stores);
+    zswap_dump_stats();
+
+    tr_free();
+    zswap_stats_t s2; zswap_get_stats(&s2);
+    TEST_ASSERT(s2.stored_pages == s1.stored_pages - held);
+    return true;
+}
+#pragma endregion
+
 #pragma region Runner
 
 static void run_test(const char* name, bool (*fn)(void)) {
@@ -672,9 +1016,12 @@ void test_vmm(void) {
     run_test("resize: grow",                   t_resize_grow);
     run_test("resize: shrink",                 t_resize_shrink);
     run_test("resize: collision → OOM",        t_resize_collision);
+    run_test("remap: grow in place",           t_remap_in_place);
+    run_test("remap: move keeps frames",       t_remap_move);
     run_test("protect: remove write",          t_prot_rm_wr);
     run_test("protect: add write",             t_prot_add_wr);
     run_test("mmio: physical match",           t_mmio_map);
+    run_test("phys: not MMIO, not freed",      t_phys_map);
     run_test("map_page + unmap_page",          t_map_unmap_pg);
     run_test("map_range + unmap_range",        t_map_unmap_range);
     run_test("PT: kernel flags (RW, !US)",     t_pt_kern_flags);
@@ -690,16 +1037,26 @@ void test_vmm(void) {
     run_test("check_buffer: zero size",        t_buf_zero_sz);
     run_test("check_buffer: wrong flags",      t_buf_bad_flags);
     run_test("check_buffer: partial unmap",    t_buf_partial_unmap);
+    run_test("user_copy: stops at unmapped",   t_user_copy_fault);
     run_test("find_mapped_object: hit",        t_find_hit);
     run_test("find_mapped_object: miss=NULL",  t_find_miss);
+    run_test("find_mapped_object: lockless",   t_find_tracks_changes);
     run_test("lazy: not mapped before access", t_lazy_before);
     run_test("lazy: mapped after access",      t_lazy_after);
+    run_test("lazy: read maps shared zero",    t_lazy_read_zero);
+    run_test("lazy: write after read private", t_lazy_write_after_read);
     run_test("OOM: small VMM exhausted",       t_oom_small);
     run_test("PT cleanup after free",          t_pt_cleanup);
     run_test("fragmentation refill",           t_frag);
+    run_test("gap search: first fit",          t_gap_first_fit);
     run_test("dirty reuse (security)",         t_dirty_reuse);
     run_test("vmm_stats: smoke",               t_stats_smoke);
+    run_test("vmm_stats: zero page count",     t_stats_zero);
+    run_test("vmm_usage: rss, peak and faults",t_usage_rss);
     run_test("swiss cheese destroy",           t_swiss_cheese);
+    run_test("zswap: store/load roundtrip",    t_zswap_roundtrip);
+    run_test("zswap: reclaim + swap-in",       t_zswap_swap_in);
+    run_test("zswap: 2x RAM oversubscribe",    t_zswap_oversubscribe);
 
     LOGF("--- END VMM TEST ---\n");
     LOGF("VMM Test Results: %d/%d\n\n", npass, ntests);
@@ -22,11 +22,14 @@
 #include <kernel/memory/slab.h>
 #include <kernel/memory/pmm.h>
 #include <kernel/memory/vmm.h>
+#include <kernel/memory/zswap.h>
 #include <kernel/sys/timers.h>
 #include <kernel/sys/acpi.h>
 #include <kernel/sys/apic.h>
 #include <kernel/sys/process.h>
 #include <kernel/sys/scheduler.h>
+#include <kernel/sys/smp.h>
+#include <kernel/sys/futex.h>
 #include <kernel/drivers/tty.h>
 #include <kernel/drivers/input.h>
 #include <kernel/debug.h>
@@ -79,6 +82,9 @@ void kernel_test(void* mb_info, char* KERNEL_VERSION) {
 	// Exclude kernel image from the allocator before populating freelists
 	pmm_exclude_range(get_kstart(false), get_kend(false));
 
+	// The AP startup trampoline must stay put in low memory
+	pmm_exclude_range(AP_TRAMPOLINE_PHYS, AP_TRAMPOLINE_PHYS + AP_TRAMPOLINE_PAGES * PAGE_SIZE);
+
 	// Populate freelists from firmware reported available regions
 	for (size_t i = 0; i < multiboot.memory_map_length; i++) {
 		uintptr_t region_start, region_end;
@@ -115,6 +121,10 @@ void kernel_test(void* mb_info, char* KERNEL_VERSION) {
 		return;
 	}
 
+    if (!zswap_init()) {
+        LOGF("[ZSWAP] Failed to initialize compressed swap\n");
+    }
+
     // Now that VMM and Heap are ready, we can map the framebuffer and setup console instances
     console_init(&multiboot);
 
@@ -173,6 +183,8 @@ void kernel_test(void* mb_info, char* KERNEL_VERSION) {
     kprintf("Running Multitasking & Userspace tests...\n");
     process_init();
     sched_init();
+    futex_init();
+    smp_init();
     test_multitasking();
     QEMU_LOG("Multitasking Test Suite Completed", TOTAL_DBG);
 
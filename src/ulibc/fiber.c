@@ -0,0 +1,379 @@
+/*
+ * fiber.c - Cooperative user mode fibers, channels and awaitable reads
+ *
+ * The scheduler context is the stack of the fiber_run() caller. Yields and
+ * wakeups switch fiber to fiber directly, only a fiber that blocks with
+ * nothing else ready goes back to fiber_run(), which then frees finished
+ * fibers or sleeps until the I/O thread completes a read.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#include <ulibc/fiber.h>
+#include <ulibc/sync.h>
+#include <ulibc/thread.h>
+#include <ulibc/syscalls.h>
+#include <ulibc/stdlib.h>
+
+#define FIBER_MMAP_FLAGS 0x11u  // VM_FLAG_WRITE | VM_FLAG_LAZY
+#define FIBER_MXCSR      0x1F80u
+#define FIBER_FCW        0x037Fu
+
+/*
+ * fiber_switch - Saves the callee saved state on the current stack into *save_sp, resumes next_sp
+ *
+ * Frame, lowest address first: MXCSR, x87 control word, r15, r14, r13, r12,
+ * rbx, rbp, return address. A new fiber's frame returns into
+ * fiber_trampoline with the fiber in r12.
+ */
+extern void fiber_switch(uint64_t* save_sp, uint64_t next_sp);
+extern char fiber_trampoline[];
+
+__asm__(
+    ".section .text.fiber_switch, \"ax\", @progbits\n"
+    ".global fiber_switch\n"
+    "fiber_switch:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    subq $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw 4(%rsp)\n"
+    "    addq $8, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".global fiber_trampoline\n"
+    "fiber_trampoline:\n"
+    "    movq %r12, %rdi\n"
+    "    andq $-16, %rsp\n"
+    "    call fiber_main\n"
+    "    ud2\n"
+    ".previous\n"
+);
+
+static fiber_queue_t ready;
+static fiber_t* current;        // NULL while fiber_run() itself runs
+static uint64_t sched_sp;       // fiber_run()'s stack while a fiber runs
+static fiber_t* zombies;        // Finished, their stacks are freed from fiber_run()
+static uint64_t switches;
+
+// Reads handed to the I/O thread
+static umutex_t io_lock;
+static fiber_queue_t io_requests;
+static fiber_queue_t io_done;
+static usem_t io_sem;
+static volatile uint32_t io_seq;
+static uint32_t io_inflight;
+static volatile bool io_stop;
+static uthread_t* io_thread;
+
+#pragma region Queues
+
+static inline void fq_push(fiber_queue_t* q, fiber_t* f) {
+    f->next = NULL;
+    if (q->tail) q->tail->next = f;
+    else q->head = f;
+    q->tail = f;
+}
+
+static inline fiber_t* fq_pop(fiber_queue_t* q) {
+    fiber_t* f = q->head;
+    if (!f) return NULL;
+    q->head = f->next;
+    if (!q->head) q->tail = NULL;
+    f->next = NULL;
+    return f;
+}
+
+#pragma endregion
+
+#pragma region Scheduler
+
+/*
+ * fiber_resume - Switches from the running fiber, or fiber_run() when from is NULL, to to
+ */
+static void fiber_resume(fiber_t* from, fiber_t* to) {
+    current = to;
+    to->state = FIBER_RUNNING;
+    switches++;
+    fiber_switch(from ? &from->sp : &sched_sp, to->sp);
+}
+
+/*
+ * fiber_block - Gives the CPU away from a fiber that already queued itself somewhere, or finished
+ */
+static void fiber_block(void) {
+    fiber_t* cur = current;
+    fiber_t* next = fq_pop(&ready);
+    if (next) {
+        fiber_resume(cur, next);
+        return;
+    }
+
+    // Nothing runnable, fiber_run() frees zombies or waits for I/O
+    current = NULL;
+    switches++;
+    fiber_switch(&cur->sp, sched_sp);
+}
+
+static void fiber_wake(fiber_t* f) {
+    f->state = FIBER_READY;
+    fq_push(&ready, f);
+}
+
+/*
+ * fiber_poll_io - Makes every fiber whose read completed runnable again
+ */
+static void fiber_poll_io(void) {
+    if (!__atomic_load_n(&io_done.head, __ATOMIC_ACQUIRE)) return;
+
+    umutex_lock(&io_lock);
+    fiber_t* f = io_done.head;
+    io_done.head = io_done.tail = NULL;
+    umutex_unlock(&io_lock);
+
+    while (f) {
+        fiber_t* next = f->next;
+        io_inflight--;
+        fiber_wake(f);
+        f = next;
+    }
+}
+
+/*
+ * fiber_main - Runs on the fiber's own stack, entered from fiber_trampoline
+ */
+__attribute__((used, noreturn)) static void fiber_main(fiber_t* f) {
+    f->fn(f->arg);
+
+    f->state = FIBER_DONE;
+    f->next = zombies;
+    zombies = f;
+    fiber_block();
+    __builtin_unreachable();
+}
+
+fiber_t* fiber_spawn(void (*fn)(void*), void* arg) {
+    if (!fn) return NULL;
+
+    fiber_t* f = calloc(1, sizeof(fiber_t));
+    if (!f) return NULL;
+
+    void* stack = syscall_mmap(NULL, FIBER_STACK_SIZE, FIBER_MMAP_FLAGS);
+    if (stack == (void*)-1 || !stack) {
+        free(f);
+        return NULL;
+    }
+    f->stack = stack;
+    f->fn = fn;
+    f->arg = arg;
+
+    // The frame fiber_switch pops: control words, r15..r12, rbx, rbp, return address
+    uint64_t* sp = (uint64_t*)((uintptr_t)stack + FIBER_STACK_SIZE) - 8;
+    sp[0] = FIBER_MXCSR | ((uint64_t)FIBER_FCW << 32);
+    sp[1] = 0;
+    sp[2] = 0;
+    sp[3] = 0;
+    sp[4] = (uint64_t)f;
+    sp[5] = 0;
+    sp[6] = 0;
+    sp[7] = (uint64_t)fiber_trampoline;
+    f->sp = (uint64_t)sp;
+
+    fiber_wake(f);
+    return f;
+}
+
+/*
+ * fiber_yield - Lets the next ready fiber run, returns at once when there is none
+ */
+void fiber_yield(void) {
+    fiber_t* cur = current;
+    if (!cur) return;
+
+    fiber_poll_io();
+    fiber_t* next = fq_pop(&ready);
+    if (!next) return;
+
+    fiber_wake(cur);
+    fiber_resume(cur, next);
+}
+
+fiber_t* fiber_current(void) {
+    return current;
+}
+
+uint64_t fiber_switches(void) {
+    return switches;
+}
+
+/*
+ * fiber_io_worker - Performs reads for fibers, one at a time in submission order
+ */
+static void fiber_io_worker(void* arg) {
+    (void)arg;
+    while (1) {
+        usem_wait(&io_sem);
+        if (io_stop) break;
+
+        umutex_lock(&io_lock);
+        fiber_t* f = fq_pop(&io_requests);
+        umutex_unlock(&io_lock);
+        if (!f) continue;
+
+        f->io_result = syscall_read(f->io_buf, f->io_len);
+
+        umutex_lock(&io_lock);
+        fq_push(&io_done, f);
+        umutex_unlock(&io_lock);
+
+        __atomic_fetch_add(&io_seq, 1, __ATOMIC_RELEASE);
+        syscall_futex_wake(&io_seq, 1);
+    }
+}
+
+/*
+ * fiber_run - Runs fibers until every one has finished and no read is pending
+ */
+void fiber_run(void) {
+    while (1) {
+        while (zombies) {
+            fiber_t* f = zombies;
+            zombies = f->next;
+            syscall_munmap(f->stack);
+            free(f);
+        }
+
+        fiber_poll_io();
+        fiber_t* next = fq_pop(&ready);
+        if (next) {
+            fiber_resume(NULL, next);
+            continue;
+        }
+
+        if (io_inflight) {
+            uint32_t seq = __atomic_load_n(&io_seq, __ATOMIC_ACQUIRE);
+            if (!__atomic_load_n(&io_done.head, __ATOMIC_ACQUIRE))
+                syscall_futex_wait(&io_seq, seq, 0);
+            continue;
+        }
+        break;
+    }
+
+    // Idle in usem_wait, no read in flight
+    if (io_thread) {
+        io_stop = true;
+        usem_post(&io_sem);
+        uthread_join(io_thread);
+        io_thread = NULL;
+        io_stop = false;
+    }
+}
+
+#pragma endregion
+
+#pragma region Channels
+
+bool fiber_chan_init(fiber_chan_t* c, uint32_t cap) {
+    if (cap == 0) cap = 1;
+    c->slots = malloc(cap * sizeof(void*));
+    if (!c->slots) return false;
+    c->cap = cap;
+    c->head = 0;
+    c->count = 0;
+    c->senders.head = c->senders.tail = NULL;
+    c->receivers.head = c->receivers.tail = NULL;
+    return true;
+}
+
+void fiber_chan_destroy(fiber_chan_t* c) {
+    free(c->slots);
+    c->slots = NULL;
+}
+
+/*
+ * fiber_chan_send - Queues value, blocking the fiber while the buffer is full
+ *
+ * Outside a fiber nothing can block, false if the buffer is full.
+ */
+bool fiber_chan_send(fiber_chan_t* c, void* value) {
+    while (c->count == c->cap) {
+        if (!current) return false;
+        current->state = FIBER_BLOCKED;
+        fq_push(&c->senders, current);
+        fiber_block();
+    }
+
+    c->slots[(c->head + c->count) % c->cap] = value;
+    c->count++;
+
+    fiber_t* r = fq_pop(&c->receivers);
+    if (r) fiber_wake(r);
+    return true;
+}
+
+/*
+ * fiber_chan_recv - Takes the oldest value, blocking the fiber while the buffer is empty
+ *
+ * Outside a fiber nothing can block, false if the buffer is empty.
+ */
+bool fiber_chan_recv(fiber_chan_t* c, void** value) {
+    while (c->count == 0) {
+        if (!current) return false;
+        current->state = FIBER_BLOCKED;
+        fq_push(&c->receivers, current);
+        fiber_block();
+    }
+
+    *value = c->slots[c->head];
+    c->head = (c->head + 1) % c->cap;
+    c->count--;
+
+    fiber_t* s = fq_pop(&c->senders);
+    if (s) fiber_wake(s);
+    return true;
+}
+
+#pragma endregion
+
+#pragma region Awaitable I/O
+
+/*
+ * fiber_read - SYS_READ that only suspends the calling fiber, the others keep running
+ */
+int64_t fiber_read(char* buf, size_t len) {
+    fiber_t* cur = current;
+    if (!cur) return syscall_read(buf, len);
+
+    if (!io_thread) {
+        io_thread = uthread_create(fiber_io_worker, NULL);
+        if (!io_thread) return syscall_read(buf, len);
+    }
+
+    cur->io_buf = buf;
+    cur->io_len = len;
+    cur->state = FIBER_BLOCKED;
+
+    umutex_lock(&io_lock);
+    fq_push(&io_requests, cur);
+    umutex_unlock(&io_lock);
+    io_inflight++;
+    usem_post(&io_sem);
+
+    fiber_block();
+    return cur->io_result;
+}
+
+#pragma endregion
@@ -0,0 +1,73 @@
+/*
+ * fiber.h - Cooperative user mode fibers, channels and awaitable reads
+ *
+ * A fiber switch stays in ring 3: the callee saved registers plus MXCSR and
+ * the x87 control word go on the outgoing stack and the incoming one pops
+ * its own, which costs a few dozen cycles against a full SYS_YIELD round
+ * trip through the scheduler. Stacks are FIBER_STACK_SIZE lazily mapped
+ * regions from syscall_mmap, only the pages a fiber touches get memory.
+ *
+ * One scheduler per process, driven by whichever thread calls fiber_run().
+ * Fibers are never preempted by each other, they run until they yield, block
+ * on a channel or await a read. fiber_read() hands the blocking SYS_READ to
+ * a helper thread and lets the other fibers run meanwhile.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define FIBER_STACK_SIZE (64 * 1024)
+
+typedef enum {
+    FIBER_READY,
+    FIBER_RUNNING,
+    FIBER_BLOCKED,
+    FIBER_DONE
+} fiber_state_t;
+
+typedef struct fiber {
+    uint64_t sp;                // Saved stack pointer while switched out
+    void* stack;                // Base of the mapped stack
+    void (*fn)(void*);
+    void* arg;
+    fiber_state_t state;
+
+    // fiber_read() request, filled in by the I/O thread
+    char* io_buf;
+    size_t io_len;
+    int64_t io_result;
+
+    struct fiber* next;         // Ready, wait or I/O queue link
+} fiber_t;
+
+typedef struct {
+    fiber_t* head;
+    fiber_t* tail;
+} fiber_queue_t;
+
+typedef struct {
+    void** slots;
+    uint32_t cap;
+    uint32_t head;
+    uint32_t count;
+    fiber_queue_t senders;      // Blocked on a full buffer
+    fiber_queue_t receivers;    // Blocked on an empty buffer
+} fiber_chan_t;
+
+fiber_t* fiber_spawn(void (*fn)(void*), void* arg);
+void fiber_yield(void);
+void fiber_run(void);
+fiber_t* fiber_current(void);
+uint64_t fiber_switches(void);
+
+bool fiber_chan_init(fiber_chan_t* c, uint32_t cap);
+void fiber_chan_destroy(fiber_chan_t* c);
+bool fiber_chan_send(fiber_chan_t* c, void* value);
+bool fiber_chan_recv(fiber_chan_t* c, void** value);
+
+int64_t fiber_read(char* buf, size_t len);
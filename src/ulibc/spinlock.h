@@ -4,6 +4,9 @@
  * Simple test-and-set spinlock using GCC atomics.
  * Safe on both single-core (preemptive) and SMP.
  *
+ * Only for sections a few instructions long, anything that can be held
+ * across a preemption should use umutex_t from sync.h, which sleeps.
+ *
  * Author: u/ApparentlyPlus
  */
 
@@ -16,8 +19,11 @@ typedef struct {
 } ulock_t;
 
 static inline void ulock_acquire(ulock_t* l) {
-    while (__sync_lock_test_and_set(&l->locked, 1))
-        ;
+    // Spin on a plain read so waiters share the line instead of bouncing it
+    while (__sync_lock_test_and_set(&l->locked, 1)) {
+        while (l->locked)
+            __asm__ volatile("pause" ::: "memory");
+    }
 }
 
 static inline void ulock_release(ulock_t* l) {
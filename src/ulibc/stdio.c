@@ -16,7 +16,7 @@
 #include <ulibc/stdio.h>
 #include <ulibc/syscalls.h>
 #include <ulibc/string.h>
-#include <ulibc/spinlock.h>
+#include <ulibc/sync.h>
 
 
 // define this globally (e.g. gcc -DPRINTF_INCLUDE_CONFIG_H ...) to include the
@@ -918,26 +918,26 @@ static int next_char = -1;
 
 // Protects rbuf, rhead, rtail, next_char.
 // Zero-initialized in .user_bss == unlocked.
-static ulock_t rlock;
+static umutex_t rlock;
 
 int u_getchar(void) {
-    ulock_acquire(&rlock);
+    umutex_lock(&rlock);
 
     // Drain single-char unget buffer first.
     if (next_char != -1) {
         int ch = next_char;
         next_char = -1;
-        ulock_release(&rlock);
+        umutex_unlock(&rlock);
         return ch;
     }
 
     // Buffer empty: release the lock before blocking in the kernel, then refill.
     if (rhead == rtail) {
-        ulock_release(&rlock);
+        umutex_unlock(&rlock);
         int64_t n = syscall_read(rbuf, sizeof(rbuf));
-        ulock_acquire(&rlock);
+        umutex_lock(&rlock);
         if (n <= 0) {
-            ulock_release(&rlock);
+            umutex_unlock(&rlock);
             return -1;
         }
         // Only update indices if another thread hasn't already filled the buffer.
@@ -948,19 +948,19 @@ int u_getchar(void) {
     }
 
     if (rhead == rtail) {
-        ulock_release(&rlock);
+        umutex_unlock(&rlock);
         return -1;
     }
 
     int ch = (unsigned char)rbuf[rhead++];
-    ulock_release(&rlock);
+    umutex_unlock(&rlock);
     return ch;
 }
 
 static void _ungetchar(int ch) {
-    ulock_acquire(&rlock);
+    umutex_lock(&rlock);
     next_char = ch;
-    ulock_release(&rlock);
+    umutex_unlock(&rlock);
 }
 
 int uvscanf_(const char* format, va_list va) {
@@ -11,7 +11,7 @@
 #include <ulibc/stdlib.h>
 #include <ulibc/syscalls.h>
 #include <ulibc/string.h>
-#include <ulibc/spinlock.h>
+#include <ulibc/sync.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -28,6 +28,7 @@
 #define MIN_ARENA_BODY   (64 * 1024)
 #define PAGE_SIZE        4096
 #define SHRINK_THRESHOLD 4
+#define LARGE_BLOCK_MIN  (128 * 1024) // gets a dedicated arena, resized with mremap
 #define MMAP_RW          1u  // VM_FLAG_WRITE
 
 #define align_up(x, a) (((x) + (size_t)(a) - 1) & ~((size_t)(a) - 1))
@@ -68,6 +69,7 @@ struct arena {
     block_t  *first_block;
     size_t    total_free;
     size_t    total_alloc;
+    bool      large;       // holds a single LARGE_BLOCK_MIN+ block
 };
 
 // Heap
@@ -82,7 +84,7 @@ typedef struct {
 } heap_t;
 
 static heap_t uheap;
-static ulock_t uheap_lock; // zero-initialized in .user_bss (unlocked)
+static umutex_t uheap_lock; // zero-initialized in .user_bss (unlocked)
 
 #pragma region Utility
 
@@ -356,6 +358,51 @@ static void try_shrink(arena_t *arena) {
         arena_destroy(arena);
 }
 
+/*
+ * large_resize - Resize a dedicated large arena so its block holds size bytes
+ *
+ * The kernel grows the mapping in place or moves its pages, never copying.
+ * Returns the (possibly moved) user pointer, or NULL if the mapping could
+ * not be resized and the caller should fall back to copying.
+ */
+static void *large_resize(block_t *b, size_t size) {
+    arena_t *arena = b->arena;
+    size_t oh = sizeof(block_t) + sizeof(bfooter_t);
+    size_t total = align_up(ARENA_HDR_SIZE + size + oh, PAGE_SIZE);
+    if (total < size) return NULL;
+    if (total == arena->size) return get_user_ptr(b);
+
+    size_t old_payload = b->size;
+
+    void *region = syscall_mremap((void *)arena, total, MREMAP_MAYMOVE);
+    if (!region || region == (void *)(uintptr_t)-1) return NULL;
+
+    // The header moved along with the pages, only the links need fixing
+    arena = (arena_t *)region;
+    if (arena->prev) arena->prev->next = arena;
+    else             uheap.arenas = arena;
+    if (arena->next) arena->next->prev = arena;
+
+    arena->start = (uintptr_t)region + ARENA_HDR_SIZE;
+    arena->end = (uintptr_t)region + total;
+    arena->size = total;
+
+    b = (block_t *)arena->start;
+    b->size = total - ARENA_HDR_SIZE - oh;
+    b->total_size = total - ARENA_HDR_SIZE;
+    b->arena = arena;
+    arena->first_block = b;
+
+    bfooter_t *f = get_footer(b);
+    f->rz_pre = f->rz_post = BLOCK_RED_ZONE;
+    f->header = b; f->magic = BLOCK_MAGIC_USED;
+
+    arena->total_alloc = b->size;
+    uheap.total_alloc = uheap.total_alloc - old_payload + b->size;
+
+    return get_user_ptr(b);
+}
+
 #pragma endregion
 
 #pragma region Heap init
@@ -379,21 +426,32 @@ static void *heap_alloc(size_t size, bool zero) {
     
     if (size < MIN_BLOCK_SIZE) size = MIN_BLOCK_SIZE;
 
-    // First-fit from sorted free list
-    block_t *b = uheap.free_list;
-    while (b && b->size < size) b = b->next_free;
+    block_t *b;
 
-    if (!b) {
-        // No block fits; expand the heap with a new arena
-        size_t needed = size + sizeof(block_t) + sizeof(bfooter_t);
-        size_t body = needed > MIN_ARENA_BODY ? needed : MIN_ARENA_BODY;
-        if (!arena_create(body)) return NULL;
+    if (size >= LARGE_BLOCK_MIN) {
+        // Large blocks own their arena so realloc can resize the mapping
+        arena_t *arena = arena_create(size + sizeof(block_t) + sizeof(bfooter_t));
+        if (!arena) return NULL;
+        arena->large = true;
+        b = arena->first_block;
+    } else {
+        // First-fit from sorted free list
         b = uheap.free_list;
         while (b && b->size < size) b = b->next_free;
-        if (!b) return NULL;
+
+        if (!b) {
+            // No block fits; expand the heap with a new arena
+            size_t needed = size + sizeof(block_t) + sizeof(bfooter_t);
+            size_t body = needed > MIN_ARENA_BODY ? needed : MIN_ARENA_BODY;
+            if (!arena_create(body)) return NULL;
+            b = uheap.free_list;
+            while (b && b->size < size) b = b->next_free;
+            if (!b) return NULL;
+        }
+
+        split_block(b, size);
     }
 
-    split_block(b, size);
     fl_remove(b);
 
     b->magic = BLOCK_MAGIC_USED;
@@ -430,6 +488,11 @@ static void heap_free(void *ptr) {
     uheap.total_free += b->size;
     uheap.alloc_count--;
 
+    if (b->arena && b->arena->large) {
+        arena_destroy(b->arena);
+        return;
+    }
+
     fl_insert(b);
     b = coalesce(b);
     if (b->arena) try_shrink(b->arena);
@@ -441,26 +504,26 @@ static void heap_free(void *ptr) {
 
 void *malloc(size_t size) {
     if (!size) return NULL;
-    ulock_acquire(&uheap_lock);
+    umutex_lock(&uheap_lock);
     void *p = heap_alloc(size, false);
-    ulock_release(&uheap_lock);
+    umutex_unlock(&uheap_lock);
     return p;
 }
 
 void free(void *ptr) {
     if (!ptr) return;
-    ulock_acquire(&uheap_lock);
+    umutex_lock(&uheap_lock);
     heap_free(ptr);
-    ulock_release(&uheap_lock);
+    umutex_unlock(&uheap_lock);
 }
 
 void *calloc(size_t nmemb, size_t size) {
     if (!nmemb || !size) return NULL;
     size_t total = nmemb * size;
     if (total / nmemb != size) return NULL;  // overflow
-    ulock_acquire(&uheap_lock);
+    umutex_lock(&uheap_lock);
     void *p = heap_alloc(total, true);
-    ulock_release(&uheap_lock);
+    umutex_unlock(&uheap_lock);
     return p;
 }
 
@@ -468,32 +531,44 @@ void *realloc(void *ptr, size_t size) {
     if (!ptr) return malloc(size);
     if (!size) { free(ptr); return NULL; }
 
-    ulock_acquire(&uheap_lock);
+    umutex_lock(&uheap_lock);
 
     block_t *b = get_header(ptr);
     if (!block_valid(b) || b->magic != BLOCK_MAGIC_USED) {
-        ulock_release(&uheap_lock);
+        umutex_unlock(&uheap_lock);
         return NULL;
     }
 
     size_t aligned = align_up(size, BLOCK_ALIGN);
     if (aligned < size) {
-        ulock_release(&uheap_lock);
+        umutex_unlock(&uheap_lock);
         return NULL;
     }
     if (aligned < MIN_BLOCK_SIZE) aligned = MIN_BLOCK_SIZE;
 
+    // Large blocks resize their mapping instead of copying. Their arena holds
+    // exactly one block, so it is never split or merged, failing that they copy
+    bool large = b->arena && b->arena->large;
+    if (large) {
+        void *moved = large_resize(b, aligned);
+        if (!moved && aligned <= b->size) moved = ptr;
+        if (moved) {
+            umutex_unlock(&uheap_lock);
+            return moved;
+        }
+    }
+
     // Shrink in place
-    if (aligned <= b->size) {
+    if (!large && aligned <= b->size) {
         size_t oh = sizeof(block_t) + sizeof(bfooter_t);
         if (b->size - aligned >= MIN_BLOCK_SIZE + oh)
             split_block(b, aligned);
-        ulock_release(&uheap_lock);
+        umutex_unlock(&uheap_lock);
         return ptr;
     }
 
     // Try to absorb the adjacent free block
-    block_t *nxt = next_block(b);
+    block_t *nxt = large ? NULL : next_block(b);
     if (nxt && nxt->magic == BLOCK_MAGIC_FREE && block_valid(nxt)) {
         size_t combined = b->size + nxt->total_size;
         if (combined >= aligned) {
@@ -511,7 +586,7 @@ void *realloc(void *ptr, size_t size) {
             f->header = b; f->magic = BLOCK_MAGIC_USED;
             f->rz_pre = f->rz_post = BLOCK_RED_ZONE;
             split_block(b, aligned);
-            ulock_release(&uheap_lock);
+            umutex_unlock(&uheap_lock);
             return ptr;
         }
     }
@@ -520,12 +595,12 @@ void *realloc(void *ptr, size_t size) {
     // Save copy_size before releasing the lock (b->size must not be read after).
     size_t copy_size = b->size < size ? b->size : size;
     void *new_ptr = heap_alloc(size, false); // called while lock is held - fine
-    ulock_release(&uheap_lock);
+    umutex_unlock(&uheap_lock);
     if (!new_ptr) return NULL;
     memcpy(new_ptr, ptr, copy_size);
-    ulock_acquire(&uheap_lock);
+    umutex_lock(&uheap_lock);
     heap_free(ptr);
-    ulock_release(&uheap_lock);
+    umutex_unlock(&uheap_lock);
     return new_ptr;
 }
 
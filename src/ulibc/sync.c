@@ -0,0 +1,142 @@
+/*
+ * sync.c - Userspace mutex, condition variable and semaphore
+ *
+ * The mutex is the three state futex lock: 0 free, 1 held, 2 held and
+ * someone may be asleep. Only an unlock that finds 2 pays for a wake
+ * syscall. A condvar is a sequence number, waiters sleep until it moves.
+ * They relock the mutex as contended, since other woken waiters may queue
+ * behind it. The semaphore counts sleepers so posts without any skip the
+ * wake.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#include <ulibc/sync.h>
+#include <ulibc/syscalls.h>
+
+#define UINT32_ALL 0xFFFFFFFFu
+
+static inline void cpu_relax(void) {
+    __asm__ volatile("pause" ::: "memory");
+}
+
+static inline uint32_t cas32(volatile uint32_t* p, uint32_t expected, uint32_t desired) {
+    __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+    return expected;
+}
+
+#pragma region Mutex
+
+/*
+ * umutex_lock_slow - Marks the lock contended and sleeps until an unlock hands it over
+ */
+static void umutex_lock_slow(umutex_t* m, uint32_t c) {
+    if (c != 2) c = __atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE);
+    while (c != 0) {
+        syscall_futex_wait(&m->state, 2, 0);
+        c = __atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE);
+    }
+}
+
+void umutex_lock(umutex_t* m) {
+    uint32_t c = cas32(&m->state, 0, 1);
+    if (c == 0) return;
+
+    // Short critical sections end quicker than a sleep and wake round trip
+    for (int i = 0; i < USYNC_SPIN && c == 1; i++) {
+        cpu_relax();
+        if (m->state == 0) {
+            c = cas32(&m->state, 0, 1);
+            if (c == 0) return;
+        } else {
+            c = m->state;
+        }
+    }
+    umutex_lock_slow(m, c);
+}
+
+bool umutex_trylock(umutex_t* m) {
+    return cas32(&m->state, 0, 1) == 0;
+}
+
+void umutex_unlock(umutex_t* m) {
+    if (__atomic_fetch_sub(&m->state, 1, __ATOMIC_RELEASE) != 1) {
+        __atomic_store_n(&m->state, 0, __ATOMIC_RELEASE);
+        syscall_futex_wake(&m->state, 1);
+    }
+}
+
+#pragma endregion
+
+#pragma region Condition variable
+
+/*
+ * ucond_wait_seq - Drops m, sleeps until seq moves past s or the timeout, then retakes m
+ */
+static int64_t ucond_wait_seq(ucond_t* c, umutex_t* m, uint64_t timeout_ns) {
+    uint32_t s = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+    umutex_unlock(m);
+    int64_t r = syscall_futex_wait(&c->seq, s, timeout_ns);
+
+    // Contended on purpose, a broadcast wakes every waiter at once
+    umutex_lock_slow(m, cas32(&m->state, 0, 2));
+    return r;
+}
+
+void ucond_wait(ucond_t* c, umutex_t* m) {
+    ucond_wait_seq(c, m, 0);
+}
+
+bool ucond_timedwait(ucond_t* c, umutex_t* m, uint64_t timeout_ns) {
+    if (timeout_ns == 0) return false;
+    return ucond_wait_seq(c, m, timeout_ns) != FUTEX_TIMEDOUT;
+}
+
+void ucond_signal(ucond_t* c) {
+    __atomic_fetch_add(&c->seq, 1, __ATOMIC_RELEASE);
+    syscall_futex_wake(&c->seq, 1);
+}
+
+void ucond_broadcast(ucond_t* c) {
+    __atomic_fetch_add(&c->seq, 1, __ATOMIC_RELEASE);
+    syscall_futex_wake(&c->seq, UINT32_ALL);
+}
+
+#pragma endregion
+
+#pragma region Semaphore
+
+void usem_init(usem_t* s, uint32_t count) {
+    s->count = count;
+    s->sleepers = 0;
+}
+
+bool usem_trywait(usem_t* s) {
+    uint32_t n = __atomic_load_n(&s->count, __ATOMIC_RELAXED);
+    while (n > 0) {
+        if (__atomic_compare_exchange_n(&s->count, &n, n - 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return true;
+    }
+    return false;
+}
+
+void usem_wait(usem_t* s) {
+    for (int i = 0; i < USYNC_SPIN; i++) {
+        if (usem_trywait(s)) return;
+        cpu_relax();
+    }
+
+    while (!usem_trywait(s)) {
+        __atomic_fetch_add(&s->sleepers, 1, __ATOMIC_SEQ_CST);
+        syscall_futex_wait(&s->count, 0, 0);
+        __atomic_fetch_sub(&s->sleepers, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void usem_post(usem_t* s) {
+    __atomic_fetch_add(&s->count, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&s->sleepers, __ATOMIC_SEQ_CST))
+        syscall_futex_wake(&s->count, 1);
+}
+
+#pragma endregion
@@ -0,0 +1,45 @@
+/*
+ * sync.h - Userspace mutex, condition variable and semaphore
+ *
+ * All three spin for a short while and then sleep in the kernel with
+ * SYS_FUTEX_WAIT, so a waiter holding no CPU burns no quanta. The
+ * uncontended paths never enter the kernel. Zero-initialized objects are
+ * ready to use (an unlocked mutex, a condvar, a semaphore at 0).
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Spins before sleeping, about a syscall round trip worth of pause
+#define USYNC_SPIN 100
+
+typedef struct {
+    volatile uint32_t state;    // 0 unlocked, 1 locked, 2 locked with possible sleepers
+} umutex_t;
+
+typedef struct {
+    volatile uint32_t seq;      // Bumped by every signal, sleepers wait for it to move
+} ucond_t;
+
+typedef struct {
+    volatile uint32_t count;
+    volatile uint32_t sleepers;
+} usem_t;
+
+void umutex_lock(umutex_t* m);
+bool umutex_trylock(umutex_t* m);
+void umutex_unlock(umutex_t* m);
+
+void ucond_wait(ucond_t* c, umutex_t* m);
+bool ucond_timedwait(ucond_t* c, umutex_t* m, uint64_t timeout_ns);
+void ucond_signal(ucond_t* c);
+void ucond_broadcast(ucond_t* c);
+
+void usem_init(usem_t* s, uint32_t count);
+void usem_wait(usem_t* s);
+bool usem_trywait(usem_t* s);
+void usem_post(usem_t* s);
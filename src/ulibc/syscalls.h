@@ -22,13 +22,64 @@
 #define SYS_SLEEP_MS 7
 #define SYS_READ 8
 #define SYS_TTY_CTRL 9
+#define SYS_MREMAP 10
+#define SYS_SET_PRIORITY 11
+#define SYS_SCHED_DEADLINE 12
+#define SYS_NANOSLEEP 13
+#define SYS_FUTEX_WAIT 14
+#define SYS_FUTEX_WAKE 15
+#define SYS_THREAD_CREATE 16
+#define SYS_THREAD_JOIN 17
+#define SYS_GETRUSAGE 18
+#define SYS_URING_SETUP 19
+#define SYS_URING_ENTER 20
+#define SYS_WRITEV 21
+#define SYS_READV 22
 
 #define TTY_CTRL_CLEAR    0
 #define TTY_CTRL_CURSOR   1
 #define TTY_CTRL_GET_DIMS 2
 
+// SYS_MREMAP flags
+#define MREMAP_MAYMOVE 1
+
+// SYS_GETRUSAGE targets
+#define RUSAGE_SELF   0
+#define RUSAGE_THREAD 1
+
+// SYS_FUTEX_WAIT results, -1 for a bad address
+#define FUTEX_WOKEN    0
+#define FUTEX_AGAIN    1
+#define FUTEX_TIMEDOUT 2
+
+// SYS_SET_PRIORITY levels, lower is more urgent
+#define PRIO_HIGHEST 8
+#define PRIO_DEFAULT 16
+#define PRIO_LOWEST  31
+
+// Most segments one SYS_WRITEV or SYS_READV takes
+#define IOV_MAX 64
+
 #define userspace __attribute__((section(".user_text")))
 
+// SYS_WRITEV and SYS_READV segment, mirrors the kernel's iovec_t
+typedef struct {
+    void* iov_base;
+    size_t iov_len;
+} iovec_t;
+
+// SYS_GETRUSAGE result, mirrors the kernel's rusage_t
+typedef struct {
+    uint64_t utime_ns;
+    uint64_t stime_ns;
+    uint64_t nvcsw;
+    uint64_t nivcsw;
+    uint64_t minflt;
+    uint64_t majflt;
+    uint64_t rss;
+    uint64_t peak_rss;
+} rusage_t;
+
 userspace static inline uint64_t sc0(uint64_t num) {
     uint64_t ret;
     __asm__ volatile(
@@ -90,6 +141,10 @@ userspace static inline void syscall_munmap(void* addr) {
     sc1(SYS_MUNMAP, (uint64_t)addr);
 }
 
+userspace static inline void* syscall_mremap(void* addr, size_t length, size_t flags) {
+    return (void*)sc3(SYS_MREMAP, (uint64_t)addr, (uint64_t)length, (uint64_t)flags);
+}
+
 userspace static inline void syscall_set_fs_base(uint64_t base) {
     sc1(SYS_SET_FS_BASE, base);
 }
@@ -98,10 +153,36 @@ userspace static inline void syscall_yield(void) {
     sc0(SYS_YIELD);
 }
 
+// Returns the previous level, or -1 outside PRIO_HIGHEST..PRIO_LOWEST
+userspace static inline int64_t syscall_set_priority(uint64_t prio) {
+    return (int64_t)sc1(SYS_SET_PRIORITY, prio);
+}
+
+// Reserve runtime_ns every period_ns, finished by deadline_ns into each period. 0 on success,
+// -1 if the parameters are invalid or no CPU has the bandwidth left. runtime_ns 0 drops the reservation.
+// syscall_yield() ends the current job early and sleeps until the next period.
+userspace static inline int64_t syscall_sched_deadline(uint64_t runtime_ns, uint64_t deadline_ns, uint64_t period_ns) {
+    return (int64_t)sc3(SYS_SCHED_DEADLINE, runtime_ns, deadline_ns, period_ns);
+}
+
 userspace static inline void syscall_sleep(uint64_t ms) {
     sc1(SYS_SLEEP_MS, ms);
 }
 
+userspace static inline void syscall_nanosleep(uint64_t ns) {
+    sc1(SYS_NANOSLEEP, ns);
+}
+
+// Sleeps while *addr == expected until woken or timeout_ns passes (0 waits forever), see FUTEX_*
+userspace static inline int64_t syscall_futex_wait(volatile uint32_t* addr, uint32_t expected, uint64_t timeout_ns) {
+    return (int64_t)sc3(SYS_FUTEX_WAIT, (uint64_t)addr, expected, timeout_ns);
+}
+
+// Wakes up to count threads sleeping on addr, returns how many
+userspace static inline uint64_t syscall_futex_wake(volatile uint32_t* addr, uint32_t count) {
+    return sc2(SYS_FUTEX_WAKE, (uint64_t)addr, count);
+}
+
 userspace static inline int64_t syscall_read(char* buf, size_t len) {
     return (int64_t)sc2(SYS_READ, (uint64_t)buf, (uint64_t)len);
 }
@@ -110,3 +191,40 @@ userspace static inline uint64_t syscall_tty_ctrl(uint64_t cmd, uint64_t arg) {
     return sc2(SYS_TTY_CTRL, cmd, arg);
 }
 
+// Starts entry(arg) on a new thread of this process, stack_top 0 for a kernel allocated stack.
+// Returns the new tid, or -1. The thread exits when entry returns.
+userspace static inline int64_t syscall_thread_create(void (*entry)(void*), void* arg, void* stack_top) {
+    return (int64_t)sc3(SYS_THREAD_CREATE, (uint64_t)entry, (uint64_t)arg, (uint64_t)stack_top);
+}
+
+// Sleeps until thread tid of this process has exited, -1 when tid is the caller
+userspace static inline int64_t syscall_thread_join(uint64_t tid) {
+    return (int64_t)sc1(SYS_THREAD_JOIN, tid);
+}
+
+// Fills *out with the usage of the whole process (RUSAGE_SELF) or the calling thread (RUSAGE_THREAD).
+// Memory and fault counts are per process either way. Returns 0, or -1.
+userspace static inline int64_t syscall_getrusage(uint64_t who, rusage_t* out) {
+    return (int64_t)sc2(SYS_GETRUSAGE, who, (uint64_t)out);
+}
+
+// Maps a submission ring of at least entries slots, flags from ulibc/uring.h. Returns its address, or -1.
+// Use uring_init() rather than calling this directly.
+userspace static inline int64_t syscall_uring_setup(uint64_t entries, uint64_t flags) {
+    return (int64_t)sc2(SYS_URING_SETUP, entries, flags);
+}
+
+// Runs up to to_submit queued entries and returns how many, or with a poller waits for min_complete results
+userspace static inline int64_t syscall_uring_enter(uint64_t to_submit, uint64_t min_complete, uint64_t flags) {
+    return (int64_t)sc3(SYS_URING_ENTER, to_submit, min_complete, flags);
+}
+
+// Writes iovcnt segments in order as one write, at most IOV_MAX. Returns the bytes written, or -1.
+userspace static inline int64_t syscall_writev(const iovec_t* iov, uint64_t iovcnt) {
+    return (int64_t)sc2(SYS_WRITEV, (uint64_t)iov, iovcnt);
+}
+
+// Reads a line into iovcnt segments, filling each before the next. Returns the bytes read, or -1.
+userspace static inline int64_t syscall_readv(const iovec_t* iov, uint64_t iovcnt) {
+    return (int64_t)sc2(SYS_READV, (uint64_t)iov, iovcnt);
+}
@@ -0,0 +1,224 @@
+/*
+ * thread.c - Userspace threads, thread local storage and a work queue pool
+ *
+ * A uthread_t is allocated by its creator and freed by whoever joins it.
+ * The new thread installs it as its own FS_BASE before running anything
+ * else. The kernel owns the stack and frees it when the thread is reaped.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#include <ulibc/thread.h>
+#include <ulibc/syscalls.h>
+#include <ulibc/stdlib.h>
+#include <ulibc/string.h>
+
+#pragma region Threads
+
+/*
+ * uthread_start - First code on a new thread: TLS first, then the user function
+ *
+ * Returning ends the thread through SYS_EXIT in userspace_start.
+ */
+static void uthread_start(void* arg) {
+    uthread_t* t = (uthread_t*)arg;
+    syscall_set_fs_base((uint64_t)t);
+    t->fn(t->arg);
+}
+
+uthread_t* uthread_create(void (*fn)(void*), void* arg) {
+    if (!fn) return NULL;
+
+    uthread_t* t = calloc(1, sizeof(uthread_t));
+    if (!t) return NULL;
+    t->self = t;
+    t->fn = fn;
+    t->arg = arg;
+
+    int64_t tid = syscall_thread_create(uthread_start, t, NULL);
+    if (tid < 0) {
+        free(t);
+        return NULL;
+    }
+    t->tid = (uint32_t)tid;
+    return t;
+}
+
+int uthread_join(uthread_t* t) {
+    if (!t) return -1;
+    if (syscall_thread_join(t->tid) < 0) return -1;
+    free(t);
+    return 0;
+}
+
+/*
+ * uthread_attach - Gives a thread the kernel started directly its own uthread_t and TLS
+ */
+uthread_t* uthread_attach(void) {
+    uthread_t* t = calloc(1, sizeof(uthread_t));
+    if (!t) return NULL;
+    t->self = t;
+    syscall_set_fs_base((uint64_t)t);
+    return t;
+}
+
+/*
+ * uthread_self - The calling thread's uthread_t, only valid after uthread_create or uthread_attach
+ */
+uthread_t* uthread_self(void) {
+    uthread_t* t;
+    __asm__ volatile("mov %%fs:0, %0" : "=r"(t));
+    return t;
+}
+
+#pragma endregion
+
+#pragma region Pool
+
+/*
+ * upool_worker - Runs queued tasks until the pool stops and the queue is empty
+ */
+static void upool_worker(void* arg) {
+    upool_t* p = (upool_t*)arg;
+
+    umutex_lock(&p->lock);
+    while (1) {
+        while (!p->head && !p->stop)
+            ucond_wait(&p->work, &p->lock);
+        if (!p->head) break;
+
+        upool_task_t* task = p->head;
+        p->head = task->next;
+        if (!p->head) p->tail = NULL;
+        umutex_unlock(&p->lock);
+
+        task->fn(task->arg);
+        free(task);
+
+        umutex_lock(&p->lock);
+        if (--p->pending == 0) ucond_broadcast(&p->done);
+    }
+    umutex_unlock(&p->lock);
+}
+
+bool upool_init(upool_t* p, uint32_t nthreads) {
+    if (nthreads == 0 || nthreads > UPOOL_MAX_THREADS) return false;
+    memset(p, 0, sizeof(*p));
+
+    for (uint32_t i = 0; i < nthreads; i++) {
+        p->threads[i] = uthread_create(upool_worker, p);
+        if (!p->threads[i]) {
+            upool_destroy(p);
+            return false;
+        }
+        p->nthreads++;
+    }
+    return true;
+}
+
+bool upool_submit(upool_t* p, void (*fn)(void*), void* arg) {
+    upool_task_t* task = malloc(sizeof(upool_task_t));
+    if (!task) return false;
+    task->fn = fn;
+    task->arg = arg;
+    task->next = NULL;
+
+    umutex_lock(&p->lock);
+    if (p->tail) p->tail->next = task;
+    else p->head = task;
+    p->tail = task;
+    p->pending++;
+    ucond_signal(&p->work);
+    umutex_unlock(&p->lock);
+    return true;
+}
+
+/*
+ * upool_wait - Sleeps until every task submitted so far has finished
+ */
+void upool_wait(upool_t* p) {
+    umutex_lock(&p->lock);
+    while (p->pending)
+        ucond_wait(&p->done, &p->lock);
+    umutex_unlock(&p->lock);
+}
+
+/*
+ * upool_destroy - Lets the workers drain the queue, then joins them
+ */
+void upool_destroy(upool_t* p) {
+    umutex_lock(&p->lock);
+    p->stop = true;
+    ucond_broadcast(&p->work);
+    umutex_unlock(&p->lock);
+
+    for (uint32_t i = 0; i < p->nthreads; i++)
+        uthread_join(p->threads[i]);
+    p->nthreads = 0;
+}
+
+#pragma endregion
+
+#pragma region Parallel for
+
+typedef struct {
+    volatile size_t next;           // First index nobody has claimed yet
+    size_t end;
+    size_t grain;
+    void (*body)(size_t lo, size_t hi, void* arg);
+    void* arg;
+    volatile uint32_t helpers;      // Helper tasks still running
+} upool_range_t;
+
+/*
+ * upool_range_run - Claims and runs chunks until the range is used up
+ */
+static void upool_range_run(upool_range_t* r) {
+    while (1) {
+        size_t lo = __atomic_fetch_add(&r->next, r->grain, __ATOMIC_RELAXED);
+        if (lo >= r->end) break;
+        size_t hi = r->end - lo < r->grain ? r->end : lo + r->grain;
+        r->body(lo, hi, r->arg);
+    }
+}
+
+static void upool_range_task(void* arg) {
+    upool_range_t* r = (upool_range_t*)arg;
+    upool_range_run(r);
+    if (__atomic_sub_fetch(&r->helpers, 1, __ATOMIC_ACQ_REL) == 0)
+        syscall_futex_wake(&r->helpers, 1);
+}
+
+/*
+ * upool_parallel_for - Calls body over [begin, end) in chunks of grain indices, returns when all are done
+ *
+ * The caller works through chunks too, so this also makes progress when
+ * every worker is busy with other tasks. At most one helper per worker is
+ * queued, and none for a range that fits in a single chunk.
+ */
+void upool_parallel_for(upool_t* p, size_t begin, size_t end, size_t grain,
+                        void (*body)(size_t lo, size_t hi, void* arg), void* arg) {
+    if (begin >= end) return;
+    if (grain == 0) grain = 1;
+
+    upool_range_t r = { .next = begin, .end = end, .grain = grain, .body = body, .arg = arg, .helpers = 0 };
+
+    size_t chunks = (end - begin - 1) / grain + 1;
+    uint32_t helpers = p->nthreads;
+    if (chunks - 1 < helpers) helpers = (uint32_t)(chunks - 1);
+
+    r.helpers = helpers;
+    for (uint32_t i = 0; i < helpers; i++) {
+        if (!upool_submit(p, upool_range_task, &r))
+            __atomic_sub_fetch(&r.helpers, 1, __ATOMIC_ACQ_REL);
+    }
+
+    upool_range_run(&r);
+
+    // r lives on this stack, every helper must be done with it
+    uint32_t h;
+    while ((h = __atomic_load_n(&r.helpers, __ATOMIC_ACQUIRE)) != 0)
+        syscall_futex_wait(&r.helpers, h, 0);
+}
+
+#pragma endregion
@@ -0,0 +1,62 @@
+/*
+ * thread.h - Userspace threads, thread local storage and a work queue pool
+ *
+ * uthread_create() spawns a thread in the calling process with
+ * SYS_THREAD_CREATE on a kernel allocated stack, and points its FS_BASE at
+ * its uthread_t, so fs:0 holds the thread pointer as the x86-64 TLS ABI
+ * expects. uthread_join() sleeps in SYS_THREAD_JOIN until the thread is gone.
+ *
+ * upool_t keeps a fixed set of workers pulling tasks off one FIFO guarded by
+ * a umutex_t. upool_parallel_for() splits an index range into chunks that the
+ * workers and the caller claim with an atomic cursor.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <ulibc/sync.h>
+
+#define UTHREAD_TLS_SLOTS 8
+#define UPOOL_MAX_THREADS 16
+
+typedef struct uthread {
+    struct uthread* self;           // fs:0, must stay the first field
+    uint32_t tid;
+    void (*fn)(void*);
+    void* arg;
+    void* tls[UTHREAD_TLS_SLOTS];   // Free for the program, zeroed at start
+} uthread_t;
+
+uthread_t* uthread_create(void (*fn)(void*), void* arg);
+int uthread_join(uthread_t* t);
+uthread_t* uthread_attach(void);
+uthread_t* uthread_self(void);
+
+typedef struct upool_task {
+    void (*fn)(void*);
+    void* arg;
+    struct upool_task* next;
+} upool_task_t;
+
+typedef struct {
+    umutex_t lock;
+    ucond_t work;                   // Signalled on submit and shutdown
+    ucond_t done;                   // Broadcast when pending drops to 0
+    upool_task_t* head;
+    upool_task_t* tail;
+    uint32_t pending;               // Queued plus running tasks
+    bool stop;
+    uint32_t nthreads;
+    uthread_t* threads[UPOOL_MAX_THREADS];
+} upool_t;
+
+bool upool_init(upool_t* p, uint32_t nthreads);
+bool upool_submit(upool_t* p, void (*fn)(void*), void* arg);
+void upool_wait(upool_t* p);
+void upool_destroy(upool_t* p);
+void upool_parallel_for(upool_t* p, size_t begin, size_t end, size_t grain,
+                        void (*body)(size_t lo, size_t hi, void* arg), void* arg);
@@ -0,0 +1,54 @@
+/*
+ * time.c - Monotonic clock read straight from the kernel's time page
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#include <ulibc/time.h>
+
+#define VVAR ((const vvar_t*)VVAR_ADDR)
+
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/*
+ * uptime_ns - Nanoseconds since the kernel booted
+ *
+ * Retries while the kernel is rewriting the page. Before timer calibration
+ * mult is 0 and so is the result.
+ */
+uint64_t uptime_ns(void) {
+    const vvar_t* v = VVAR;
+    uint32_t seq;
+    uint64_t ns;
+
+    do {
+        seq = __atomic_load_n(&v->seq, __ATOMIC_ACQUIRE);
+        uint64_t base = v->boot_tsc;
+        uint64_t mult = v->mult;
+        uint32_t shift = v->shift;
+        uint64_t tsc = rdtsc();
+        ns = tsc > base ? (uint64_t)(((unsigned __int128)(tsc - base) * mult) >> shift) : 0;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&v->seq, __ATOMIC_RELAXED));
+
+    return ns;
+}
+
+uint64_t uptime_ms(void) {
+    return uptime_ns() / 1000000;
+}
+
+/*
+ * clock_gettime - CLOCK_MONOTONIC only, -1 for any other clock
+ */
+int clock_gettime(int clock, timespec_t* ts) {
+    if (clock != CLOCK_MONOTONIC || !ts) return -1;
+    uint64_t ns = uptime_ns();
+    ts->tv_sec = (int64_t)(ns / 1000000000ULL);
+    ts->tv_nsec = (int64_t)(ns % 1000000000ULL);
+    return 0;
+}
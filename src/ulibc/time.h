@@ -0,0 +1,35 @@
+/*
+ * time.h - Monotonic clock read straight from the kernel's time page
+ *
+ * The kernel maps a read only page at VVAR_ADDR into every process with
+ * the TSC value at boot and a fixed point TSC to ns factor. uptime_ns()
+ * is one rdtsc and a multiply, no syscall. The layout mirrors the
+ * kernel's vvar_t in kernel/sys/vvar.h.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define VVAR_ADDR 0x00007FFFFFFFE000ULL
+
+#define CLOCK_MONOTONIC 1
+
+typedef struct {
+    volatile uint32_t seq;  // Odd while the kernel rewrites the page
+    uint32_t shift;
+    uint64_t boot_tsc;
+    uint64_t mult;
+    uint64_t tsc_per_ms;
+} vvar_t;
+
+typedef struct {
+    int64_t tv_sec;
+    int64_t tv_nsec;
+} timespec_t;
+
+uint64_t uptime_ns(void);
+uint64_t uptime_ms(void);
+int clock_gettime(int clock, timespec_t* ts);
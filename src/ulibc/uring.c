@@ -0,0 +1,84 @@
+/*
+ * uring.c - Batched syscalls through shared submission and completion rings
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#include <ulibc/uring.h>
+#include <ulibc/syscalls.h>
+
+/*
+ * uring_init - Sets up the process's ring with at least entries slots, 0 on success or -1
+ */
+int uring_init(uring_t* ring, uint32_t entries, uint32_t flags) {
+    int64_t addr = syscall_uring_setup(entries, flags);
+    if (addr == -1) return -1;
+
+    ring->hdr = (uring_hdr_t*)addr;
+    ring->sqes = (uring_sqe_t*)((uint8_t*)ring->hdr + ring->hdr->sq_off);
+    ring->cqes = (uring_cqe_t*)((uint8_t*)ring->hdr + ring->hdr->cq_off);
+    ring->sq_tail = 0;
+    ring->cq_head = 0;
+    ring->sqpoll = (flags & URING_SETUP_SQPOLL) != 0;
+    return 0;
+}
+
+/*
+ * uring_get_sqe - Next free submission slot, NULL while the kernel has not consumed a full ring's worth
+ */
+uring_sqe_t* uring_get_sqe(uring_t* ring) {
+    uint32_t head = __atomic_load_n(&ring->hdr->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_tail - head >= ring->hdr->sq_entries) return NULL;
+    return &ring->sqes[ring->sq_tail++ & (ring->hdr->sq_entries - 1)];
+}
+
+/*
+ * uring_prep - Fills sqe with op and its syscall arguments
+ */
+void uring_prep(uring_sqe_t* sqe, uint32_t op, uint64_t a0, uint64_t a1, uint64_t a2, uint64_t user_data) {
+    sqe->op = op;
+    sqe->flags = 0;
+    sqe->user_data = user_data;
+    sqe->args[0] = a0;
+    sqe->args[1] = a1;
+    sqe->args[2] = a2;
+}
+
+/*
+ * uring_submit - Publishes the prepared entries, returns what SYS_URING_ENTER did, 0 if it was not needed
+ *
+ * Without a poller the entries have all completed on return. With one, this
+ * only enters the kernel to wake it or to wait for min_complete results.
+ */
+int64_t uring_submit(uring_t* ring, uint32_t min_complete) {
+    uring_hdr_t* hdr = ring->hdr;
+    __atomic_store_n(&hdr->sq_tail, ring->sq_tail, __ATOMIC_RELEASE);
+
+    if (!ring->sqpoll) {
+        uint32_t pending = ring->sq_tail - __atomic_load_n(&hdr->sq_head, __ATOMIC_ACQUIRE);
+        if (!pending && !min_complete) return 0;
+        return syscall_uring_enter(pending, min_complete, 0);
+    }
+
+    // Pairs with the poller setting the flag before it rechecks the tail
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint32_t flags = (__atomic_load_n(&hdr->flags, __ATOMIC_RELAXED) & URING_SQ_NEED_WAKEUP) ? URING_ENTER_SQ_WAKEUP : 0;
+    if (!flags && !min_complete) return 0;
+    return syscall_uring_enter(0, min_complete, flags);
+}
+
+/*
+ * uring_peek_cqe - Oldest unconsumed completion, NULL if there is none
+ */
+uring_cqe_t* uring_peek_cqe(uring_t* ring) {
+    if (ring->cq_head == __atomic_load_n(&ring->hdr->cq_tail, __ATOMIC_ACQUIRE)) return NULL;
+    return &ring->cqes[ring->cq_head & (ring->hdr->cq_entries - 1)];
+}
+
+/*
+ * uring_cqe_seen - Hands the completion from uring_peek_cqe() back to the kernel
+ */
+void uring_cqe_seen(uring_t* ring) {
+    ring->cq_head++;
+    __atomic_store_n(&ring->hdr->cq_head, ring->cq_head, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,65 @@
+/*
+ * uring.h - Batched syscalls through shared submission and completion rings
+ *
+ * uring_init() maps the process's ring. Take a slot with uring_get_sqe(),
+ * fill it with uring_prep(), and uring_submit() hands every prepared entry
+ * to the kernel in a single SYS_URING_ENTER, or in none at all with
+ * URING_SETUP_SQPOLL while the kernel's poller is awake. Results come back
+ * in order through uring_peek_cqe() and uring_cqe_seen(). An op is a SYS_*
+ * number with its usual arguments, write, read, writev, readv, mmap,
+ * munmap, the sleeps and futex_wake are accepted. The layout mirrors kernel/sys/uring.h.
+ *
+ * Author: u/ApparentlyPlus
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define URING_SETUP_SQPOLL    1
+#define URING_ENTER_SQ_WAKEUP 1
+#define URING_SQ_NEED_WAKEUP  1
+
+#define URING_OP_NOP 0
+
+typedef struct {
+    uint32_t op;
+    uint32_t flags;
+    uint64_t user_data;
+    uint64_t args[3];
+} uring_sqe_t;
+
+typedef struct {
+    uint64_t user_data;
+    int64_t res;
+} uring_cqe_t;
+
+typedef struct {
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    volatile uint32_t flags;
+    uint32_t sq_off;
+    uint32_t cq_off;
+    uint32_t size;
+} uring_hdr_t;
+
+typedef struct {
+    uring_hdr_t* hdr;
+    uring_sqe_t* sqes;
+    uring_cqe_t* cqes;
+    uint32_t sq_tail;       // Prepared up to here, published by uring_submit()
+    uint32_t cq_head;
+    bool sqpoll;
+} uring_t;
+
+int uring_init(uring_t* ring, uint32_t entries, uint32_t flags);
+uring_sqe_t* uring_get_sqe(uring_t* ring);
+void uring_prep(uring_sqe_t* sqe, uint32_t op, uint64_t a0, uint64_t a1, uint64_t a2, uint64_t user_data);
+int64_t uring_submit(uring_t* ring, uint32_t min_complete);
+uring_cqe_t* uring_peek_cqe(uring_t* ring);
+void uring_cqe_seen(uring_t* ring);